@@ -92,6 +92,10 @@ f.close(); // close file separately -- r should not be used after this point
 #include <limits.h>
 #include <ctype.h>
 #include <errno.h>
+#include <string.h>
+
+#include "read_table_memory.h"
+#include "read_table_float.h"
 
 #ifdef __cplusplus
 #include <cmath>
@@ -108,11 +112,11 @@ static inline int _isinf(double x) { return isinf(x); } */
 
 /* possible error codes */
 enum read_table_errors {T_OK = 0, T_EOF = 1, T_EOL, T_MISSING, T_FORMAT,
-	T_OVERFLOW, T_NAN, T_TYPE, T_COPIED, T_ERROR_FOPEN, T_READ_ERROR};
+	T_OVERFLOW, T_NAN, T_TYPE, T_COPIED, T_ERROR_FOPEN, T_READ_ERROR, T_WRITE_ERROR, T_MEMORY};
 static const char * const error_desc[] = {"No error", "End of file", "Unexpected end of line",
 		"Missing value", "Invalid value", "Overflow or underflow", "NaN or infinity read",
 		"Unknown conversion requested", "Invalidated instance", "Error opening file",
-		"Error reading input"};
+		"Error reading input", "Error writing output", "Out of memory or memory limit exceeded"};
 
 /* convert error code to string description */
 static const char* get_error_desc(enum read_table_errors err) {
@@ -140,6 +144,10 @@ static const char* get_error_desc(enum read_table_errors err) {
 			return error_desc[9];
 		case T_READ_ERROR:
 			return error_desc[10];
+		case T_WRITE_ERROR:
+			return error_desc[11];
+		case T_MEMORY:
+			return error_desc[12];
 		default:
 			return unkn;
 	}
@@ -159,7 +167,10 @@ typedef struct read_table_s {
 	enum read_table_errors last_error; /* error code of the last operation */
 	char delim; /* delimiter to use; 0 means any blank (space or tab) note: cannot be newline */
 	char comment; /* character to indicate comments; 0 means none */
+	char decimal; /* decimal separator for doubles; with '.', strtod() is used (depending on the locale), otherwise read_table_strtod_sep() */
 	uint8_t flags; /* further flags: whether reading a NaN or INF for double values is considered and error */
+	read_table_mem* mem; /* optional memory account for the buffer (see read_table_memory.h) */
+	size_t mem_tracked; /* size of the buffer counted in mem and the global account */
 } read_table;
 
 /* flags used above */
@@ -178,9 +189,28 @@ static void read_table_init(read_table* r, FILE* f_) {
 	r->last_error = T_OK;
 	r->delim = 0;
 	r->comment = 0;
+	r->decimal = '.';
 	r->fn = 0;
 	r->base = 10;
 	r->flags = READ_TABLE_ALLOW_NAN_INF;
+	r->mem = 0;
+	r->mem_tracked = 0;
+}
+
+/* free the line buffer, releasing it from the memory accounts */
+static void read_table_free_buf(read_table* r) {
+	if(r->buf) free(r->buf);
+	r->buf = 0;
+	r->buf_size = 0;
+	read_table_mem_update(r->mem, &(r->mem_tracked), 0);
+}
+
+/* reset the buffer in a copy of r (after copying the whole struct), so
+ * that the copy allocates (and accounts for) its own */
+static void read_table_reset_buf(read_table* r) {
+	r->buf = 0;
+	r->buf_size = 0;
+	r->mem_tracked = 0;
 }
 
 /* create new read_table object, reading from the given file
@@ -215,12 +245,48 @@ static read_table* read_table_new_fn(const char* fn_) {
  * note that this does not close the file, that is the caller's responsibility! */
 static void read_table_free(read_table* r) {
 	if(r) {
-		if(r->buf) free(r->buf);
+		read_table_free_buf(r);
 		if(r->flags & READ_TABLE_CLOSE_FILE) if(r->f) fclose(r->f);
 		free(r);
 	}
 }
 
+/* read one line into r->buf similarly to getline(), but counting the
+ * buffer in the memory accounts before growing it; returns the length of
+ * the line, or -1 at the end of the input or on error (r->last_error is
+ * set to T_MEMORY if the buffer could not be grown) */
+static ssize_t read_table_getline_limited(read_table* r) {
+	size_t len = 0;
+	int c;
+	flockfile(r->f);
+	while(1) {
+		if(len + 1 >= r->buf_size) {
+			size_t size = r->buf_size ? 2 * r->buf_size : 128;
+			char* tmp;
+			if(read_table_mem_update(r->mem, &(r->mem_tracked), size)) {
+				r->last_error = T_MEMORY;
+				break;
+			}
+			tmp = (char*)realloc(r->buf, size);
+			if(!tmp) {
+				read_table_mem_update(r->mem, &(r->mem_tracked), r->buf_size);
+				r->last_error = T_MEMORY;
+				break;
+			}
+			r->buf = tmp;
+			r->buf_size = size;
+		}
+		c = getc_unlocked(r->f);
+		if(c == EOF) break;
+		r->buf[len++] = (char)c;
+		if(c == '\n') break;
+	}
+	funlockfile(r->f);
+	if(r->last_error == T_MEMORY || !len) return -1;
+	r->buf[len] = 0;
+	return (ssize_t)len;
+}
+
 /* read a new line (discarding any remaining data in the current line)
  * returns 0 if a line was read, 1 on failure
  * note that failure can mean end of file, which should be checked separately
@@ -230,10 +296,25 @@ static void read_table_free(read_table* r) {
 static int read_table_line_skip(read_table* r, int skip) {
 	if(!r) return 1;
 	if(r->last_error == T_EOF || r->last_error == T_COPIED ||
-		r->last_error == T_ERROR_FOPEN) return 1;
+		r->last_error == T_ERROR_FOPEN || r->last_error == T_MEMORY) return 1;
 	if(!(r->f)) { r->last_error = T_READ_ERROR; return 1; }
 	while(1) {
-		ssize_t len = getline(&(r->buf),&(r->buf_size),r->f);
+		ssize_t len;
+		if(read_table_mem_has_limit(r->mem)) {
+			/* note: getline() could allocate any amount of memory */
+			len = read_table_getline_limited(r);
+			if(r->last_error == T_MEMORY) {
+				r->line_len = 0;
+				return 1;
+			}
+		}
+		else len = getline(&(r->buf),&(r->buf_size),r->f);
+		if(r->buf_size != r->mem_tracked &&
+				read_table_mem_update(r->mem, &(r->mem_tracked), r->buf_size)) {
+			r->last_error = T_MEMORY;
+			r->line_len = 0;
+			return 1;
+		}
 		if(len < 0) {
 			r->last_error = T_EOF;
 			r->line_len = 0; /* ensure the buffer will never be accessed */
@@ -262,6 +343,162 @@ static inline int read_table_line(read_table* r) {
 	return read_table_line_skip(r,1);
 }
 
+
+/* reading lines in batches: data is read in large blocks, and a view
+ * (pointer and length) of each line is returned, avoiding the overhead
+ * of reading one line at a time */
+#ifndef READ_TABLE_BLOCK_SIZE
+#define READ_TABLE_BLOCK_SIZE (64UL*1024UL)
+#endif
+
+/* one line returned by read_table_lines(); line endings are not included
+ * in len, but the line is always followed by a newline or a 0 byte */
+typedef struct read_table_line_view_s {
+	const char* str;
+	size_t len;
+	uint64_t line; /* line number in the input */
+} read_table_line_view;
+
+/* buffer for reading lines in batches */
+typedef struct read_table_batch_s {
+	char* data; /* block of data read from the input */
+	size_t size; /* size of data (one more byte is allocated) */
+	size_t pos; /* start of data not processed yet */
+	size_t end; /* end of valid data */
+	read_table_line_view* lines; /* lines read in the last call to read_table_lines() */
+	size_t nlines; /* number of lines in the previous array */
+	size_t max_lines; /* maximum number of lines to read at once */
+	read_table_mem* mem; /* memory account used for data (taken from the reader) */
+	size_t mem_tracked; /* size of data counted in mem */
+} read_table_batch;
+
+/* initialize batch to read at most max_lines lines at once;
+ * returns 0 on success, 1 on memory allocation error */
+static int read_table_batch_init(read_table_batch* b, size_t max_lines) {
+	b->data = 0;
+	b->size = 0;
+	b->pos = 0;
+	b->end = 0;
+	b->nlines = 0;
+	b->max_lines = max_lines ? max_lines : 1;
+	b->mem = 0;
+	b->mem_tracked = 0;
+	b->lines = (read_table_line_view*)malloc(b->max_lines * sizeof(read_table_line_view));
+	return b->lines ? 0 : 1;
+}
+
+static void read_table_batch_free(read_table_batch* b) {
+	if(b->data) free(b->data);
+	if(b->lines) free(b->lines);
+	b->data = 0;
+	b->lines = 0;
+	b->size = 0;
+	b->nlines = 0;
+	read_table_mem_update(b->mem, &(b->mem_tracked), 0);
+}
+
+/* read more data into b, keeping the unprocessed part
+ * returns 0 on success, 1 if no more data could be read; sets
+ * r->last_error to T_READ_ERROR on error */
+static int read_table_batch_fill(read_table* r, read_table_batch* b) {
+	if(b->pos > 0) {
+		if(b->pos < b->end) memmove(b->data, b->data + b->pos, b->end - b->pos);
+		b->end -= b->pos;
+		b->pos = 0;
+	}
+	if(b->end == b->size) {
+		/* note: a line can be longer than the block size */
+		size_t size = b->size ? 2*b->size : READ_TABLE_BLOCK_SIZE;
+		if(!b->mem_tracked) b->mem = r->mem;
+		if(read_table_mem_update(b->mem, &(b->mem_tracked), size + 1)) {
+			r->last_error = T_MEMORY;
+			return 1;
+		}
+		char* data = (char*)realloc(b->data, size + 1);
+		if(!data) {
+			read_table_mem_update(b->mem, &(b->mem_tracked), b->size ? b->size + 1 : 0);
+			r->last_error = T_MEMORY;
+			return 1;
+		}
+		b->data = data;
+		b->size = size;
+	}
+	size_t n = fread(b->data + b->end, 1, b->size - b->end, r->f);
+	if(ferror(r->f)) { r->last_error = T_READ_ERROR; return 1; }
+	b->end += n;
+	b->data[b->end] = 0;
+	return n ? 0 : 1;
+}
+
+/* read up to b->max_lines lines into b->lines, setting b->nlines;
+ * empty and comment-only lines are skipped
+ * the lines are valid until the next call, and can be parsed by
+ * setting them as the current line of a separate read_table struct
+ * with read_table_set_line() (see below)
+ * note: this should not be mixed with read_table_line() on the same
+ * read_table struct, as the data stored in b would be skipped
+ * returns 0 if any lines were read, 1 at the end of the input or on error */
+static int read_table_lines(read_table* r, read_table_batch* b) {
+	if(!r || !b) return 1;
+	b->nlines = 0;
+	if(r->last_error == T_EOF || r->last_error == T_COPIED ||
+		r->last_error == T_ERROR_FOPEN || r->last_error == T_READ_ERROR ||
+		r->last_error == T_MEMORY) return 1;
+	if(!(r->f)) { r->last_error = T_READ_ERROR; return 1; }
+	while(b->nlines < b->max_lines) {
+		char* start = b->data + b->pos;
+		size_t len;
+		size_t next;
+		char* nl = (b->pos < b->end) ? (char*)memchr(start, '\n', b->end - b->pos) : 0;
+		if(nl) {
+			len = nl - start;
+			next = b->pos + len + 1;
+		}
+		else {
+			/* lines already read point to the buffer, it can only be
+			 * refilled if there are none */
+			if(b->nlines) break;
+			if(read_table_batch_fill(r, b) == 0) continue;
+			if(r->last_error == T_READ_ERROR || r->last_error == T_MEMORY) return 1;
+			if(b->pos == b->end) break; /* end of input */
+			/* last line without a newline at the end */
+			start = b->data + b->pos;
+			len = b->end - b->pos;
+			next = b->end;
+		}
+		r->line++;
+		b->pos = next;
+		if(len && start[len-1] == '\r') len--;
+		/* skip empty and comment-only lines */
+		size_t i = 0;
+		for(; i < len; i++) if( ! (start[i] == ' ' || start[i] == '\t') ) break;
+		if(i == len || (r->comment && start[i] == r->comment)) continue;
+		read_table_line_view* v = b->lines + b->nlines;
+		v->str = start;
+		v->len = len;
+		v->line = r->line;
+		b->nlines++;
+	}
+	if(b->nlines == 0) {
+		r->last_error = T_EOF;
+		return 1;
+	}
+	r->last_error = T_OK;
+	return 0;
+}
+
+/* set the given line to be parsed by r; r->buf will point to the line,
+ * so r should not own a buffer (i.e. it should not be used for reading
+ * with read_table_line()) */
+static void read_table_set_line(read_table* r, const read_table_line_view* v) {
+	r->buf = (char*)v->str;
+	r->line_len = v->len;
+	r->line = v->line;
+	r->pos = 0;
+	r->col = 0;
+	r->last_error = T_OK;
+}
+
 /* checks to be performed before trying to convert a field */
 static int read_table_pre_check(read_table* r) {
 	if(!r) return 1;
@@ -269,7 +506,7 @@ static int read_table_pre_check(read_table* r) {
 		r->last_error == T_READ_ERROR || r->last_error == T_ERROR_FOPEN) return 1;
 	/* 1. skip any blanks */
 	for(;r->pos<r->line_len;r->pos++)
-		if( ! (r->buf[r->pos] == ' ' || r->buf[r->pos] == '\t') ) break;
+		if( ! ((r->buf[r->pos] == ' ' || r->buf[r->pos] == '\t') && r->buf[r->pos] != r->delim) ) break; /* note: delimiter can be a tab */
 	/* 2. check for end of line or comment */
 	if(r->pos == r->line_len || r->buf[r->pos] == '\n' || (r->comment && r->buf[r->pos] == r->comment) ) {
 		r->last_error = T_EOL;
@@ -298,7 +535,7 @@ static int read_table_post_check(read_table* r, char* c2) {
 	/* 1. skip the converted number and any blanks */
 	int have_blank = 0;
 	for(r->pos = c2 - r->buf;r->pos<r->line_len;r->pos++)
-		if( ! (r->buf[r->pos] == ' ' || r->buf[r->pos] == '\t') ) break;
+		if( ! ((r->buf[r->pos] == ' ' || r->buf[r->pos] == '\t') && r->buf[r->pos] != r->delim) ) break; /* note: delimiter can be a tab */
 		else have_blank = 1;
 	r->last_error = T_OK;
 	/* 2. check for end of line -- this is not a problem here */
@@ -333,14 +570,21 @@ static int read_table_skip(read_table* r) {
 	
 	if(r->delim) {
 		/* if there is a delimiter, just advance until after the next one */
-		if(r->pos == r->line_len) {
+		if(r->pos == r->line_len || r->last_error == T_EOL) {
 			r->last_error = T_EOL;
 			return 1;
 		}
 		for(;r->pos<r->line_len;r->pos++) if(r->buf[r->pos] == r->delim || r->buf[r->pos] == '\n' ||
 			(r->comment && r->buf[r->pos] == r->comment)) break;
 		
+		r->col++;
 		if(r->pos<r->line_len && r->buf[r->pos] == r->delim) r->pos++; /* note: we do not care what is after the delimiter */
+		else {
+			r->last_error = T_EOL; /* this was the last field (same as for strings) */
+			return 0;
+		}
+		r->last_error = T_OK;
+		return 0;
 	}
 	else {
 		/* no delimiter, skip any blanks, then skip all non-blanks */
@@ -580,13 +824,19 @@ static inline int read_table_uint16(read_table* r, uint16_t* i) {
 	return read_table_uint16_limits(r,i,0,UINT16_MAX);
 }
 
+/* convert the number at the current position with the decimal separator set in r */
+static inline double read_table_strtod(read_table* r, char** c2) {
+	if(r->decimal == '.') return strtod(r->buf + r->pos, c2);
+	return read_table_strtod_sep(r->buf + r->pos, c2, r->decimal);
+}
+
 /* try to convert the next value to a double precision float value
  * return 0 on success, 1 on error */
 static int read_table_double(read_table* r, double* d) {
 	if(read_table_pre_check(r)) return 1;
 	errno = 0;
 	char* c2;
-	*d = strtod(r->buf + r->pos, &c2);
+	*d = read_table_strtod(r, &c2);
 	/* advance position after the number, check if there is proper field separator */
 	if(read_table_post_check(r,c2)) return 1;
 	if( (r->flags & READ_TABLE_ALLOW_NAN_INF) == 0) {
@@ -601,7 +851,7 @@ static int read_table_double_limits(read_table* r, double* d, double min, double
 	if(read_table_pre_check(r)) return 1;
 	errno = 0;
 	char* c2;
-	*d = strtod(r->buf + r->pos, &c2);
+	*d = read_table_strtod(r, &c2);
 	if(read_table_post_check(r,c2)) return 1;
 	if(isnan(*d)) {
 		r->last_error = T_NAN;
@@ -617,6 +867,100 @@ static int read_table_double_limits(read_table* r, double* d, double min, double
 }
 
 
+/* generic interface for reading values with the type given at runtime
+ * (e.g. from a schema supplied by the user) */
+enum read_table_types {RT_SKIP = 0, RT_STRING, RT_INT16, RT_UINT16, RT_INT32,
+	RT_UINT32, RT_INT64, RT_UINT64, RT_DOUBLE};
+
+/* one value of any of the above types */
+typedef union read_table_value_u {
+	int16_t i16;
+	uint16_t u16;
+	int32_t i32;
+	uint32_t u32;
+	int64_t i64;
+	uint64_t u64;
+	double d;
+	struct { const char* str; size_t len; } s; /* note: points to the line buffer */
+} read_table_value;
+
+/* description of one column to be read */
+typedef struct read_table_col_s {
+	enum read_table_types type;
+	int has_bounds; /* if nonzero, min and max are used as limits */
+	read_table_value min; /* note: the member corresponding to type is used */
+	read_table_value max;
+} read_table_col;
+
+/* read the next field as given by c, storing the value in val
+ * return 0 on success, 1 on error */
+static int read_table_read_col(read_table* r, const read_table_col* c, read_table_value* val) {
+	if(!(r && c && val)) return 1;
+	switch(c->type) {
+		case RT_SKIP:
+			return read_table_skip(r);
+		case RT_STRING:
+			return read_table_string(r, &(val->s.str), &(val->s.len));
+		case RT_INT16:
+			return c->has_bounds ? read_table_int16_limits(r, &(val->i16), c->min.i16, c->max.i16) :
+				read_table_int16(r, &(val->i16));
+		case RT_UINT16:
+			return c->has_bounds ? read_table_uint16_limits(r, &(val->u16), c->min.u16, c->max.u16) :
+				read_table_uint16(r, &(val->u16));
+		case RT_INT32:
+			return c->has_bounds ? read_table_int32_limits(r, &(val->i32), c->min.i32, c->max.i32) :
+				read_table_int32(r, &(val->i32));
+		case RT_UINT32:
+			return c->has_bounds ? read_table_uint32_limits(r, &(val->u32), c->min.u32, c->max.u32) :
+				read_table_uint32(r, &(val->u32));
+		case RT_INT64:
+			return c->has_bounds ? read_table_int64_limits(r, &(val->i64), c->min.i64, c->max.i64) :
+				read_table_int64(r, &(val->i64));
+		case RT_UINT64:
+			return c->has_bounds ? read_table_uint64_limits(r, &(val->u64), c->min.u64, c->max.u64) :
+				read_table_uint64(r, &(val->u64));
+		case RT_DOUBLE:
+			return c->has_bounds ? read_table_double_limits(r, &(val->d), c->min.d, c->max.d) :
+				read_table_double(r, &(val->d));
+		default:
+			r->last_error = T_TYPE;
+			return 1;
+	}
+}
+
+/* check that there is no more data in the current line (after reading
+ * all expected fields); return 0 if the line ended, 1 if there is more
+ * data (and set the error code to T_FORMAT); with an explicit delimiter,
+ * a delimiter at the end of the line (i.e. an empty last field) is also
+ * considered extra data */
+static int read_table_check_end(read_table* r) {
+	if(!r) return 1;
+	if(r->last_error == T_EOL) {
+		/* the last field ended the line */
+		r->last_error = T_OK;
+		return 0;
+	}
+	if(read_table_pre_check(r) == 0) {
+		r->last_error = T_FORMAT;
+		return 1;
+	}
+	if(r->last_error != T_EOL) return 1;
+	if(r->delim) {
+		/* check if the last field was followed by a delimiter */
+		size_t pos = r->pos;
+		for(; pos > 0; pos--)
+			if( ! ((r->buf[pos-1] == ' ' || r->buf[pos-1] == '\t') && r->buf[pos-1] != r->delim) ) break;
+		if(pos > 0 && r->buf[pos-1] == r->delim) {
+			r->pos = pos;
+			r->last_error = T_FORMAT;
+			return 1;
+		}
+	}
+	r->last_error = T_OK;
+	return 0;
+}
+
+
 /* auxilliary functions for setting parameters and getting diagnostic */
 
 /* set delimiter character (default is spaces and tabs) */
@@ -637,6 +981,17 @@ static char read_table_get_comment(const read_table* r) {
 	if(r) return r->comment;
 	else return 0;
 }
+/* set the decimal separator used for reading doubles (default is '.',
+ * using the locale); any other character (e.g. ',' with ';' as the
+ * delimiter) is handled without depending on the locale */
+static void read_table_set_decimal(read_table* r, char decimal) {
+	if(r) r->decimal = decimal ? decimal : '.';
+}
+/* get the decimal separator */
+static char read_table_get_decimal(const read_table* r) {
+	if(r) return r->decimal;
+	else return '.';
+}
 
 /* get last error code */
 static enum read_table_errors read_table_get_last_error(const read_table* r) {
@@ -701,6 +1056,7 @@ static void read_table_reset_pos(read_table* r) {
 #include <utility>
 #include <string>
 #include <sstream>
+#include <vector>
 
 
 template<class T>
@@ -838,6 +1194,74 @@ template<> int read_table_next(read_table* r, read_bounds_t<std::pair<double,dou
 }
 
 
+/* rows with a variable number of values, stored in compressed sparse row
+ * (CSR) format: the values in row i are values[offsets[i]] to
+ * values[offsets[i+1]-1] */
+template<class T>
+struct ragged_array {
+	std::vector<uint64_t> offsets; /* start of each row, always starts with 0 */
+	std::vector<T> values; /* values of all rows */
+	ragged_array():offsets(1,0) { }
+	size_t nrows() const { return offsets.size() - 1; }
+	size_t row_size(size_t i) const { return offsets[i+1] - offsets[i]; }
+	const T* row(size_t i) const { return values.data() + offsets[i]; }
+	void clear() { offsets.assign(1,0); values.clear(); }
+};
+/* struct to read all remaining values in a line as a new row in a
+ * ragged_array, optionally with bounds */
+template<class T>
+struct rest_of_line_t {
+	rest_of_line_t(ragged_array<T>& arr_):arr(arr_),has_bounds(false),min(),max() { }
+	rest_of_line_t(ragged_array<T>& arr_, T min_, T max_):arr(arr_),has_bounds(true),min(min_),max(max_) { }
+	ragged_array<T>& arr;
+	bool has_bounds;
+	T min;
+	T max;
+};
+template<class T> static rest_of_line_t<T> rest_of_line(ragged_array<T>& arr) {
+	return rest_of_line_t<T>(arr);
+}
+template<class T> static rest_of_line_t<T> rest_of_line(ragged_array<T>& arr, T min, T max) {
+	return rest_of_line_t<T>(arr,min,max);
+}
+
+/* overload for reading all remaining values in the line as a new row
+ * (an empty row if there are none); with a delimiter, empty fields are an
+ * error (T_MISSING), also after a delimiter at the end of the line; on
+ * error, nothing is added
+ * example usage (for lines with a node ID and a list of neighbors):
+ragged_array<uint32_t> adj;
+uint32_t node;
+while(read_table_line(r) == 0) if(read_table_multiple(r, node, rest_of_line(adj))) break;
+*/
+template<class T> static int read_table_next(read_table* r, rest_of_line_t<T> v) {
+	std::vector<T>& values = v.arr.values;
+	size_t start = values.size();
+	while(1) {
+		values.emplace_back();
+		int ret = v.has_bounds ? read_table_next(r,read_bounds(values.back(),v.min,v.max)) :
+			read_table_next(r,values.back());
+		if(ret) {
+			values.pop_back();
+			if(r->last_error == T_EOL) {
+				/* no more values; a delimiter before the end of the line
+				 * means that the last field is empty */
+				size_t pos = r->pos;
+				for(; pos > 0; pos--)
+					if( ! ((r->buf[pos-1] == ' ' || r->buf[pos-1] == '\t') && r->buf[pos-1] != r->delim) ) break;
+				if(!(r->delim && pos > 0 && r->buf[pos-1] == r->delim)) break;
+				r->last_error = T_MISSING;
+			}
+			values.resize(start);
+			return 1;
+		}
+	}
+	r->last_error = T_OK;
+	v.arr.offsets.push_back(values.size());
+	return 0;
+}
+
+
 /* recursive templated function to convert whole line using one function call only
  * note: recursion will be probably eliminated and the whole function expanded to
  * the actual sequence of conversions needed */
@@ -893,8 +1317,7 @@ struct read_table2 : public read_table {
 			/* note: the above statement copies all data members first
 			 * we then invalidate rt_ to not be able to read from the file
 			 * with two different instances of this class */
-			rt_.buf = 0;
-			rt_.buf_size = 0;
+			read_table_reset_buf(&rt_);
 			rt_.pos = 0;
 			rt_.line_len = 0;
 			rt_.col = 0;
@@ -902,12 +1325,17 @@ struct read_table2 : public read_table {
 		}
 		/* destructor frees temporary buffer */
 		~read_table2() {
-			if(buf) free(buf);
-			buf = 0;
-			buf_size = 0;
+			read_table_free_buf(this);
 			if(flags & READ_TABLE_CLOSE_FILE) if(f) fclose(f);
 			f = 0;
 		}
+		/* count the memory used by the buffer in m (in addition to the
+		 * global account); reading fails with T_MEMORY if this would exceed
+		 * the limit of either */
+		void set_memory(read_table_mem* m) {
+			read_table_mem_update(mem, &mem_tracked, 0);
+			mem = m;
+		}
 		/* read next line into the internal buffer */
 		bool read_line(bool skip = true) {
 			return (read_table_line_skip(this,skip) == 0);
@@ -970,6 +1398,10 @@ struct read_table2 : public read_table {
 		void set_comment(char comment_) { comment = comment_; }
 		/* get comment character (default is none) */
 		char get_comment() const { return comment; }
+		/* set decimal separator (default is '.', see read_table_set_decimal()) */
+		void set_decimal(char decimal_) { read_table_set_decimal(this,decimal_); }
+		/* get decimal separator */
+		char get_decimal() const { return decimal; }
 		
 		/* reset the current position to the beginning of the line */
 		void reset_pos() { read_table_reset_pos(this); }
@@ -0,0 +1,245 @@
+/*  -*- C++ -*-
+ * read_table_block_cache.h -- cache of parsed blocks for repeated lookups
+ * 	with the index in read_table_index.h
+ *
+ * Queries with string_index read and parse the blocks that contain the
+ * requested terms each time. With many lookups (e.g. random access by
+ * key), the same blocks are often needed repeatedly; this cache keeps the
+ * most recently used blocks in memory, each loaded with table_loader
+ * (read_table_bulk.h), i.e. with the position of all fields, and the
+ * columns converted by a user-supplied function. The total memory used
+ * is limited, and least recently used blocks are removed when needed.
+ *
+ * The cache can be used from multiple threads: blocks are returned as
+ * shared pointers to const table_loader objects, which remain valid even
+ * if the block is removed from the cache in the meantime; converted
+ * columns can be accessed with table_loader::get_column(). Blocks that
+ * are not found in the cache are loaded without holding a lock (if two
+ * threads load the same block at the same time, one of the copies is
+ * discarded).
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+string_index idx;
+if(!idx.read("input.tsv.idx")) ... // handle error
+// lines have 3 columns, convert the first one to uint32_t in each block
+block_cache cache(idx, "input.tsv", 3, [](table_loader& t) {
+	return t.request<uint32_t>(0) && t.materialize(1);
+});
+// find all lines where the third column is "abc"
+bool ret = cache.query(2, {"abc"}, [](const table_loader& t, size_t row) {
+	const std::vector<uint32_t>* ids = t.get_column<uint32_t>(0);
+	... // use (*ids)[row]
+	return true;
+});
+if(!ret) cache.write_error(stderr);
+
+ */
+
+#ifndef READ_TABLE_BLOCK_CACHE_H
+#define READ_TABLE_BLOCK_CACHE_H
+
+#include "read_table_index.h"
+#include "read_table_bulk.h"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <sstream>
+
+/* default memory limit */
+#ifndef READ_TABLE_BLOCK_CACHE_LIMIT
+#define READ_TABLE_BLOCK_CACHE_LIMIT (256UL*1024UL*1024UL)
+#endif
+
+
+class block_cache {
+	public:
+		typedef std::shared_ptr<const table_loader> block_ptr;
+		/* function to convert the required columns after loading a block */
+		typedef std::function<bool(table_loader&)> prepare_fn;
+
+	protected:
+		const string_index& idx;
+		std::string fn; /* input file (the same as the index was built from) */
+		size_t ncols; /* number of columns to load */
+		line_parser_params par;
+		prepare_fn prepare;
+		size_t limit; /* maximum memory used by the blocks */
+
+		struct entry {
+			block_ptr t;
+			size_t size;
+			std::list<uint64_t>::iterator lru; /* position in the list below */
+		};
+		std::unordered_map<uint64_t, entry> blocks;
+		std::list<uint64_t> lru; /* block ids, most recently used first */
+		size_t total = 0; /* total memory used */
+		uint64_t nhits = 0;
+		uint64_t nmisses = 0;
+		std::string err_msg; /* last error */
+		mutable std::mutex m; /* protects all of the above */
+
+		/* remove the least recently used blocks until the memory used is
+		 * below the limit, keeping at least min_blocks (m should be locked) */
+		void evict(size_t min_blocks) {
+			while(total > limit && lru.size() > min_blocks) {
+				auto it = blocks.find(lru.back());
+				total -= it->second.size;
+				blocks.erase(it);
+				lru.pop_back();
+			}
+		}
+		/* load one block; returns nullptr on error */
+		block_ptr load(uint64_t id);
+		void set_error(const std::string& msg) {
+			std::lock_guard<std::mutex> lock(m);
+			err_msg = msg;
+		}
+
+	public:
+		/* cache blocks of the file fn (with an index built from it), loading
+		 * ncols columns of each line (see table_loader::load()), and calling
+		 * prepare_ (if given) to convert the columns needed */
+		block_cache(const string_index& idx_, const char* fn_, size_t ncols_, prepare_fn prepare_ = prepare_fn(),
+			const line_parser_params& par_ = line_parser_params(), size_t limit_ = READ_TABLE_BLOCK_CACHE_LIMIT) :
+			idx(idx_), fn(fn_), ncols(ncols_), par(par_), prepare(std::move(prepare_)), limit(limit_) { }
+
+		/* get one block, either from the cache or loading it from the
+		 * file; returns nullptr on error */
+		block_ptr get(uint64_t id);
+
+		/* call f(t, row) for each line where the given column equals any
+		 * of the given terms (similarly to string_index::query()), using
+		 * the cached blocks; f should return false on error */
+		template<class F>
+		bool query(size_t col, const std::vector<std::string>& terms, F&& f);
+
+		/* set the memory limit (removing blocks if needed) */
+		void set_limit(size_t limit_);
+		/* remove all blocks */
+		void clear() { set_limit(0); }
+
+		/* statistics */
+		uint64_t hits() const { std::lock_guard<std::mutex> lock(m); return nhits; }
+		uint64_t misses() const { std::lock_guard<std::mutex> lock(m); return nmisses; }
+		size_t memory_used() const { std::lock_guard<std::mutex> lock(m); return total; }
+		size_t nblocks() const { std::lock_guard<std::mutex> lock(m); return blocks.size(); }
+
+		void write_error(FILE* f) const {
+			std::lock_guard<std::mutex> lock(m);
+			if(f) fprintf(f,"%s",err_msg.c_str());
+		}
+};
+
+
+block_cache::block_ptr block_cache::load(uint64_t id) {
+	if(id >= idx.nblocks()) {
+		set_error("block_cache: invalid block id\n");
+		return nullptr;
+	}
+	const string_index::block_start& b = idx.get_block(id);
+	read_table2 r(fn.c_str(), par);
+	std::shared_ptr<table_loader> t = std::make_shared<table_loader>();
+	t->set_fn_for_diag(fn.c_str());
+	std::ostringstream os;
+	if(!r.seek(b.offset, b.line) || !t->load(r, ncols, idx.get_block_end(id))) r.write_error(os);
+	else if(prepare && !prepare(*t)) t->write_error(os);
+	else return t;
+	set_error(os.str());
+	return nullptr;
+}
+
+block_cache::block_ptr block_cache::get(uint64_t id) {
+	{
+		std::lock_guard<std::mutex> lock(m);
+		auto it = blocks.find(id);
+		if(it != blocks.end()) {
+			nhits++;
+			lru.splice(lru.begin(), lru, it->second.lru);
+			return it->second.t;
+		}
+		nmisses++;
+	}
+	block_ptr t = load(id);
+	if(!t) return t;
+	size_t size = t->memory_size();
+
+	std::lock_guard<std::mutex> lock(m);
+	auto it = blocks.find(id);
+	if(it != blocks.end()) {
+		/* loaded by another thread in the meantime */
+		lru.splice(lru.begin(), lru, it->second.lru);
+		return it->second.t;
+	}
+	lru.push_front(id);
+	blocks[id] = entry{t, size, lru.begin()};
+	total += size;
+	evict(1); /* note: keep this block, even if it is larger than the limit */
+	return t;
+}
+
+void block_cache::set_limit(size_t limit_) {
+	std::lock_guard<std::mutex> lock(m);
+	limit = limit_;
+	evict(0);
+}
+
+template<class F>
+bool block_cache::query(size_t col, const std::vector<std::string>& terms, F&& f) {
+	if(col >= ncols) {
+		set_error("block_cache: invalid column\n");
+		return false;
+	}
+	std::vector<uint64_t> ids = idx.find_any(terms);
+	std::vector<std::string> sorted_terms(terms);
+	std::sort(sorted_terms.begin(), sorted_terms.end());
+	for(uint64_t id : ids) {
+		block_ptr t = get(id);
+		if(!t) return false;
+		for(size_t row = 0; row < t->nrows(); row++) {
+			/* note: the block can contain other terms as well */
+			string_view_custom str = t->get_field(row, col);
+			auto it = std::lower_bound(sorted_terms.begin(), sorted_terms.end(), str,
+				[](const std::string& x, const string_view_custom& y) {
+					int c = memcmp(x.data(), y.str, std::min(x.size(), y.len));
+					return c < 0 || (c == 0 && x.size() < y.len);
+				});
+			if(it == sorted_terms.end() || it->size() != str.len ||
+				memcmp(it->data(), str.str, str.len)) continue;
+			if(!f(*t, row)) return false;
+		}
+	}
+	return true;
+}
+
+#endif
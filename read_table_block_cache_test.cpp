@@ -0,0 +1,202 @@
+/*
+ * read_table_block_cache_test.cpp -- simple test cases for read_table_block_cache.h
+ *
+ * usage: read_table_block_cache_test [-n lines] [-k keys] [-b block_size]
+ * 	[-t threads] [-q lookups]
+ *
+ * a generated file of lines "id\tkeyN\tvalue" (default: 20000 lines,
+ * N < keys, default: 500, in runs of 8 lines with the same key) is
+ * written to a temporary file and indexed on the second column with the
+ * given block size (default: 4096)
+ * 1. all keys are looked up twice without a memory limit: the second
+ * time, all blocks should be found in the cache
+ * 2. with a limit of less than three blocks, the least recently used
+ * block is removed when loading a new one
+ * 3. random keys are looked up from several threads (default: 4, in
+ * total lookups times, default: 10000) with a limit of a few blocks
+ * results are compared to sums computed when generating the file
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include "read_table_block_cache.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* sum of the first column in lines with the given key, using the cache */
+static bool lookup(block_cache& cache, const std::string& key, uint64_t& sum) {
+	sum = 0;
+	return cache.query(1, {key}, [&sum](const table_loader& t, size_t row) {
+		const std::vector<uint32_t>* ids = t.get_column<uint32_t>(0);
+		if(!ids) return false;
+		sum += (*ids)[row];
+		return true;
+	});
+}
+
+/* look up all keys, comparing to the expected sums */
+static bool lookup_all(block_cache& cache, const std::vector<std::string>& keys,
+		const std::unordered_map<std::string, uint64_t>& expected) {
+	for(const std::string& key : keys) {
+		uint64_t sum;
+		if(!lookup(cache, key, sum) || sum != expected.at(key)) return false;
+	}
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	unsigned int nthreads = 4;
+	uint32_t nlines = 20000;
+	uint32_t nkeys = 500;
+	size_t nlookups = 10000;
+	size_t block_size = 4096;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nlines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'k':
+			nkeys = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'b':
+			block_size = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'q':
+			nlookups = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	if(!nthreads) nthreads = 1;
+	if(!nkeys) nkeys = 1;
+	if(nlines < 100) nlines = 100;
+
+	/* expected results: sum of the first column for each key */
+	std::unordered_map<std::string, uint64_t> expected;
+	std::vector<std::string> keys;
+	char fn[] = "/tmp/read_table_block_cache_test.XXXXXX";
+	{
+		int fd = mkstemp(fn);
+		FILE* f = (fd >= 0) ? fdopen(fd, "w") : nullptr;
+		if(!f) {
+			fprintf(stderr,"Error creating temporary file!\n");
+			return 1;
+		}
+		for(uint32_t j = 0; j < nlines; j++) {
+			std::string key = "key" + std::to_string((j / 8) % nkeys); /* note: in runs of 8 lines */
+			fprintf(f, "%u\t%s\t%u\n", j, key.c_str(), j % 13);
+			auto it = expected.find(key);
+			if(it == expected.end()) {
+				keys.push_back(key);
+				expected[key] = j;
+			}
+			else it->second += j;
+		}
+		if(fclose(f)) {
+			fprintf(stderr,"Error writing temporary file!\n");
+			unlink(fn);
+			return 1;
+		}
+	}
+
+	line_parser_params par;
+	par.set_delim('\t');
+	string_index idx(block_size);
+	{
+		read_table2 r(fn, par);
+		if(!idx.build(r, 1)) {
+			r.write_error(std::cerr);
+			unlink(fn);
+			return 1;
+		}
+	}
+	auto prepare = [](table_loader& t) { return t.request<uint32_t>(0) && t.materialize(1); };
+	bool ret = check(idx.nblocks() >= 3, "too few blocks, use a smaller block size");
+
+	/* 1. no limit: each block is loaded once */
+	{
+		block_cache cache(idx, fn, 3, prepare, par, SIZE_MAX);
+		ret = check(lookup_all(cache, keys, expected), "wrong results") && ret;
+		uint64_t misses = cache.misses();
+		ret = check(misses == idx.nblocks() && cache.nblocks() == idx.nblocks(), "blocks loaded more than once") && ret;
+		ret = check(lookup_all(cache, keys, expected) && cache.misses() == misses, "blocks not found in the cache") && ret;
+		ret = check(!cache.query(3, {keys[0]}, [](const table_loader&, size_t) { return true; }),
+			"invalid column not detected") && ret;
+	}
+
+	/* 2. least recently used blocks are removed */
+	if(ret) {
+		block_cache cache(idx, fn, 3, prepare, par, SIZE_MAX);
+		size_t size[3];
+		for(uint64_t j = 0; j < 3; j++) size[j] = cache.get(j)->memory_size();
+		cache.clear();
+		ret = check(cache.nblocks() == 0 && cache.memory_used() == 0, "cache not cleared") && ret;
+		cache.set_limit(size[0] + size[1] + size[2] - 1);
+		/* note: each step is the block to get, and the expected number of
+		 * misses and blocks in the cache after it */
+		const uint64_t steps[][3] = {{0, 1, 1}, {1, 2, 2}, {2, 3, 2}, {1, 3, 2}, {0, 4, 2}, {1, 4, 2}, {2, 5, 2}, {0, 6, 2}};
+		uint64_t misses0 = cache.misses();
+		for(const auto& s : steps) {
+			cache.get(s[0]);
+			if(!check(cache.misses() - misses0 == s[1] && cache.nblocks() == s[2], "least recently used block not removed")) {
+				ret = false;
+				break;
+			}
+		}
+		ret = check(cache.memory_used() <= size[0] + size[1] + size[2] - 1, "memory limit exceeded") && ret;
+	}
+
+	/* 3. random lookups from several threads, with a limit of a few blocks */
+	if(ret) {
+		block_cache cache(idx, fn, 3, prepare, par, SIZE_MAX);
+		size_t limit = 16 * cache.get(0)->memory_size();
+		cache.set_limit(limit);
+		std::vector<size_t> errors(nthreads, 0);
+		std::vector<std::thread> threads;
+		for(unsigned int j = 0; j < nthreads; j++) threads.emplace_back([&, j]() {
+			std::mt19937_64 rng(j + 1);
+			/* note: half of the lookups are for a few values, to have repeated blocks */
+			size_t nfrequent = std::min(keys.size(), (size_t)10);
+			for(size_t k = 0; k < nlookups / nthreads; k++) {
+				const std::string& key = keys[(k % 2) ? rng() % nfrequent : rng() % keys.size()];
+				uint64_t sum;
+				if(!lookup(cache, key, sum) || sum != expected.at(key)) errors[j]++;
+			}
+		});
+		for(auto& t : threads) t.join();
+		size_t nerrors = 0;
+		for(size_t e : errors) nerrors += e;
+		if(nerrors) cache.write_error(stderr);
+		ret = check(nerrors == 0, "wrong results from multiple threads") && ret;
+		ret = check(cache.memory_used() <= limit || cache.nblocks() == 1, "memory limit exceeded") && ret;
+		fprintf(stdout,"%lu lookups, cache hits: %lu, misses: %lu, %lu blocks (%lu bytes) in memory\n",
+			nthreads * (nlookups / nthreads), cache.hits(), cache.misses(), cache.nblocks(), cache.memory_used());
+	}
+
+	unlink(fn);
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
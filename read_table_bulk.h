@@ -0,0 +1,833 @@
+/*  -*- C++ -*-
+ * read_table_bulk.h -- loading whole tables into memory in columnar form,
+ * 	using the parsing functions in read_table_cpp.h
+ *
+ * The input is read and tokenized once: the text of all lines is kept in
+ * memory, together with the position of each field. Columns are converted
+ * to typed arrays only when they are first requested; this way, it is
+ * cheap to declare many columns and only use a few of them. Requested
+ * columns can be converted in parallel: each thread converts a range of
+ * adjacent columns, processing a block of rows at a time, which works
+ * well also for short and very wide tables (e.g. matrices with few rows
+ * and many thousands of columns).
+ * Errors are reported at conversion time, with the original line and
+ * column number.
+ *
+ * Note: this requires C++11 and linking with -pthread
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+read_table2 r("input.tsv");
+table_loader t;
+if(!t.load(r, 30)) r.write_error(std::cerr); // read and tokenize lines with 30 fields
+const std::vector<uint32_t>* ids;
+const std::vector<double>* values;
+if(!t.column(0, ids) || !t.column(5, values, 0.0, 1.0)) t.write_error(std::cerr);
+
+// or: request several columns first, then convert them in parallel
+t.request<uint32_t>(0);
+t.request<double>(5);
+if(!t.materialize(4)) t.write_error(std::cerr);
+
+// wide table: number of columns is taken from the first line
+t.load(r, 0);
+t.request_range<double>(1, t.get_ncols() - 1); // all columns except the first
+if(!t.materialize(0)) t.write_error(std::cerr);
+
+ */
+
+#ifndef READ_TABLE_BULK_H
+#define READ_TABLE_BULK_H
+
+#include "read_table_cpp.h"
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <typeinfo>
+#include <limits>
+#include <clocale>
+
+/* location of an error found when converting a column */
+struct column_error {
+	uint64_t line = 0; /* line in the original input */
+	size_t pos = 0; /* position in the line */
+	size_t col = 0; /* column (field) index */
+	enum read_table_errors err = T_OK;
+};
+
+
+class table_loader;
+
+/* small direct-mapped cache of converted values, keyed on the raw text of
+ * fields (up to 16 bytes); useful for columns with few distinct values,
+ * so that these do not have to be converted again on each occurrence;
+ * the number of hits and misses is counted to be able to check if it
+ * helps (longer fields are never cached, and are counted as misses) */
+template<class T>
+class field_cache {
+	protected:
+		struct entry {
+			uint64_t k1;
+			uint64_t k2;
+			size_t len; /* 0 means empty slot */
+			T val;
+		};
+		std::vector<entry> table;
+		size_t mask;
+		uint64_t nhits = 0;
+		uint64_t nmisses = 0;
+		
+		static void make_key(const char* str, size_t len, uint64_t& k1, uint64_t& k2) {
+			char tmp[16] = {0};
+			memcpy(tmp, str, len);
+			memcpy(&k1, tmp, 8);
+			memcpy(&k2, tmp + 8, 8);
+		}
+		size_t slot(uint64_t k1, uint64_t k2, size_t len) const {
+			uint64_t h = (k1 * 0x9E3779B97F4A7C15ULL) ^ (k2 * 0xC2B2AE3D27D4EB4FULL) ^ len;
+			return (size_t)(h ^ (h >> 29) ^ (h >> 47)) & mask;
+		}
+	public:
+		static constexpr size_t max_len = 16;
+		/* size is rounded up to a power of two */
+		explicit field_cache(size_t size = 256) {
+			size_t n = 1;
+			while(n < size) n *= 2;
+			table.resize(n);
+			for(auto& e : table) e.len = 0;
+			mask = n - 1;
+		}
+		/* memory used by a cache created with the given size (in bytes) */
+		static size_t memory_size(size_t size) {
+			size_t n = 1;
+			while(n < size) n *= 2;
+			return n * sizeof(entry);
+		}
+		size_t memory_size() const { return table.capacity() * sizeof(entry); }
+		/* look up the given field; returns NULL if not found */
+		const T* find(const char* str, size_t len) {
+			if(len == 0 || len > max_len) { nmisses++; return nullptr; }
+			uint64_t k1, k2;
+			make_key(str, len, k1, k2);
+			const entry& e = table[slot(k1, k2, len)];
+			if(e.len == len && e.k1 == k1 && e.k2 == k2) { nhits++; return &(e.val); }
+			nmisses++;
+			return nullptr;
+		}
+		/* store the converted value of a field (replacing any previous
+		 * value in the same slot) */
+		void insert(const char* str, size_t len, const T& val) {
+			if(len == 0 || len > max_len) return;
+			uint64_t k1, k2;
+			make_key(str, len, k1, k2);
+			entry& e = table[slot(k1, k2, len)];
+			e.k1 = k1;
+			e.k2 = k2;
+			e.len = len;
+			e.val = val;
+		}
+		uint64_t hits() const { return nhits; }
+		uint64_t misses() const { return nmisses; }
+		double hit_rate() const { return (nhits + nmisses) ? nhits / (double)(nhits + nmisses) : 0.0; }
+};
+
+/* specialized conversion of fields with a simple format: integers with at
+ * most 8 digits (no sign) and decimals without an exponent (with at most
+ * 15 digits, so the result is exact before the final division, which gives
+ * the same correctly rounded value as strtod(), using the decimal separator
+ * given in the parameters); these return false for
+ * anything else (including values out of bounds), in which case the field
+ * has to be converted by the generic functions of line_parser */
+template<class T>
+struct fast_convert {
+	static constexpr bool available = false;
+	static bool usable(const line_parser_params&) { return false; }
+	static bool convert(const char*, size_t, T&, char) { return false; }
+};
+
+template<class T>
+struct fast_convert_int {
+	static constexpr bool available = true;
+	/* note: a different base or prefixes (e.g. 0x) are not handled here */
+	static bool usable(const line_parser_params& par) { return par.base == 10; }
+	static bool convert(const char* str, size_t len, T& val, char) {
+		if(len == 0 || len > 8) return false;
+		uint32_t x = 0;
+		for(size_t i = 0; i < len; i++) {
+			uint32_t d = (uint32_t)(unsigned char)str[i] - '0';
+			if(d > 9) return false;
+			x = 10 * x + d;
+		}
+		if((uint64_t)x > (uint64_t)std::numeric_limits<T>::max()) return false;
+		val = (T)x;
+		return true;
+	}
+};
+template<> struct fast_convert<int16_t> : fast_convert_int<int16_t> { };
+template<> struct fast_convert<uint16_t> : fast_convert_int<uint16_t> { };
+template<> struct fast_convert<int32_t> : fast_convert_int<int32_t> { };
+template<> struct fast_convert<uint32_t> : fast_convert_int<uint32_t> { };
+template<> struct fast_convert<int64_t> : fast_convert_int<int64_t> { };
+template<> struct fast_convert<uint64_t> : fast_convert_int<uint64_t> { };
+
+template<>
+struct fast_convert<double> {
+	static constexpr bool available = true;
+	/* strtod() uses the decimal point of the current locale (other separators
+	 * are handled by read_table_strtod_sep(), independently of the locale) */
+	static bool usable(const line_parser_params& par) {
+		if(par.decimal != '.') return true;
+		const struct lconv* l = localeconv();
+		return l && l->decimal_point && l->decimal_point[0] == '.' && l->decimal_point[1] == 0;
+	}
+	static bool convert(const char* str, size_t len, double& val, char decimal) {
+		static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+			1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+		const char* end = str + len;
+		bool neg = false;
+		if(str < end && *str == '-') { neg = true; str++; }
+		uint64_t x = 0;
+		unsigned int ndigits = 0;
+		unsigned int nfrac = 0;
+		const char* start = str;
+		for(; str < end; str++) {
+			uint32_t d = (uint32_t)(unsigned char)*str - '0';
+			if(d > 9) break;
+			x = 10 * x + d;
+			ndigits++;
+		}
+		if(str == start) return false; /* at least one digit before the decimal point */
+		if(str < end) {
+			if(*str != decimal) return false;
+			str++;
+			start = str;
+			for(; str < end; str++) {
+				uint32_t d = (uint32_t)(unsigned char)*str - '0';
+				if(d > 9) return false;
+				x = 10 * x + d;
+				ndigits++;
+				if(ndigits > 15) return false;
+			}
+			nfrac = str - start;
+			if(nfrac == 0) return false; /* at least one digit after the decimal point */
+		}
+		if(ndigits > 15) return false;
+		double d = (double)x;
+		if(nfrac) d /= pow10[nfrac];
+		val = neg ? -d : d;
+		return true;
+	}
+};
+
+/* base class for converted columns; this should not be used directly */
+struct column_base {
+	bool done = false; /* whether the column has been converted */
+	virtual ~column_base() { }
+	virtual const std::type_info& type() const = 0;
+	/* allocate space for the given number of rows */
+	virtual void prepare(size_t nrows) = 0;
+	/* free all memory used */
+	virtual void clear() = 0;
+	/* convert rows [row1,row2) of column col of t using lp for parsing;
+	 * prepare() has to be called before; returns false on error */
+	virtual bool convert_rows(const table_loader& t, size_t col, size_t row1, size_t row2,
+		line_parser& lp, column_error& err) = 0;
+	/* convert the whole column */
+	bool convert(const table_loader& t, size_t col, line_parser& lp, column_error& err);
+	/* get the number of cache hits and misses; returns false if no cache is used */
+	virtual bool cache_stats(uint64_t&, uint64_t&) const { return false; }
+	/* approximate memory used by the converted values (in bytes) */
+	virtual size_t memory_size() const = 0;
+	/* memory that will be used after calling prepare(nrows) */
+	virtual size_t prepared_size(size_t nrows) const = 0;
+};
+
+/* one column with values of type T */
+template<class T>
+struct column_data : public column_base {
+	std::vector<T> values;
+	bool has_bounds = false;
+	T min;
+	T max;
+	std::unique_ptr<field_cache<T> > cache; /* optional cache of converted values */
+	/* whether to try fast_convert<T> first; it is turned off if the values
+	 * in this column turn out to not match the simple format often enough */
+	bool fast_path = fast_convert<T>::available;
+	uint32_t fast_tried = 0;
+	uint32_t fast_failed = 0;
+	static constexpr uint32_t fast_check_rows = 1024; /* check the success rate after this many rows */
+	column_data() : min(), max() { }
+	const std::type_info& type() const override { return typeid(T); }
+	bool cache_stats(uint64_t& hits, uint64_t& misses) const override {
+		if(!cache) return false;
+		hits = cache->hits();
+		misses = cache->misses();
+		return true;
+	}
+	void prepare(size_t nrows) override {
+		values.reserve(nrows); /* note: allocates exactly nrows, as counted by prepared_size() */
+		values.resize(nrows);
+		fast_path = fast_convert<T>::available;
+		fast_tried = 0;
+		fast_failed = 0;
+	}
+	void clear() override { std::vector<T>().swap(values); }
+	size_t memory_size() const override {
+		return values.capacity() * sizeof(T) + (cache ? cache->memory_size() : 0);
+	}
+	size_t prepared_size(size_t nrows) const override {
+		return memory_size() + (nrows > values.capacity() ? (nrows - values.capacity()) * sizeof(T) : 0);
+	}
+	bool convert_rows(const table_loader& t, size_t col, size_t row1, size_t row2,
+		line_parser& lp, column_error& err) override;
+};
+
+
+class table_loader {
+	protected:
+		line_parser_params par; /* parameters used for parsing */
+		size_t ncols = 0; /* number of columns stored for each row */
+		std::vector<char> text; /* contents of all lines */
+		std::vector<uint64_t> row_offset; /* start of each row in text */
+		std::vector<uint64_t> row_line; /* line number of each row in the original input */
+		std::vector<uint32_t> field_pos; /* start of each field, relative to the start of the row */
+		std::vector<uint32_t> field_len; /* length of each field */
+		std::vector<std::unique_ptr<column_base> > columns; /* converted (or requested) columns */
+		size_t row_block = 256; /* number of rows processed at once by materialize() */
+		bool fast_path = true; /* whether to use specialized conversion for simple number formats */
+		column_error last_err; /* first error encountered when converting */
+		const char* fn = nullptr; /* file name for diagnostic messages */
+		read_table_mem_tracker mem; /* memory used by the text and columns (see read_table_memory.h) */
+
+		/* find the fields in one line and store them */
+		bool tokenize(const std::string& line, uint64_t line_num, column_error& err);
+
+		/* get the column object for column i, creating it if necessary;
+		 * returns nullptr if it was requested with a different type */
+		template<class T> column_data<T>* get_col(size_t i) {
+			if(i >= ncols) return nullptr;
+			if(!columns[i]) columns[i].reset(new column_data<T>());
+			if(columns[i]->type() != typeid(T)) return nullptr;
+			return static_cast<column_data<T>*>(columns[i].get());
+		}
+		/* update the memory accounts to size; returns false and sets
+		 * T_MEMORY as the error if a limit is exceeded; this is called
+		 * before growing any buffer, with the size after growing it */
+		bool charge_memory(size_t size, uint64_t line = 0) {
+			if(mem.update(size)) return true;
+			last_err = column_error();
+			last_err.line = line;
+			last_err.err = T_MEMORY;
+			return false;
+		}
+		/* update the memory accounts with memory_size() */
+		bool update_memory(uint64_t line = 0) { return charge_memory(memory_size(), line); }
+		/* make space for storing one more line of len characters */
+		bool reserve_line(size_t len, uint64_t line);
+		bool type_error(size_t i) {
+			last_err = column_error();
+			last_err.col = i;
+			last_err.err = T_TYPE;
+			return false;
+		}
+
+		template<class T> friend struct column_data;
+		
+		template<class T> bool rest_column(ragged_array<T>& res, rest_of_line_t<T> rest);
+
+	public:
+		/* 1. loading the data */
+
+		/* read all lines from r, storing the first ncols fields of each
+		 * (lines with less fields are considered an error, further fields are
+		 * ignored); if ncols is zero, the number of fields in the first line
+		 * is used; parameters (delimiter, comment character) are taken from r;
+		 * if end_offset is given, reading stops before the line starting at
+		 * or after it (e.g. to only load one block of a file after seeking);
+		 * returns false on error (r contains the error code and position,
+		 * except if the memory limit set by set_memory() is exceeded, in
+		 * which case get_last_error() returns T_MEMORY) */
+		bool load(read_table2& r, size_t ncols_, uint64_t end_offset = UINT64_MAX);
+
+		size_t nrows() const { return row_offset.size(); }
+		size_t get_ncols() const { return ncols; }
+		/* parameters used for parsing (taken from the input) */
+		const line_parser_params& get_params() const { return par; }
+		/* get the raw text of field (row, col) */
+		string_view_custom get_field(size_t row, size_t col) const {
+			string_view_custom str;
+			size_t i = row * ncols + col;
+			str.str = text.data() + row_offset[row] + field_pos[i];
+			str.len = field_len[i];
+			return str;
+		}
+		/* line number of a row in the input */
+		uint64_t get_row_line(size_t row) const { return row_line[row]; }
+
+		/* 2. requesting columns to be converted (with type T); these can be
+		 * converted at once, in parallel, with materialize()
+		 * return false if the column does not exist or was previously
+		 * requested with a different type */
+		template<class T> bool request(size_t i) {
+			return get_col<T>(i) ? true : type_error(i);
+		}
+		template<class T> bool request(size_t i, T min, T max) {
+			column_data<T>* c = get_col<T>(i);
+			if(!c) return type_error(i);
+			if(!c->done) {
+				c->has_bounds = true;
+				c->min = min;
+				c->max = max;
+			}
+			return true;
+		}
+		/* use a cache of the given size for converting column i (as type T),
+		 * so repeated values are only converted once; this is useful for
+		 * columns with few distinct values; this also requests the column,
+		 * and has to be called before materialize() to have an effect;
+		 * note: values converted by the specialized functions (see
+		 * set_fast_path()) do not use the cache, so e.g. short integers
+		 * only use it after these are turned off for the column;
+		 * returns false if the column does not exist or was previously
+		 * requested with a different type */
+		template<class T> bool use_cache(size_t i, size_t size = 256) {
+			column_data<T>* c = get_col<T>(i);
+			if(!c) return type_error(i);
+			size_t old = c->cache ? c->cache->memory_size() : 0;
+			if(!charge_memory(memory_size() - old + field_cache<T>::memory_size(size))) return false;
+			c->cache.reset(new field_cache<T>(size));
+			return update_memory();
+		}
+		/* get the number of cache hits and misses for column i (values
+		 * converted by the specialized functions are not counted, see
+		 * use_cache()); returns false if there is no cache for that column */
+		bool cache_stats(size_t i, uint64_t& hits, uint64_t& misses) const {
+			return (i < ncols && columns[i]) ? columns[i]->cache_stats(hits, misses) : false;
+		}
+		/* request n adjacent columns starting at first */
+		template<class T> bool request_range(size_t first, size_t n) {
+			for(size_t i = first; i < first + n; i++) if(!request<T>(i)) return false;
+			return true;
+		}
+		template<class T> bool request_range(size_t first, size_t n, T min, T max) {
+			for(size_t i = first; i < first + n; i++) if(!request<T>(i, min, max)) return false;
+			return true;
+		}
+		/* convert all requested columns using nthreads threads (0 means
+		 * using the number of processors); the columns are divided into
+		 * ranges of adjacent columns, each converted by one thread in
+		 * blocks of rows; returns false on error, the error with the
+		 * lowest line number is stored */
+		bool materialize(unsigned int nthreads = 1);
+		/* set the number of rows converted at once in each column range
+		 * by materialize(); this should be small enough so that the
+		 * text of these rows fits in the cache */
+		void set_row_block(size_t row_block_) { row_block = row_block_ ? row_block_ : 1; }
+		/* set whether to try specialized conversions for columns with simple
+		 * number formats (e.g. short integers, decimals without exponent),
+		 * falling back to the generic conversion for anything else; the
+		 * results (and errors) are the same either way, this is mainly
+		 * useful for comparison */
+		void set_fast_path(bool fast_path_) { fast_path = fast_path_; }
+
+		/* 3. get a converted column, converting it now if needed
+		 * returns false on error; in this case, res is not changed */
+		template<class T> bool column(size_t i, const std::vector<T>*& res) {
+			column_data<T>* c = get_col<T>(i);
+			if(!c) return type_error(i);
+			if(!c->done) {
+				if(!charge_memory(memory_size() - c->memory_size() + c->prepared_size(nrows()))) return false;
+				c->prepare(nrows());
+				line_parser lp(get_params());
+				if(!c->convert(*this, i, lp, last_err)) return false;
+			}
+			res = &(c->values);
+			return true;
+		}
+		template<class T> bool column(size_t i, const std::vector<T>*& res, T min, T max) {
+			if(!request(i, min, max)) return false;
+			return column(i, res);
+		}
+		/* read all values after the stored columns in each row (e.g. for
+		 * lines like "node n1 n2 n3 ..." loaded with ncols = 1) into res,
+		 * adding one row for each row of the table (with the same rules as
+		 * rest_of_line() in read_table_cpp.h); returns false on error
+		 * (in this case, res contains the rows before the error) */
+		template<class T> bool rest_column(ragged_array<T>& res) {
+			return rest_column(res, rest_of_line_t<T>(res));
+		}
+		template<class T> bool rest_column(ragged_array<T>& res, T min, T max) {
+			return rest_column(res, rest_of_line_t<T>(res, min, max));
+		}
+		/* free the memory used by a converted column (it can be converted again later) */
+		void release(size_t i) {
+			if(i < ncols) columns[i].reset();
+			mem.update(memory_size());
+		}
+		/* get column i only if it was already converted as type T (nullptr
+		 * otherwise); this does not modify anything, so it can be used from
+		 * multiple threads at the same time */
+		template<class T> const std::vector<T>* get_column(size_t i) const {
+			if(i >= ncols || !columns[i] || !columns[i]->done || columns[i]->type() != typeid(T)) return nullptr;
+			return &(static_cast<const column_data<T>*>(columns[i].get())->values);
+		}
+		/* approximate memory used by the text, field positions and converted columns (in bytes) */
+		size_t memory_size() const {
+			size_t size = text.capacity() + (row_offset.capacity() + row_line.capacity()) * sizeof(uint64_t) +
+				(field_pos.capacity() + field_len.capacity()) * sizeof(uint32_t);
+			for(const auto& c : columns) if(c) size += c->memory_size();
+			return size;
+		}
+		/* count the memory returned by memory_size() in m (in addition to
+		 * the global account); loading or converting columns fails with
+		 * T_MEMORY if this would exceed the limit of either */
+		void set_memory(read_table_mem* m) {
+			mem.set_account(m);
+			mem.update(memory_size());
+		}
+
+		/* 4. diagnostics */
+		enum read_table_errors get_last_error() const { return last_err.err; }
+		const column_error& get_error() const { return last_err; }
+		void set_fn_for_diag(const char* fn_) { fn = fn_; }
+		void write_error(std::ostream& f) const {
+			f << "read_table, ";
+			if(fn) f << "file " << fn << ", ";
+			else f << "input ";
+			f << "line " << last_err.line << ", position " << last_err.pos << " / column " <<
+				last_err.col << ": " << get_error_desc(last_err.err) << "\n";
+		}
+		void write_error(FILE* f) const {
+			if(!f) return;
+			fprintf(f,"read_table, ");
+			if(fn) fprintf(f,"file %s, ",fn);
+			else fprintf(f,"input ");
+			fprintf(f,"line %lu, position %lu / column %lu: %s\n",last_err.line,last_err.pos,
+				last_err.col,get_error_desc(last_err.err));
+		}
+};
+
+
+bool table_loader::tokenize(const std::string& line, uint64_t line_num, column_error& err) {
+	const char* buf = line.data();
+	size_t len = line.size();
+	size_t pos = 0;
+	size_t i;
+	const char delim = par.delim;
+	const char comment = par.comment;
+	if(comment) {
+		const char* c = (const char*)memchr(buf, comment, len);
+		if(c) len = c - buf;
+	}
+	for(i = 0; i < ncols; i++) {
+		size_t start, end;
+		if(delim) {
+			if(pos > len) break;
+			const char* d = (const char*)memchr(buf + pos, delim, len - pos);
+			start = pos;
+			end = d ? (size_t)(d - buf) : len;
+			pos = end + 1;
+		}
+		else {
+			for(; pos < len; pos++) if( ! (buf[pos] == ' ' || buf[pos] == '\t') ) break;
+			if(pos == len) break;
+			start = pos;
+			for(; pos < len; pos++) if(buf[pos] == ' ' || buf[pos] == '\t') break;
+			end = pos;
+		}
+		if(end > UINT32_MAX) break; /* note: lines longer than 4 GiB are not supported */
+		field_pos.push_back(start);
+		field_len.push_back(end - start);
+	}
+	if(i < ncols && ncols == SIZE_MAX && row_offset.empty() && i > 0) {
+		/* first line, number of columns is not known */
+		ncols = i;
+		columns.resize(ncols);
+	}
+	if(i < ncols) {
+		/* remove fields stored for this line */
+		field_pos.resize(field_pos.size() - i);
+		field_len.resize(field_len.size() - i);
+		err.line = line_num;
+		err.pos = pos > len ? len : pos;
+		err.col = i;
+		err.err = T_EOL;
+		return false;
+	}
+	row_offset.push_back(text.size());
+	row_line.push_back(line_num);
+	text.insert(text.end(), buf, buf + len);
+	return true;
+}
+
+/* note: the buffers are counted in the memory accounts before they are
+ * grown, so the limit is never exceeded */
+bool table_loader::reserve_line(size_t len, uint64_t line) {
+	size_t nfields = (ncols == SIZE_MAX) ? len + 1 : ncols; /* first line: at most one field per character */
+	size_t text_cap = read_table_grown_capacity(text, len);
+	size_t field_cap = read_table_grown_capacity(field_pos, nfields);
+	size_t row_cap = read_table_grown_capacity(row_offset, 1);
+	if(text_cap == text.capacity() && field_cap == field_pos.capacity() &&
+		row_cap == row_offset.capacity()) return true;
+	size_t size = memory_size() + (text_cap - text.capacity()) +
+		2 * (field_cap - field_pos.capacity()) * sizeof(uint32_t) +
+		2 * (row_cap - row_offset.capacity()) * sizeof(uint64_t);
+	if(!charge_memory(size, line)) return false;
+	text.reserve(text_cap);
+	field_pos.reserve(field_cap);
+	field_len.reserve(field_cap);
+	row_offset.reserve(row_cap);
+	row_line.reserve(row_cap);
+	return true;
+}
+
+bool table_loader::load(read_table2& r, size_t ncols_, uint64_t end_offset) {
+	ncols = ncols_ ? ncols_ : SIZE_MAX; /* note: SIZE_MAX means taking it from the first line */
+	par = r.get_params();
+	text.clear();
+	row_offset.clear();
+	row_line.clear();
+	field_pos.clear();
+	field_len.clear();
+	columns.clear();
+	if(ncols_) columns.resize(ncols);
+	last_err = column_error();
+	if(!fn) fn = r.get_fn();
+	bool ret = update_memory(); /* note: memory freed above */
+	while(ret && r.get_next_offset() < end_offset) {
+		if(!r.read_line()) {
+			ret = (r.get_last_error() == T_EOF);
+			break;
+		}
+		if(!reserve_line(r.get_line_str().size(), r.get_line())) {
+			ret = false;
+			break;
+		}
+		if(!tokenize(r.get_line_str(), r.get_line(), last_err)) {
+			/* note: set the error in r as well */
+			r.reset_pos();
+			for(size_t i = 0; i < last_err.col; i++) r.read_skip();
+			r.read_skip();
+			return false;
+		}
+	}
+	if(ncols == SIZE_MAX) ncols = 0; /* empty input */
+	return ret;
+}
+
+bool column_base::convert(const table_loader& t, size_t col, line_parser& lp, column_error& err) {
+	prepare(t.nrows());
+	if(!convert_rows(t, col, 0, t.nrows(), lp, err)) {
+		clear();
+		return false;
+	}
+	done = true;
+	return true;
+}
+
+/* convert part of a column, one field at a time, with the usual parsing
+ * functions (each field is copied to the line_parser's buffer) */
+template<class T>
+bool column_data<T>::convert_rows(const table_loader& t, size_t col, size_t row1, size_t row2,
+		line_parser& lp, column_error& err) {
+	bool fast = fast_path && t.fast_path && fast_convert<T>::usable(t.par);
+	size_t counted = row1; /* rows before this are already counted in fast_tried */
+	for(size_t row = row1; row < row2; row++) {
+		string_view_custom str = t.get_field(row, col);
+		if(fast) {
+			/* note: this is cheaper than a cache lookup, so the cache is
+			 * only used (and counted) for the other values */
+			bool ret = fast_convert<T>::convert(str.str, str.len, values[row], t.par.decimal);
+			if(ret && has_bounds && (values[row] < min || values[row] > max)) ret = false;
+			if(ret) continue;
+			/* not the simple format, turn it off if this happens too often */
+			fast_failed++;
+			fast_tried += row + 1 - counted;
+			counted = row + 1;
+			if(fast_tried >= fast_check_rows) {
+				if(fast_failed * 8 > fast_tried) fast = fast_path = false;
+				fast_tried = 0;
+				fast_failed = 0;
+			}
+		}
+		if(cache) {
+			/* note: values in the cache were checked with the same bounds */
+			const T* val = cache->find(str.str, str.len);
+			if(val) {
+				values[row] = *val;
+				continue;
+			}
+		}
+		lp.assign_line(str.str, str.len);
+		bool ret;
+		if(str.len == 0) {
+			/* note: an empty field can only occur with an explicit delimiter */
+			ret = false;
+		}
+		else if(has_bounds) ret = lp.read_next(read_bounds(values[row], min, max));
+		else ret = lp.read_next(values[row]);
+		if(!ret) {
+			err.line = t.get_row_line(row);
+			err.pos = t.field_pos[row * t.ncols + col] + (str.len ? lp.get_pos() : 0);
+			err.col = col;
+			err.err = str.len ? lp.get_last_error() : T_MISSING;
+			return false;
+		}
+		if(cache) cache->insert(str.str, str.len, values[row]);
+	}
+	if(fast) fast_tried += row2 - counted;
+	return true;
+}
+
+/* strings can be returned without copying, pointing to the stored text */
+template<>
+bool column_data<string_view_custom>::convert_rows(const table_loader& t, size_t col, size_t row1, size_t row2,
+		line_parser&, column_error&) {
+	for(size_t row = row1; row < row2; row++) values[row] = t.get_field(row, col);
+	return true;
+}
+template<>
+bool column_data<std::string>::convert_rows(const table_loader& t, size_t col, size_t row1, size_t row2,
+		line_parser&, column_error&) {
+	for(size_t row = row1; row < row2; row++) {
+		string_view_custom str = t.get_field(row, col);
+		values[row].assign(str.str, str.len);
+	}
+	return true;
+}
+
+
+template<class T>
+bool table_loader::rest_column(ragged_array<T>& res, rest_of_line_t<T> rest) {
+	line_parser lp(get_params());
+	size_t n = nrows();
+	res.offsets.reserve(res.offsets.size() + n);
+	for(size_t row = 0; row < n; row++) {
+		/* start after the last stored field */
+		size_t start = row_offset[row];
+		if(ncols) start += field_pos[row * ncols + ncols - 1] + field_len[row * ncols + ncols - 1];
+		size_t end = (row + 1 < n) ? row_offset[row + 1] : text.size();
+		bool after_delim = false;
+		if(ncols && par.delim && start < end) {
+			start++; /* skip the delimiter */
+			after_delim = true;
+		}
+		lp.assign_line(text.data() + start, end - start);
+		size_t nvalues = res.values.size();
+		enum read_table_errors err = T_OK;
+		if(!lp.read_next(rest)) err = lp.get_last_error();
+		else if(after_delim && res.values.size() == nvalues) {
+			/* delimiter after the last stored field, but no values:
+			 * the field after it is empty */
+			res.offsets.pop_back();
+			err = T_MISSING;
+		}
+		if(err != T_OK) {
+			last_err.line = row_line[row];
+			last_err.pos = start - row_offset[row] + lp.get_pos();
+			last_err.col = ncols + lp.get_col();
+			last_err.err = err;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool table_loader::materialize(unsigned int nthreads) {
+	if(!nthreads) nthreads = std::thread::hardware_concurrency();
+	if(!nthreads) nthreads = 1;
+	std::vector<size_t> todo;
+	for(size_t i = 0; i < ncols; i++) if(columns[i] && !columns[i]->done) todo.push_back(i);
+	if(todo.empty()) return true;
+	size_t size = memory_size();
+	for(size_t i : todo) size += columns[i]->prepared_size(nrows()) - columns[i]->memory_size();
+	if(!charge_memory(size)) return false;
+	for(size_t i : todo) columns[i]->prepare(nrows());
+
+	/* divide the columns into ranges, a few for each thread (so that
+	 * the work is balanced even if some columns are more expensive) */
+	size_t range = todo.size() / (4 * (size_t)nthreads);
+	if(!range) range = 1;
+	size_t nranges = (todo.size() + range - 1) / range;
+	if(nthreads > nranges) nthreads = nranges;
+
+	std::mutex m;
+	size_t next = 0;
+	bool ret = true;
+	std::vector<bool> failed(todo.size(), false); /* note: only accessed while holding m */
+	auto worker = [&]() {
+		line_parser lp(get_params());
+		std::vector<bool> ok;
+		while(true) {
+			size_t r1;
+			{
+				std::lock_guard<std::mutex> lock(m);
+				if(next == nranges) break;
+				r1 = range * next++;
+			}
+			size_t r2 = r1 + range;
+			if(r2 > todo.size()) r2 = todo.size();
+			ok.assign(r2 - r1, true);
+			/* process blocks of rows, so that the text of these stays in
+			 * the cache while converting all columns in the range */
+			for(size_t row1 = 0; row1 < nrows(); row1 += row_block) {
+				size_t row2 = row1 + row_block;
+				if(row2 > nrows()) row2 = nrows();
+				for(size_t j = r1; j < r2; j++) if(ok[j - r1]) {
+					column_error err;
+					if(!columns[todo[j]]->convert_rows(*this, todo[j], row1, row2, lp, err)) {
+						/* note: rows after the error in this column are skipped */
+						ok[j - r1] = false;
+						std::lock_guard<std::mutex> lock(m);
+						failed[j] = true;
+						if(ret || err.line < last_err.line || (err.line == last_err.line && err.col < last_err.col))
+							last_err = err;
+						ret = false;
+					}
+				}
+			}
+		}
+	};
+	std::vector<std::thread> threads;
+	for(unsigned int j = 1; j < nthreads; j++) threads.emplace_back(worker);
+	worker();
+	for(auto& th : threads) th.join();
+	for(size_t j = 0; j < todo.size(); j++) {
+		if(failed[j]) columns[todo[j]]->clear();
+		else columns[todo[j]]->done = true;
+	}
+	return ret;
+}
+
+#endif /* READ_TABLE_BULK_H */
+
@@ -0,0 +1,174 @@
+/*
+ * read_table_bulk_range_test.cpp -- simple test cases for converting
+ * 	ranges of columns with table_loader in read_table_bulk.h
+ *
+ * usage: read_table_bulk_range_test [-n rows] [-c cols] [-t threads]
+ *
+ * a generated table of rows x cols fields (default: 1000 x 20) is loaded
+ * with the number of columns taken from the first line; two ranges of
+ * columns are requested (integers with and without bounds, doubles) and
+ * converted with one and with the given number of threads (default: 4),
+ * in small blocks of rows, and the values are compared to the generated
+ * ones; error cases: wrong type or invalid range requested, a value out
+ * of bounds in several columns, a short line
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include "read_table_bulk.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* value in row j, column k (for k > 0): integers in the first half of the
+ * columns, doubles (exactly representable) in the second half */
+static uint32_t int_value(size_t j, size_t k) { return (uint32_t)((j * 31 + k * 7) % 1000); }
+static double double_value(size_t j, size_t k) { return (double)(j % 100) + 0.25 * (double)k; }
+
+/* load the table and convert all columns, then compare to the values above */
+static bool test_table(const std::string& input, size_t nrows, size_t ncols, size_t nint,
+		unsigned int nthreads, size_t row_block) {
+	std::istringstream is(input);
+	read_table2 r(is, line_parser_params().set_delim('\t'));
+	table_loader t;
+	if(!t.load(r, 0)) {
+		r.write_error(stderr);
+		return check(false, "loading the table");
+	}
+	bool ret = check(t.get_ncols() == ncols && t.nrows() == nrows, "number of columns or rows");
+	t.set_row_block(row_block);
+	ret = check(t.request<uint32_t>(0), "requesting the first column") && ret;
+	ret = check(t.request_range<uint32_t>(1, nint), "requesting the integer columns") && ret;
+	ret = check(t.request_range<double>(nint + 1, ncols - nint - 1, 0.0, 1000.0),
+		"requesting the double columns") && ret;
+	if(!ret) return false;
+	if(!t.materialize(nthreads)) {
+		t.write_error(stderr);
+		return check(false, "converting the columns");
+	}
+	for(size_t k = 0; k < ncols; k++) {
+		const std::vector<uint32_t>* c1 = t.get_column<uint32_t>(k);
+		const std::vector<double>* c2 = t.get_column<double>(k);
+		bool ok = (k <= nint) ? (c1 && !c2 && c1->size() == nrows) : (c2 && !c1 && c2->size() == nrows);
+		for(size_t j = 0; ok && j < nrows; j++) {
+			if(k == 0) ok = ((*c1)[j] == j);
+			else if(k <= nint) ok = ((*c1)[j] == int_value(j, k));
+			else ok = ((*c2)[j] == double_value(j, k));
+		}
+		if(!ok) {
+			fprintf(stderr,"Error: wrong values in column %lu with %u threads!\n", k, nthreads);
+			ret = false;
+		}
+	}
+	return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t nrows = 1000;
+	size_t ncols = 20;
+	unsigned int nthreads = 4;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nrows = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'c':
+			ncols = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	if(ncols < 3) ncols = 3;
+	if(!nrows) nrows = 1;
+	size_t nint = (ncols - 1) / 2;
+	bool ret = true;
+
+	std::string input;
+	for(size_t j = 0; j < nrows; j++) {
+		input += std::to_string(j);
+		for(size_t k = 1; k < ncols; k++) {
+			char tmp[64];
+			if(k <= nint) snprintf(tmp, sizeof(tmp), "\t%u", int_value(j, k));
+			else snprintf(tmp, sizeof(tmp), "\t%.2f", double_value(j, k));
+			input += tmp;
+		}
+		input += '\n';
+	}
+
+	/* 1. all columns, with one and more threads, with blocks of rows not
+	 * dividing the number of rows */
+	ret = test_table(input, nrows, ncols, nint, 1, 7) && ret;
+	ret = test_table(input, nrows, ncols, nint, nthreads, 7) && ret;
+	ret = test_table(input, nrows, ncols, nint, nthreads, 1) && ret;
+
+	/* 2. invalid requests */
+	{
+		std::istringstream is(input);
+		read_table2 r(is, line_parser_params().set_delim('\t'));
+		table_loader t;
+		ret = check(t.load(r, 0) && t.get_ncols() == ncols, "loading the table") && ret;
+		ret = check(t.request_range<uint32_t>(1, nint), "requesting the integer columns") && ret;
+		ret = check(!t.request_range<double>(nint, 2) && t.get_last_error() == T_TYPE &&
+			t.get_error().col == nint, "requesting a column with a different type") && ret;
+		ret = check(!t.request_range<double>(ncols - 1, 2) && t.get_last_error() == T_TYPE &&
+			t.get_error().col == ncols, "requesting columns after the last one") && ret;
+		/* note: a range of zero columns is not an error */
+		ret = check(t.request_range<double>(ncols, 0), "requesting an empty range") && ret;
+	}
+
+	/* 3. out of bounds values: the error with the lowest line number (and
+	 * column within that line) is reported, and failed columns are not
+	 * available */
+	{
+		std::istringstream is(input);
+		read_table2 r(is, line_parser_params().set_delim('\t'));
+		table_loader t;
+		ret = check(t.load(r, 0), "loading the table") && ret;
+		t.set_row_block(5);
+		ret = check(t.request_range<uint32_t>(1, nint, 0, 900), "requesting the integer columns with bounds") && ret;
+		bool ok = t.materialize(nthreads);
+		/* first value above 900 in the columns 1 -- nint */
+		size_t line = 0, col = 0;
+		for(size_t j = 0; j < nrows && !line; j++) for(size_t k = 1; k <= nint; k++)
+			if(int_value(j, k) > 900) {
+				line = j + 1;
+				col = k;
+				break;
+			}
+		if(line) {
+			ret = check(!ok && t.get_last_error() == T_OVERFLOW && t.get_error().line == line &&
+				t.get_error().col == col, "value out of bounds not detected") && ret;
+			ret = check(!t.get_column<uint32_t>(col), "failed column is available") && ret;
+		}
+		else ret = check(ok, "converting the columns with bounds") && ret;
+	}
+
+	/* 4. a line with less fields than the first one */
+	{
+		std::istringstream is("1\t2\t3\n4\t5\t6\n7\t8\n");
+		read_table2 r(is, line_parser_params().set_delim('\t'));
+		table_loader t;
+		ret = check(!t.load(r, 0) && t.get_ncols() == 3 && r.get_last_error() == T_EOL &&
+			r.get_line() == 3, "short line not detected") && ret;
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
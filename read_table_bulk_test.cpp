@@ -0,0 +1,194 @@
+/*
+ * read_table_bulk_test.cpp -- simple test cases for read_table_bulk.h
+ *
+ * usage: read_table_bulk_test [-n rows] [-t threads]
+ *
+ * a generated table of the given number of rows (default: 10000) with an
+ * integer ID, a string, a double and a small integer column is loaded
+ * 1. columns are only converted when requested: column() converts one
+ * column, and the others are not available until they are requested
+ * 2. requested columns are converted with materialize() with one and the
+ * given number of threads (default: 4), with and without the specialized
+ * conversion functions (the results should be the same)
+ * 3. requesting a column with a different type or after the last one
+ * fails with T_TYPE; values out of the requested bounds are reported at
+ * the first row where they occur
+ * 4. a cache converts the repeated values of the small integer column
+ * only once
+ * 5. converted columns are counted in a memory account: a column that
+ * would exceed the limit is not converted, releasing another one makes
+ * space for it; loading with a small limit fails
+ * 6. a different delimiter and decimal separator
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include <iostream>
+#include "read_table_bulk.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* values in row j (doubles are exactly representable with 3 digits) */
+static uint32_t id_value(size_t j) { return (uint32_t)((j * 7919) % 100000); }
+static double double_value(size_t j) { return (double)(j % 1000) / 8.0; }
+static int small_value(size_t j) { return (int)(j % 5) - 2; }
+
+/* load the generated input to t (counting its memory in m if given) */
+static bool load(table_loader& t, const std::string& input, read_table_mem* m = nullptr) {
+	std::istringstream is(input);
+	read_table2 r(is, line_parser_params().set_delim('\t'));
+	if(m) t.set_memory(m);
+	if(t.load(r, 4)) return true;
+	if(t.get_last_error() != T_MEMORY) r.write_error(stderr);
+	return false;
+}
+
+/* compare the converted columns to the generated values (a column that
+ * is not converted is skipped) */
+static bool compare(const table_loader& t, size_t nrows) {
+	const std::vector<uint32_t>* ids = t.get_column<uint32_t>(0);
+	const std::vector<string_view_custom>* names = t.get_column<string_view_custom>(1);
+	const std::vector<double>* values = t.get_column<double>(2);
+	const std::vector<int>* small = t.get_column<int>(3);
+	if(t.nrows() != nrows) return false;
+	for(size_t j = 0; j < nrows; j++) {
+		std::string name = "name" + std::to_string(j % 37);
+		if(ids && (*ids)[j] != id_value(j)) return false;
+		if(names && ((*names)[j].len != name.size() || memcmp((*names)[j].str, name.data(), name.size()))) return false;
+		if(values && (*values)[j] != double_value(j)) return false;
+		if(small && (*small)[j] != small_value(j)) return false;
+	}
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t nrows = 10000;
+	unsigned int nthreads = 4;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nrows = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	if(nrows < 1000) nrows = 1000;
+	bool ret = true;
+
+	std::string input;
+	for(size_t j = 0; j < nrows; j++) {
+		char tmp[128];
+		snprintf(tmp, sizeof(tmp), "%u\tname%lu\t%.3f\t%d\n", id_value(j), (unsigned long)(j % 37),
+			double_value(j), small_value(j));
+		input += tmp;
+	}
+
+	/* 1. lazy conversion */
+	{
+		table_loader t;
+		ret = check(load(t, input) && t.get_ncols() == 4, "loading the table") && ret;
+		size_t size = t.memory_size();
+		ret = check(!t.get_column<uint32_t>(0) && !t.get_column<double>(2), "columns converted before use") && ret;
+		const std::vector<double>* values;
+		ret = check(t.column(2, values) && values->size() == nrows, "converting one column") && ret;
+		ret = check(!t.get_column<uint32_t>(0) && !t.get_column<int>(3) && t.get_column<double>(2) == values &&
+			t.memory_size() == size + nrows * sizeof(double), "only the used column should be converted") && ret;
+		ret = check(compare(t, nrows), "wrong values") && ret;
+	}
+
+	/* 2. converting all columns at once */
+	for(int strict = 0; strict < 2; strict++) for(unsigned int nt = 1; nt <= nthreads; nt += (nthreads > 1 ? nthreads - 1 : 1)) {
+		table_loader t;
+		ret = check(load(t, input), "loading the table") && ret;
+		if(strict) t.set_fast_path(false);
+		t.set_row_block(100);
+		ret = check(t.request<uint32_t>(0) && t.request<string_view_custom>(1) && t.request<double>(2) &&
+			t.request<int>(3) && t.materialize(nt), "converting the columns") && ret;
+		if(t.get_last_error() != T_OK) t.write_error(std::cerr);
+		ret = check(t.get_column<uint32_t>(0) && t.get_column<string_view_custom>(1) &&
+			t.get_column<double>(2) && t.get_column<int>(3) && compare(t, nrows), "wrong values") && ret;
+	}
+
+	/* 3. errors */
+	{
+		table_loader t;
+		ret = check(load(t, input), "loading the table") && ret;
+		const std::vector<uint32_t>* ids;
+		const std::vector<int64_t>* ids2;
+		ret = check(t.column(0, ids) && !t.column(0, ids2) && t.get_last_error() == T_TYPE &&
+			t.get_error().col == 0, "column converted with two types") && ret;
+		ret = check(!t.request<int>(4) && t.get_last_error() == T_TYPE && t.get_error().col == 4,
+			"column after the last one requested") && ret;
+		/* first value above 100: row 801 */
+		ret = check(t.request<double>(2, 0.0, 100.0) && !t.materialize(nthreads) &&
+			t.get_last_error() == T_OVERFLOW && t.get_error().line == 802 && t.get_error().col == 2 &&
+			!t.get_column<double>(2), "value out of bounds not detected") && ret;
+	}
+
+	/* 4. cache (note: only used without the specialized conversion) */
+	{
+		table_loader t;
+		ret = check(load(t, input), "loading the table") && ret;
+		t.set_fast_path(false);
+		const std::vector<int>* small;
+		uint64_t hits = 0, misses = 0;
+		ret = check(t.use_cache<int>(3) && !t.cache_stats(2, hits, misses) && t.column(3, small) &&
+			t.cache_stats(3, hits, misses) && compare(t, nrows), "converting with a cache") && ret;
+		ret = check(hits + misses == nrows && misses == 5, "values converted more than once") && ret;
+	}
+
+	/* 5. memory limit */
+	{
+		read_table_mem m;
+		read_table_mem_init(&m, 0);
+		table_loader t;
+		ret = check(load(t, input, &m) && m.used == t.memory_size(), "memory of the table not counted") && ret;
+		/* space for the doubles, but not for the IDs as well */
+		size_t limit = m.used + nrows * sizeof(double) + 100;
+		read_table_mem_set_limit(&m, limit);
+		const std::vector<uint32_t>* ids;
+		const std::vector<double>* values;
+		ret = check(t.column(0, ids) && !t.column(2, values) && t.get_last_error() == T_MEMORY &&
+			!t.get_column<double>(2), "memory limit not enforced") && ret;
+		t.release(0);
+		ret = check(!t.get_column<uint32_t>(0) && t.column(2, values) && compare(t, nrows),
+			"converting after releasing a column") && ret;
+		ret = check(m.peak <= limit && m.used == t.memory_size(), "memory limit exceeded") && ret;
+
+		table_loader t2;
+		read_table_mem m2;
+		read_table_mem_init(&m2, 4096);
+		ret = check(!load(t2, input, &m2) && t2.get_last_error() == T_MEMORY && m2.peak <= 4096,
+			"loading with a small memory limit") && ret;
+	}
+
+	/* 6. other delimiter and decimal separator */
+	{
+		std::istringstream is("1;2,5\n2;-0,25\n# comment\n3;1e3\n");
+		read_table2 r(is, line_parser_params().set_delim(';').set_decimal(',').set_comment('#'));
+		table_loader t;
+		const std::vector<double>* values;
+		ret = check(t.load(r, 2) && t.column(1, values) && values->size() == 3 && (*values)[0] == 2.5 &&
+			(*values)[1] == -0.25 && (*values)[2] == 1000.0, "decimal separator") && ret;
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
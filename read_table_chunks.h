@@ -0,0 +1,240 @@
+/*  -*- C -*-
+ * read_table_chunks.h -- helpers for processing a text file in chunks
+ * 	that are aligned to line boundaries; used by the parallel readers
+ *
+ * The file is memory-mapped and split into chunks of roughly the
+ * requested size, each chunk starting at the beginning of a line and
+ * ending after a newline (or at the end of the file). Number of lines
+ * before each chunk can be computed separately (possibly in parallel),
+ * so that line numbers in diagnostic messages refer to the whole file.
+ *
+ * This file does not depend on either read_table.h or read_table_cpp.h,
+ * so it can be used with both. It requires POSIX mmap().
+ *
+ * Copyright 2018-2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef READ_TABLE_CHUNKS_H
+#define READ_TABLE_CHUNKS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/* default size of chunks (in bytes) the input is split into */
+#ifndef READ_TABLE_CHUNK_SIZE
+#define READ_TABLE_CHUNK_SIZE (4UL*1024UL*1024UL)
+#endif
+
+/* one memory-mapped input file */
+typedef struct read_table_mapped_s {
+	const char* data; /* start of the mapping (NULL if the file is empty) */
+	size_t size; /* size of the file (and the mapping) */
+	int fd; /* file descriptor, kept open while the file is mapped */
+} read_table_mapped;
+
+/* one chunk of the input */
+typedef struct read_table_chunk_s {
+	size_t start; /* offset of the first byte, always at the beginning of a line */
+	size_t end; /* offset after the last byte (i.e. after a newline or at the end of the file) */
+	uint64_t first_line; /* number of lines before this chunk */
+} read_table_chunk;
+
+
+/* map the given file for reading
+ * returns 0 on success, 1 on error (file cannot be opened or mapped) */
+static int read_table_map_file(read_table_mapped* m, const char* fn) {
+	struct stat st;
+	if(!(m && fn)) return 1;
+	m->data = 0;
+	m->size = 0;
+	m->fd = open(fn, O_RDONLY | O_CLOEXEC);
+	if(m->fd < 0) return 1;
+	if(fstat(m->fd, &st) || !S_ISREG(st.st_mode)) {
+		/* only regular files can be mapped and split */
+		close(m->fd);
+		m->fd = -1;
+		return 1;
+	}
+	m->size = st.st_size;
+	if(m->size) {
+		void* p = mmap(0, m->size, PROT_READ, MAP_SHARED, m->fd, 0);
+		if(p == MAP_FAILED) {
+			close(m->fd);
+			m->fd = -1;
+			m->size = 0;
+			return 1;
+		}
+		m->data = (const char*)p;
+	}
+	return 0;
+}
+
+/* unmap a file mapped by the previous function */
+static void read_table_unmap_file(read_table_mapped* m) {
+	if(!m) return;
+	if(m->data) munmap((void*)(m->data), m->size);
+	if(m->fd >= 0) close(m->fd);
+	m->data = 0;
+	m->size = 0;
+	m->fd = -1;
+}
+
+/* split data of the given size into chunks of approximately chunk_size
+ * bytes, ensuring that each chunk ends after a newline (or at the end);
+ * the array of chunks is allocated and stored in chunks, the caller has
+ * to free it; returns the number of chunks (0 if there is no data or
+ * on memory allocation error, in which case chunks is set to NULL) */
+static size_t read_table_split_chunks(const char* data, size_t size, size_t chunk_size,
+		read_table_chunk** chunks) {
+	size_t n = 0;
+	size_t nalloc;
+	size_t pos = 0;
+	*chunks = 0;
+	if(!(data && size)) return 0;
+	if(!chunk_size) chunk_size = READ_TABLE_CHUNK_SIZE;
+	nalloc = size / chunk_size + 1; /* note: this is an upper limit */
+	*chunks = (read_table_chunk*)malloc(nalloc * sizeof(read_table_chunk));
+	if(!*chunks) return 0;
+	while(pos < size) {
+		size_t end = pos + chunk_size;
+		if(end >= size) end = size;
+		else {
+			/* advance until after the next newline */
+			const char* nl = (const char*)memchr(data + end - 1, '\n', size - end + 1);
+			end = nl ? (size_t)(nl - data) + 1 : size;
+		}
+		(*chunks)[n].start = pos;
+		(*chunks)[n].end = end;
+		(*chunks)[n].first_line = 0;
+		n++;
+		pos = end;
+	}
+	return n;
+}
+
+/* count the number of lines in the given range of data, i.e. the
+ * number of newline characters */
+static uint64_t read_table_count_lines(const char* data, size_t start, size_t end) {
+	uint64_t n = 0;
+	const char* p = data + start;
+	const char* e = data + end;
+	while(p < e) {
+		const char* nl = (const char*)memchr(p, '\n', e - p);
+		if(!nl) break;
+		n++;
+		p = nl + 1;
+	}
+	return n;
+}
+
+/* fill in the first_line fields of the given array of chunks from the
+ * number of newlines in each chunk which is stored in the same field
+ * when calling this function */
+static void read_table_chunks_prefix_lines(read_table_chunk* chunks, size_t n) {
+	uint64_t lines = 0;
+	size_t i;
+	for(i = 0; i < n; i++) {
+		uint64_t tmp = chunks[i].first_line;
+		chunks[i].first_line = lines;
+		lines += tmp;
+	}
+}
+
+/* estimate the fraction of the given mapped data that is in the page
+ * cache (i.e. can be read without accessing the disk)
+ * returns a number between 0 and 1, or -1 if it cannot be determined */
+static double read_table_cached_fraction(const char* data, size_t size) {
+	long page = sysconf(_SC_PAGESIZE);
+	size_t npages, i, n = 0;
+	unsigned char* vec;
+	if(!(data && size) || page <= 0) return -1.0;
+	npages = (size + page - 1) / page;
+	vec = (unsigned char*)malloc(npages);
+	if(!vec) return -1.0;
+	if(mincore((void*)data, size, vec)) {
+		free(vec);
+		return -1.0;
+	}
+	for(i = 0; i < npages; i++) if(vec[i] & 1) n++;
+	free(vec);
+	return n / (double)npages;
+}
+
+/* get the fraction of each of the n chunks of the mapped data that is in
+ * the page cache, storing it in cached (which should have space for n
+ * elements); returns 0 on success, 1 if it cannot be determined */
+static int read_table_chunks_cached(const char* data, const read_table_chunk* chunks, size_t n,
+		float* cached) {
+	long page = sysconf(_SC_PAGESIZE);
+	size_t i, j, max_pages = 0;
+	unsigned char* vec;
+	if(!(data && chunks) || page <= 0) return 1;
+	for(i = 0; i < n; i++) {
+		size_t npages = (chunks[i].end - chunks[i].start) / page + 2;
+		if(npages > max_pages) max_pages = npages;
+	}
+	vec = (unsigned char*)malloc(max_pages);
+	if(!vec) return 1;
+	for(i = 0; i < n; i++) {
+		/* note: the address given to mincore() has to be page-aligned */
+		size_t start = chunks[i].start - chunks[i].start % page;
+		size_t npages = (chunks[i].end - start + page - 1) / page;
+		size_t k = 0;
+		if(!npages) { cached[i] = 1.0f; continue; }
+		if(mincore((void*)(data + start), chunks[i].end - start, vec)) {
+			free(vec);
+			return 1;
+		}
+		for(j = 0; j < npages; j++) if(vec[j] & 1) k++;
+		cached[i] = k / (float)npages;
+	}
+	free(vec);
+	return 0;
+}
+
+/* ask the kernel to start reading the given chunk of the mapped data
+ * into the page cache (without waiting for it) */
+static void read_table_chunk_readahead(const char* data, const read_table_chunk* c) {
+	long page = sysconf(_SC_PAGESIZE);
+	size_t start;
+	if(!data || page <= 0 || c->end <= c->start) return;
+	start = c->start - c->start % page;
+	madvise((void*)(data + start), c->end - start, MADV_WILLNEED); /* note: errors are ignored */
+}
+
+#endif /* READ_TABLE_CHUNKS_H */
+
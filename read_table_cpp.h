@@ -75,19 +75,26 @@ if(r.get_last_error() != T_EOF) { // handle error
 #include <sstream>
 #include <string>
 #include <string.h>
+#include <vector>
+#include <tuple>
+#include <functional>
+#include <initializer_list>
 #if __cplusplus >= 201703L
 #include <string_view>
 #endif
 
 #include <cmath>
 
+#include "read_table_memory.h"
+#include "read_table_float.h"
+
 /* possible error codes */
 enum read_table_errors {T_OK = 0, T_EOF = 1, T_EOL, T_MISSING, T_FORMAT,
-	T_OVERFLOW, T_NAN, T_TYPE, T_COPIED, T_ERROR_FOPEN, T_READ_ERROR};
+	T_OVERFLOW, T_NAN, T_TYPE, T_COPIED, T_ERROR_FOPEN, T_READ_ERROR, T_WRITE_ERROR, T_MEMORY};
 static const char * const error_desc[] = {"No error", "End of file", "Unexpected end of line",
 		"Missing value", "Invalid value", "Overflow or underflow", "NaN or infinity read",
 		"Unknown conversion requested", "Invalidated instance", "Error opening file",
-		"Error reading input"};
+		"Error reading input", "Error writing output", "Out of memory or memory limit exceeded"};
 
 /* convert error code to string description */
 static const char* get_error_desc(enum read_table_errors err) {
@@ -115,6 +122,10 @@ static const char* get_error_desc(enum read_table_errors err) {
 			return error_desc[9];
 		case T_READ_ERROR:
 			return error_desc[10];
+		case T_WRITE_ERROR:
+			return error_desc[11];
+		case T_MEMORY:
+			return error_desc[12];
 		default:
 			return unkn;
 	}
@@ -179,15 +190,108 @@ read_bounds_t<std::pair<double,double> > read_bounds_coords(std::pair<double,dou
 		std::make_pair(-180.0,-90.0),std::make_pair(180.0,90.0));
 }
 
+/* rows with a variable number of values, stored in compressed sparse row
+ * (CSR) format: the values in row i are values[offsets[i]] to
+ * values[offsets[i+1]-1] */
+template<class T>
+struct ragged_array {
+	std::vector<uint64_t> offsets; /* start of each row, always starts with 0 */
+	std::vector<T> values; /* values of all rows */
+	ragged_array():offsets(1,0) { }
+	size_t nrows() const { return offsets.size() - 1; }
+	size_t row_size(size_t i) const { return offsets[i+1] - offsets[i]; }
+	const T* row(size_t i) const { return values.data() + offsets[i]; }
+	void clear() { offsets.assign(1,0); values.clear(); }
+};
+/* struct to read all remaining values in a line as a new row in a
+ * ragged_array, optionally with bounds (to be given to read() or
+ * read_next(), e.g. for lines like "node n1 n2 n3 ...") */
+template<class T>
+struct rest_of_line_t {
+	rest_of_line_t(ragged_array<T>& arr_):arr(arr_),has_bounds(false),min(),max() { }
+	rest_of_line_t(ragged_array<T>& arr_, T min_, T max_):arr(arr_),has_bounds(true),min(min_),max(max_) { }
+	ragged_array<T>& arr;
+	bool has_bounds;
+	T min;
+	T max;
+};
+template<class T> rest_of_line_t<T> rest_of_line(ragged_array<T>& arr) {
+	return rest_of_line_t<T>(arr);
+}
+template<class T> rest_of_line_t<T> rest_of_line(ragged_array<T>& arr, T min, T max) {
+	return rest_of_line_t<T>(arr,min,max);
+}
+
+/* value that can be missing (e.g. optional keys in key=value lines) */
+template<class T>
+struct read_table_nullable {
+	T val;
+	bool valid; /* false if the value was missing */
+	read_table_nullable():val(),valid(false) { }
+	explicit operator bool() const { return valid; }
+	const T& value_or(const T& def) const { return valid ? val : def; }
+};
+
+/* set of keys to look up in lines with key=value fields (e.g. logfmt);
+ * keys are stored in a small open addressing hash table which is
+ * built once and can be used for parsing any number of lines */
+class kv_keys {
+	protected:
+		std::vector<std::string> keys;
+		std::vector<uint32_t> table; /* index + 1 of the key stored in each slot, 0 if empty */
+		uint32_t mask = 0;
+		
+		static uint32_t hash(const char* str, size_t len) {
+			/* FNV-1a */
+			uint32_t h = 2166136261U;
+			for(size_t i = 0; i < len; i++) {
+				h ^= (unsigned char)str[i];
+				h *= 16777619U;
+			}
+			return h;
+		}
+		void build() {
+			size_t size = 8;
+			while(size < 2 * keys.size()) size *= 2;
+			table.assign(size, 0);
+			mask = size - 1;
+			for(size_t i = 0; i < keys.size(); i++) {
+				uint32_t j = hash(keys[i].data(), keys[i].size()) & mask;
+				while(table[j]) j = (j + 1) & mask;
+				table[j] = i + 1;
+			}
+		}
+	public:
+		kv_keys(std::initializer_list<std::string> keys_) : keys(keys_) { build(); }
+		explicit kv_keys(std::vector<std::string> keys_) : keys(std::move(keys_)) { build(); }
+		
+		/* return the index of the given key, or size() if not found */
+		size_t find(const char* str, size_t len) const {
+			uint32_t j = hash(str, len) & mask;
+			while(table[j]) {
+				const std::string& k = keys[table[j] - 1];
+				if(k.size() == len && !memcmp(k.data(), str, len)) return table[j] - 1;
+				j = (j + 1) & mask;
+			}
+			return keys.size();
+		}
+		size_t size() const { return keys.size(); }
+		const std::string& operator [] (size_t i) const { return keys[i]; }
+};
+
 struct line_parser_params {
 	int base; /* base for integer conversions */
 	char delim; /* delimiter to use; 0 means any blank (space or tab) note: cannot be newline */
 	char comment; /* character to indicate comments; 0 means none */
+	char decimal; /* decimal separator for doubles; with '.', strtod() is used (depending on the locale) */
 	bool allow_nan_inf; /* further flags: whether reading a NaN or INF for double values is considered and error */
-	line_parser_params():base(10),delim(0),comment(0),allow_nan_inf(true) { }
+	line_parser_params():base(10),delim(0),comment(0),decimal('.'),allow_nan_inf(true) { }
 	line_parser_params& set_base(int base_) { base = base_; return *this; }
 	line_parser_params& set_delim(char delim_) { delim = delim_; return *this; }
 	line_parser_params& set_comment(char comment_) { comment = comment_; return *this; }
+	/* set the decimal separator, e.g. ',' (with ';' as the delimiter);
+	 * anything else than '.' is parsed without depending on the locale */
+	line_parser_params& set_decimal(char decimal_) { decimal = decimal_ ? decimal_ : '.'; return *this; }
 	line_parser_params& set_allow_nan_inf(bool allow_nan_inf_) { allow_nan_inf = allow_nan_inf_; return *this; }
 };
 
@@ -201,12 +305,14 @@ struct line_parser {
 		enum read_table_errors last_error = T_OK; /* error code of the last operation */
 		char delim; /* delimiter to use; 0 means any blank (space or tab) note: cannot be newline */
 		char comment; /* character to indicate comments; 0 means none */
+		char decimal; /* decimal separator for doubles */
 		bool allow_nan_inf; /* further flags: whether reading a NaN or INF for double values is considered and error */
 		
 		void line_parser_init(const line_parser_params& par) {
 			base = par.base;
 			delim = par.delim;
 			comment = par.comment;
+			decimal = par.decimal;
 			allow_nan_inf = par.allow_nan_inf;
 		}
 		
@@ -232,7 +338,9 @@ struct line_parser {
 			pos = lp.pos;
 			col = lp.col;
 			base = lp.base;
+			delim = lp.delim;
 			comment = lp.comment;
+			decimal = lp.decimal;
 			allow_nan_inf = lp.allow_nan_inf;
 			last_error = lp.last_error;
 			lp.last_error = T_COPIED;
@@ -245,7 +353,9 @@ struct line_parser {
 			pos = lp.pos;
 			col = lp.col;
 			base = lp.base;
+			delim = lp.delim;
 			comment = lp.comment;
+			decimal = lp.decimal;
 			allow_nan_inf = lp.allow_nan_inf;
 			last_error = lp.last_error;
 			lp.last_error = T_COPIED;
@@ -262,6 +372,14 @@ struct line_parser {
 			pos = 0;
 			last_error = T_OK;
 		}
+		/* same, but copy from the given buffer, reusing the memory already
+		 * allocated for the internal string if possible */
+		void assign_line(const char* str, size_t len) {
+			buf.assign(str, len);
+			col = 0;
+			pos = 0;
+			last_error = T_OK;
+		}
 		/* get current line string */
 		const char* get_line_c_str() const { return buf.c_str(); }
 		const std::string& get_line_str() const { return buf; }
@@ -272,11 +390,17 @@ struct line_parser {
 		 * strings, pairs of doubles and special "types":
 		 * 	- read_table_skip_t for skipping values
 		 * 	- read_bounds_t for specifying minimum and maximum value for the input
+		 * 	- rest_of_line_t for reading all remaining values in the line
 		 * see below for more explanation */
 		/* try to parse one value from the currently read line */
 		template<class T> bool read_next(T& val, bool advance_pos = true);
 		/* overload of the previous for reading values with bounds */
 		template<class T> bool read_next(read_bounds_t<T> val, bool advance_pos = true);
+		/* overload for reading all remaining values as a new row of a
+		 * ragged_array (an empty row if there are none); with a
+		 * delimiter, empty fields are an error (T_MISSING), also after
+		 * a delimiter at the end of the line; on error, nothing is added */
+		template<class T> bool read_next(rest_of_line_t<T> val, bool advance_pos = true);
 		/* overload for reading std::pairs */
 		template<class U, class V> bool read_next(std::pair<U, V>& p, bool advance_pos = true) {
 			U u;
@@ -307,8 +431,12 @@ struct line_parser {
 		void set_comment(char comment_) { comment = comment_; }
 		/* get comment character (default is none) */
 		char get_comment() const { return comment; }
+		/* set decimal separator (default is '.') */
+		void set_decimal(char decimal_) { decimal = decimal_ ? decimal_ : '.'; }
+		/* get decimal separator */
+		char get_decimal() const { return decimal; }
 		line_parser_params get_params() const {
-			return line_parser_params().set_base(base).set_delim(delim).set_allow_nan_inf(allow_nan_inf).set_comment(comment);
+			return line_parser_params().set_base(base).set_delim(delim).set_allow_nan_inf(allow_nan_inf).set_comment(comment).set_decimal(decimal);
 		}
 		void reset_pos() {
 			if(last_error == T_COPIED || last_error == T_EOF ||
@@ -359,7 +487,44 @@ struct line_parser {
 		bool read_string_view(std::string_view& str, bool advance_pos = true);
 #endif
 		bool read_string_view_custom(string_view_custom& str, bool advance_pos = true);
+		
+		/* 6. parse lines consisting of key=value fields separated by blanks
+		 * (e.g. logfmt); values for the keys in keys are stored in vals
+		 * (in the same order as the keys); vals can be read_table_nullable<T>,
+		 * which are set to invalid for missing keys, or any other supported
+		 * type, for which a missing key is an error (T_MISSING, with the
+		 * position and column set to the end of the line); values can
+		 * be quoted with double quotes (without escapes) if read as strings;
+		 * fields with other keys are ignored; the line is tokenized once and
+		 * only values of the given keys are converted
+		 * note: this uses blanks as separators regardless of the delimiter set */
+		template<class... Ts>
+		bool read_kv(const kv_keys& keys, Ts&&... vals);
 	
+	protected:
+		/* position of a value in a key=value line */
+		struct kv_span {
+			size_t start; /* start of the value (after the '=' and the quote if any) */
+			size_t len; /* length of the value */
+			size_t col; /* index of the field */
+			bool found;
+		};
+		bool kv_tokenize(const kv_keys& keys, kv_span* spans, size_t nspans);
+		template<class T> bool kv_convert(const kv_span& sp, T& val);
+		bool kv_convert(const kv_span& sp, std::string& val);
+		bool kv_convert(const kv_span& sp, string_view_custom& val);
+#if __cplusplus >= 201703L
+		bool kv_convert(const kv_span& sp, std::string_view& val);
+#endif
+		template<class T> bool kv_store(const kv_span& sp, T& val);
+		template<class T> bool kv_store(const kv_span& sp, read_table_nullable<T>& val);
+		bool kv_store_all(const kv_span*) { return true; }
+		template<class first, class ...rest>
+		bool kv_store_all(const kv_span* spans, first&& val, rest&&... vals) {
+			if(!kv_store(*spans, val)) return false;
+			return kv_store_all(spans + 1, vals...);
+		}
+		
 	protected:
 		/* helper functions for the previous */
 		bool read_table_pre_check(bool advance_pos);
@@ -367,9 +532,26 @@ struct line_parser {
 		/* read string return start position and length
 		 *  -- the other read_string functions then use these to create the string_view or copy to a string */
 		bool read_string2(std::pair<size_t,size_t>& pos1, bool advance_pos = true);
+		
+		friend class record_dispatcher;
 };
 
 
+/* default size of blocks read at once by read_table2::read_lines() */
+#ifndef READ_TABLE_BLOCK_SIZE
+#define READ_TABLE_BLOCK_SIZE (64UL*1024UL)
+#endif
+
+/* one line returned by read_table2::read_lines(), pointing to the internal
+ * buffer of read_table2 (valid until the next call to read_lines() or
+ * read_line()); line endings are not included */
+struct line_view {
+	const char* str;
+	size_t len;
+	uint64_t line; /* line number in the input */
+	uint64_t offset; /* offset of the start of the line in the input */
+};
+
 /* main class containing main parameters for processing text */
 struct read_table2 : public line_parser {
 	protected:
@@ -378,11 +560,30 @@ struct read_table2 : public line_parser {
 		std::unique_ptr<std::ifstream> fs; /* file stream if it is opened by us */
 		const char* fn = nullptr; /* file name, stored optionally for error output (note: not owned by this class, caller should not free the supplied value) */
 		uint64_t line = 0; /* current line (count starts from 1) */
+		uint64_t line_offset = 0; /* offset of the start of the current line in the input (in bytes) */
+		uint64_t next_offset = 0; /* offset of the start of the next line */
+		std::vector<char> block; /* block of data read by read_lines() */
+		size_t block_pos = 0; /* start of data not processed yet in block */
+		size_t block_end = 0; /* end of valid data in block */
+		read_table_mem_tracker mem; /* memory used by the buffers (see read_table_memory.h) */
 		read_table2() = delete; /* user should supply either an input stream or a filename to use */
 		read_table2(const read_table2& r) = delete; /* disallow copying, only moving is possible */
 		
 		const char line_endings[2] = {'\n','\r'};
 		
+		/* get the next line to buf, either from block or the input stream;
+		 * size is set to the number of bytes consumed from the input
+		 * (including the newline character if there was one) */
+		bool get_next_line(size_t& size);
+		/* read more data into block, keeping the unprocessed part */
+		bool fill_block();
+		/* update the memory accounts after the buffers grew; returns
+		 * false and sets last_error to T_MEMORY if a limit is exceeded */
+		bool update_memory();
+		/* make sure that buf can store n characters, counting it in the
+		 * memory accounts before growing it */
+		bool reserve_buf(size_t n);
+		
 	public:
 		
 		/* 1. constructors -- need to give a file name or an already open input stream */
@@ -401,12 +602,37 @@ struct read_table2 : public line_parser {
 		
 		read_table2& operator = (read_table2&& r);
 		
+		/* count the memory used by the buffers in m (in addition to the
+		 * global account); reading fails with T_MEMORY if this would exceed
+		 * the limit of either */
+		void set_memory(read_table_mem* m) { mem.set_account(m); }
+		
 		/* 2. read one line into the internal buffer
 		 * 	the 'skip' parameter controls whether empty lines are skipped */
 		bool read_line(bool skip = true);
 		
+		/* read up to max_lines lines at once into batch (clearing its
+		 * previous contents); empty and comment-only lines are skipped;
+		 * the lines point to an internal buffer, and are valid until the
+		 * next call to read_lines() or read_line(); a line can be parsed
+		 * by copying it to a line_parser (with line_parser::assign_line())
+		 * returns false if no lines could be read (at the end of the input
+		 * or on error) */
+		bool read_lines(std::vector<line_view>& batch, size_t max_lines = 1024);
+		
 		/* get current position in the file */
 		uint64_t get_line() const { return line; }
+		/* get the offset of the beginning of the current line (in bytes,
+		 * counted from where reading started; this is the same as the
+		 * position in the stream if it was read from the beginning) */
+		uint64_t get_line_offset() const { return line_offset; }
+		/* get the offset of the beginning of the next line */
+		uint64_t get_next_offset() const { return next_offset; }
+		/* continue reading from the given offset in the input, which should
+		 * be the beginning of a line; line_ is the number of lines before
+		 * that point (used for diagnostic messages); this requires the
+		 * input stream to be seekable; returns false on error */
+		bool seek(uint64_t offset, uint64_t line_ = 0);
 		/* set filename (for better formatting of diagnostic messages) */
 		void set_fn_for_diag(const char* fn_) { fn = fn_; }
 		const char* get_fn() const { return fn; }
@@ -460,7 +686,10 @@ read_table2::read_table2(std::istream& is_, const line_parser_params& par) : lin
 /* move constructor -- moves the stream to the new instance
  * the old instance is invalidated */
 read_table2::read_table2(read_table2&& r) : line_parser(std::move(r)), 
-		is(r.is), fs(std::move(r.fs)), fn(r.fn), line(r.line) {
+		is(r.is), fs(std::move(r.fs)), fn(r.fn), line(r.line),
+		line_offset(r.line_offset), next_offset(r.next_offset),
+		block(std::move(r.block)), block_pos(r.block_pos), block_end(r.block_end),
+		mem(std::move(r.mem)) {
 	/* note: line_parser base class' move constructor will set r.last_error == T_COPIED,
 	 * so r will not be usable from this point on */
 	r.is = nullptr;
@@ -473,6 +702,12 @@ read_table2& read_table2::operator = (read_table2&& r) {
 	fs = std::move(r.fs);
 	fn = r.fn;
 	line = r.line;
+	line_offset = r.line_offset;
+	next_offset = r.next_offset;
+	block = std::move(r.block);
+	block_pos = r.block_pos;
+	block_end = r.block_end;
+	mem = std::move(r.mem);
 	r.is = nullptr;
 	return *this;
 }
@@ -485,14 +720,19 @@ read_table2& read_table2::operator = (read_table2&& r) {
  * which will probably result in errors if data is tried to be parsed from it */
 bool read_table2::read_line(bool skip) {
 	if(last_error == T_EOF || last_error == T_COPIED ||
-		last_error == T_ERROR_FOPEN) return false;
-	if(is->eof()) { last_error = T_EOF; return false; }
+		last_error == T_ERROR_FOPEN || last_error == T_MEMORY) return false;
+	if(is->eof() && block_pos == block_end) { last_error = T_EOF; return false; }
 	while(1) {
-		std::getline(*is,buf);
-		if(is->eof()) { last_error = T_EOF; return false; }
-		if(is->fail()) { last_error = T_READ_ERROR; return false; }
+		size_t size;
+		if(!get_next_line(size)) return false;
+		if(!update_memory()) return false;
 		size_t len = buf.size();
 		line++; 
+		line_offset = next_offset;
+		next_offset += size;
+		/* remove line end characters (same as read_lines()) */
+		if(len && buf[len-1] == '\r') buf.pop_back();
+		len = buf.size();
 		pos = 0;
 		/* check that there is actual data in the line, empty lines are skipped */
 		if(skip) {
@@ -508,10 +748,188 @@ bool read_table2::read_line(bool skip) {
 	}
 	col = 0; /* reset the counter for columns */
 	last_error = T_OK;
-	
-	/* check line end characters */
-	if(buf.size()) for(char c : line_endings) if(buf.back() == c) { buf.pop_back(); break; }
-	
+	return true;
+}
+
+/* get the next line to buf (without the newline character) -- if there is
+ * data in block (from previous calls to read_lines()), it is used first */
+bool read_table2::get_next_line(size_t& size) {
+	if(mem.limited()) {
+		/* with a memory limit, the input is always read in blocks, so
+		 * that the buffers are counted before growing them (note:
+		 * std::getline() could allocate any amount of memory) */
+		last_error = T_OK;
+		while(1) {
+			const char* start = block.data() + block_pos;
+			const char* nl = (block_pos < block_end) ?
+				(const char*)memchr(start, '\n', block_end - block_pos) : nullptr;
+			size_t len = nl ? (size_t)(nl - start) : block_end - block_pos;
+			if(!nl) {
+				if(fill_block()) continue;
+				if(last_error == T_READ_ERROR || last_error == T_MEMORY) return false;
+				if(!len) { last_error = T_EOF; return false; }
+				start = block.data() + block_pos; /* last line without a newline at the end */
+			}
+			if(!reserve_buf(len)) return false;
+			buf.assign(start, len);
+			size = len + (nl ? 1 : 0);
+			block_pos += size;
+			return true;
+		}
+	}
+	if(block_pos < block_end) {
+		const char* start = block.data() + block_pos;
+		const char* nl = (const char*)memchr(start, '\n', block_end - block_pos);
+		if(nl) {
+			buf.assign(start, nl - start);
+			block_pos += (nl - start) + 1;
+			size = buf.size() + 1;
+			return true;
+		}
+		/* partial line, the rest is read from the input */
+		buf.assign(start, block_end - block_pos);
+		block_pos = block_end = 0;
+		std::string tmp;
+		std::getline(*is,tmp);
+		if(is->bad()) { last_error = T_READ_ERROR; return false; }
+		buf += tmp;
+		size = buf.size() + (is->eof() ? 0 : 1); /* no newline at the end of the input */
+		return true;
+	}
+	std::getline(*is,buf);
+	if(is->bad()) { last_error = T_READ_ERROR; return false; }
+	if(is->eof()) {
+		/* note: the last line is returned even without a newline at the end */
+		if(buf.empty()) { last_error = T_EOF; return false; }
+		size = buf.size();
+		return true;
+	}
+	if(is->fail()) { last_error = T_READ_ERROR; return false; }
+	size = buf.size() + 1; /* note: the newline character was removed by getline() */
+	return true;
+}
+
+/* read more data into block; returns false if nothing could be read */
+bool read_table2::fill_block() {
+	if(block_pos > 0) {
+		if(block_pos < block_end) memmove(block.data(), block.data() + block_pos, block_end - block_pos);
+		block_end -= block_pos;
+		block_pos = 0;
+	}
+	size_t new_size = block.size();
+	if(new_size < READ_TABLE_BLOCK_SIZE) new_size = READ_TABLE_BLOCK_SIZE;
+	else if(block_end == new_size) new_size *= 2; /* line longer than the block */
+	if(new_size > block.capacity()) {
+		/* note: counted before allocating */
+		if(!mem.update(buf.capacity() + new_size)) {
+			last_error = T_MEMORY;
+			return false;
+		}
+		block.reserve(new_size);
+	}
+	block.resize(new_size);
+	if(!update_memory()) return false;
+	if(is->eof()) return false;
+	is->read(block.data() + block_end, block.size() - block_end);
+	size_t n = is->gcount();
+	if(is->bad()) { last_error = T_READ_ERROR; return false; }
+	block_end += n;
+	return n > 0;
+}
+
+bool read_table2::update_memory() {
+	if(!mem.update(buf.capacity() + block.capacity())) {
+		last_error = T_MEMORY;
+		return false;
+	}
+	return true;
+}
+
+bool read_table2::reserve_buf(size_t n) {
+	if(n <= buf.capacity()) return true;
+	/* note: std::string grows to at least twice its capacity */
+	size_t cap = 2 * buf.capacity();
+	if(cap < n) cap = n;
+	if(!mem.update(cap + block.capacity())) {
+		last_error = T_MEMORY;
+		return false;
+	}
+	buf.reserve(cap);
+	return update_memory();
+}
+
+/* read a batch of lines */
+bool read_table2::read_lines(std::vector<line_view>& batch, size_t max_lines) {
+	batch.clear();
+	if(last_error == T_EOF || last_error == T_COPIED ||
+		last_error == T_ERROR_FOPEN || last_error == T_READ_ERROR ||
+		last_error == T_MEMORY) return false;
+	while(batch.size() < max_lines) {
+		const char* start = block.data() + block_pos;
+		size_t len;
+		size_t next;
+		const char* nl = (block_pos < block_end) ?
+			(const char*)memchr(start, '\n', block_end - block_pos) : nullptr;
+		if(nl) {
+			len = nl - start;
+			next = block_pos + len + 1;
+		}
+		else {
+			/* note: lines already in batch point to block, so it can only
+			 * be refilled if batch is empty */
+			if(batch.size()) break;
+			if(fill_block()) continue;
+			if(last_error == T_READ_ERROR || last_error == T_MEMORY) return false;
+			if(block_pos == block_end) break; /* end of input */
+			/* last line without a newline at the end */
+			len = block_end - block_pos;
+			next = block_end;
+			start = block.data() + block_pos;
+		}
+		line++;
+		line_offset = next_offset;
+		next_offset += next - block_pos;
+		block_pos = next;
+		if(len && start[len-1] == '\r') len--;
+		/* skip empty and comment-only lines */
+		size_t i = 0;
+		for(; i < len; i++) if( ! (start[i] == ' ' || start[i] == '\t') ) break;
+		if(i == len || (comment && start[i] == comment)) continue;
+		line_view v;
+		v.str = start;
+		v.len = len;
+		v.line = line;
+		v.offset = line_offset;
+		batch.push_back(v);
+	}
+	buf.clear();
+	pos = 0;
+	col = 0;
+	if(batch.empty()) {
+		last_error = T_EOF;
+		return false;
+	}
+	last_error = T_OK;
+	return true;
+}
+
+/* continue reading from a given offset */
+bool read_table2::seek(uint64_t offset, uint64_t line_) {
+	if(last_error == T_COPIED || last_error == T_ERROR_FOPEN || !is) return false;
+	is->clear();
+	is->seekg((std::streamoff)offset, std::ios_base::beg);
+	if(is->fail()) {
+		last_error = T_READ_ERROR;
+		return false;
+	}
+	line = line_;
+	line_offset = offset;
+	next_offset = offset;
+	block_pos = block_end = 0;
+	buf.clear();
+	pos = 0;
+	col = 0;
+	last_error = T_OK;
 	return true;
 }
 
@@ -523,7 +941,7 @@ bool line_parser::read_table_pre_check(bool advance_pos) {
 	size_t old_pos = pos;
 	size_t len = buf.size();
 	for(;pos < len; pos++)
-		if( ! (buf[pos] == ' ' || buf[pos] == '\t') ) break;
+		if( ! ((buf[pos] == ' ' || buf[pos] == '\t') && buf[pos] != delim) ) break; /* note: delimiter can be a tab */
 	/* 2. check for end of line or comment */
 	if(pos == len || buf[pos] == '\n' || (comment && buf[pos] == comment) ) {
 		last_error = T_EOL;
@@ -554,7 +972,7 @@ bool line_parser::read_table_post_check(const char* c2) {
 	bool have_blank = false;
 	size_t len = buf.size();
 	for(pos = c2 - buf.c_str();pos<len;pos++)
-		if( ! (buf[pos] == ' ' || buf[pos] == '\t') ) break;
+		if( ! ((buf[pos] == ' ' || buf[pos] == '\t') && buf[pos] != delim) ) break; /* note: delimiter can be a tab */
 		else have_blank = true;
 	last_error = T_OK;
 	/* 2. check for end of line -- this is not a problem here */
@@ -858,7 +1276,7 @@ bool line_parser::read_double(double& d, bool advance_pos) {
 	if(!read_table_pre_check(advance_pos)) return false;
 	errno = 0;
 	char* c2;
-	d = strtod(buf.c_str() + pos, &c2);
+	d = (decimal == '.') ? strtod(buf.c_str() + pos, &c2) : read_table_strtod_sep(buf.c_str() + pos, &c2, decimal);
 	/* advance position after the number, check if there is proper field separator */
 	bool ret = read_table_post_check(c2);
 	if(ret && allow_nan_inf == false) {
@@ -875,7 +1293,7 @@ bool line_parser::read_double_limits(double& d, double min, double max, bool adv
 	if(!read_table_pre_check(advance_pos)) return false;
 	errno = 0;
 	char* c2;
-	d = strtod(buf.c_str() + pos, &c2);
+	d = (decimal == '.') ? strtod(buf.c_str() + pos, &c2) : read_table_strtod_sep(buf.c_str() + pos, &c2, decimal);
 	bool ret = read_table_post_check(c2);
 	if(ret) {
 		if(std::isnan(d)) {
@@ -986,6 +1404,41 @@ template<> bool line_parser::read_next(read_bounds_t<std::pair<double,double> >
 }
 
 
+/* read all remaining values in the line
+ * example usage (for lines with a node ID and a list of neighbors):
+ragged_array<uint32_t> adj;
+uint32_t node;
+while(r.read_line()) if(!r.read(node, rest_of_line(adj))) break;
+*/
+template<class T> bool line_parser::read_next(rest_of_line_t<T> val, bool advance_pos) {
+	std::vector<T>& values = val.arr.values;
+	size_t start = values.size();
+	size_t old_pos = pos;
+	while(true) {
+		values.emplace_back();
+		bool ret = val.has_bounds ? read_next(read_bounds(values.back(),val.min,val.max)) :
+			read_next(values.back());
+		if(!ret) {
+			values.pop_back();
+			if(last_error == T_EOL) {
+				/* no more values; a delimiter before the end of the line
+				 * means that the last field is empty */
+				size_t p = pos;
+				for(; p > 0; p--) if( ! ((buf[p-1] == ' ' || buf[p-1] == '\t') && buf[p-1] != delim) ) break;
+				if(!(delim && p > 0 && buf[p-1] == delim)) break;
+				last_error = T_MISSING;
+			}
+			values.resize(start);
+			return false;
+		}
+	}
+	last_error = T_OK;
+	val.arr.offsets.push_back(values.size());
+	if(!advance_pos) pos = old_pos;
+	return true;
+}
+
+
 /* recursive templated function to convert whole line using one function call only
  * note: recursion will be probably eliminated and the whole function expanded to
  * the actual sequence of conversions needed */
@@ -999,6 +1452,255 @@ bool line_parser::read(first&& val, rest&&... vals) {
 
 
 
+/* parsing key=value fields */
+/* find the position of the values for the keys (only the first nspans
+ * keys are considered) */
+bool line_parser::kv_tokenize(const kv_keys& keys, kv_span* spans, size_t nspans) {
+	if(last_error == T_EOF || last_error == T_EOL || last_error == T_COPIED ||
+		last_error == T_READ_ERROR || last_error == T_ERROR_FOPEN) return false;
+	for(size_t i = 0; i < nspans; i++) spans[i].found = false;
+	size_t len = buf.size();
+	size_t c = 0;
+	while(true) {
+		/* skip blanks, check for end of line */
+		for(; pos < len; pos++) if( ! (buf[pos] == ' ' || buf[pos] == '\t') ) break;
+		if(pos == len || buf[pos] == '\n' || (comment && buf[pos] == comment)) break;
+		/* key */
+		size_t k1 = pos;
+		for(; pos < len; pos++) if(buf[pos] == '=' || buf[pos] == ' ' || buf[pos] == '\t' ||
+			buf[pos] == '\n' || (comment && buf[pos] == comment)) break;
+		size_t k2 = pos;
+		/* value */
+		size_t v1 = pos, v2 = pos;
+		if(pos < len && buf[pos] == '=') {
+			pos++;
+			if(pos < len && buf[pos] == '"') {
+				v1 = ++pos;
+				for(; pos < len; pos++) if(buf[pos] == '"') break;
+				if(pos == len) {
+					last_error = T_FORMAT; /* missing closing quote */
+					col = c;
+					pos = v1 - 1;
+					return false;
+				}
+				v2 = pos++;
+			}
+			else {
+				v1 = pos;
+				for(; pos < len; pos++) if(buf[pos] == ' ' || buf[pos] == '\t' ||
+					buf[pos] == '\n' || (comment && buf[pos] == comment)) break;
+				v2 = pos;
+			}
+		}
+		size_t i = keys.find(buf.data() + k1, k2 - k1);
+		if(i < nspans && !spans[i].found) {
+			spans[i].start = v1;
+			spans[i].len = v2 - v1;
+			spans[i].col = c;
+			spans[i].found = true;
+		}
+		c++;
+	}
+	/* missing keys refer to the end of the line (for error messages) */
+	for(size_t i = 0; i < nspans; i++) if(!spans[i].found) {
+		spans[i].start = pos;
+		spans[i].len = 0;
+		spans[i].col = c;
+	}
+	col = c;
+	return true;
+}
+
+/* convert one value with the usual functions (this requires that the
+ * value is followed by a blank or the end of the line) */
+template<class T>
+bool line_parser::kv_convert(const kv_span& sp, T& val) {
+	size_t end = sp.start + sp.len;
+	if(end < buf.size() && buf[end] == '"') {
+		/* quoted values can only be read as strings */
+		last_error = T_FORMAT;
+		pos = sp.start;
+		col = sp.col;
+		return false;
+	}
+	if(sp.len == 0) {
+		last_error = T_MISSING;
+		pos = sp.start;
+		col = sp.col;
+		return false;
+	}
+	char delim1 = delim;
+	delim = 0;
+	pos = sp.start;
+	col = sp.col;
+	last_error = T_OK;
+	bool ret = read_next(val);
+	delim = delim1;
+	return ret;
+}
+bool line_parser::kv_convert(const kv_span& sp, std::string& val) {
+	val.assign(buf, sp.start, sp.len);
+	return true;
+}
+bool line_parser::kv_convert(const kv_span& sp, string_view_custom& val) {
+	val.str = buf.data() + sp.start;
+	val.len = sp.len;
+	return true;
+}
+#if __cplusplus >= 201703L
+bool line_parser::kv_convert(const kv_span& sp, std::string_view& val) {
+	val = std::string_view(buf.data() + sp.start, sp.len);
+	return true;
+}
+#endif
+
+template<class T>
+bool line_parser::kv_store(const kv_span& sp, T& val) {
+	if(!sp.found) {
+		last_error = T_MISSING;
+		pos = sp.start;
+		col = sp.col;
+		return false;
+	}
+	return kv_convert(sp, val);
+}
+template<class T>
+bool line_parser::kv_store(const kv_span& sp, read_table_nullable<T>& val) {
+	val.valid = false;
+	if(!sp.found) return true;
+	if(!kv_convert(sp, val.val)) return false;
+	val.valid = true;
+	return true;
+}
+
+template<class... Ts>
+bool line_parser::read_kv(const kv_keys& keys, Ts&&... vals) {
+	kv_span spans[sizeof...(Ts) ? sizeof...(Ts) : 1];
+	if(!kv_tokenize(keys, spans, sizeof...(Ts))) return false;
+	size_t end_pos = pos;
+	size_t end_col = col;
+	if(!kv_store_all(spans, vals...)) return false;
+	pos = end_pos;
+	col = end_col;
+	last_error = T_OK;
+	return true;
+}
+
+
+/* helpers to call a function with the elements of a tuple as arguments (C++11) */
+template<size_t... I> struct rt_index_seq { };
+template<size_t N, size_t... I> struct rt_make_index_seq : rt_make_index_seq<N-1, N-1, I...> { };
+template<size_t... I> struct rt_make_index_seq<0, I...> { typedef rt_index_seq<I...> type; };
+/* call f; if it returns void, this is considered success */
+template<class F, class... Args>
+auto rt_invoke(F& f, Args&... args) -> typename std::enable_if<std::is_void<decltype(f(args...))>::value, bool>::type {
+	f(args...);
+	return true;
+}
+template<class F, class... Args>
+auto rt_invoke(F& f, Args&... args) -> typename std::enable_if<!std::is_void<decltype(f(args...))>::value, bool>::type {
+	return f(args...);
+}
+template<class F, class Tuple, size_t... I>
+bool rt_read_and_call(line_parser& lp, F& f, Tuple& vals, rt_index_seq<I...>) {
+	if(!lp.read(std::get<I>(vals)...)) return false;
+	return rt_invoke(f, std::get<I>(vals)...);
+}
+template<class Tuple, class Cols, size_t... I>
+bool rt_read_and_store(line_parser& lp, Tuple& vals, Cols& cols, rt_index_seq<I...>) {
+	if(!lp.read(std::get<I>(vals)...)) return false;
+	int dummy[] = { 0, (std::get<I>(cols)->push_back(std::get<I>(vals)), 0)... };
+	(void)dummy;
+	return true;
+}
+
+
+/* Dispatching lines to different handlers based on the value of one
+ * field (the discriminator), e.g. for files where the first field is
+ * "H", "D" or "T" for header, data and trailer records, each followed
+ * by a different set of columns.
+ * The discriminator is read once and the handler continues parsing the
+ * line directly after it, i.e. it gets the remaining fields; if the
+ * discriminator is not the first column, the fields before it are
+ * skipped (a handler that needs them can call lp.reset_pos() to read
+ * the line again from the beginning).
+ * 
+ * Example usage:
+record_dispatcher d;
+d.add_record<uint32_t, double>("D", [&](uint32_t id, double x) { ... });
+d.add_columns("P", ids, values); // ids and values are std::vector<T>, values are appended
+d.add("H", [&](line_parser& lp) { ... return true; }); // parse the rest of the line directly
+while(r.read_line()) if(!d.dispatch(r)) break;
+if(r.get_last_error() != T_EOF) r.write_error(std::cerr);
+ */
+class record_dispatcher {
+	public:
+		/* handler called with the parser positioned after the discriminator;
+		 * it should return false on error (with the error code set by the parser) */
+		typedef std::function<bool(line_parser&)> handler;
+		
+	protected:
+		std::vector<std::pair<std::string, handler> > handlers;
+		handler default_handler; /* called for unknown record types (if set) */
+		size_t disc_col; /* column containing the discriminator (0-based) */
+		
+		void add_handler(std::string&& key, handler&& h) {
+			for(auto& x : handlers) if(x.first == key) { x.second = std::move(h); return; }
+			handlers.emplace_back(std::move(key), std::move(h));
+		}
+		
+	public:
+		explicit record_dispatcher(size_t disc_col_ = 0) : disc_col(disc_col_) { }
+		
+		/* add a handler for the given discriminator value */
+		void add(std::string key, handler h) { add_handler(std::move(key), std::move(h)); }
+		/* set handler to call for lines with unknown discriminators; if not
+		 * set, these are considered errors (T_FORMAT) */
+		void set_default(handler h) { default_handler = std::move(h); }
+		
+		/* add a handler that reads the given types and calls f with them
+		 * (f can return void or bool, false meaning an error) */
+		template<class... Ts, class F>
+		void add_record(std::string key, F f) {
+			add_handler(std::move(key), [f](line_parser& lp) mutable -> bool {
+				std::tuple<Ts...> vals;
+				return rt_read_and_call(lp, f, vals, typename rt_make_index_seq<sizeof...(Ts)>::type());
+			});
+		}
+		
+		/* add a handler that appends the values read to the given vectors
+		 * (note: references to the vectors are kept, so they need to stay
+		 * valid while this dispatcher is used) */
+		template<class... Ts>
+		void add_columns(std::string key, std::vector<Ts>&... cols) {
+			std::tuple<std::vector<Ts>*...> ptrs(&cols...);
+			add_handler(std::move(key), [ptrs](line_parser& lp) mutable -> bool {
+				std::tuple<Ts...> vals;
+				return rt_read_and_store(lp, vals, ptrs, typename rt_make_index_seq<sizeof...(Ts)>::type());
+			});
+		}
+		
+		/* process the current line of lp, calling the handler corresponding
+		 * to the discriminator; returns false on error */
+		bool dispatch(line_parser& lp) const {
+			string_view_custom key;
+			for(size_t i = 0; i < disc_col; i++) if(!lp.read_skip()) return false;
+			size_t pos = lp.pos;
+			size_t col = lp.col;
+			if(!lp.read_string_view_custom(key)) return false;
+			for(const auto& x : handlers)
+				if(x.first.size() == key.len && !memcmp(x.first.data(), key.str, key.len))
+					return x.second(lp);
+			if(default_handler) return default_handler(lp);
+			lp.pos = pos; /* error refers to the discriminator */
+			lp.col = col;
+			lp.last_error = T_FORMAT;
+			return false;
+		}
+};
+
+
+
 /* Wrapper for creating an stdiostream from an arbitrary function
  * that reads data -- this can be used to read from C FILE* objects
  * in a portable way.
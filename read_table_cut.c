@@ -0,0 +1,95 @@
+/*
+ * read_table_cut.c -- select and reorder columns of a text file
+ * 	(similar to cut -f, but output columns can be given in any order)
+ *
+ * usage: read_table_cut -f 3,1,2 [-i input] [-d delim] [-c comment] [-t nthreads]
+ *
+ * columns are numbered from 1; if the input is a regular file, it is
+ * processed in parallel, otherwise (or if reading from stdin) it is
+ * processed sequentially
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include "read_table_parallel.h"
+
+
+int main(int argc, char **argv)
+{
+	char* fn = 0;
+	char* fields = 0;
+	int i;
+	char delim = 0;
+	char comment = 0;
+	unsigned int nthreads = 0;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'i':
+			fn = argv[i+1];
+			i++;
+			break;
+		case 'f':
+			fields = argv[i+1];
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'd':
+			delim = argv[i+1][0];
+			i++;
+			break;
+		case 'c':
+			comment = argv[i+1][0];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	if(!fields) {
+		fprintf(stderr,"No columns given (use -f)!\n");
+		return 1;
+	}
+
+	/* parse the list of columns */
+	size_t ncols = 1;
+	for(i=0;fields[i];i++) if(fields[i] == ',') ncols++;
+	size_t* cols = (size_t*)malloc(ncols * sizeof(size_t));
+	if(!cols) return 1;
+	{
+		read_table r;
+		read_table_init(&r,0);
+		r.buf = fields;
+		r.line_len = strlen(fields);
+		read_table_set_delim(&r,',');
+		for(i=0;i<(int)ncols;i++) {
+			uint64_t c;
+			if(read_table_uint64_limits(&r,&c,1,SIZE_MAX)) {
+				fprintf(stderr,"Invalid list of columns: %s!\n",fields);
+				free(cols);
+				return 1;
+			}
+			cols[i] = c - 1;
+		}
+	}
+
+	read_table_cut_spec spec;
+	read_table_cut_spec_init(&spec,cols,ncols);
+
+	read_table r;
+	read_table_init(&r,0);
+	if(delim) read_table_set_delim(&r,delim);
+	if(comment) read_table_set_comment(&r,comment);
+
+	int ret = read_table_cut(fn,&r,&spec,nthreads,STDOUT_FILENO);
+	if(ret) read_table_write_error(&r,stderr);
+	free(cols);
+
+	return ret;
+}
+
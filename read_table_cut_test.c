@@ -0,0 +1,241 @@
+/*
+ * read_table_cut_test.c -- simple test cases for read_table_cut() in
+ * 	read_table_parallel.h (used by read_table_cut.c)
+ *
+ * usage: read_table_cut_test [-n lines] [-t max_threads]
+ *
+ * a file is generated with the given number of lines (default: 20000),
+ * each with 4-6 fields, where columns 3,1,4,1 are selected (so columns
+ * are reordered and repeated); the file is cut in parallel (as a regular
+ * file, using small chunks, with 1 to max_threads threads, default: 8)
+ * and sequentially (read from a pipe), and the outputs are compared to
+ * the expected columns:
+ * 1. fields separated by a delimiter (',' or tab, some of them empty)
+ * or by blanks; empty lines, comment lines, comments after the fields
+ * and lines ending with CRLF are included, and the last line has no
+ * newline at the end
+ * 2. one line (with a known line number) has only two fields: this is
+ * reported as an error (T_EOL) in that line, and the output contains
+ * the lines before it
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+/* note: small chunks, so that the file is split into many of them */
+#ifndef READ_TABLE_CHUNK_SIZE
+#define READ_TABLE_CHUNK_SIZE 4096
+#endif
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include "read_table_parallel.h"
+
+
+static int check(int cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* columns selected (0-based) */
+static const size_t cols[] = {2, 0, 3, 0};
+#define NCOLS (sizeof(cols) / sizeof(cols[0]))
+
+/* generate the input file with the given delimiter (0: blanks) in input
+ * and the expected output in expected; if bad is nonzero, the bad-th
+ * line with data has only two fields, and its line number in the file
+ * is stored in bad_line (the expected output contains the lines before
+ * it); returns 0 on success, 1 on memory allocation error */
+static int gen_input(char delim, uint64_t nlines, uint64_t bad, read_table_outbuf* input,
+		read_table_outbuf* expected, uint64_t* bad_line) {
+	uint64_t j, line = 0;
+	char field[6][32];
+	size_t len[6];
+	int err = 0;
+	*bad_line = 0;
+	for(j = 0; j < nlines && !err; j++) {
+		size_t k, nf = 4 + j % 3;
+		char sep = delim ? delim : ' ';
+		if(j % 50 == 7) {
+			/* lines skipped when reading */
+			err = read_table_out_string(input, "\n# comment line\n", 16) ||
+				read_table_out_string(input, " \t\r\n", 4);
+			line += 3;
+		}
+		if(bad && j + 1 == bad) nf = 2;
+		for(k = 0; k < nf; k++) {
+			len[k] = sprintf(field[k], "f%lu_%lu", (unsigned long)j, (unsigned long)k);
+			if(delim && (j + k) % 11 == 0) len[k] = 0; /* empty field */
+			if(k) err = err || read_table_out_char(input, sep);
+			/* note: with blanks, fields can be separated by any number of them */
+			if(!delim && (j + k) % 5 == 0) err = err || read_table_out_string(input, " \t ", 3);
+			err = err || read_table_out_string(input, field[k], len[k]);
+		}
+		if(j % 13 == 5) err = err || read_table_out_string(input, "# comment", 9);
+		if(j % 17 == 3) err = err || read_table_out_char(input, '\r');
+		if(j + 1 < nlines) err = err || read_table_out_newline(input);
+		line++;
+		if(nf == 2) {
+			*bad_line = line;
+			break;
+		}
+		for(k = 0; k < NCOLS; k++) {
+			if(k) err = err || read_table_out_char(expected, delim ? delim : '\t');
+			err = err || read_table_out_string(expected, field[cols[k]], len[cols[k]]);
+		}
+		err = err || read_table_out_newline(expected);
+	}
+	/* rest of the lines after the bad one */
+	for(j++; j < nlines && !err; j++) err = read_table_out_string(input, "a b c d e\n", 10);
+	return err;
+}
+
+/* cut the file fn with read_table_cut() and nthreads threads, reading
+ * it from a pipe if use_pipe is nonzero; the output is stored in out;
+ * returns the result of read_table_cut() (or -1 if the test could not be
+ * run), r is used for the parameters and errors */
+static int run_cut(const char* fn, read_table* r, const read_table_cut_spec* spec,
+		unsigned int nthreads, int use_pipe, read_table_outbuf* out) {
+	FILE* tmp = tmpfile();
+	int fd[2] = {-1, -1};
+	pid_t pid = -1;
+	int ret = -1;
+	char path[64];
+	struct stat st;
+	if(!tmp) return -1;
+	if(use_pipe) {
+		/* child process copies the file to the pipe */
+		if(pipe(fd)) {
+			fclose(tmp);
+			return -1;
+		}
+		pid = fork();
+		if(pid == 0) {
+			FILE* f = fopen(fn, "r");
+			char buf[4096];
+			size_t len;
+			close(fd[0]);
+			if(!f) _exit(1);
+			while((len = fread(buf, 1, sizeof(buf), f)) > 0)
+				if(read_table_write_all(fd[1], buf, len)) _exit(1);
+			_exit(0);
+		}
+		close(fd[1]);
+		sprintf(path, "/dev/fd/%d", fd[0]);
+	}
+	if(pid != -1 || !use_pipe) {
+		r->line = 0;
+		r->last_error = T_OK;
+		ret = read_table_cut(use_pipe ? path : fn, r, spec, nthreads, fileno(tmp));
+	}
+	if(use_pipe) {
+		close(fd[0]);
+		if(pid != -1) waitpid(pid, 0, 0);
+	}
+	out->len = 0;
+	if(ret != -1 && !fstat(fileno(tmp), &st) && !read_table_outbuf_reserve(out, st.st_size + 1)) {
+		rewind(tmp);
+		out->len = fread(out->buf, 1, st.st_size, tmp);
+	}
+	fclose(tmp);
+	return ret;
+}
+
+/* run read_table_cut() on the file fn in parallel with 1 to max_threads
+ * threads and sequentially, comparing the outputs to the expected one;
+ * if bad_line is nonzero, an error is expected in that line */
+static int test_cut(const char* fn, char delim, unsigned int max_threads,
+		const read_table_outbuf* expected, uint64_t bad_line) {
+	read_table_cut_spec spec;
+	read_table_outbuf out;
+	read_table r;
+	unsigned int nthreads;
+	int ret = 1;
+	read_table_cut_spec_init(&spec, cols, NCOLS);
+	read_table_init(&r, 0);
+	if(delim) read_table_set_delim(&r, delim);
+	read_table_set_comment(&r, '#');
+	read_table_outbuf_init(&out);
+	for(nthreads = 0; nthreads <= max_threads; nthreads++) {
+		/* note: nthreads == 0 is used for reading from a pipe */
+		int err = run_cut(fn, &r, &spec, nthreads ? nthreads : 1, !nthreads, &out);
+		int ok = (out.len == expected->len && !memcmp(out.buf, expected->buf, out.len));
+		if(bad_line) ok = ok && err == 1 && r.last_error == T_EOL && r.line == bad_line && r.col == 2;
+		else ok = ok && err == 0 && r.last_error == T_EOF;
+		if(!ok) {
+			fprintf(stderr,"Error: wrong output %s (delimiter: '%c')!\n",
+				nthreads ? "cutting the file in parallel" : "cutting from a pipe", delim ? delim : ' ');
+			if(nthreads) fprintf(stderr,"(with %u threads)\n", nthreads);
+			if(err == 1) read_table_write_error(&r, stderr);
+			ret = 0;
+		}
+	}
+	read_table_free_buf(&r);
+	read_table_outbuf_free(&out);
+	return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	uint64_t nlines = 20000;
+	unsigned int max_threads = 8;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nlines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 't':
+			max_threads = atoi(argv[i+1]);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	if(nlines < 100) nlines = 100;
+	if(!max_threads) max_threads = 1;
+	int ret = 1;
+
+	char fn[] = "/tmp/read_table_cut_test.XXXXXX";
+	int fd = mkstemp(fn);
+	if(fd < 0) {
+		fprintf(stderr,"Error creating temporary file!\n");
+		return 1;
+	}
+	close(fd);
+
+	const char delims[] = {',', '\t', 0};
+	size_t k;
+	for(k = 0; k < sizeof(delims); k++) {
+		uint64_t bad;
+		/* 1. all lines correct, 2. missing columns in the line after two thirds */
+		for(bad = 0; bad <= 2 * nlines / 3; bad += 2 * nlines / 3) {
+			read_table_outbuf input, expected;
+			uint64_t bad_line;
+			read_table_outbuf_init(&input);
+			read_table_outbuf_init(&expected);
+			FILE* f = 0;
+			if(gen_input(delims[k], nlines, bad, &input, &expected, &bad_line) || !(f = fopen(fn, "w")) ||
+					fwrite(input.buf, 1, input.len, f) != input.len) {
+				fprintf(stderr,"Error creating the input file!\n");
+				if(f) fclose(f);
+				ret = 0;
+			}
+			else if(fclose(f)) {
+				fprintf(stderr,"Error writing the input file!\n");
+				ret = 0;
+			}
+			else ret = test_cut(fn, delims[k], max_threads, &expected, bad_line) && ret;
+			read_table_outbuf_free(&input);
+			read_table_outbuf_free(&expected);
+		}
+	}
+	unlink(fn);
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
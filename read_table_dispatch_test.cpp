@@ -0,0 +1,138 @@
+/*
+ * read_table_dispatch_test.cpp -- simple test cases for record_dispatcher
+ * 	in read_table_cpp.h
+ *
+ * usage: read_table_dispatch_test
+ *
+ * a small file with several record types (header, data, points, trailer)
+ * is read with the discriminator in the first and in the second column;
+ * lines with an unknown discriminator are either errors or are given to
+ * a default handler
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include "read_table_cpp.h"
+
+
+/* discriminator in the first column */
+static const char input1[] =
+	"# records: H name year, D id value, P x y, T\n"
+	"H\ttest\t2021\n"
+	"D\t1\t0.5\n"
+	"P\t10\t100\n"
+	"D\t2\t1.5\n"
+	"\n"
+	"P\t20\t200\n"
+	"T\n"
+	"X\t1\t2\n"
+	"D\t3\t2.5\n";
+
+/* discriminator in the second column */
+static const char input2[] =
+	"1 D 0.5\n"
+	"2 P 10 100\n"
+	"3 D 1.5\n";
+
+
+struct records {
+	std::string name;
+	int year = 0;
+	uint32_t nd = 0;
+	uint32_t sum_id = 0;
+	double sum = 0.0;
+	std::vector<int> x;
+	std::vector<uint64_t> y;
+	uint32_t trailer = 0;
+	uint32_t unknown = 0;
+};
+
+static void add_handlers(record_dispatcher& d, records& rec) {
+	d.add("H", [&rec](line_parser& lp) { return lp.read(rec.name, rec.year); });
+	d.add_record<uint32_t, double>("D", [&rec](uint32_t id, double value) {
+		rec.nd++;
+		rec.sum_id += id;
+		rec.sum += value;
+	});
+	d.add_columns("P", rec.x, rec.y);
+	d.add_record<>("T", [&rec]() { rec.trailer++; });
+}
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	for(i=1;i<argc;i++) fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	bool ret = true;
+
+	/* 1. unknown discriminators are errors by default */
+	{
+		std::istringstream is(input1);
+		read_table2 r(is, line_parser_params().set_delim('\t').set_comment('#'));
+		record_dispatcher d;
+		records rec;
+		add_handlers(d, rec);
+		while(r.read_line()) if(!d.dispatch(r)) break;
+		ret = check(r.get_last_error() == T_FORMAT, "unknown record type not detected") && ret;
+		ret = check(r.get_line() == 9 && r.get_pos() == 0 && r.get_col() == 0,
+			"wrong position for the unknown record type") && ret;
+		ret = check(rec.name == "test" && rec.year == 2021, "wrong header") && ret;
+		ret = check(rec.nd == 2 && rec.sum_id == 3 && rec.sum == 2.0, "wrong data records") && ret;
+		ret = check(rec.x.size() == 2 && rec.x[1] == 20 && rec.y[1] == 200, "wrong point records") && ret;
+		ret = check(rec.trailer == 1, "trailer not read") && ret;
+	}
+
+	/* 2. unknown discriminators given to the default handler */
+	{
+		std::istringstream is(input1);
+		read_table2 r(is, line_parser_params().set_delim('\t').set_comment('#'));
+		record_dispatcher d;
+		records rec;
+		add_handlers(d, rec);
+		d.set_default([&rec](line_parser&) { rec.unknown++; return true; });
+		while(r.read_line()) if(!d.dispatch(r)) break;
+		if(r.get_last_error() != T_EOF) r.write_error(stderr);
+		ret = check(r.get_last_error() == T_EOF, "error with a default handler") && ret;
+		ret = check(rec.unknown == 1 && rec.nd == 3 && rec.sum == 4.5, "wrong records with a default handler") && ret;
+	}
+
+	/* 3. discriminator in the second column: handlers get the fields after
+	 * it, and can go back to the beginning of the line if needed */
+	{
+		std::istringstream is(input2);
+		read_table2 r(is);
+		record_dispatcher d(1);
+		records rec;
+		d.add_record<double>("D", [&rec](double value) { rec.nd++; rec.sum += value; });
+		d.add("P", [&rec](line_parser& lp) {
+			int x;
+			uint64_t y;
+			uint32_t id;
+			if(!lp.read(x, y)) return false;
+			lp.reset_pos();
+			if(!lp.read(id)) return false;
+			rec.x.push_back(x);
+			rec.y.push_back(y);
+			rec.sum_id += id;
+			return true;
+		});
+		while(r.read_line()) if(!d.dispatch(r)) break;
+		if(r.get_last_error() != T_EOF) r.write_error(stderr);
+		ret = check(r.get_last_error() == T_EOF, "error with the discriminator in the second column") && ret;
+		ret = check(rec.nd == 2 && rec.sum == 2.0 && rec.x.size() == 1 && rec.x[0] == 10 &&
+			rec.y[0] == 100 && rec.sum_id == 2, "wrong records with the discriminator in the second column") && ret;
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
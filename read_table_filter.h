@@ -0,0 +1,291 @@
+/*  -*- C++ -*-
+ * read_table_filter.h -- filtering and selecting rows of columns loaded
+ * 	with read_table_bulk.h (or read_table_serve.h)
+ *
+ * Filters (value ranges, equality, set membership, NaN checks) are
+ * evaluated over a whole column at once, and their result is stored as a
+ * bitmap, one bit for each row; the inner loops are written without
+ * branches, so the compiler can vectorize them (e.g. with -O3 or
+ * -ftree-vectorize and -march=native). Bitmaps can be combined, and
+ * converted to a list of the selected row indices (selection vector);
+ * columns can then be materialized for the selected rows only.
+ *
+ * All functions operate on arrays of values, as returned by
+ * table_loader::column() (use the data() and size() of the vector) or
+ * shared_table::column(). String columns can be filtered by first
+ * replacing them with integer codes (dictionary_encode()).
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+table_loader t;
+... // load the table
+const std::vector<uint32_t>* ids;
+const std::vector<double>* values;
+if(!t.column(0, ids) || !t.column(2, values)) ... // handle error
+
+// select rows with 100 <= id <= 200 and value > 0
+row_bitmap b1, b2;
+filter_range(ids->data(), ids->size(), 100U, 200U, b1);
+filter_greater(values->data(), values->size(), 0.0, b2);
+bitmap_and(b1, b2);
+std::vector<double> selected;
+compact(values->data(), values->size(), b1, selected);
+
+// or: get the row indices and use them for several columns
+std::vector<size_t> rows;
+bitmap_to_selection(b1, rows);
+std::vector<uint32_t> selected_ids;
+gather(ids->data(), rows, selected_ids);
+
+ */
+
+#ifndef READ_TABLE_FILTER_H
+#define READ_TABLE_FILTER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <bitset>
+#include <algorithm>
+#include <unordered_map>
+
+/* one bit for each row, stored in 64-bit words (bit j of word i
+ * corresponds to row 64*i + j); bits after the last row are zero */
+typedef std::vector<uint64_t> row_bitmap;
+
+static size_t bitmap_words(size_t n) { return (n + 63) / 64; }
+
+/* pack 64 flags (each 0 or 1) into the bits of one word */
+static uint64_t bitmap_pack(const uint8_t* flags) {
+	uint64_t bits = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	/* 8 flags at a time: the multiplication moves byte j to bit 56 + j */
+	for(unsigned int k = 0; k < 8; k++) {
+		uint64_t v;
+		memcpy(&v, flags + 8 * k, 8);
+		bits |= ((v * 0x0102040810204080ULL) >> 56) << (8 * k);
+	}
+#else
+	for(unsigned int j = 0; j < 64; j++) bits |= ((uint64_t)flags[j]) << j;
+#endif
+	return bits;
+}
+
+/* evaluate f for all values in x, store the result in res;
+ * f should be simple (no branches) for the best performance */
+template<class T, class F>
+static void filter_bitmap(const T* x, size_t n, row_bitmap& res, F&& f) {
+	res.assign(bitmap_words(n), 0);
+	size_t nfull = n / 64;
+	uint8_t flags[64];
+	for(size_t i = 0; i < nfull; i++) {
+		const T* y = x + 64 * i;
+		/* note: this loop can be vectorized */
+		for(unsigned int j = 0; j < 64; j++) flags[j] = f(y[j]);
+		res[i] = bitmap_pack(flags);
+	}
+	if(n % 64) {
+		const T* y = x + 64 * nfull;
+		memset(flags, 0, sizeof(flags));
+		for(unsigned int j = 0; j < n % 64; j++) flags[j] = f(y[j]);
+		res[nfull] = bitmap_pack(flags);
+	}
+}
+
+/* select values in the range [min, max] (inclusive) */
+template<class T>
+static void filter_range(const T* x, size_t n, T min, T max, row_bitmap& res) {
+	filter_bitmap(x, n, res, [min, max](T y) { return (y >= min) & (y <= max); });
+}
+
+/* select values equal to / different from v */
+template<class T>
+static void filter_equal(const T* x, size_t n, T v, row_bitmap& res) {
+	filter_bitmap(x, n, res, [v](T y) { return y == v; });
+}
+template<class T>
+static void filter_not_equal(const T* x, size_t n, T v, row_bitmap& res) {
+	filter_bitmap(x, n, res, [v](T y) { return y != v; });
+}
+
+/* select values strictly smaller or larger than v */
+template<class T>
+static void filter_less(const T* x, size_t n, T v, row_bitmap& res) {
+	filter_bitmap(x, n, res, [v](T y) { return y < v; });
+}
+template<class T>
+static void filter_greater(const T* x, size_t n, T v, row_bitmap& res) {
+	filter_bitmap(x, n, res, [v](T y) { return y > v; });
+}
+
+/* select values that are in the given set; small sets are compared
+ * directly, larger ones are sorted and searched */
+template<class T>
+static void filter_in(const T* x, size_t n, const std::vector<T>& set, row_bitmap& res) {
+	if(set.empty()) res.assign(bitmap_words(n), 0);
+	else if(set.size() <= 8) {
+		/* note: fill with repeats of the first value, so that always 8 are compared */
+		T s[8];
+		for(size_t j = 0; j < 8; j++) s[j] = set[j < set.size() ? j : 0];
+		filter_bitmap(x, n, res, [&s](T y) {
+			return (y == s[0]) | (y == s[1]) | (y == s[2]) | (y == s[3]) |
+				(y == s[4]) | (y == s[5]) | (y == s[6]) | (y == s[7]);
+		});
+	}
+	else {
+		std::vector<T> sorted(set);
+		std::sort(sorted.begin(), sorted.end());
+		filter_bitmap(x, n, res, [&sorted](T y) {
+			return std::binary_search(sorted.begin(), sorted.end(), y);
+		});
+	}
+}
+
+/* select values that are NaN (i.e. missing) or not NaN */
+static void filter_nan(const double* x, size_t n, row_bitmap& res) {
+	filter_bitmap(x, n, res, [](double y) { return std::isnan(y); });
+}
+static void filter_not_nan(const double* x, size_t n, row_bitmap& res) {
+	filter_bitmap(x, n, res, [](double y) { return !std::isnan(y); });
+}
+
+
+/* combine bitmaps (of the same length), storing the result in a */
+static void bitmap_and(row_bitmap& a, const row_bitmap& b) {
+	for(size_t i = 0; i < a.size() && i < b.size(); i++) a[i] &= b[i];
+}
+static void bitmap_or(row_bitmap& a, const row_bitmap& b) {
+	for(size_t i = 0; i < a.size() && i < b.size(); i++) a[i] |= b[i];
+}
+/* negate a bitmap for n rows (keeping the bits after the last row zero) */
+static void bitmap_not(row_bitmap& a, size_t n) {
+	a.resize(bitmap_words(n));
+	for(size_t i = 0; i < a.size(); i++) a[i] = ~a[i];
+	if(n % 64) a.back() &= (((uint64_t)1) << (n % 64)) - 1;
+}
+
+/* number of selected rows */
+static size_t bitmap_count(const row_bitmap& a) {
+	size_t c = 0;
+	for(uint64_t w : a) c += std::bitset<64>(w).count();
+	return c;
+}
+
+/* position of the lowest set bit (w should not be zero) */
+static unsigned int bitmap_lowest_bit(uint64_t w) {
+#ifdef __GNUC__
+	return __builtin_ctzll(w);
+#else
+	unsigned int j = 0;
+	for(; !(w & 1); w >>= 1) j++;
+	return j;
+#endif
+}
+
+/* convert to the list of selected row indices */
+static void bitmap_to_selection(const row_bitmap& a, std::vector<size_t>& sel) {
+	sel.clear();
+	sel.reserve(bitmap_count(a));
+	for(size_t i = 0; i < a.size(); i++) {
+		uint64_t w = a[i];
+		while(w) {
+			sel.push_back(64 * i + bitmap_lowest_bit(w));
+			w &= w - 1;
+		}
+	}
+}
+
+/* convert a list of row indices (all smaller than n) to a bitmap */
+static void selection_to_bitmap(const std::vector<size_t>& sel, size_t n, row_bitmap& a) {
+	a.assign(bitmap_words(n), 0);
+	for(size_t i : sel) a[i / 64] |= ((uint64_t)1) << (i % 64);
+}
+
+
+/* copy the values in the selected rows */
+template<class T>
+static void gather(const T* x, const std::vector<size_t>& sel, std::vector<T>& res) {
+	res.resize(sel.size());
+	for(size_t i = 0; i < sel.size(); i++) res[i] = x[sel[i]];
+}
+
+/* copy the values in the rows selected by the bitmap (which should be
+ * created for the same n rows) */
+template<class T>
+static void compact(const T* x, size_t n, const row_bitmap& a, std::vector<T>& res) {
+	res.clear();
+	res.reserve(bitmap_count(a));
+	for(size_t i = 0; i < a.size() && 64 * i < n; i++) {
+		uint64_t w = a[i];
+		if(w == ~(uint64_t)0 && 64 * (i + 1) <= n) res.insert(res.end(), x + 64 * i, x + 64 * (i + 1));
+		else while(w) {
+			res.push_back(x[64 * i + bitmap_lowest_bit(w)]);
+			w &= w - 1;
+		}
+	}
+}
+
+
+/* replace strings with integer codes (in the order of first occurrence);
+ * the distinct values are stored in dict; the codes can then be used with
+ * the filters above (e.g. find the code of a value in dict and use
+ * filter_equal() or filter_in()) */
+template<class S>
+static void dictionary_encode(const S* x, size_t n, std::vector<uint32_t>& codes, std::vector<std::string>& dict) {
+	std::unordered_map<std::string, uint32_t> map;
+	std::string tmp;
+	codes.resize(n);
+	dict.clear();
+	for(size_t i = 0; i < n; i++) {
+		tmp.assign(x[i].str, x[i].len);
+		auto it = map.find(tmp);
+		if(it == map.end()) {
+			uint32_t c = dict.size();
+			map.emplace(tmp, c);
+			dict.push_back(tmp);
+			codes[i] = c;
+		}
+		else codes[i] = it->second;
+	}
+}
+
+/* find the code of a string in the dictionary; returns false if not found */
+static bool dictionary_find(const std::vector<std::string>& dict, const std::string& str, uint32_t& code) {
+	auto it = std::find(dict.begin(), dict.end(), str);
+	if(it == dict.end()) return false;
+	code = it - dict.begin();
+	return true;
+}
+
+#endif
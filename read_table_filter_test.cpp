@@ -0,0 +1,166 @@
+/*
+ * read_table_filter_test.cpp -- simple test cases for read_table_filter.h
+ *
+ * usage: read_table_filter_test [-n rows]
+ *
+ * filters are evaluated on generated columns of several lengths (from
+ * zero to the given number of rows, default: 10000, including lengths
+ * around multiples of 64, where the bitmaps have partial words) and the
+ * results are compared to simple loops:
+ * 1. comparisons, ranges, set membership (sets of different sizes) and
+ * NaN checks; bits after the last row should be zero
+ * 2. combining and negating bitmaps, counting, converting to and from
+ * lists of rows, copying the selected values
+ * 3. string columns of a table loaded with read_table_bulk.h, filtered
+ * by their dictionary codes
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include "read_table_bulk.h"
+#include "read_table_filter.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* check that b selects exactly the rows j < n where f(j) is true */
+template<class F>
+static bool same(const row_bitmap& b, size_t n, F&& f) {
+	if(b.size() != bitmap_words(n)) return false;
+	for(size_t j = 0; j < 64 * b.size(); j++) {
+		bool bit = (b[j / 64] >> (j % 64)) & 1;
+		if(bit != (j < n && f(j))) return false;
+	}
+	return true;
+}
+
+/* run all filters on the first n values of the columns */
+static bool test_filters(const std::vector<uint32_t>& ids, const std::vector<double>& values, size_t n) {
+	const uint32_t* x = ids.data();
+	const double* y = values.data();
+	row_bitmap b1, b2;
+	bool ret = true;
+
+	/* 1. filters */
+	filter_range(x, n, 100U, 200U, b1);
+	ret = check(same(b1, n, [x](size_t j) { return x[j] >= 100 && x[j] <= 200; }), "filter_range()") && ret;
+	filter_equal(x, n, 7U, b1);
+	ret = check(same(b1, n, [x](size_t j) { return x[j] == 7; }), "filter_equal()") && ret;
+	filter_not_equal(x, n, 7U, b1);
+	ret = check(same(b1, n, [x](size_t j) { return x[j] != 7; }), "filter_not_equal()") && ret;
+	filter_less(y, n, -1.5, b1);
+	ret = check(same(b1, n, [y](size_t j) { return y[j] < -1.5; }), "filter_less()") && ret;
+	filter_greater(y, n, 0.0, b1);
+	ret = check(same(b1, n, [y](size_t j) { return y[j] > 0.0; }), "filter_greater()") && ret;
+	filter_nan(y, n, b1);
+	ret = check(same(b1, n, [y](size_t j) { return std::isnan(y[j]); }), "filter_nan()") && ret;
+	filter_not_nan(y, n, b2);
+	ret = check(same(b2, n, [y](size_t j) { return !std::isnan(y[j]); }), "filter_not_nan()") && ret;
+	/* note: sets of up to 8 values are compared directly, larger ones are searched */
+	for(size_t k : {0, 1, 3, 8, 9, 50}) {
+		std::vector<uint32_t> set;
+		for(size_t j = 0; j < k; j++) set.push_back((uint32_t)(50 * k - 3 * j));
+		filter_in(x, n, set, b1);
+		ret = check(same(b1, n, [x, &set](size_t j) { return std::find(set.begin(), set.end(), x[j]) != set.end(); }),
+			"filter_in()") && ret;
+	}
+
+	/* 2. combining and converting bitmaps */
+	filter_range(x, n, 100U, 600U, b1);
+	filter_greater(y, n, 0.0, b2);
+	row_bitmap b3 = b1;
+	bitmap_and(b1, b2);
+	bitmap_or(b3, b2);
+	auto in_range = [x](size_t j) { return x[j] >= 100 && x[j] <= 600; };
+	ret = check(same(b1, n, [&](size_t j) { return in_range(j) && y[j] > 0.0; }), "bitmap_and()") && ret;
+	ret = check(same(b3, n, [&](size_t j) { return in_range(j) || y[j] > 0.0; }), "bitmap_or()") && ret;
+	size_t cnt = bitmap_count(b1);
+	bitmap_not(b1, n);
+	ret = check(same(b1, n, [&](size_t j) { return !(in_range(j) && y[j] > 0.0); }) &&
+		bitmap_count(b1) == n - cnt, "bitmap_not()") && ret;
+
+	std::vector<size_t> sel, sel2;
+	for(size_t j = 0; j < n; j++) if(in_range(j)) sel2.push_back(j);
+	filter_range(x, n, 100U, 600U, b1);
+	bitmap_to_selection(b1, sel);
+	selection_to_bitmap(sel, n, b2);
+	ret = check(sel == sel2 && b1 == b2, "converting to and from a list of rows") && ret;
+	std::vector<double> res, res2;
+	compact(y, n, b1, res);
+	gather(y, sel, res2);
+	ret = check(res.size() == sel.size() && !memcmp(res.data(), res2.data(), res.size() * sizeof(double)),
+		"copying the selected values") && ret;
+	/* all rows selected: whole words are copied at once */
+	filter_range(x, n, 0U, UINT32_MAX, b1);
+	std::vector<uint32_t> all;
+	compact(x, n, b1, all);
+	ret = check(bitmap_count(b1) == n && all.size() == n && std::equal(all.begin(), all.end(), x),
+		"copying all values") && ret;
+	return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t nrows = 10000;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nrows = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	if(nrows < 200) nrows = 200;
+	bool ret = true;
+
+	std::vector<uint32_t> ids(nrows);
+	std::vector<double> values(nrows);
+	for(size_t j = 0; j < nrows; j++) {
+		ids[j] = (uint32_t)((j * 2654435761ULL) % 1000);
+		values[j] = (j % 17 == 5) ? NAN : ((double)(j % 23) - 11.0) / 4.0;
+	}
+
+	/* 1-2. filters on columns of several lengths */
+	for(size_t n : {(size_t)0, (size_t)1, (size_t)63, (size_t)64, (size_t)65, (size_t)130, nrows - 1, nrows})
+		if(!test_filters(ids, values, n)) {
+			fprintf(stderr,"Error: wrong results for %lu rows!\n", (unsigned long)n);
+			ret = false;
+		}
+
+	/* 3. strings in a loaded table */
+	{
+		std::string input;
+		for(size_t j = 0; j < nrows; j++) input += std::to_string(ids[j]) + "\tcat" + std::to_string(ids[j] % 11) + "\n";
+		std::istringstream is(input);
+		read_table2 r(is, line_parser_params().set_delim('\t'));
+		table_loader t;
+		const std::vector<string_view_custom>* names;
+		ret = check(t.load(r, 2) && t.column(1, names), "loading the table") && ret;
+		if(ret) {
+			std::vector<uint32_t> codes;
+			std::vector<std::string> dict;
+			dictionary_encode(names->data(), nrows, codes, dict);
+			ret = check(dict.size() == 11 && dict[0] == "cat" + std::to_string(ids[0] % 11), "dictionary") && ret;
+			uint32_t code;
+			ret = check(!dictionary_find(dict, "cat11", code), "string not in the dictionary found") && ret;
+			ret = check(dictionary_find(dict, "cat3", code), "string in the dictionary not found") && ret;
+			row_bitmap b;
+			filter_equal(codes.data(), nrows, code, b);
+			ret = check(same(b, nrows, [&ids](size_t j) { return ids[j] % 11 == 3; }), "filtering strings") && ret;
+		}
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
@@ -0,0 +1,182 @@
+/*  -*- C -*-
+ * read_table_float.h -- parsing floating point numbers with a given
+ * 	decimal separator, independently of the locale
+ *
+ * strtod() uses the decimal point of the current locale, which can only
+ * be changed for the whole process with setlocale() (which is not safe
+ * to do while other threads are running). The function here parses
+ * numbers with any decimal separator (e.g. "3,14" in files exported
+ * with European settings): numbers with at most 15 significant digits
+ * and a small exponent are converted directly (with one multiplication
+ * or division, which gives the correctly rounded result); other numbers
+ * (e.g. with many digits, NaN or infinity) are copied to a temporary
+ * buffer with '.' as the decimal point and converted with strtod(),
+ * which uses the "C" locale in the current thread only (set with
+ * uselocale()), so the result does not depend on setlocale() called by
+ * other threads.
+ *
+ * This file does not depend on either read_table.h or read_table_cpp.h,
+ * and is included by both.
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+char* end;
+errno = 0;
+double x = read_table_strtod_sep("3,14;2,71", &end, ',');
+// x == 3.14, end points to ";2,71"; errno is set to ERANGE on overflow (similarly to strtod())
+
+ */
+
+#ifndef READ_TABLE_FLOAT_H
+#define READ_TABLE_FLOAT_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <strings.h>
+#include <errno.h>
+#include <locale.h>
+
+/* get the "C" locale (created once, and kept until the program exits);
+ * returns (locale_t)0 if it cannot be created */
+static locale_t read_table_c_locale(void) {
+	static locale_t loc = (locale_t)0;
+	locale_t l = __atomic_load_n(&loc, __ATOMIC_ACQUIRE);
+	if(!l) {
+		locale_t prev = (locale_t)0;
+		l = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+		/* note: another thread might have created it at the same time */
+		if(l && !__atomic_compare_exchange_n(&loc, &prev, l, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			freelocale(l);
+			l = prev;
+		}
+	}
+	return l;
+}
+
+/* strtod() using the "C" locale in this thread; if the locale cannot be
+ * created, end is set to str and errno to ENOMEM */
+static double read_table_strtod_c(const char* str, char** end) {
+	locale_t l = read_table_c_locale();
+	locale_t old;
+	double d;
+	if(!l) {
+		*end = (char*)str;
+		errno = ENOMEM;
+		return 0.0;
+	}
+	old = uselocale(l);
+	d = strtod(str, end);
+	uselocale(old);
+	return d;
+}
+
+/* convert str to a double, using sep as the decimal separator; end is
+ * set to the first character after the number (or str if no number was
+ * found); leading whitespace is skipped; errno is set to ERANGE if the
+ * value is out of range; hexadecimal numbers are not supported */
+static double read_table_strtod_sep(const char* str, char** end, char sep) {
+	static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	const char* p = str;
+	const char* start;
+	uint64_t x = 0;
+	int neg = 0;
+	int ndigits = 0; /* all digits in the mantissa */
+	int nsig = 0; /* significant digits (after leading zeros) */
+	int nfrac = 0; /* digits after the separator */
+	long exp = 0;
+	while(isspace((unsigned char)*p)) p++;
+	start = p;
+	if(*p == '-' || *p == '+') { neg = (*p == '-'); p++; }
+	for(; *p >= '0' && *p <= '9'; p++) {
+		ndigits++;
+		if(x || *p != '0') nsig++;
+		if(nsig <= 19) x = 10 * x + (*p - '0');
+	}
+	if(*p == sep && sep) {
+		p++;
+		for(; *p >= '0' && *p <= '9'; p++) {
+			ndigits++;
+			nfrac++;
+			if(x || *p != '0') nsig++;
+			if(nsig <= 19) x = 10 * x + (*p - '0');
+		}
+	}
+	if(!ndigits) {
+		/* NaN or infinity (these do not contain the decimal separator) */
+		if(!strncasecmp(p, "inf", 3) || !strncasecmp(p, "nan", 3)) return read_table_strtod_c(str, end);
+		*end = (char*)str;
+		return 0.0;
+	}
+	if(*p == 'e' || *p == 'E') {
+		const char* q = p + 1;
+		int eneg = 0;
+		if(*q == '-' || *q == '+') { eneg = (*q == '-'); q++; }
+		if(*q >= '0' && *q <= '9') {
+			for(; *q >= '0' && *q <= '9'; q++) if(exp < 100000) exp = 10 * exp + (*q - '0');
+			if(eneg) exp = -exp;
+			p = q;
+		}
+	}
+	*end = (char*)p;
+	exp -= nfrac;
+	if(nsig <= 15 && exp >= -22 && exp <= 22) {
+		/* note: x < 2^53 and 10^|exp| are exact, so one operation gives the correctly rounded value */
+		double d = (double)x;
+		if(exp > 0) d *= pow10[exp];
+		else if(exp < 0) d /= pow10[-exp];
+		return neg ? -d : d;
+	}
+	{
+		/* copy the number with '.' as the decimal point */
+		char tmp[128];
+		char* buf = tmp;
+		size_t len = p - start;
+		size_t i;
+		double d;
+		char* bend;
+		if(len + 1 > sizeof(tmp)) {
+			buf = (char*)malloc(len + 1);
+			if(!buf) { *end = (char*)str; return 0.0; }
+		}
+		for(i = 0; i < len; i++) buf[i] = (start[i] == sep) ? '.' : start[i];
+		buf[len] = 0;
+		d = read_table_strtod_c(buf, &bend);
+		if(bend != buf + len) *end = (char*)str; /* should not happen */
+		if(buf != tmp) free(buf);
+		return d;
+	}
+}
+
+#endif
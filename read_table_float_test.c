@@ -0,0 +1,208 @@
+/*
+ * read_table_float_test.c -- simple test cases for read_table_float.h
+ * 	and reading doubles with a decimal separator in read_table.h
+ *
+ * usage: read_table_float_test [-n numbers] [-s seed] [-l locale]
+ *
+ * 1. generated numbers (default: 1000000, with up to 25 digits, exponents
+ * up to 400, so that both the direct conversion and the fallback to
+ * strtod() are used) are written with ',' as the decimal separator and
+ * converted with read_table_strtod_sep(); the result, the end position
+ * and errno (ERANGE on overflow and underflow) should be the same as
+ * converting the number with '.' using strtod()
+ * 2. special cases: infinity, NaN, missing digits, invalid input
+ * 3. the same numbers are read from a table with ';' as the delimiter
+ * with read_table_double() after read_table_set_decimal(): out of range
+ * numbers are errors (T_OVERFLOW), as well as NaN and infinity unless
+ * allowed (T_NAN)
+ * 4. if the given locale (default: de_DE.UTF-8, which uses ',' as the
+ * decimal point) is available, 1. is repeated after setting it
+ * read_table_float_test.cpp tests reading with read_table_cpp.h
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <locale.h>
+#include "read_table.h"
+
+
+/* one generated number (with ',' as the separator) and its value */
+typedef struct {
+	char str[64];
+	double value;
+	int range; /* whether strtod() set errno to ERANGE */
+} test_number;
+
+static int check(int cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* generate a random number with ',' as the separator */
+static void gen_number(char* buf, unsigned int* seed) {
+	char* p = buf;
+	int ndigits = 1 + rand_r(seed) % 25;
+	int sep = rand_r(seed) % (ndigits + 2) - 1; /* position of the separator (-1: none) */
+	int i;
+	if(rand_r(seed) % 4 == 0) *p++ = '-';
+	else if(rand_r(seed) % 8 == 0) *p++ = '+';
+	for(i = 0; i < ndigits; i++) {
+		if(i == sep) *p++ = ',';
+		/* note: leading and trailing zeros are more common than other digits */
+		*p++ = (rand_r(seed) % 4 == 0) ? '0' : '0' + rand_r(seed) % 10;
+	}
+	if(sep == ndigits) *p++ = ',';
+	if(rand_r(seed) % 2) {
+		int e = (rand_r(seed) % 4 == 0) ? rand_r(seed) % 801 - 400 : rand_r(seed) % 61 - 30;
+		p += sprintf(p, "%s%s%d", rand_r(seed) % 2 ? "e" : "E", (e >= 0 && rand_r(seed) % 2) ? "+" : "", e);
+	}
+	*p = 0;
+}
+
+/* convert with read_table_strtod_sep() and compare to the expected result */
+static int compare_number(const test_number* t) {
+	char* end;
+	double d;
+	errno = 0;
+	d = read_table_strtod_sep(t->str, &end, ',');
+	return *end == 0 && (errno == ERANGE) == t->range && !memcmp(&d, &(t->value), sizeof(double));
+}
+
+/* 1. compare all numbers; returns the number of differences */
+static size_t test_numbers(const test_number* numbers, size_t n) {
+	size_t i, ndiff = 0;
+	for(i = 0; i < n; i++) if(!compare_number(numbers + i)) {
+		if(ndiff < 10) fprintf(stderr,"Error: wrong result for %s!\n",numbers[i].str);
+		ndiff++;
+	}
+	return ndiff;
+}
+
+/* 2. special cases: str converted to value, with end at the given offset */
+static int test_special(const char* str, double value, size_t end_pos) {
+	char* end;
+	double d;
+	errno = 0;
+	d = read_table_strtod_sep(str, &end, ',');
+	if((size_t)(end - str) != end_pos) return 0;
+	if(isnan(value)) return isnan(d);
+	return d == value && signbit(d) == signbit(value);
+}
+
+/* 3. read the numbers from a table; returns the number of differences */
+static size_t test_table(const test_number* numbers, size_t n, int allow_nan_inf) {
+	size_t i, ndiff = 0;
+	char* data = (char*)malloc(n * 80 + 1);
+	char* p = data;
+	FILE* f;
+	read_table r;
+	if(!data) return n;
+	for(i = 0; i < n; i++) p += sprintf(p, "%lu;%s;x\n", (unsigned long)i, numbers[i].str);
+	f = fmemopen(data, p - data, "r");
+	if(!f) {
+		free(data);
+		return n;
+	}
+	read_table_init(&r, f);
+	read_table_set_delim(&r, ';');
+	read_table_set_decimal(&r, ',');
+	if(!allow_nan_inf) r.flags &= ~READ_TABLE_ALLOW_NAN_INF;
+	for(i = 0; i < n; i++) {
+		uint32_t j;
+		double d;
+		int ok, err;
+		if(read_table_line(&r) || read_table_uint32(&r, &j) || j != i) {
+			ndiff = n;
+			break;
+		}
+		err = read_table_double(&r, &d);
+		if(numbers[i].range) ok = err && r.last_error == T_OVERFLOW;
+		else if(!allow_nan_inf && (isnan(numbers[i].value) || isinf(numbers[i].value))) ok = err && r.last_error == T_NAN;
+		else ok = !err && !memcmp(&d, &(numbers[i].value), sizeof(double)) && !read_table_skip(&r);
+		if(!ok) {
+			if(ndiff < 10) fprintf(stderr,"Error: wrong result when reading %s (line %lu)!\n",
+				numbers[i].str, (unsigned long)(i + 1));
+			ndiff++;
+		}
+	}
+	fclose(f);
+	free(data);
+	return ndiff;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t n = 1000000;
+	unsigned int seed = 1;
+	const char* locale = "de_DE.UTF-8";
+	int ret = 1;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			n = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 's':
+			seed = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'l':
+			locale = argv[i+1];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	/* 1. generated numbers, compared to strtod() in the "C" locale */
+	test_number* numbers = (test_number*)malloc((n + 8) * sizeof(test_number));
+	if(!numbers) {
+		fprintf(stderr,"Error allocating memory!\n");
+		return 1;
+	}
+	size_t j, k;
+	for(j = 0; j < n; j++) gen_number(numbers[j].str, &seed);
+	/* add some values that are out of range or special */
+	const char* extra[] = {"1,8e308", "-2e308", "1e-400", "2,4e-320", "inf", "-Infinity", "nan", "123456789012345678901234,5"};
+	for(k = 0; k < sizeof(extra) / sizeof(extra[0]); k++) strcpy(numbers[n++].str, extra[k]);
+	for(j = 0; j < n; j++) {
+		char tmp[64];
+		char* end;
+		for(k = 0; numbers[j].str[k]; k++) tmp[k] = (numbers[j].str[k] == ',') ? '.' : numbers[j].str[k];
+		tmp[k] = 0;
+		errno = 0;
+		numbers[j].value = strtod(tmp, &end);
+		numbers[j].range = (errno == ERANGE);
+	}
+	ret = check(test_numbers(numbers, n) == 0, "numbers converted differently than by strtod()") && ret;
+
+	/* 2. special cases */
+	ret = check(test_special("inf;1", INFINITY, 3) && test_special("-Infinity", -INFINITY, 9) &&
+		test_special("nan", NAN, 3) && test_special("  -0,0", -0.0, 6), "infinity or NaN") && ret;
+	ret = check(test_special(",5", 0.5, 2) && test_special("5,", 5.0, 2) && test_special("1,5e", 1.5, 3) &&
+		test_special("1,5e+x", 1.5, 3) && test_special("2,5.3", 2.5, 3), "partial numbers") && ret;
+	ret = check(test_special(",", 0.0, 0) && test_special("-", 0.0, 0) && test_special("abc", 0.0, 0) &&
+		test_special("", 0.0, 0) && test_special(",e5", 0.0, 0), "invalid numbers") && ret;
+
+	/* 3. reading from a table */
+	ret = check(test_table(numbers, n, 0) == 0, "wrong values read from a table") && ret;
+	ret = check(test_table(numbers, n, 1) == 0, "wrong values read from a table (allowing NaN)") && ret;
+
+	/* 4. locale using ',' as the decimal point */
+	if(setlocale(LC_NUMERIC, locale)) {
+		ret = check(test_numbers(numbers, n) == 0, "numbers converted differently with a different locale") && ret;
+		setlocale(LC_NUMERIC, "C");
+	}
+	else fprintf(stderr,"Locale %s is not available, not testing it\n",locale);
+
+	free(numbers);
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
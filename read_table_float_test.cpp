@@ -0,0 +1,179 @@
+/*
+ * read_table_float_test.cpp -- simple test cases for reading doubles with
+ * 	a decimal separator in read_table_cpp.h
+ *
+ * usage: read_table_float_test [-n numbers] [-s seed] [-l locale]
+ *
+ * generated numbers (default: 1000000, with up to 25 digits, exponents up
+ * to 400) are written with ',' as the decimal separator and read with
+ * line_parser::read_double() after set_decimal(); the results should be
+ * the same as converting the number with '.' using strtod():
+ * 1. parsing lines with a line_parser: out of range numbers are errors
+ * (T_OVERFLOW), as well as NaN and infinity unless allowed (T_NAN);
+ * also with read_double_limits()
+ * 2. reading a table with ';' as the delimiter with read_table2, set up
+ * with line_parser_params().set_decimal()
+ * 3. if the given locale (default: de_DE.UTF-8, which uses ',' as the
+ * decimal point) is available, 1. is repeated after setting it
+ * read_table_float_test.c does the same for read_table.h
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <locale.h>
+#include <random>
+#include <sstream>
+#include "read_table_cpp.h"
+
+
+/* one generated number (with ',' as the separator) and its value */
+struct test_number {
+	std::string str;
+	double value;
+	bool range; /* whether strtod() set errno to ERANGE */
+};
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* generate a random number with ',' as the separator */
+static std::string gen_number(std::mt19937& rng) {
+	std::string s;
+	int ndigits = 1 + rng() % 25;
+	int sep = (int)(rng() % (ndigits + 2)) - 1; /* position of the separator (-1: none) */
+	if(rng() % 4 == 0) s += '-';
+	else if(rng() % 8 == 0) s += '+';
+	for(int i = 0; i < ndigits; i++) {
+		if(i == sep) s += ',';
+		/* note: leading and trailing zeros are more common than other digits */
+		s += (rng() % 4 == 0) ? '0' : (char)('0' + rng() % 10);
+	}
+	if(sep == ndigits) s += ',';
+	if(rng() % 2) {
+		int e = (rng() % 4 == 0) ? (int)(rng() % 801) - 400 : (int)(rng() % 61) - 30;
+		s += (rng() % 2) ? 'e' : 'E';
+		if(e >= 0 && rng() % 2) s += '+';
+		s += std::to_string(e);
+	}
+	return s;
+}
+
+/* check the result of reading t (err is true if there was an error) */
+static bool same_result(const test_number& t, bool err, read_table_errors last_error, double d, bool allow_nan_inf) {
+	if(t.range) return err && last_error == T_OVERFLOW;
+	if(!allow_nan_inf && (std::isnan(t.value) || std::isinf(t.value))) return err && last_error == T_NAN;
+	return !err && !memcmp(&d, &(t.value), sizeof(double));
+}
+
+/* 1. parse each number as a line with a line_parser; returns the number
+ * of differences */
+static size_t test_parser(const std::vector<test_number>& numbers, bool allow_nan_inf) {
+	const line_parser_params par = line_parser_params().set_decimal(',').set_allow_nan_inf(allow_nan_inf);
+	line_parser lp(par);
+	size_t ndiff = 0;
+	for(const test_number& t : numbers) {
+		double d = 0.0;
+		lp.set_line(t.str);
+		bool err = !lp.read_double(d);
+		bool ok = same_result(t, err, lp.get_last_error(), d, allow_nan_inf);
+		/* with limits, infinity is out of range and NaN is always an error */
+		lp.set_line(t.str);
+		err = !lp.read_double_limits(d, -1e300, 1e300);
+		if(std::isnan(t.value)) ok = ok && err && lp.get_last_error() == T_NAN;
+		else if(t.range || !(t.value >= -1e300 && t.value <= 1e300))
+			ok = ok && err && lp.get_last_error() == T_OVERFLOW;
+		else ok = ok && !err && !memcmp(&d, &(t.value), sizeof(double));
+		if(!ok) {
+			if(ndiff < 10) fprintf(stderr,"Error: wrong result for %s!\n",t.str.c_str());
+			ndiff++;
+		}
+	}
+	return ndiff;
+}
+
+/* 2. read the numbers from a table; returns the number of differences */
+static size_t test_table(const std::vector<test_number>& numbers, bool allow_nan_inf) {
+	std::string data;
+	for(size_t i = 0; i < numbers.size(); i++) data += std::to_string(i) + ";" + numbers[i].str + ";" + std::to_string(i % 7) + "\n";
+	std::istringstream is(data);
+	read_table2 r(is, line_parser_params().set_delim(';').set_decimal(',').set_allow_nan_inf(allow_nan_inf));
+	size_t ndiff = 0;
+	for(size_t i = 0; i < numbers.size(); i++) {
+		uint64_t j, k;
+		double d = 0.0;
+		if(!r.read_line() || !r.read_uint64(j) || j != i) return numbers.size();
+		bool err = !r.read_double(d);
+		if(!same_result(numbers[i], err, r.get_last_error(), d, allow_nan_inf) || (!err && !(r.read_uint64(k) && k == i % 7))) {
+			if(ndiff < 10) fprintf(stderr,"Error: wrong result when reading %s (line %lu)!\n",
+				numbers[i].str.c_str(), (unsigned long)r.get_line());
+			ndiff++;
+		}
+	}
+	return ndiff;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t n = 1000000;
+	unsigned int seed = 1;
+	const char* locale = "de_DE.UTF-8";
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			n = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 's':
+			seed = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'l':
+			locale = argv[i+1];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	bool ret = true;
+
+	/* generated numbers, with the expected values from strtod() in the "C" locale */
+	std::mt19937 rng(seed);
+	std::vector<test_number> numbers(n);
+	for(test_number& t : numbers) t.str = gen_number(rng);
+	/* add some values that are out of range or special */
+	for(const char* str : {"1,8e308", "-2e308", "1e-400", "2,4e-320", "inf", "-Infinity", "nan", "123456789012345678901234,5"})
+		numbers.push_back(test_number{str, 0.0, false});
+	for(test_number& t : numbers) {
+		std::string tmp = t.str;
+		for(char& c : tmp) if(c == ',') c = '.';
+		errno = 0;
+		t.value = strtod(tmp.c_str(), nullptr);
+		t.range = (errno == ERANGE);
+	}
+
+	/* 1. line_parser */
+	ret = check(test_parser(numbers, false) == 0, "numbers converted differently than by strtod()") && ret;
+	ret = check(test_parser(numbers, true) == 0, "numbers converted differently than by strtod() (allowing NaN)") && ret;
+
+	/* 2. reading from a table */
+	ret = check(test_table(numbers, false) == 0, "wrong values read from a table") && ret;
+	ret = check(test_table(numbers, true) == 0, "wrong values read from a table (allowing NaN)") && ret;
+
+	/* 3. locale using ',' as the decimal point */
+	if(setlocale(LC_NUMERIC, locale)) {
+		ret = check(test_parser(numbers, true) == 0, "numbers converted differently with a different locale") && ret;
+		setlocale(LC_NUMERIC, "C");
+	}
+	else fprintf(stderr,"Locale %s is not available, not testing it\n",locale);
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
@@ -0,0 +1,298 @@
+/*  -*- C++ -*-
+ * read_table_index.h -- index of the values in a string column of a file
+ * 	read with read_table_cpp.h, to be used for filtering with equality
+ * 	or IN-list conditions without reading the whole file
+ *
+ * The input is divided into blocks of approximately the given size
+ * (always starting at the beginning of a line). While reading the file,
+ * the block ids where each distinct value (term) occurs are recorded.
+ * The index can be saved in a compact binary form ("sidecar" file), and
+ * later used to only read the blocks that contain the requested values.
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+// build the index on the third column (column 2, counting from 0)
+read_table2 r("input.tsv");
+string_index idx;
+if(!idx.build(r, 2) || !idx.write("input.tsv.idx")) ... // handle error
+
+// later: find all lines where the third column is "abc" or "xyz"
+string_index idx;
+if(!idx.read("input.tsv.idx")) ... // handle error
+read_table2 r("input.tsv");
+idx.query(r, 2, {"abc", "xyz"}, [](line_parser& lp) {
+	... // parse the line
+	return true;
+});
+
+ */
+
+#ifndef READ_TABLE_INDEX_H
+#define READ_TABLE_INDEX_H
+
+#include "read_table_cpp.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+
+/* default size of blocks (in bytes) */
+#ifndef READ_TABLE_INDEX_BLOCK_SIZE
+#define READ_TABLE_INDEX_BLOCK_SIZE (64UL*1024UL)
+#endif
+
+/* read the string in the given column (0-based) of the current line */
+static bool read_string_col(line_parser& lp, size_t col, string_view_custom& str) {
+	for(size_t i = 0; i < col; i++) if(!lp.read_skip()) return false;
+	return lp.read_string_view_custom(str);
+}
+
+
+class string_index {
+	public:
+		/* start of one block */
+		struct block_start {
+			uint64_t offset; /* offset of the first line in the input */
+			uint64_t line; /* number of lines before this block */
+		};
+
+	protected:
+		uint64_t block_size;
+		std::vector<block_start> blocks;
+		uint64_t end_offset = 0; /* end of the last block (i.e. the size of the input) */
+		/* list of blocks for each term (in increasing order) */
+		std::unordered_map<std::string, std::vector<uint64_t> > postings;
+
+		/* helpers for the binary format: variable length integers */
+		static void write_varint(std::string& out, uint64_t x) {
+			while(x >= 0x80) {
+				out.push_back((char)((x & 0x7f) | 0x80));
+				x >>= 7;
+			}
+			out.push_back((char)x);
+		}
+		static bool read_varint(const std::string& in, size_t& pos, uint64_t& x) {
+			x = 0;
+			for(unsigned int shift = 0; shift < 64; shift += 7) {
+				if(pos >= in.size()) return false;
+				unsigned char c = in[pos++];
+				x |= ((uint64_t)(c & 0x7f)) << shift;
+				if(!(c & 0x80)) return true;
+			}
+			return false;
+		}
+		static constexpr const char* magic() { return "RTIDX001"; }
+
+	public:
+		explicit string_index(uint64_t block_size_ = READ_TABLE_INDEX_BLOCK_SIZE) :
+			block_size(block_size_ ? block_size_ : READ_TABLE_INDEX_BLOCK_SIZE) { }
+
+		/* 1. building the index */
+
+		/* add one line with the given term, starting at the given offset
+		 * (as returned by read_table2::get_line_offset()); line is its line
+		 * number (as returned by read_table2::get_line());
+		 * lines should be added in the order they appear in the input */
+		void add(const char* term, size_t len, uint64_t offset, uint64_t line) {
+			if(blocks.empty() || offset >= blocks.back().offset + block_size) {
+				block_start b;
+				b.offset = offset;
+				b.line = line - 1;
+				blocks.push_back(b);
+			}
+			uint64_t id = blocks.size() - 1;
+			std::vector<uint64_t>& p = postings[std::string(term, len)];
+			if(p.empty() || p.back() != id) p.push_back(id);
+		}
+		/* set the end of the last block, should be called after all lines
+		 * have been added (with e.g. read_table2::get_next_offset()) */
+		void set_end(uint64_t end_offset_) { end_offset = end_offset_; }
+
+		/* build the index by reading all lines from r, using the values in
+		 * the given column (0-based) as terms
+		 * returns false on error (r contains the error code and position) */
+		bool build(read_table2& r, size_t col) {
+			while(r.read_line()) {
+				string_view_custom str;
+				if(!read_string_col(r, col, str)) return false;
+				add(str.str, str.len, r.get_line_offset(), r.get_line());
+			}
+			set_end(r.get_next_offset());
+			return r.get_last_error() == T_EOF;
+		}
+
+		/* 2. accessing the index */
+		size_t nblocks() const { return blocks.size(); }
+		size_t nterms() const { return postings.size(); }
+		const block_start& get_block(size_t i) const { return blocks[i]; }
+		/* end of a block (i.e. the start of the next one) */
+		uint64_t get_block_end(size_t i) const { return (i + 1 < blocks.size()) ? blocks[i+1].offset : end_offset; }
+
+		/* get the list of blocks containing the given term (or NULL if not present) */
+		const std::vector<uint64_t>* find(const std::string& term) const {
+			auto it = postings.find(term);
+			return (it == postings.end()) ? nullptr : &(it->second);
+		}
+		/* get the sorted list of blocks containing any of the given terms */
+		std::vector<uint64_t> find_any(const std::vector<std::string>& terms) const {
+			std::vector<uint64_t> res;
+			for(const auto& t : terms) {
+				const std::vector<uint64_t>* p = find(t);
+				if(p) res.insert(res.end(), p->begin(), p->end());
+			}
+			std::sort(res.begin(), res.end());
+			res.erase(std::unique(res.begin(), res.end()), res.end());
+			return res;
+		}
+
+		/* 3. saving and loading the index; both return false on error
+		 * format: magic string, block size, end offset, number of blocks,
+		 * then for each block the difference of offsets and lines to the
+		 * previous one, number of terms, then the terms in sorted order,
+		 * each with its length and string, the number of blocks and the
+		 * differences of block ids; all numbers are stored as varints */
+		bool write(const char* fn) const {
+			std::string out(magic());
+			write_varint(out, block_size);
+			write_varint(out, end_offset);
+			write_varint(out, blocks.size());
+			block_start prev = {0, 0};
+			for(const auto& b : blocks) {
+				write_varint(out, b.offset - prev.offset);
+				write_varint(out, b.line - prev.line);
+				prev = b;
+			}
+			std::vector<const std::pair<const std::string, std::vector<uint64_t> >*> sorted;
+			sorted.reserve(postings.size());
+			for(const auto& p : postings) sorted.push_back(&p);
+			std::sort(sorted.begin(), sorted.end(), [](const std::pair<const std::string, std::vector<uint64_t> >* x,
+				const std::pair<const std::string, std::vector<uint64_t> >* y) { return x->first < y->first; });
+			write_varint(out, sorted.size());
+			for(const auto* p : sorted) {
+				write_varint(out, p->first.size());
+				out.append(p->first);
+				write_varint(out, p->second.size());
+				uint64_t prev_id = 0;
+				for(uint64_t id : p->second) {
+					write_varint(out, id - prev_id);
+					prev_id = id;
+				}
+			}
+			std::ofstream f(fn, std::ios_base::binary);
+			if(!f) return false;
+			f.write(out.data(), out.size());
+			f.close();
+			return !f.fail();
+		}
+		bool read(const char* fn) {
+			std::ifstream f(fn, std::ios_base::binary);
+			if(!f) return false;
+			std::string in((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+			if(f.bad()) return false;
+			size_t len = strlen(magic());
+			if(in.compare(0, len, magic())) return false;
+			size_t pos = len;
+			uint64_t n;
+			blocks.clear();
+			postings.clear();
+			if(!(read_varint(in, pos, block_size) && read_varint(in, pos, end_offset) &&
+				read_varint(in, pos, n))) return false;
+			block_start prev = {0, 0};
+			for(uint64_t i = 0; i < n; i++) {
+				block_start b;
+				if(!(read_varint(in, pos, b.offset) && read_varint(in, pos, b.line))) return false;
+				b.offset += prev.offset;
+				b.line += prev.line;
+				blocks.push_back(b);
+				prev = b;
+			}
+			if(!read_varint(in, pos, n)) return false;
+			for(uint64_t i = 0; i < n; i++) {
+				uint64_t tlen, np;
+				if(!read_varint(in, pos, tlen) || tlen > in.size() - pos) return false;
+				std::vector<uint64_t>& p = postings[in.substr(pos, tlen)];
+				pos += tlen;
+				if(!read_varint(in, pos, np)) return false;
+				uint64_t id = 0;
+				for(uint64_t j = 0; j < np; j++) {
+					uint64_t d;
+					if(!read_varint(in, pos, d)) return false;
+					id += d;
+					if(id >= blocks.size()) return false;
+					p.push_back(id);
+				}
+			}
+			return true;
+		}
+
+		/* 4. query: call f for each line where the given column (0-based)
+		 * equals any of the given terms, reading only the blocks that
+		 * contain these terms; f is called with the parser positioned at
+		 * the beginning of the line and should return false on error
+		 * r needs to be seekable (e.g. opened from a file), and read the
+		 * same file as the index was built from
+		 * returns true on success, false on error (r contains the error) */
+		template<class F>
+		bool query(read_table2& r, size_t col, const std::vector<std::string>& terms, F&& f) const {
+			std::vector<uint64_t> ids = find_any(terms);
+			std::vector<std::string> sorted_terms(terms);
+			std::sort(sorted_terms.begin(), sorted_terms.end());
+			for(uint64_t id : ids) {
+				const block_start& b = blocks[id];
+				uint64_t end = get_block_end(id);
+				if(!r.seek(b.offset, b.line)) return false;
+				while(r.get_next_offset() < end) {
+					if(!r.read_line()) {
+						if(r.get_last_error() != T_EOF) return false;
+						break;
+					}
+					string_view_custom str;
+					if(!read_string_col(r, col, str)) return false;
+					/* note: the block can contain other terms as well */
+					auto it = std::lower_bound(sorted_terms.begin(), sorted_terms.end(), str,
+						[](const std::string& x, const string_view_custom& y) {
+							int c = memcmp(x.data(), y.str, std::min(x.size(), y.len));
+							return c < 0 || (c == 0 && x.size() < y.len);
+						});
+					if(it == sorted_terms.end() || it->size() != str.len ||
+						memcmp(it->data(), str.str, str.len)) continue;
+					r.reset_pos();
+					if(!f(r)) return false;
+				}
+			}
+			return true;
+		}
+};
+
+#endif /* READ_TABLE_INDEX_H */
+
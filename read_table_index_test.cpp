@@ -0,0 +1,157 @@
+/*
+ * read_table_index_test.cpp -- simple test cases for the line offsets
+ * 	tracked by read_table2 and the string index in read_table_index.h
+ *
+ * usage: read_table_index_test [-n lines] [-k keys] [-b block_size]
+ * 	[-o index_file]
+ *
+ * 1. offsets of lines (with empty and comment lines, CRLF line endings
+ * and no newline at the end of the input) are checked against the input,
+ * and seeking to them gives the same lines
+ * 2. an index is built on the second column of generated lines
+ * "id\tkeyN\tvalue" (N < keys), saved and loaded (to index_file, which is
+ * removed at the end), and querying some keys is compared to reading
+ * the whole input; a small block size (default: 256) gives many blocks
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include "read_table_index.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* read all lines, starting with the batch interface (so that the rest
+ * of the input is in the block of read_table2), and check the offsets */
+static bool test_offsets(const std::string& input) {
+	std::istringstream is(input);
+	read_table2 r(is, line_parser_params().set_comment('#'));
+	std::vector<line_view> batch;
+	std::vector<uint64_t> offsets;
+	std::vector<std::string> lines;
+	bool ret = true;
+	if(!r.read_lines(batch, 1) || batch.size() != 1 || batch[0].offset != 0) return check(false, "first line");
+	offsets.push_back(0);
+	lines.emplace_back(batch[0].str, batch[0].len);
+	uint64_t prev_end = r.get_next_offset();
+	while(r.read_line()) {
+		uint64_t off = r.get_line_offset();
+		const std::string& str = r.get_line_str();
+		ret = check(off >= prev_end && input.compare(off, str.size(), str) == 0, "line offset") && ret;
+		uint64_t end = r.get_next_offset();
+		ret = check(end > off + str.size() - 1 && end <= input.size() &&
+			(end == input.size() || input[end - 1] == '\n'), "next line offset") && ret;
+		prev_end = end;
+		offsets.push_back(off);
+		lines.push_back(str);
+	}
+	ret = check(r.get_last_error() == T_EOF, "reading the input") && ret;
+	ret = check(r.get_next_offset() == input.size(), "offset at the end of the input") && ret;
+
+	/* seek to each line and read it again */
+	for(size_t i = offsets.size(); i > 0; i--) {
+		bool ok = r.seek(offsets[i-1]) && r.read_line() && r.get_line_str() == lines[i-1] &&
+			r.get_line_offset() == offsets[i-1];
+		ret = check(ok, "reading the line after seeking") && ret;
+	}
+	return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	uint32_t nlines = 10000;
+	uint32_t nkeys = 100;
+	uint64_t block_size = 256;
+	const char* fn = "read_table_index_test.idx";
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nlines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'k':
+			nkeys = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'b':
+			block_size = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'o':
+			fn = argv[i+1];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	if(!nkeys) nkeys = 1;
+	bool ret = true;
+
+	/* 1. line offsets */
+	ret = test_offsets("a 1\n\n# comment\nb 2\r\n  c 3\nd 4") && ret;
+	ret = test_offsets("a 1\nb 2\n") && ret;
+
+	/* 2. index on generated data */
+	std::string input;
+	for(uint32_t j = 0; j < nlines; j++) {
+		char tmp[64];
+		snprintf(tmp, sizeof(tmp), "%u\tkey%u\t%u\n", j, (j * 7919U) % nkeys, j % 13);
+		input += tmp;
+		if(j % 100 == 99) input += "# comment\n";
+	}
+	{
+		std::istringstream is(input);
+		read_table2 r(is, line_parser_params().set_delim('\t').set_comment('#'));
+		string_index idx(block_size);
+		if(!idx.build(r, 1)) r.write_error(stderr);
+		ret = check(r.get_last_error() == T_EOF && idx.nterms() == std::min(nkeys, nlines), "building the index") && ret;
+		ret = check(idx.write(fn), "writing the index") && ret;
+	}
+	{
+		string_index idx;
+		ret = check(idx.read(fn), "reading the index") && ret;
+		remove(fn);
+		std::vector<std::string> terms = {"key1", "key3", "nokey"};
+		std::istringstream is(input);
+		read_table2 r(is, line_parser_params().set_delim('\t').set_comment('#'));
+		uint64_t n1 = 0, sum1 = 0, n2 = 0, sum2 = 0;
+		bool ok = idx.query(r, 1, terms, [&n1, &sum1](line_parser& lp) {
+			uint32_t id, x;
+			if(!lp.read(id, read_table_skip(), x)) return false;
+			n1++;
+			sum1 += id + x;
+			return true;
+		});
+		if(!ok) r.write_error(stderr);
+		ret = check(ok, "query") && ret;
+		/* compare to reading everything */
+		std::istringstream is2(input);
+		read_table2 r2(is2, line_parser_params().set_delim('\t').set_comment('#'));
+		while(r2.read_line()) {
+			uint32_t id, x;
+			std::string key;
+			if(!r2.read(id, key, x)) break;
+			if(key == "key1" || key == "key3") {
+				n2++;
+				sum2 += id + x;
+			}
+		}
+		ret = check(r2.get_last_error() == T_EOF, "reading the whole input") && ret;
+		ret = check(n1 == n2 && sum1 == sum2, "query results differ") && ret;
+		if(ret) fprintf(stdout,"%lu lines found in %lu blocks (out of %lu)\n", n1,
+			idx.find_any(terms).size(), idx.nblocks());
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
@@ -0,0 +1,202 @@
+/*  -*- C++ -*-
+ * read_table_join.h -- streaming merge join of two inputs sorted by a key
+ *
+ * Both inputs are read line by line with read_table2, and only the key
+ * column is parsed while advancing; lines are matched by comparing the
+ * keys, and a user-supplied function is called for each result, which can
+ * then parse the other columns of the matching lines. Lines of the right
+ * input with the same key are kept in memory while processing lines of
+ * the left input with that key (so that duplicate keys on both sides
+ * give all pairs); apart from this, memory use does not depend on the
+ * size of the inputs. The inputs must be sorted by the key (in increasing
+ * order, e.g. with read_table_sort.h); this is checked while reading.
+ *
+ * Supported join types:
+ * 	JOIN_INNER -- each pair of left and right lines with the same key
+ * 	JOIN_LEFT -- same, plus left lines without a match (with no right line)
+ * 	JOIN_ANTI -- only left lines without a match
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ * example usage:
+
+read_table2 r1("users.tsv", line_parser_params().set_delim('\t'));
+read_table2 r2("events.tsv", line_parser_params().set_delim('\t'));
+// join on the first column of users and the second column of events
+merge_join<uint64_t> j(r1, 0, r2, 1, JOIN_LEFT);
+bool ret = j.run([](const uint64_t& id, line_parser& user, line_parser* event) {
+	// user and event are positioned at the start of the line
+	std::string_view name;
+	if(!user.read(read_table_skip_t(), name)) return false;
+	if(event) ... // parse columns of event
+	return true; // return false to stop
+});
+if(!ret && j.get_last_error() != T_OK) j.write_error(stderr);
+
+ */
+
+#ifndef READ_TABLE_JOIN_H
+#define READ_TABLE_JOIN_H
+
+#include "read_table_cpp.h"
+#include <vector>
+#include <string>
+#include <stdio.h>
+
+enum join_type { JOIN_INNER, JOIN_LEFT, JOIN_ANTI };
+
+
+template<class K>
+class merge_join {
+	protected:
+		read_table2& left;
+		read_table2& right;
+		size_t left_col; /* key columns (starting from 0) */
+		size_t right_col;
+		enum join_type type;
+		std::vector<line_parser> group; /* right lines with the current key */
+		size_t ngroup = 0; /* number of lines in group (note: elements are reused) */
+		enum read_table_errors last_error = T_OK;
+		std::string err_msg;
+
+		/* read the next line of r and parse its key (checking that keys are
+		 * in order); returns false at the end of the input or on error */
+		bool next(read_table2& r, size_t col, K& key, bool first);
+		bool set_error(read_table2& r) {
+			last_error = r.get_last_error();
+			err_msg = r.exception_string();
+			return false;
+		}
+
+	public:
+		/* join left and right on columns left_col_ and right_col_ (starting
+		 * from 0), parsed as type K; the readers are used directly (they
+		 * should not be used by the caller while running the join) */
+		merge_join(read_table2& left_, size_t left_col_, read_table2& right_, size_t right_col_,
+			enum join_type type_ = JOIN_INNER) : left(left_), right(right_), left_col(left_col_),
+			right_col(right_col_), type(type_) { }
+
+		/* run the join, calling f(key, left_line, right_line) for each
+		 * result, where right_line is nullptr for left lines without a
+		 * match; both are positioned at the beginning of the line (so that
+		 * any columns can be parsed); f should return false to stop;
+		 * returns false on error or if f returned false (in this case,
+		 * get_last_error() returns T_OK) */
+		template<class F> bool run(F&& f);
+
+		/* largest number of right lines with the same key stored at once */
+		size_t max_group_size() const { return group.size(); }
+
+		enum read_table_errors get_last_error() const { return last_error; }
+		void write_error(FILE* f) const {
+			if(!f) return;
+			if(err_msg.size()) fprintf(f,"%s",err_msg.c_str());
+			else fprintf(f,"merge_join: %s\n",get_error_desc(last_error));
+		}
+};
+
+
+template<class K>
+bool merge_join<K>::next(read_table2& r, size_t col, K& key, bool first) {
+	if(!r.read_line()) {
+		if(r.get_last_error() != T_EOF) set_error(r);
+		return false;
+	}
+	K prev = key;
+	for(size_t i = 0; i < col; i++) if(!r.read_skip()) return set_error(r);
+	if(!r.read_next(key)) return set_error(r);
+	if(std::is_floating_point<K>::value && std::isnan((double)key)) {
+		/* note: NaN values cannot be ordered */
+		last_error = T_NAN;
+		err_msg = r.exception_string();
+		return false;
+	}
+	if(!first && key < prev) {
+		char buf[64];
+		snprintf(buf, sizeof(buf), "line %lu: ", (unsigned long)r.get_line());
+		last_error = T_FORMAT;
+		err_msg = "merge_join, ";
+		if(r.get_fn()) { err_msg += "file "; err_msg += r.get_fn(); err_msg += ", "; }
+		else err_msg += "input ";
+		err_msg += buf;
+		err_msg += "input is not sorted by the key\n";
+		return false;
+	}
+	r.reset_pos();
+	return true;
+}
+
+template<class K> template<class F>
+bool merge_join<K>::run(F&& f) {
+	last_error = T_OK;
+	err_msg.clear();
+	const line_parser_params par = right.get_params();
+	K lkey = K();
+	K rkey = K();
+	K gkey = K(); /* key of the lines in group */
+	bool have_group = false; /* whether group contains the matches for gkey */
+	bool first_left = true;
+	bool right_valid = next(right, right_col, rkey, true);
+	if(last_error != T_OK) return false;
+	while(next(left, left_col, lkey, first_left)) {
+		first_left = false;
+		if(!(have_group && gkey == lkey)) {
+			/* new key, find the matching lines in right */
+			while(right_valid && rkey < lkey) right_valid = next(right, right_col, rkey, false);
+			if(last_error != T_OK) return false;
+			ngroup = 0;
+			while(right_valid && rkey == lkey) {
+				if(type != JOIN_ANTI) {
+					/* note: line_parser objects are reused for later groups */
+					if(ngroup == group.size()) group.emplace_back(par);
+					const std::string& line = right.get_line_str();
+					group[ngroup].assign_line(line.data(), line.size());
+				}
+				ngroup++;
+				right_valid = next(right, right_col, rkey, false);
+			}
+			if(last_error != T_OK) return false;
+			gkey = lkey;
+			have_group = true;
+		}
+		if(ngroup == 0) {
+			if(type != JOIN_INNER && !f(lkey, (line_parser&)left, (line_parser*)nullptr)) return false;
+		}
+		else if(type != JOIN_ANTI) for(size_t i = 0; i < ngroup; i++) {
+			left.reset_pos();
+			group[i].reset_pos();
+			if(!f(lkey, (line_parser&)left, &group[i])) return false;
+		}
+	}
+	return last_error == T_OK;
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * read_table_join_test.cpp -- simple test cases for read_table_join.h
+ *
+ * two inputs with random sorted keys (with duplicates) are generated, and
+ * the result of each join type is compared to a simple nested loop join
+ * format of the inputs: key, value (left); value, key (right)
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include "read_table_join.h"
+
+
+/* number of results and sum of (left value * right value) */
+struct join_result {
+	uint64_t n = 0;
+	uint64_t sum = 0;
+	bool operator == (const join_result& r) const { return n == r.n && sum == r.sum; }
+};
+
+static bool run_join(const std::string& left, const std::string& right, enum join_type type,
+		join_result& res, size_t& max_group) {
+	std::istringstream s1(left);
+	std::istringstream s2(right);
+	read_table2 r1(s1);
+	read_table2 r2(s2);
+	merge_join<uint32_t> j(r1, 0, r2, 1, type);
+	bool ret = j.run([&res](const uint32_t& key, line_parser& l, line_parser* r) {
+		uint32_t k1, v1, v2 = 1;
+		if(!l.read(k1, v1)) return false;
+		if(r) {
+			uint32_t k2;
+			if(!r->read(v2, k2) || k2 != key) return false;
+		}
+		if(k1 != key) return false;
+		res.n++;
+		res.sum += (uint64_t)v1 * v2;
+		return true;
+	});
+	if(!ret) {
+		j.write_error(stderr);
+		return false;
+	}
+	max_group = j.max_group_size();
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t n1 = 10000;
+	size_t n2 = 20000;
+	uint32_t max_key = 5000;
+	unsigned int seed = 1;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'l':
+			n1 = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'r':
+			n2 = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'k':
+			max_key = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 's':
+			seed = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	/* generate the inputs */
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<uint32_t> keys(0, max_key);
+	std::uniform_int_distribution<uint32_t> values(1, 1000);
+	std::vector<std::pair<uint32_t, uint32_t> > x1(n1), x2(n2);
+	for(auto& x : x1) x = std::make_pair(keys(rng), values(rng));
+	for(auto& x : x2) x = std::make_pair(keys(rng), values(rng));
+	std::sort(x1.begin(), x1.end());
+	std::sort(x2.begin(), x2.end());
+	std::ostringstream s1, s2;
+	for(const auto& x : x1) s1 << x.first << '\t' << x.second << '\n';
+	for(const auto& x : x2) s2 << x.second << ' ' << x.first << '\n';
+
+	/* expected results */
+	join_result expected[3];
+	for(const auto& x : x1) {
+		bool found = false;
+		auto it = std::lower_bound(x2.begin(), x2.end(), std::make_pair(x.first, 0U));
+		for(; it != x2.end() && it->first == x.first; ++it) {
+			found = true;
+			expected[JOIN_INNER].n++;
+			expected[JOIN_INNER].sum += (uint64_t)x.second * it->second;
+		}
+		if(!found) {
+			expected[JOIN_ANTI].n++;
+			expected[JOIN_ANTI].sum += x.second;
+		}
+	}
+	expected[JOIN_LEFT].n = expected[JOIN_INNER].n + expected[JOIN_ANTI].n;
+	expected[JOIN_LEFT].sum = expected[JOIN_INNER].sum + expected[JOIN_ANTI].sum;
+
+	const char* names[3] = {"inner", "left", "anti"};
+	int ret = 0;
+	for(int t = 0; t < 3; t++) {
+		join_result res;
+		size_t max_group = 0;
+		if(!run_join(s1.str(), s2.str(), (enum join_type)t, res, max_group)) return 1;
+		fprintf(stdout,"%s join: %lu results, sum: %lu, largest group: %lu\n",names[t],res.n,res.sum,max_group);
+		if(!(res == expected[t])) {
+			fprintf(stderr,"Error: expected %lu results, sum: %lu!\n",expected[t].n,expected[t].sum);
+			ret = 1;
+		}
+	}
+
+	/* unsorted input should be detected */
+	{
+		std::istringstream u1("1 1\n3 1\n2 1\n");
+		std::istringstream u2("1 1\n2 2\n3 3\n");
+		read_table2 r1(u1);
+		read_table2 r2(u2);
+		merge_join<uint32_t> j(r1, 0, r2, 1);
+		if(j.run([](const uint32_t&, line_parser&, line_parser*) { return true; }) ||
+				j.get_last_error() != T_FORMAT) {
+			fprintf(stderr,"Error: unsorted input not detected!\n");
+			ret = 1;
+		}
+	}
+
+	if(!ret) fprintf(stdout,"Merge join OK\n");
+	return ret;
+}
@@ -0,0 +1,96 @@
+/*
+ * read_table_kv_test.cpp -- simple test cases for reading key=value
+ * 	(logfmt) lines with line_parser::read_kv() in read_table_cpp.h
+ *
+ * usage: read_table_kv_test [-n nkeys]
+ *
+ * a few lines with required, optional, quoted and unknown keys are read,
+ * including error cases (missing required key, quoted number, missing
+ * closing quote); the lookup table is also checked with nkeys keys
+ * (default: 1000)
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include "read_table_cpp.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t nkeys = 1000;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nkeys = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	bool ret = true;
+
+	/* 1. lookup of many keys */
+	{
+		std::vector<std::string> names;
+		for(size_t j = 0; j < nkeys; j++) names.push_back("key" + std::to_string(j));
+		kv_keys keys(names);
+		bool ok = (keys.size() == nkeys);
+		for(size_t j = 0; j < nkeys; j++) ok = ok && (keys.find(names[j].data(), names[j].size()) == j);
+		ok = ok && (keys.find("key", 3) == nkeys) && (keys.find("", 0) == nkeys);
+		ret = check(ok, "key lookup") && ret;
+	}
+
+	const kv_keys keys{"ts", "level", "dur", "msg", "retry"};
+	std::istringstream is(
+		"ts=1 level=info dur=0.5 msg=\"hello world\" other=x\n"
+		"  other=\"a b\" msg=short ts=2 level=warn retry=3 dur=1.5 # comment\n"
+		"ts=3 level=error msg= dur=2\n"
+		"level=info dur=0.5 msg=x\n"
+		"ts=\"5\" level=info dur=0.5 msg=x\n"
+		"ts=6 level=info dur=0.5 msg=\"unterminated\n");
+	read_table2 r(is, line_parser_params().set_comment('#'));
+	uint64_t ts;
+	std::string level;
+	double dur;
+	string_view_custom msg;
+	read_table_nullable<uint32_t> retry;
+
+	/* 2. valid lines, optional key missing or present */
+	bool ok = r.read_line() && r.read_kv(keys, ts, level, dur, msg, retry);
+	ret = check(ok && ts == 1 && level == "info" && dur == 0.5 && msg.len == 11 &&
+		!memcmp(msg.str, "hello world", 11) && !retry, "first line") && ret;
+	ok = r.read_line() && r.read_kv(keys, ts, level, dur, msg, retry);
+	ret = check(ok && ts == 2 && level == "warn" && dur == 1.5 && msg.len == 5 &&
+		retry && retry.val == 3, "second line") && ret;
+	/* empty value is fine for strings */
+	ok = r.read_line() && r.read_kv(keys, ts, level, dur, msg, retry);
+	ret = check(ok && ts == 3 && msg.len == 0 && dur == 2.0, "third line") && ret;
+
+	/* 3. errors: missing required key (position is the end of the line) */
+	ok = r.read_line() && !r.read_kv(keys, ts, level, dur, msg);
+	ret = check(ok && r.get_last_error() == T_MISSING && r.get_line() == 4 &&
+		r.get_pos() == 24 && r.get_col() == 3, "missing key") && ret;
+	/* quoted number */
+	ok = r.read_line() && !r.read_kv(keys, ts, level, dur, msg);
+	ret = check(ok && r.get_last_error() == T_FORMAT && r.get_pos() == 4 && r.get_col() == 0,
+		"quoted number") && ret;
+	/* missing closing quote */
+	ok = r.read_line() && !r.read_kv(keys, ts, level, dur, msg);
+	ret = check(ok && r.get_last_error() == T_FORMAT && r.get_col() == 3, "missing closing quote") && ret;
+	ret = check(!r.read_line() && r.get_last_error() == T_EOF, "end of input") && ret;
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
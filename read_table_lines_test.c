@@ -0,0 +1,135 @@
+/*
+ * read_table_lines_test.c -- simple test cases for reading lines in
+ * 	batches with read_table_lines() in read_table.h
+ *
+ * usage: read_table_lines_test [-m max_lines]
+ *
+ * several inputs (empty and comment lines, CRLF line endings, no newline
+ * at the end, lines longer than the block size) are read both in batches
+ * of max_lines lines (default: 3) and with read_table_line(), and the
+ * lines and line numbers returned are compared
+ * read_table_lines_test.cpp does the same for read_table_cpp.h
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include "read_table.h"
+
+
+/* compare reading data with the two methods; returns 0 if they gave the
+ * same lines, and the number of lines is nlines */
+static int test_input(const char* data, size_t len, size_t max_lines, uint64_t nlines, const char* desc) {
+	read_table r1, r2;
+	read_table_batch b;
+	uint64_t n = 0;
+	int ret = 0;
+	FILE* f1 = fmemopen((void*)data, len, "r");
+	FILE* f2 = fmemopen((void*)data, len, "r");
+	if(!(f1 && f2) || read_table_batch_init(&b, max_lines)) {
+		fprintf(stderr,"Error allocating memory!\n");
+		return 1;
+	}
+	read_table_init(&r1, f1);
+	read_table_init(&r2, f2);
+	read_table_set_comment(&r1, '#');
+	read_table_set_comment(&r2, '#');
+	while(ret == 0 && read_table_lines(&r1, &b) == 0) {
+		size_t i;
+		for(i = 0; i < b.nlines; i++) {
+			const read_table_line_view* v = b.lines + i;
+			size_t len2;
+			if(read_table_line(&r2)) {
+				fprintf(stderr,"%s: line %lu not found with read_table_line()!\n", desc, v->line);
+				ret = 1;
+				break;
+			}
+			/* note: read_table_line() keeps the line endings */
+			len2 = r2.line_len;
+			if(len2 && r2.buf[len2 - 1] == '\n') len2--;
+			if(len2 && r2.buf[len2 - 1] == '\r') len2--;
+			if(!(v->len == len2 && !memcmp(v->str, r2.buf, len2) && v->line == r2.line &&
+					(v->str[v->len] == '\n' || v->str[v->len] == '\r' || v->str[v->len] == 0))) {
+				fprintf(stderr,"%s: lines differ: %lu: %.*s, %lu: %.*s!\n", desc, v->line, (int)v->len,
+					v->str, r2.line, (int)len2, r2.buf);
+				ret = 1;
+				break;
+			}
+			n++;
+		}
+	}
+	if(ret == 0) {
+		if(r1.last_error != T_EOF) {
+			fprintf(stderr,"%s: ", desc);
+			read_table_write_error(&r1, stderr);
+			ret = 1;
+		}
+		else if(read_table_line(&r2) == 0) {
+			fprintf(stderr,"%s: line %lu not found with read_table_lines()!\n", desc, r2.line);
+			ret = 1;
+		}
+		else if(n != nlines) {
+			fprintf(stderr,"%s: %lu lines read instead of %lu!\n", desc, n, nlines);
+			ret = 1;
+		}
+	}
+	read_table_batch_free(&b);
+	read_table_free_buf(&r2);
+	fclose(f1);
+	fclose(f2);
+	return ret;
+}
+
+static int test_str(const char* data, size_t max_lines, uint64_t nlines, const char* desc) {
+	return test_input(data, strlen(data), max_lines, nlines, desc);
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t max_lines = 3;
+	int ret = 0;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'm':
+			max_lines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	ret |= test_str("", max_lines, 0, "empty input");
+	ret |= test_str("\n\n  \n# comment only\n", max_lines, 0, "no data");
+	ret |= test_str("a 1\nb 2\n", max_lines, 2, "simple input");
+	ret |= test_str("a 1\nb 2", max_lines, 2, "no newline at the end");
+	ret |= test_str("a 1\r\n\r\n  \r\n# comment\r\nb 2\r\n  c 3  \r\nd 4\r", max_lines, 4, "CRLF line endings");
+	ret |= test_str("\n\na 1\n\n\n# x\n\nb 2\n\n\n", max_lines, 2, "empty lines");
+
+	/* many lines and lines longer than the block size */
+	{
+		size_t size = 4 * READ_TABLE_BLOCK_SIZE + 12345;
+		char* data = (char*)malloc(size);
+		size_t len = 0;
+		uint64_t n = 0;
+		if(!data) return 1;
+		while(len + 100 < size) {
+			int l = sprintf(data + len, "%lu\t%lu\n", n, n * n);
+			len += l;
+			n++;
+		}
+		ret |= test_input(data, len, max_lines, n, "many lines");
+		memset(data, 'x', size);
+		data[READ_TABLE_BLOCK_SIZE / 2] = '\n';
+		data[3 * READ_TABLE_BLOCK_SIZE] = '\n';
+		ret |= test_input(data, size, max_lines, 3, "long lines");
+		free(data);
+	}
+
+	if(!ret) fprintf(stdout,"All tests passed\n");
+	return ret;
+}
+
@@ -0,0 +1,112 @@
+/*
+ * read_table_lines_test.cpp -- simple test cases for reading lines in
+ * 	batches with read_table2::read_lines() in read_table_cpp.h
+ *
+ * usage: read_table_lines_test [-m max_lines]
+ *
+ * several inputs (empty and comment lines, CRLF line endings, no newline
+ * at the end, lines longer than the block size) are read both in batches
+ * of max_lines lines (default: 3) and with read_line(), and the lines,
+ * line numbers and offsets returned are compared
+ * read_table_lines_test.c does the same for read_table.h
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include "read_table_cpp.h"
+
+
+/* compare reading data with the two methods; returns true if they gave
+ * the same lines, and the number of lines is nlines */
+static bool test_input(const std::string& data, size_t max_lines, uint64_t nlines, const char* desc) {
+	std::istringstream is1(data);
+	std::istringstream is2(data);
+	read_table2 r1(is1, line_parser_params().set_comment('#'));
+	read_table2 r2(is2, line_parser_params().set_comment('#'));
+	std::vector<line_view> batch;
+	uint64_t n = 0;
+	while(r1.read_lines(batch, max_lines)) for(const line_view& v : batch) {
+		if(!r2.read_line()) {
+			fprintf(stderr,"%s: line %lu not found with read_line()!\n", desc, v.line);
+			return false;
+		}
+		const std::string& str = r2.get_line_str();
+		if(!(v.len == str.size() && !memcmp(v.str, str.data(), v.len) && v.line == r2.get_line() &&
+				v.offset == r2.get_line_offset())) {
+			fprintf(stderr,"%s: lines differ: %lu: %.*s, %lu: %s!\n", desc, v.line, (int)v.len,
+				v.str, r2.get_line(), str.c_str());
+			return false;
+		}
+		n++;
+	}
+	if(r1.get_last_error() != T_EOF) {
+		fprintf(stderr,"%s: ", desc);
+		r1.write_error(stderr);
+		return false;
+	}
+	if(r2.read_line()) {
+		fprintf(stderr,"%s: line %lu not found with read_lines()!\n", desc, r2.get_line());
+		return false;
+	}
+	if(r2.get_last_error() != T_EOF) {
+		fprintf(stderr,"%s: ", desc);
+		r2.write_error(stderr);
+		return false;
+	}
+	if(n != nlines) {
+		fprintf(stderr,"%s: %lu lines read instead of %lu!\n", desc, n, nlines);
+		return false;
+	}
+	if(r1.get_next_offset() != data.size() || r2.get_next_offset() != data.size()) {
+		fprintf(stderr,"%s: wrong offset at the end of the input!\n", desc);
+		return false;
+	}
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t max_lines = 3;
+	bool ret = true;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'm':
+			max_lines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	ret = test_input("", max_lines, 0, "empty input") && ret;
+	ret = test_input("\n\n  \n# comment only\n", max_lines, 0, "no data") && ret;
+	ret = test_input("a 1\nb 2\n", max_lines, 2, "simple input") && ret;
+	ret = test_input("a 1\nb 2", max_lines, 2, "no newline at the end") && ret;
+	ret = test_input("a 1\r\n\r\n  \r\n# comment\r\nb 2\r\n  c 3  \r\nd 4\r", max_lines, 4, "CRLF line endings") && ret;
+	ret = test_input("\n\na 1\n\n\n# x\n\nb 2\n\n\n", max_lines, 2, "empty lines") && ret;
+
+	/* many lines and lines longer than the block size */
+	{
+		std::string data;
+		uint64_t n = 0;
+		while(data.size() < 4 * READ_TABLE_BLOCK_SIZE + 12345) {
+			data += std::to_string(n) + "\t" + std::to_string(n * n) + "\n";
+			n++;
+		}
+		ret = test_input(data, max_lines, n, "many lines") && ret;
+		data.assign(4 * READ_TABLE_BLOCK_SIZE + 12345, 'x');
+		data[READ_TABLE_BLOCK_SIZE / 2] = '\n';
+		data[3 * READ_TABLE_BLOCK_SIZE] = '\n';
+		ret = test_input(data, max_lines, 3, "long lines") && ret;
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
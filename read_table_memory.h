@@ -0,0 +1,217 @@
+/*  -*- C -*-
+ * read_table_memory.h -- accounting of the memory used by the readers
+ *
+ * Buffers allocated by the library are counted in a global account, and
+ * optionally in a separate account given for each reader (so that e.g.
+ * several readers can share a budget). These are: the line and batch
+ * buffers of readers (read_table.h and read_table_cpp.h, also when used
+ * by other modules, e.g. read_table_join.h), the text, columns and field
+ * caches stored by table_loader (read_table_bulk.h, also the blocks kept
+ * by read_table_block_cache.h), the runs of external_sort
+ * (read_table_sort.h), the arrays of read_table_sparse.h and the output
+ * buffers of read_table_parallel.h (only in the global account). Not
+ * counted: the index built by read_table_index.h, the lines with the
+ * same key kept by merge_join in read_table_join.h, the list of chunks
+ * in read_table_parallel.h, and shared memory mapped by other modules;
+ * rtiobuf uses a fixed size buffer inside the object. Each account can
+ * have a limit; if growing a buffer would exceed it, the operation fails
+ * with the T_MEMORY error, instead of continuing to use more memory.
+ * If a limit is set (for the reader's or the global account), buffers
+ * are counted before they are grown, so the limit is never exceeded
+ * (lines are then read without getline() and std::getline(), which
+ * could allocate any amount of memory; note that read_table2 then reads
+ * in blocks of at least READ_TABLE_BLOCK_SIZE bytes); otherwise, the new
+ * size is counted after growing.
+ *
+ * Accounts can be updated from multiple threads (using the GCC atomic
+ * builtins if available). The global account is shared by all
+ * compilation units of a program (see below for the exception).
+ *
+ * This file does not depend on either read_table.h or read_table_cpp.h,
+ * and is included by both.
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+read_table_mem_set_limit(&read_table_mem_global, 1UL << 30); // at most 1 GiB for all readers
+read_table_mem m;
+read_table_mem_init(&m, 256UL << 20); // at most 256 MiB for this reader
+read_table* r = read_table_new_fn("input.txt");
+r->mem = &m;
+while(read_table_line(r) == 0) ...
+if(r->last_error == T_MEMORY) ... // limit reached
+fprintf(stderr, "used: %lu, peak: %lu\n", m.used, m.peak);
+
+ */
+
+#ifndef READ_TABLE_MEMORY_H
+#define READ_TABLE_MEMORY_H
+
+#include <stddef.h>
+
+/* one account: memory currently used, maximum used, limit (0: none) */
+typedef struct read_table_mem_s {
+	size_t used;
+	size_t peak;
+	size_t limit;
+} read_table_mem;
+
+/* global account, all allocations are counted here as well; this is
+ * shared by all translation units of a program: with GCC (and compatible
+ * compilers), it is a weak symbol (the linker keeps one of the copies),
+ * otherwise in C++ it is a static variable of an inline function;
+ * note: in C without GCC, each translation unit has its own account */
+#if defined(__GNUC__)
+#ifdef __cplusplus
+extern "C" {
+#endif
+__attribute__((weak)) read_table_mem read_table_mem_global = {0, 0, 0};
+#ifdef __cplusplus
+}
+#endif
+#elif defined(__cplusplus)
+inline read_table_mem& read_table_mem_global_account() {
+	static read_table_mem m = {0, 0, 0};
+	return m;
+}
+#define read_table_mem_global (read_table_mem_global_account())
+#else
+static read_table_mem read_table_mem_global = {0, 0, 0};
+#endif
+
+static void read_table_mem_init(read_table_mem* m, size_t limit) {
+	m->used = 0;
+	m->peak = 0;
+	m->limit = limit;
+}
+static void read_table_mem_set_limit(read_table_mem* m, size_t limit) { m->limit = limit; }
+
+/* add n bytes to one account; returns 0 on success, 1 if this would
+ * exceed the limit (in this case, the account is not changed) */
+static int read_table_mem_add1(read_table_mem* m, size_t n) {
+#ifdef __GNUC__
+	size_t old = __atomic_load_n(&(m->used), __ATOMIC_RELAXED);
+	size_t peak;
+	do {
+		if(m->limit && old + n > m->limit) return 1;
+	} while(!__atomic_compare_exchange_n(&(m->used), &old, old + n, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	peak = __atomic_load_n(&(m->peak), __ATOMIC_RELAXED);
+	while(old + n > peak && !__atomic_compare_exchange_n(&(m->peak), &peak, old + n, 1,
+		__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#else
+	if(m->limit && m->used + n > m->limit) return 1;
+	m->used += n;
+	if(m->used > m->peak) m->peak = m->used;
+#endif
+	return 0;
+}
+static void read_table_mem_sub1(read_table_mem* m, size_t n) {
+#ifdef __GNUC__
+	__atomic_sub_fetch(&(m->used), n, __ATOMIC_RELAXED);
+#else
+	m->used -= n;
+#endif
+}
+
+/* add n bytes to m (if not NULL) and the global account
+ * returns 0 on success, 1 if a limit would be exceeded */
+static int read_table_mem_add(read_table_mem* m, size_t n) {
+	if(m && read_table_mem_add1(m, n)) return 1;
+	if(read_table_mem_add1(&read_table_mem_global, n)) {
+		if(m) read_table_mem_sub1(m, n);
+		return 1;
+	}
+	return 0;
+}
+/* release n bytes from m (if not NULL) and the global account */
+static void read_table_mem_sub(read_table_mem* m, size_t n) {
+	if(m) read_table_mem_sub1(m, n);
+	read_table_mem_sub1(&read_table_mem_global, n);
+}
+
+/* returns nonzero if m (if not NULL) or the global account has a limit */
+static int read_table_mem_has_limit(const read_table_mem* m) {
+	return (m && m->limit) || read_table_mem_global.limit;
+}
+
+/* update the size counted for one buffer from *tracked to size; returns
+ * 0 on success (*tracked is set to size), 1 if a limit would be exceeded
+ * (note: releasing memory never fails) */
+static int read_table_mem_update(read_table_mem* m, size_t* tracked, size_t size) {
+	if(size > *tracked) {
+		if(read_table_mem_add(m, size - *tracked)) return 1;
+	}
+	else read_table_mem_sub(m, *tracked - size);
+	*tracked = size;
+	return 0;
+}
+
+#ifdef __cplusplus
+/* size of one buffer (or group of buffers) counted in an account and the
+ * global account; it is released when destroyed, and moved along with
+ * the object owning the buffer */
+struct read_table_mem_tracker {
+	read_table_mem* mem = nullptr;
+	size_t size = 0;
+	read_table_mem_tracker() { }
+	read_table_mem_tracker(const read_table_mem_tracker&) = delete;
+	read_table_mem_tracker(read_table_mem_tracker&& t) : mem(t.mem), size(t.size) { t.size = 0; }
+	read_table_mem_tracker& operator = (read_table_mem_tracker&& t) {
+		if(this != &t) {
+			release();
+			mem = t.mem;
+			size = t.size;
+			t.size = 0;
+		}
+		return *this;
+	}
+	~read_table_mem_tracker() { release(); }
+	/* use a different account (the current size is released from the old one) */
+	void set_account(read_table_mem* m) { release(); mem = m; }
+	/* true if a limit applies (memory needs to be counted before growing) */
+	bool limited() const { return read_table_mem_has_limit(mem) != 0; }
+	/* update the size; returns false if this would exceed a limit */
+	bool update(size_t size_) { return size_ == size || read_table_mem_update(mem, &size, size_) == 0; }
+	void release() { read_table_mem_update(mem, &size, 0); }
+};
+
+/* capacity of the vector v after making space for n more elements (it
+ * is grown to at least twice as large, as e.g. push_back() would); this
+ * can be counted before calling v.reserve() with it */
+template<class V> static size_t read_table_grown_capacity(const V& v, size_t n) {
+	size_t need = v.size() + n;
+	if(need <= v.capacity()) return v.capacity();
+	size_t cap = 2 * v.capacity();
+	return cap < need ? need : cap;
+}
+#endif
+
+#endif
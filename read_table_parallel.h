@@ -0,0 +1,977 @@
+/*  -*- C -*-
+ * read_table_parallel.h -- parallel processing of text files with the
+ * 	C interface of read_table.h
+ *
+ * The input file is memory-mapped and split into chunks at line
+ * boundaries; chunks are processed by a set of worker threads (POSIX
+ * threads), each using its own read_table struct and buffers. For each
+ * line, a user-supplied callback is called which can parse the line
+ * with the usual read_table_*() functions. Line numbers are counted in
+ * the whole file, so error messages (e.g. from read_table_write_error())
+ * refer to the original position in the file.
+ *
+ * Optionally, the callback can format output rows into a buffer for
+ * each chunk; these are written to the output in the original order of
+ * the chunks, so that simple transformations (e.g. TSV to TSV) can be
+ * done fully in parallel (see read_table_parallel_write()).
+ *
+ * Note: this requires the fmemopen() and getline() functions (POSIX 2008)
+ * and linking with -pthread
+ *
+ * Copyright 2018-2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+int process_line(read_table* r, void* user_data, unsigned int thread_id) {
+	int32_t id;
+	double d;
+	if(read_table_int32(r,&id) || read_table_double(r,&d)) return 1; // stop on error
+	... // do something with the values, e.g. add to per-thread sums in user_data[thread_id]
+	return 0;
+}
+
+read_table r;
+read_table_init(&r, 0); // r is only used for parameters and to return errors
+read_table_set_delim(&r, '\t');
+if(read_table_parallel("input.tsv", &r, 4, process_line, user_data))
+	read_table_write_error(&r, stderr);
+
+ */
+
+#ifndef READ_TABLE_PARALLEL_H
+#define READ_TABLE_PARALLEL_H
+
+#include "read_table.h"
+#include "read_table_chunks.h"
+#include <pthread.h>
+
+/* callback called for each line read; r contains the current line which
+ * can be parsed with the read_table_*() functions; thread_id is between
+ * 0 and nthreads - 1 and can be used to index per-thread data;
+ * should return 0 to continue processing or nonzero to stop on error */
+typedef int (*read_table_parallel_cb)(read_table* r, void* user_data, unsigned int thread_id);
+
+
+
+/* growable output buffer, used to format rows in the worker threads;
+ * the allocated size is counted in the global memory account (see
+ * read_table_memory.h) */
+typedef struct read_table_outbuf_s {
+	char* buf; /* data (not NULL-terminated) */
+	size_t len; /* length of data in the buffer */
+	size_t size; /* allocated size */
+} read_table_outbuf;
+
+static void read_table_outbuf_init(read_table_outbuf* o) {
+	o->buf = 0;
+	o->len = 0;
+	o->size = 0;
+}
+static void read_table_outbuf_free(read_table_outbuf* o) {
+	if(o->buf) free(o->buf);
+	read_table_mem_sub(0, o->size);
+	read_table_outbuf_init(o);
+}
+/* ensure that there is space for at least len more bytes
+ * returns 0 on success, 1 on memory allocation error */
+static int read_table_outbuf_reserve(read_table_outbuf* o, size_t len) {
+	if(o->size - o->len >= len) return 0;
+	size_t size = o->size ? o->size : 4096;
+	while(size - o->len < len) size *= 2;
+	/* note: counted before allocating, so that a limit is not exceeded */
+	if(read_table_mem_add(0, size - o->size)) return 1;
+	char* tmp = (char*)realloc(o->buf, size);
+	if(!tmp) {
+		read_table_mem_sub(0, size - o->size);
+		return 1;
+	}
+	o->buf = tmp;
+	o->size = size;
+	return 0;
+}
+
+/* functions to format data into an output buffer
+ * all return 0 on success, 1 on memory allocation error */
+static int read_table_out_string(read_table_outbuf* o, const char* str, size_t len) {
+	if(read_table_outbuf_reserve(o, len)) return 1;
+	memcpy(o->buf + o->len, str, len);
+	o->len += len;
+	return 0;
+}
+static int read_table_out_char(read_table_outbuf* o, char c) {
+	if(read_table_outbuf_reserve(o, 1)) return 1;
+	o->buf[o->len++] = c;
+	return 0;
+}
+static int read_table_out_uint64(read_table_outbuf* o, uint64_t x) {
+	char tmp[20];
+	int i = 20;
+	do {
+		tmp[--i] = '0' + (x % 10);
+		x /= 10;
+	} while(x);
+	return read_table_out_string(o, tmp + i, 20 - i);
+}
+static int read_table_out_int64(read_table_outbuf* o, int64_t x) {
+	if(x >= 0) return read_table_out_uint64(o, (uint64_t)x);
+	/* note: negate as unsigned to avoid overflow for INT64_MIN */
+	if(read_table_out_char(o, '-')) return 1;
+	return read_table_out_uint64(o, -(uint64_t)x);
+}
+/* write a double value with the given precision (as with printf("%.*g")) */
+static int read_table_out_double(read_table_outbuf* o, double d, int prec) {
+	int len;
+	if(read_table_outbuf_reserve(o, 32)) return 1;
+	len = snprintf(o->buf + o->len, o->size - o->len, "%.*g", prec, d);
+	if(len < 0) return 1;
+	if((size_t)len >= o->size - o->len) {
+		/* only possible with very large precision */
+		if(read_table_outbuf_reserve(o, len + 1)) return 1;
+		snprintf(o->buf + o->len, o->size - o->len, "%.*g", prec, d);
+	}
+	o->len += len;
+	return 0;
+}
+/* write a field delimiter matching the one used when reading with r;
+ * if r does not use an explicit delimiter, a tab is written */
+static int read_table_out_delim(read_table_outbuf* o, const read_table* r) {
+	return read_table_out_char(o, r->delim ? r->delim : '\t');
+}
+static int read_table_out_newline(read_table_outbuf* o) {
+	return read_table_out_char(o, '\n');
+}
+/* copy the whole current line of r (adding a newline if it was missing) */
+static int read_table_out_line(read_table_outbuf* o, const read_table* r) {
+	if(read_table_out_string(o, r->buf, r->line_len)) return 1;
+	if(r->line_len == 0 || r->buf[r->line_len - 1] != '\n') return read_table_out_newline(o);
+	return 0;
+}
+
+
+/* writer that outputs buffers in the original order of chunks
+ * buffers committed out of order are kept until all previous chunks are
+ * written; at most window chunks can be pending at the same time, worker
+ * threads wait before starting to process chunks beyond this */
+typedef struct read_table_writer_s {
+	int fd; /* file descriptor to write to */
+	size_t window; /* maximum number of pending chunks */
+	read_table_outbuf* slots; /* buffers of the pending chunks (indexed by chunk % window) */
+	char* ready; /* whether each slot contains data ready to be written */
+	size_t next; /* next chunk to be written */
+	size_t stop; /* do not write chunks after this one */
+	int flushing; /* whether a thread is currently writing data */
+	int err; /* errno of a failed write, 0 if no error */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} read_table_writer;
+
+/* returns 0 on success, 1 on memory allocation error */
+static int read_table_writer_init(read_table_writer* w, int fd, size_t window) {
+	size_t i;
+	if(!window) window = 1;
+	w->fd = fd;
+	w->window = window;
+	w->next = 0;
+	w->stop = (size_t)-1;
+	w->flushing = 0;
+	w->err = 0;
+	w->slots = (read_table_outbuf*)malloc(window * sizeof(read_table_outbuf));
+	w->ready = (char*)calloc(window, 1);
+	if(!(w->slots && w->ready)) {
+		if(w->slots) free(w->slots);
+		if(w->ready) free(w->ready);
+		return 1;
+	}
+	for(i = 0; i < window; i++) read_table_outbuf_init(w->slots + i);
+	pthread_mutex_init(&(w->mutex), 0);
+	pthread_cond_init(&(w->cond), 0);
+	return 0;
+}
+
+static void read_table_writer_free(read_table_writer* w) {
+	size_t i;
+	for(i = 0; i < w->window; i++) read_table_outbuf_free(w->slots + i);
+	free(w->slots);
+	free(w->ready);
+	pthread_mutex_destroy(&(w->mutex));
+	pthread_cond_destroy(&(w->cond));
+}
+
+/* write all data, retrying on partial writes; returns 0 or errno */
+static int read_table_write_all(int fd, const char* buf, size_t len) {
+	while(len) {
+		ssize_t ret = write(fd, buf, len);
+		if(ret < 0) {
+			if(errno == EINTR) continue;
+			return errno;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/* wait until chunk i can be processed (i.e. it is within the window of
+ * pending chunks); returns 1 if it should be skipped (due to an error) */
+static int read_table_writer_wait(read_table_writer* w, size_t i) {
+	int ret;
+	pthread_mutex_lock(&(w->mutex));
+	while(!w->err && i <= w->stop && i >= w->next + w->window)
+		pthread_cond_wait(&(w->cond), &(w->mutex));
+	ret = (w->err || i > w->stop);
+	pthread_mutex_unlock(&(w->mutex));
+	return ret;
+}
+
+/* do not write any chunk after i */
+static void read_table_writer_stop(read_table_writer* w, size_t i) {
+	pthread_mutex_lock(&(w->mutex));
+	if(i < w->stop) w->stop = i;
+	pthread_cond_broadcast(&(w->cond));
+	pthread_mutex_unlock(&(w->mutex));
+}
+
+/* commit the output of chunk i; the contents of o are taken over by the
+ * writer, o is replaced by an empty buffer that can be reused; if all
+ * previous chunks have been written already, the output is written
+ * directly, together with any subsequent chunks that are ready
+ * returns 0 on success, 1 if there was an error writing the output */
+static int read_table_writer_commit(read_table_writer* w, size_t i, read_table_outbuf* o) {
+	int ret;
+	pthread_mutex_lock(&(w->mutex));
+	if(!w->err && i <= w->stop) {
+		size_t j = i % w->window;
+		read_table_outbuf tmp = w->slots[j];
+		w->slots[j] = *o;
+		*o = tmp;
+		w->ready[j] = 1;
+		if(!w->flushing) {
+			w->flushing = 1;
+			while(!w->err && w->next <= w->stop && w->ready[w->next % w->window]) {
+				read_table_outbuf* b = w->slots + (w->next % w->window);
+				int err;
+				/* write without holding the lock, other threads can commit in the meantime */
+				pthread_mutex_unlock(&(w->mutex));
+				err = read_table_write_all(w->fd, b->buf, b->len);
+				pthread_mutex_lock(&(w->mutex));
+				if(err) w->err = err;
+				b->len = 0;
+				w->ready[w->next % w->window] = 0;
+				w->next++;
+				pthread_cond_broadcast(&(w->cond));
+			}
+			w->flushing = 0;
+		}
+	}
+	o->len = 0;
+	ret = w->err ? 1 : 0;
+	pthread_mutex_unlock(&(w->mutex));
+	return ret;
+}
+
+
+/* callback for parallel processing with output: similar to
+ * read_table_parallel_cb, but rows can be formatted into out, which
+ * is written to the output in the original order of lines */
+typedef int (*read_table_parallel_write_cb)(read_table* r, read_table_outbuf* out,
+	void* user_data, unsigned int thread_id);
+
+/* whether to schedule chunks based on the page cache by default (see
+ * read_table_parallel_next_chunk() below) */
+#ifndef READ_TABLE_PARALLEL_SCHEDULE
+#define READ_TABLE_PARALLEL_SCHEDULE 1
+#endif
+
+/* what a worker thread does with a chunk (see read_table_parallel_next_chunk()) */
+enum read_table_parallel_task { READ_TABLE_TASK_PROCESS = 0, READ_TABLE_TASK_COUNT, READ_TABLE_TASK_COUNT_COLD };
+
+/* state shared among the worker threads */
+typedef struct read_table_parallel_state_s {
+	const read_table_mapped* m; /* input */
+	read_table_chunk* chunks; /* chunks the input is split into */
+	size_t nchunks; /* number of chunks */
+	size_t chunk_size; /* size of chunks to use (0: READ_TABLE_CHUNK_SIZE) */
+	size_t next_chunk; /* next chunk to be processed by any thread (in the order of the file) */
+	size_t stop_chunk; /* do not process chunks after this one (where an error occured) */
+	/* lines are counted in each chunk before processing, so that line
+	 * numbers refer to the whole file; a chunk can be processed once all
+	 * chunks before it are counted */
+	unsigned char* counted; /* for each chunk: 0: not counted, 1: being counted, 2: counted */
+	size_t next_count; /* no chunk before this one is waiting to be counted */
+	size_t nknown; /* the first_line field is set in the chunks before this one */
+	uint64_t nlines; /* number of lines in the first nknown chunks */
+	unsigned int counting; /* number of threads counting chunks not in the page cache */
+	int schedule; /* whether to count chunks in the page cache first and read ahead the others */
+	float* cached; /* fraction of each chunk in the page cache (if scheduling) */
+	size_t readahead; /* number of chunks to read ahead if scheduling */
+	size_t next_readahead; /* next chunk to read ahead */
+	const read_table* params; /* parameters to use (delimiter, comment, etc.) */
+	read_table_parallel_cb cb; /* callback to call for each line (if not writing output) */
+	read_table_parallel_write_cb wcb; /* callback to call for each line if writing output */
+	read_table_writer* w; /* writer to use for output (or NULL) */
+	void* user_data; /* passed to the callback */
+	pthread_mutex_t mutex; /* protects the fields above that change while processing and the error fields */
+	pthread_cond_t cond; /* signaled when more chunks can be processed or on error */
+	/* first error encountered (with the lowest line number) */
+	uint64_t err_line;
+	size_t err_pos;
+	size_t err_col;
+	enum read_table_errors err;
+} read_table_parallel_state;
+
+/* arguments for one thread */
+typedef struct read_table_parallel_thread_s {
+	read_table_parallel_state* s;
+	unsigned int id;
+	pthread_t th;
+} read_table_parallel_thread;
+
+
+/* get the number of threads to use if not given by the user */
+static unsigned int read_table_default_nthreads(void) {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if(n < 1) return 1;
+	return (unsigned int)n;
+}
+
+/* get the next chunk to count or process (the task to do is stored in
+ * task), waiting if there is none yet; returns nchunks if there is no
+ * more work
+ * if scheduling, chunks in the page cache are counted first (this is
+ * fast and does not access the disk), while the others are counted by
+ * one thread at a time in the order of the file, with the next ones read
+ * ahead; meanwhile, the other threads process the chunks that have all
+ * lines before them counted, so processing overlaps reading from the
+ * disk; without scheduling, all chunks are counted first */
+static size_t read_table_parallel_next_chunk(read_table_parallel_state* s, int* task) {
+	size_t i = s->nchunks;
+	size_t ra1 = 0, ra2 = 0;
+	pthread_mutex_lock(&(s->mutex));
+	while(1) {
+		size_t c;
+		int can_count, can_process, cold;
+		while(s->next_count < s->nchunks && s->counted[s->next_count]) s->next_count++;
+		c = s->next_count;
+		can_count = (c < s->stop_chunk);
+		cold = can_count && s->cached && s->cached[c] < 1.0f;
+		can_process = (s->next_chunk < s->nknown && s->next_chunk < s->stop_chunk);
+		if(can_count && (!cold || !s->counting || !can_process)) {
+			s->counted[c] = 1;
+			i = c;
+			*task = READ_TABLE_TASK_COUNT;
+			if(cold) {
+				*task = READ_TABLE_TASK_COUNT_COLD;
+				s->counting++;
+				ra1 = s->next_readahead > c ? s->next_readahead : c;
+				ra2 = c + s->readahead;
+				if(ra2 > s->nchunks) ra2 = s->nchunks;
+				if(ra2 > ra1) s->next_readahead = ra2;
+			}
+			break;
+		}
+		if(can_process) {
+			i = s->next_chunk++;
+			*task = READ_TABLE_TASK_PROCESS;
+			break;
+		}
+		/* note: if no chunk can be counted, but some are waiting to be
+		 * processed, the chunks before them are being counted */
+		if(s->next_chunk >= s->stop_chunk) break;
+		pthread_cond_wait(&(s->cond), &(s->mutex));
+	}
+	pthread_mutex_unlock(&(s->mutex));
+	for(; ra1 < ra2; ra1++)
+		if(s->cached[ra1] < 1.0f) read_table_chunk_readahead(s->m->data, s->chunks + ra1);
+	return i;
+}
+
+/* store the number of lines counted in chunk i and set the line numbers
+ * of the chunks that can be processed after this */
+static void read_table_parallel_counted(read_table_parallel_state* s, size_t i, uint64_t nlines, int task) {
+	pthread_mutex_lock(&(s->mutex));
+	s->chunks[i].first_line = nlines;
+	s->counted[i] = 2;
+	if(task == READ_TABLE_TASK_COUNT_COLD) s->counting--;
+	for(; s->nknown < s->nchunks && s->counted[s->nknown] == 2; s->nknown++) {
+		uint64_t tmp = s->chunks[s->nknown].first_line;
+		s->chunks[s->nknown].first_line = s->nlines;
+		s->nlines += tmp;
+	}
+	pthread_cond_broadcast(&(s->cond));
+	pthread_mutex_unlock(&(s->mutex));
+}
+
+/* save an error that occured in chunk i, if it is before any previous error */
+static void read_table_parallel_set_error(read_table_parallel_state* s, const read_table* r, size_t i) {
+	pthread_mutex_lock(&(s->mutex));
+	if(i < s->stop_chunk) {
+		s->stop_chunk = i;
+		s->err_line = r->line;
+		s->err_pos = r->pos;
+		s->err_col = r->col;
+		s->err = r->last_error;
+		pthread_cond_broadcast(&(s->cond));
+	}
+	pthread_mutex_unlock(&(s->mutex));
+	if(s->w) read_table_writer_stop(s->w, i);
+}
+
+/* count the lines in each chunk and process all lines in it */
+static void* read_table_parallel_worker(void* arg) {
+	read_table_parallel_thread* t = (read_table_parallel_thread*)arg;
+	read_table_parallel_state* s = t->s;
+	read_table r = *(s->params); /* copy parameters */
+	read_table_outbuf o; /* output of the current chunk (if writing output) */
+	size_t i;
+	int task = READ_TABLE_TASK_PROCESS;
+	read_table_reset_buf(&r); /* buffer is reused for all chunks processed by this thread */
+	r.flags &= ~READ_TABLE_CLOSE_FILE;
+	read_table_outbuf_init(&o);
+
+	while((i = read_table_parallel_next_chunk(s, &task)) < s->nchunks) {
+		const read_table_chunk* c = s->chunks + i;
+		int err;
+		if(task != READ_TABLE_TASK_PROCESS) {
+			read_table_parallel_counted(s, i, read_table_count_lines(s->m->data, c->start, c->end), task);
+			continue;
+		}
+		if(s->w && read_table_writer_wait(s->w, i)) break;
+		r.f = fmemopen((void*)(s->m->data + c->start), c->end - c->start, "r");
+		r.line = c->first_line;
+		r.line_len = 0;
+		r.pos = 0;
+		r.col = 0;
+		if(r.f) {
+			r.last_error = T_OK;
+			if(s->w) {
+				while(read_table_line(&r) == 0)
+					if(s->wcb(&r, &o, s->user_data, t->id)) break;
+			}
+			else while(read_table_line(&r) == 0)
+				if(s->cb(&r, s->user_data, t->id)) break;
+			fclose(r.f);
+			r.f = 0;
+		}
+		else r.last_error = T_READ_ERROR;
+		/* error in this chunk -- either from the callback or from reading
+		 * (note: last_error can be T_OK if the callback requested stopping) */
+		err = (r.last_error != T_EOF);
+		if(err) read_table_parallel_set_error(s, &r, i);
+		/* note: output is committed even in case of an error, so that
+		 * lines before the error are written out */
+		if(s->w && read_table_writer_commit(s->w, i, &o) && !err) {
+			r.last_error = T_WRITE_ERROR;
+			read_table_parallel_set_error(s, &r, i);
+			err = 1;
+		}
+		if(err) break;
+	}
+	read_table_free_buf(&r);
+	read_table_outbuf_free(&o);
+	return 0;
+}
+
+/* run the given function with nthreads threads on the shared state */
+static int read_table_parallel_run(read_table_parallel_state* s, unsigned int nthreads,
+		void* (*fn)(void*)) {
+	unsigned int i;
+	int ret = 0;
+	read_table_parallel_thread* t = (read_table_parallel_thread*)malloc(nthreads * sizeof(read_table_parallel_thread));
+	if(!t) return 1;
+	for(i = 0; i < nthreads; i++) {
+		t[i].s = s;
+		t[i].id = i;
+	}
+	/* start nthreads - 1 new threads, the current thread is used as well */
+	for(i = 1; i < nthreads; i++) if(pthread_create(&(t[i].th), 0, fn, t + i)) {
+		nthreads = i; /* could not create more threads, continue with the ones we have */
+		break;
+	}
+	fn(t);
+	for(i = 1; i < nthreads; i++) if(pthread_join(t[i].th, 0)) ret = 1;
+	free(t);
+	return ret;
+}
+
+/* process the given file with the callbacks and writer set in s */
+static int read_table_parallel_main(const char* fn, read_table* r, unsigned int nthreads,
+		read_table_parallel_state* s) {
+	read_table_mapped m;
+	if(!r->fn) r->fn = fn;
+	if(read_table_map_file(&m, fn)) {
+		r->last_error = T_ERROR_FOPEN;
+		return 1;
+	}
+	if(!nthreads) nthreads = read_table_default_nthreads();
+
+	s->m = &m;
+	s->nchunks = read_table_split_chunks(m.data, m.size, s->chunk_size, &(s->chunks));
+	s->next_chunk = 0;
+	s->stop_chunk = s->nchunks;
+	s->next_count = 0;
+	s->nknown = 0;
+	s->nlines = 0;
+	s->counting = 0;
+	s->next_readahead = 0;
+	s->params = r;
+	s->err = T_OK;
+	s->cached = 0;
+	s->counted = (unsigned char*)calloc(s->nchunks ? s->nchunks : 1, 1);
+	if((m.size && !s->nchunks) || !s->counted) {
+		if(s->chunks) free(s->chunks);
+		free(s->counted);
+		read_table_unmap_file(&m);
+		r->last_error = T_READ_ERROR;
+		return 1;
+	}
+	if(nthreads > s->nchunks) nthreads = s->nchunks ? s->nchunks : 1;
+	if(s->schedule && s->nchunks > 1) {
+		/* note: if allocation fails, all chunks are counted first */
+		s->cached = (float*)malloc(s->nchunks * sizeof(float));
+		if(s->cached && read_table_chunks_cached(m.data, s->chunks, s->nchunks, s->cached)) {
+			/* residency cannot be determined, read ahead all chunks in order */
+			size_t i;
+			for(i = 0; i < s->nchunks; i++) s->cached[i] = 0.0f;
+		}
+		s->readahead = 2 * (size_t)nthreads;
+	}
+	pthread_mutex_init(&(s->mutex), 0);
+	pthread_cond_init(&(s->cond), 0);
+
+	if(read_table_parallel_run(s, nthreads, read_table_parallel_worker) && s->err == T_OK) {
+		s->stop_chunk = 0;
+		s->err = T_READ_ERROR;
+	}
+
+	pthread_cond_destroy(&(s->cond));
+	pthread_mutex_destroy(&(s->mutex));
+	if(s->chunks) free(s->chunks);
+	free(s->counted);
+	free(s->cached);
+	read_table_unmap_file(&m);
+
+	r->pos = 0;
+	r->col = 0;
+	if(s->stop_chunk == s->nchunks && s->err == T_OK) {
+		r->last_error = T_EOF;
+		return 0;
+	}
+	r->line = s->err_line;
+	r->pos = s->err_pos;
+	r->col = s->err_col;
+	r->last_error = s->err;
+	return 1;
+}
+
+/* process the given file in parallel, calling cb for each line (see
+ * read_table_parallel() below), with the size of chunks (0 means
+ * READ_TABLE_CHUNK_SIZE) and whether to schedule chunks based on the
+ * page cache (see read_table_parallel_next_chunk()) given explicitly */
+static int read_table_parallel_ex(const char* fn, read_table* r, unsigned int nthreads,
+		read_table_parallel_cb cb, void* user_data, size_t chunk_size, int schedule) {
+	read_table_parallel_state s;
+	if(!(r && cb)) return 1;
+	s.cb = cb;
+	s.wcb = 0;
+	s.w = 0;
+	s.user_data = user_data;
+	s.chunk_size = chunk_size;
+	s.schedule = schedule;
+	return read_table_parallel_main(fn, r, nthreads, &s);
+}
+
+/* process the given file in parallel using nthreads threads (0 means
+ * using the number of available processors); parameters (delimiter,
+ * comment character, base, flags) are copied from r, which is also used
+ * to return the first error encountered (if any)
+ * returns 0 on success (in this case r->last_error is set to T_EOF,
+ * similarly to reading a file sequentially), 1 on error or if the
+ * callback requested stopping (in the latter case, r->last_error is T_OK)
+ * note: in case of an error, all lines before the error were processed,
+ * but lines after it might have been processed as well */
+static int read_table_parallel(const char* fn, read_table* r, unsigned int nthreads,
+		read_table_parallel_cb cb, void* user_data) {
+	return read_table_parallel_ex(fn, r, nthreads, cb, user_data, 0, READ_TABLE_PARALLEL_SCHEDULE);
+}
+
+/* process the given file in parallel similarly to read_table_parallel(),
+ * writing the output formatted by the callback to the file descriptor
+ * out_fd; output is written in the same order as the input lines
+ * (i.e. as if the file was processed sequentially); in case of an
+ * error, output is written up to and including the line with the error
+ * returns 0 on success, 1 on error (T_WRITE_ERROR if writing failed) */
+static int read_table_parallel_write(const char* fn, read_table* r, unsigned int nthreads,
+		read_table_parallel_write_cb cb, void* user_data, int out_fd) {
+	read_table_parallel_state s;
+	read_table_writer w;
+	int ret;
+	if(!(r && cb)) return 1;
+	if(!nthreads) nthreads = read_table_default_nthreads();
+	/* allow each thread to be a few chunks ahead of the writer */
+	if(read_table_writer_init(&w, out_fd, 4 * (size_t)nthreads)) {
+		r->last_error = T_WRITE_ERROR;
+		return 1;
+	}
+	s.cb = 0;
+	s.wcb = cb;
+	s.w = &w;
+	s.user_data = user_data;
+	s.chunk_size = 0;
+	s.schedule = READ_TABLE_PARALLEL_SCHEDULE;
+	ret = read_table_parallel_main(fn, r, nthreads, &s);
+	read_table_writer_free(&w);
+	return ret;
+}
+
+
+/* fallback for inputs that cannot be processed in parallel (e.g. pipes):
+ * open the given file (or stdin if fn is NULL) for reading sequentially
+ * with r2, copying the parameters from r (r2 allocates its own buffer)
+ * returns 0 on success, 1 if the file could not be opened (r->last_error
+ * is set to T_ERROR_FOPEN) */
+static int read_table_seq_open(const char* fn, read_table* r, read_table* r2) {
+	*r2 = *r;
+	read_table_reset_buf(r2);
+	r2->flags &= ~READ_TABLE_CLOSE_FILE;
+	r2->line = 0;
+	r2->last_error = T_OK;
+	r2->f = fn ? fopen(fn, "r") : stdin;
+	r2->fn = fn ? fn : r->fn;
+	if(!r2->f) {
+		r->fn = r2->fn;
+		r->last_error = T_ERROR_FOPEN;
+		return 1;
+	}
+	return 0;
+}
+
+/* close the input opened by read_table_seq_open(), copying the position
+ * and error code (e.g. T_EOF after reading all lines) from r2 to r */
+static void read_table_seq_close(read_table* r, read_table* r2) {
+	read_table_free_buf(r2);
+	if(r2->f != stdin) fclose(r2->f);
+	r2->f = 0;
+	r->line = r2->line;
+	r->pos = r2->pos;
+	r->col = r2->col;
+	r->last_error = r2->last_error;
+	r->fn = r2->fn;
+}
+
+
+/* selecting and reordering columns (similar to cut -f, but allowing
+ * any order of the output columns) */
+typedef struct read_table_cut_spec_s {
+	const size_t* cols; /* columns to output (0-based), in the order to output them */
+	size_t ncols; /* number of columns to output */
+	size_t nfields; /* number of fields that need to be found in each line (i.e. max(cols) + 1) */
+} read_table_cut_spec;
+
+static void read_table_cut_spec_init(read_table_cut_spec* spec, const size_t* cols, size_t ncols) {
+	size_t i;
+	spec->cols = cols;
+	spec->ncols = ncols;
+	spec->nfields = 0;
+	for(i = 0; i < ncols; i++) if(cols[i] + 1 > spec->nfields) spec->nfields = cols[i] + 1;
+}
+
+/* find the start and end of the first nfields fields in the current line
+ * of r, storing them in spans (which should have space for 2*nfields
+ * elements); fields are separated by r->delim or blanks and the line ends
+ * at a newline or the comment character; no conversion is performed
+ * returns 0 on success, 1 if there are less fields (r->last_error is set
+ * to T_EOL and r->col to the number of fields found) */
+static int read_table_find_fields(read_table* r, size_t nfields, size_t* spans) {
+	size_t end = r->line_len;
+	size_t pos = r->pos;
+	size_t i;
+	const char* buf = r->buf;
+	/* find the end of the line content */
+	if(end && buf[end - 1] == '\n') end--;
+	if(end && buf[end - 1] == '\r') end--;
+	if(r->comment) {
+		const char* c = (const char*)memchr(buf + pos, r->comment, end - pos);
+		if(c) end = c - buf;
+	}
+	/* note: read_table_line() skips blanks at the start of the line; if
+	 * the delimiter is a blank, these are empty fields */
+	if(r->col == 0 && (r->delim == '\t' || r->delim == ' '))
+		for(; pos > 0 && buf[pos - 1] == r->delim; pos--);
+	for(i = 0; i < nfields; i++) {
+		if(r->delim) {
+			const char* d;
+			if(pos > end || (pos == end && i && buf[pos - 1] != r->delim)) break;
+			d = (const char*)memchr(buf + pos, r->delim, end - pos);
+			spans[2*i] = pos;
+			spans[2*i + 1] = d ? (size_t)(d - buf) : end;
+			pos = spans[2*i + 1] + 1;
+		}
+		else {
+			for(; pos < end; pos++) if( ! (buf[pos] == ' ' || buf[pos] == '\t') ) break;
+			if(pos == end) break;
+			spans[2*i] = pos;
+			for(; pos < end; pos++) if(buf[pos] == ' ' || buf[pos] == '\t') break;
+			spans[2*i + 1] = pos;
+		}
+	}
+	r->col = i;
+	if(i < nfields) {
+		r->pos = pos > end ? end : pos;
+		r->last_error = T_EOL;
+		return 1;
+	}
+	r->pos = pos > end ? end : pos;
+	r->last_error = T_OK;
+	return 0;
+}
+
+/* copy the selected fields of the current line of r to out (in the order
+ * given in spec), separated by the same delimiter as the input (tab if
+ * blanks are used in the input); spans should have space for
+ * 2*spec->nfields elements; returns 0 on success, 1 on error */
+static int read_table_cut_line(read_table* r, const read_table_cut_spec* spec,
+		size_t* spans, read_table_outbuf* out) {
+	size_t i;
+	if(read_table_find_fields(r, spec->nfields, spans)) return 1;
+	for(i = 0; i < spec->ncols; i++) {
+		size_t j = spec->cols[i];
+		if(i && read_table_out_delim(out, r)) return 1;
+		if(read_table_out_string(out, r->buf + spans[2*j], spans[2*j + 1] - spans[2*j])) return 1;
+	}
+	return read_table_out_newline(out);
+}
+
+/* helpers for processing a file in parallel with the previous */
+typedef struct read_table_cut_data_s {
+	const read_table_cut_spec* spec;
+	size_t* spans; /* separate space for each thread */
+} read_table_cut_data;
+
+static int read_table_cut_cb(read_table* r, read_table_outbuf* out, void* user_data, unsigned int thread_id) {
+	read_table_cut_data* d = (read_table_cut_data*)user_data;
+	return read_table_cut_line(r, d->spec, d->spans + 2 * d->spec->nfields * thread_id, out);
+}
+
+/* select columns from the input read by r (sequentially), writing the
+ * result to out_fd; returns 0 on success, 1 on error */
+static int read_table_cut_stream(read_table* r, const read_table_cut_spec* spec, int out_fd) {
+	read_table_outbuf o;
+	size_t* spans = (size_t*)malloc(2 * (spec->nfields ? spec->nfields : 1) * sizeof(size_t));
+	int ret = 0;
+	if(!spans) return 1;
+	read_table_outbuf_init(&o);
+	while(read_table_line(r) == 0) {
+		if(read_table_cut_line(r, spec, spans, &o)) { ret = 1; break; }
+		if(o.len >= READ_TABLE_CHUNK_SIZE / 16) {
+			if(read_table_write_all(out_fd, o.buf, o.len)) {
+				r->last_error = T_WRITE_ERROR;
+				ret = 1;
+				break;
+			}
+			o.len = 0;
+		}
+	}
+	if(o.len && read_table_write_all(out_fd, o.buf, o.len) && !ret) {
+		r->last_error = T_WRITE_ERROR;
+		ret = 1;
+	}
+	if(r->last_error != T_EOF) ret = 1;
+	read_table_outbuf_free(&o);
+	free(spans);
+	return ret;
+}
+
+/* select columns from the given file, writing the result to out_fd;
+ * if the file is a regular file, it is processed in parallel with
+ * nthreads threads, otherwise (e.g. a pipe) it is read sequentially;
+ * if fn is NULL, stdin is read
+ * parameters are taken from r, which is also used to return errors
+ * returns 0 on success, 1 on error */
+static int read_table_cut(const char* fn, read_table* r, const read_table_cut_spec* spec,
+		unsigned int nthreads, int out_fd) {
+	struct stat st;
+	int ret;
+	if(!(r && spec)) return 1;
+	if(fn && !stat(fn, &st) && S_ISREG(st.st_mode)) {
+		read_table_cut_data d;
+		if(!nthreads) nthreads = read_table_default_nthreads();
+		d.spec = spec;
+		d.spans = (size_t*)malloc(2 * (spec->nfields ? spec->nfields : 1) * nthreads * sizeof(size_t));
+		if(!d.spans) return 1;
+		ret = read_table_parallel_write(fn, r, nthreads, read_table_cut_cb, &d, out_fd);
+		free(d.spans);
+		return ret;
+	}
+	/* read sequentially (e.g. from a pipe) */
+	read_table r2;
+	if(read_table_seq_open(fn, r, &r2)) return 1;
+	ret = read_table_cut_stream(&r2, spec, out_fd);
+	read_table_seq_close(r, &r2);
+	return ret;
+}
+
+
+/* validating a file against a schema, without storing the values */
+
+/* number of possible error codes */
+#define READ_TABLE_NERRORS ((size_t)T_MEMORY + 1)
+
+/* location of one error */
+typedef struct read_table_error_loc_s {
+	uint64_t line;
+	size_t pos;
+	size_t col;
+	enum read_table_errors err;
+} read_table_error_loc;
+
+/* summary of the errors found in a file */
+typedef struct read_table_validate_report_s {
+	uint64_t lines; /* number of (nonempty) lines checked */
+	uint64_t nerrors[READ_TABLE_NERRORS]; /* number of lines with each type of error */
+	read_table_error_loc* first; /* locations of the first errors, ordered by line
+		(allocated by the caller, with space for max_first elements) */
+	size_t nfirst; /* number of elements stored in first */
+	size_t max_first; /* maximum number of errors to store */
+} read_table_validate_report;
+
+/* set up a report; first should have space for max_first elements */
+static void read_table_validate_report_init(read_table_validate_report* rep,
+		read_table_error_loc* first, size_t max_first) {
+	size_t i;
+	rep->lines = 0;
+	for(i = 0; i < READ_TABLE_NERRORS; i++) rep->nerrors[i] = 0;
+	rep->first = first;
+	rep->nfirst = 0;
+	rep->max_first = first ? max_first : 0;
+}
+
+/* store the location of an error if it is among the first max_first ones */
+static void read_table_validate_report_add_loc(read_table_validate_report* rep, const read_table_error_loc* loc) {
+	size_t i;
+	if(!rep->max_first) return;
+	if(rep->nfirst == rep->max_first) {
+		if(loc->line >= rep->first[rep->nfirst - 1].line) return;
+		rep->nfirst--; /* last one is dropped */
+	}
+	/* insert keeping the order of lines */
+	for(i = rep->nfirst; i > 0 && rep->first[i - 1].line > loc->line; i--)
+		rep->first[i] = rep->first[i - 1];
+	rep->first[i] = *loc;
+	rep->nfirst++;
+}
+
+/* add one error to the report */
+static void read_table_validate_report_add(read_table_validate_report* rep, const read_table_error_loc* loc) {
+	if((size_t)loc->err < READ_TABLE_NERRORS) rep->nerrors[loc->err]++;
+	read_table_validate_report_add_loc(rep, loc);
+}
+
+/* write a summary of the report to the given stream */
+static void read_table_validate_report_write(const read_table_validate_report* rep,
+		const char* fn, FILE* f) {
+	size_t i;
+	fprintf(f, "read_table, %s%s: %lu lines checked\n", fn ? "file " : "input", fn ? fn : "", rep->lines);
+	for(i = 1; i < READ_TABLE_NERRORS; i++) if(rep->nerrors[i])
+		fprintf(f, "%s: %lu\n", get_error_desc((enum read_table_errors)i), rep->nerrors[i]);
+	for(i = 0; i < rep->nfirst; i++)
+		fprintf(f, "line %lu, position %lu / column %lu: %s\n", rep->first[i].line,
+			rep->first[i].pos, rep->first[i].col, get_error_desc(rep->first[i].err));
+}
+
+/* schema and per-thread reports used when validating in parallel */
+typedef struct read_table_validate_data_s {
+	const read_table_col* cols;
+	size_t ncols;
+	int allow_extra; /* whether lines can contain more fields than ncols */
+	read_table_validate_report* reps; /* one for each thread */
+} read_table_validate_data;
+
+static int read_table_validate_cb(read_table* r, void* user_data, unsigned int thread_id) {
+	read_table_validate_data* d = (read_table_validate_data*)user_data;
+	read_table_validate_report* rep = d->reps + thread_id;
+	read_table_value val;
+	size_t i;
+	rep->lines++;
+	for(i = 0; i < d->ncols; i++) if(read_table_read_col(r, d->cols + i, &val)) break;
+	if(i == d->ncols && (d->allow_extra || !read_table_check_end(r))) return 0;
+	read_table_error_loc loc;
+	loc.line = r->line;
+	loc.pos = r->pos;
+	loc.col = r->col;
+	loc.err = r->last_error;
+	read_table_validate_report_add(rep, &loc);
+	return 0; /* continue with the next line */
+}
+
+/* check that all lines in the file conform to the given schema (list of
+ * column types and bounds); values are converted, but not stored; if
+ * allow_extra is zero, lines with more than ncols fields are considered
+ * errors; the file is processed in parallel with nthreads threads
+ * parameters are taken from r, errors are summarized in rep
+ * returns 0 if there were no errors, 1 if there were errors in the file
+ * or it could not be read (in the latter case, r->last_error is set) */
+static int read_table_validate(const char* fn, read_table* r, const read_table_col* cols,
+		size_t ncols, int allow_extra, unsigned int nthreads, read_table_validate_report* rep) {
+	read_table_validate_data d;
+	size_t i, j;
+	int ret;
+	if(!(r && rep)) return 1;
+	if(!nthreads) nthreads = read_table_default_nthreads();
+	d.cols = cols;
+	d.ncols = ncols;
+	d.allow_extra = allow_extra;
+	d.reps = (read_table_validate_report*)malloc(nthreads * sizeof(read_table_validate_report));
+	read_table_error_loc* first = (read_table_error_loc*)malloc(nthreads * (rep->max_first + 1) * sizeof(read_table_error_loc));
+	if(!(d.reps && first)) {
+		if(d.reps) free(d.reps);
+		if(first) free(first);
+		r->last_error = T_MEMORY;
+		return 1;
+	}
+	for(i = 0; i < nthreads; i++)
+		read_table_validate_report_init(d.reps + i, first + i * (rep->max_first + 1), rep->max_first);
+
+	ret = read_table_parallel(fn, r, nthreads, read_table_validate_cb, &d);
+
+	/* merge the reports of the threads */
+	for(i = 0; i < nthreads; i++) {
+		rep->lines += d.reps[i].lines;
+		for(j = 0; j < d.reps[i].nfirst; j++) read_table_validate_report_add_loc(rep, d.reps[i].first + j);
+		for(j = 0; j < READ_TABLE_NERRORS; j++) rep->nerrors[j] += d.reps[i].nerrors[j];
+	}
+	free(first);
+	free(d.reps);
+	if(ret) return 1;
+	for(j = 1; j < READ_TABLE_NERRORS; j++) if(rep->nerrors[j]) return 1;
+	return 0;
+}
+
+#endif /* READ_TABLE_PARALLEL_H */
+
@@ -0,0 +1,172 @@
+/*
+ * read_table_parallel_bench.c -- effect of scheduling chunks based on the
+ * 	page cache in read_table_parallel.h on partially cached files
+ *
+ * usage: read_table_parallel_bench -i input [-t nthreads] [-C chunk_size]
+ * 	[-e fraction] [-b block_size] [-n repeats] [-s seed]
+ *
+ * before each run, random blocks of the input (of block_size bytes,
+ * default 16 MiB) are removed from the page cache (with posix_fadvise()),
+ * so that approximately the given fraction (default 0.5) of the file has
+ * to be read from the disk; then the file is processed in parallel, both
+ * with and without scheduling, counting the lines and the sum of the
+ * numbers at the beginning of each line
+ * note: the input needs to be on a disk (not e.g. tmpfs), and the times
+ * depend on what else is running on the machine
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "read_table_parallel.h"
+
+
+/* per-thread results: number of lines and sum of values read */
+typedef struct {
+	uint64_t n;
+	double sum;
+} thread_data;
+
+static int count_cb(read_table* r, void* user_data, unsigned int thread_id) {
+	thread_data* d = (thread_data*)user_data;
+	double x;
+	if(read_table_double(r,&x)) return 1;
+	d[thread_id].n++;
+	d[thread_id].sum += x;
+	return 0;
+}
+
+static double get_time(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* remove random blocks of the file from the page cache */
+static int evict_blocks(const char* fn, double fraction, size_t block_size, unsigned int* seed) {
+	struct stat st;
+	off_t pos;
+	int fd = open(fn, O_RDONLY);
+	if(fd < 0) return 1;
+	if(fstat(fd, &st)) { close(fd); return 1; }
+	/* note: read the whole file first, so that the result does not depend on the previous run */
+	posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+	{
+		char* buf = (char*)malloc(block_size);
+		if(buf) {
+			while(read(fd, buf, block_size) > 0);
+			free(buf);
+		}
+	}
+	fdatasync(fd); /* note: pages not written to the disk yet cannot be removed */
+	for(pos = 0; pos < st.st_size; pos += block_size)
+		if(rand_r(seed) < fraction * ((double)RAND_MAX + 1.0))
+			posix_fadvise(fd, pos, block_size, POSIX_FADV_DONTNEED);
+	close(fd);
+	return 0;
+}
+
+static double cached_fraction(const char* fn) {
+	read_table_mapped m;
+	double res;
+	if(read_table_map_file(&m, fn)) return -1.0;
+	res = read_table_cached_fraction(m.data, m.size);
+	read_table_unmap_file(&m);
+	return res;
+}
+
+
+int main(int argc, char **argv)
+{
+	char* fn = 0;
+	int i, j;
+	unsigned int nthreads = 0;
+	size_t chunk_size = 0;
+	size_t block_size = 16UL*1024UL*1024UL;
+	double fraction = 0.5;
+	int repeats = 3;
+	unsigned int seed = 1;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'i':
+			fn = argv[i+1];
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'C':
+			chunk_size = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'b':
+			block_size = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'e':
+			fraction = atof(argv[i+1]);
+			i++;
+			break;
+		case 'n':
+			repeats = atoi(argv[i+1]);
+			i++;
+			break;
+		case 's':
+			seed = atoi(argv[i+1]);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	if(!fn) {
+		fprintf(stderr,"No input file given!\n");
+		return 1;
+	}
+	if(!nthreads) nthreads = read_table_default_nthreads();
+	if(!block_size) block_size = 1;
+	thread_data* d = (thread_data*)malloc(nthreads * sizeof(thread_data));
+	if(!d) return 1;
+
+	double total[2] = {0.0, 0.0};
+	for(j = 0; j < repeats; j++) for(i = 0; i < 2; i++) {
+		/* note: use the same blocks for both cases */
+		unsigned int seed2 = seed + j;
+		read_table r;
+		double t1, t2, c;
+		int k;
+		read_table_init(&r, 0);
+		if(evict_blocks(fn, fraction, block_size, &seed2)) {
+			fprintf(stderr,"Error opening file %s!\n",fn);
+			free(d);
+			return 1;
+		}
+		c = cached_fraction(fn);
+		memset(d, 0, nthreads * sizeof(thread_data));
+		t1 = get_time();
+		if(read_table_parallel_ex(fn, &r, nthreads, count_cb, d, chunk_size, i)) {
+			read_table_write_error(&r, stderr);
+			free(d);
+			return 1;
+		}
+		t2 = get_time();
+		total[i] += t2 - t1;
+		uint64_t n = 0;
+		double sum = 0.0;
+		for(k = 0; k < (int)nthreads; k++) {
+			n += d[k].n;
+			sum += d[k].sum;
+		}
+		fprintf(stdout,"%s: %.1f%% cached, %f s, %lu lines, sum: %f\n",
+			i ? "scheduled" : "in order", 100.0 * c, t2 - t1, n, sum);
+	}
+	if(repeats > 0) fprintf(stdout,"average time: in order: %f s, scheduled: %f s\n",
+		total[0] / repeats, total[1] / repeats);
+	free(d);
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * read_table_parallel_test.c -- simple test cases for read_table_parallel.h
+ *
+ * only a few "manual" test cases; input is read from the given file
+ * (needs to be a regular file, so that it can be mapped)
+ * with -p, the number of threads and chunk size is chosen with
+ * read_table_plan.h, and the plan is written to stderr (-o is ignored)
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "read_table_plan.h"
+
+
+/* per-thread results: number of lines and sum of values read */
+typedef struct {
+	uint64_t n;
+	double sum;
+} thread_data;
+
+/* 1. unsigned integer between [1,1000], coordinates */
+int test1(read_table* r, void* user_data, unsigned int thread_id) {
+	thread_data* d = (thread_data*)user_data;
+	unsigned int x;
+	double y1;
+	double y2;
+	if( read_table_uint32_limits(r,&x,1U,1000U) ||
+		read_table_double_limits(r,&y1,-180.0,180.0) ||
+		read_table_double_limits(r,&y2,-90.0,90.0) ) return 1;
+	d[thread_id].n++;
+	d[thread_id].sum += x + y1 + y2;
+	return 0;
+}
+
+/* 2. signed integer, skip, uint64_t, skip, uint16_t, double */
+int test2(read_table* r, void* user_data, unsigned int thread_id) {
+	thread_data* d = (thread_data*)user_data;
+	int x; uint64_t y; uint16_t z; double dd;
+	if( read_table_int32(r,&x) || read_table_skip(r) ||
+		read_table_uint64(r,&y) || read_table_skip(r) ||
+		read_table_uint16(r,&z) || read_table_double(r,&dd) ) return 1;
+	d[thread_id].n++;
+	d[thread_id].sum += x + (double)y + z + dd;
+	return 0;
+}
+
+read_table_parallel_cb func[] = { test1, test2 };
+
+/* output for test 1: write the values read, separated by the same
+ * delimiter as the input */
+int test1_write(read_table* r, read_table_outbuf* out, void* user_data, unsigned int thread_id) {
+	if(test1(r, user_data, thread_id)) return 1;
+	/* re-read the line to write out the values */
+	unsigned int x;
+	double y1;
+	double y2;
+	read_table_reset_pos(r);
+	if( read_table_uint32(r,&x) || read_table_double(r,&y1) || read_table_double(r,&y2) ) return 1;
+	return read_table_out_uint64(out,x) || read_table_out_delim(out,r) ||
+		read_table_out_double(out,y1,10) || read_table_out_delim(out,r) ||
+		read_table_out_double(out,y2,10) || read_table_out_newline(out);
+}
+
+/* output for test 2: copy lines */
+int test2_write(read_table* r, read_table_outbuf* out, void* user_data, unsigned int thread_id) {
+	if(test2(r, user_data, thread_id)) return 1;
+	return read_table_out_line(out,r);
+}
+
+read_table_parallel_write_cb func_write[] = { test1_write, test2_write };
+
+/* schema for each test case (used for planning) */
+read_table_col cols1[] = { {RT_UINT32, 0, {0}, {0}}, {RT_DOUBLE, 0, {0}, {0}}, {RT_DOUBLE, 0, {0}, {0}} };
+read_table_col cols2[] = { {RT_INT32, 0, {0}, {0}}, {RT_SKIP, 0, {0}, {0}}, {RT_UINT64, 0, {0}, {0}},
+	{RT_SKIP, 0, {0}, {0}}, {RT_UINT16, 0, {0}, {0}}, {RT_DOUBLE, 0, {0}, {0}} };
+read_table_col* cols[] = { cols1, cols2 };
+size_t ncols[] = { 3, 6 };
+
+
+int main(int argc, char **argv)
+{
+	int testcase = 0;
+	char* fn = 0;
+	int i;
+	char delim = 0;
+	char comment = 0;
+	unsigned int nthreads = 0;
+	int write_output = 0;
+	int use_plan = 0;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'i':
+			fn = argv[i+1];
+			i++;
+			break;
+		case 'o':
+			write_output = 1;
+			break;
+		case 'p':
+			use_plan = 1;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'd':
+			delim = argv[i+1][0];
+			i++;
+			break;
+		case 'c':
+			comment = argv[i+1][0];
+			i++;
+			break;
+		default:
+			if(isdigit(argv[i][1])) {
+				testcase = atoi(argv[i]+1);
+				if(testcase >= 2) testcase = 0;
+				break;
+			}
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	if(!fn) {
+		fprintf(stderr,"No input file given!\n");
+		return 1;
+	}
+	read_table r;
+	read_table_init(&r, 0);
+	if(delim) read_table_set_delim(&r,delim);
+	if(comment) read_table_set_comment(&r,comment);
+
+	read_table_plan plan;
+	if(use_plan) {
+		/* choose the number of threads and chunk size */
+		if(read_table_plan_init(&plan, fn, &r, cols[testcase], ncols[testcase], nthreads)) {
+			read_table_write_error(&r,stderr);
+			return 1;
+		}
+		nthreads = plan.nthreads;
+	}
+	if(!nthreads) nthreads = read_table_default_nthreads();
+	thread_data* d = (thread_data*)calloc(nthreads, sizeof(thread_data));
+	if(!d) return 1;
+
+	int ret;
+	if(use_plan) {
+		ret = read_table_plan_run(&plan, fn, &r, func[testcase], d);
+		read_table_plan_write(&plan, stderr);
+	}
+	else if(write_output) ret = read_table_parallel_write(fn, &r, nthreads, func_write[testcase], d, STDOUT_FILENO);
+	else ret = read_table_parallel(fn, &r, nthreads, func[testcase], d);
+	if(ret) read_table_write_error(&r,stderr);
+
+	uint64_t n = 0;
+	double sum = 0.0;
+	for(i=0;i<(int)nthreads;i++) {
+		n += d[i].n;
+		sum += d[i].sum;
+	}
+	fprintf(write_output ? stderr : stdout,"Read %lu lines, sum: %f\n",n,sum);
+	free(d);
+
+	return ret;
+}
+
@@ -0,0 +1,294 @@
+/*  -*- C -*-
+ * read_table_plan.h -- choosing how to read a file (sequentially or in
+ * 	parallel, number of threads, chunk and buffer sizes) based on the
+ * 	input and the expected cost of parsing it
+ *
+ * The plan is made by looking at the type and size of the input, the
+ * fraction of the file already in the page cache, the number of
+ * processors, and the parsing speed measured on a sample at the start
+ * of the file with the given schema (so wide or expensive schemas are
+ * taken into account). The plan is stored in a struct which can be
+ * inspected, modified or printed before running it; after running, the
+ * measured throughput is stored as well, and the chunk size and number
+ * of threads are adjusted based on it (useful if the plan is reused for
+ * similar files, e.g. if using more threads did not result in a speedup,
+ * less threads are used next time).
+ *
+ * Note: this requires linking with -pthread (see read_table_parallel.h)
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+read_table_col cols[3] = ... // types of the columns (see read_table_read_col())
+read_table r;
+read_table_init(&r, 0); // r is only used for parameters and to return errors
+read_table_plan plan;
+read_table_plan_init(&plan, fn, &r, cols, 3, 0); // fn can be NULL for stdin
+if(read_table_plan_run(&plan, fn, &r, process_line, user_data)) // same callback as for read_table_parallel()
+	read_table_write_error(&r, stderr);
+read_table_plan_write(&plan, stderr);
+
+ */
+
+#ifndef READ_TABLE_PLAN_H
+#define READ_TABLE_PLAN_H
+
+#include "read_table_parallel.h"
+#include <time.h>
+
+/* files smaller than this are always read sequentially */
+#ifndef READ_TABLE_PLAN_MIN_PARALLEL
+#define READ_TABLE_PLAN_MIN_PARALLEL (1024UL*1024UL)
+#endif
+/* size of the sample used to measure parsing speed */
+#ifndef READ_TABLE_PLAN_SAMPLE_SIZE
+#define READ_TABLE_PLAN_SAMPLE_SIZE (1024UL*1024UL)
+#endif
+/* target time to process one chunk (in seconds) -- chunks should be
+ * small enough for balancing the load among threads, but large enough
+ * so that the overhead of each chunk is negligible */
+#ifndef READ_TABLE_PLAN_CHUNK_TIME
+#define READ_TABLE_PLAN_CHUNK_TIME 0.02
+#endif
+/* minimum amount of work (in seconds) for each thread */
+#ifndef READ_TABLE_PLAN_THREAD_TIME
+#define READ_TABLE_PLAN_THREAD_TIME 0.05
+#endif
+/* maximum number of threads used if most of the file is not cached
+ * (reading is limited by the disk in this case) */
+#ifndef READ_TABLE_PLAN_COLD_THREADS
+#define READ_TABLE_PLAN_COLD_THREADS 4
+#endif
+/* buffer size used when reading sequentially */
+#ifndef READ_TABLE_PLAN_STREAM_BUFFER
+#define READ_TABLE_PLAN_STREAM_BUFFER (1024UL*1024UL)
+#endif
+
+/* possible ways of reading */
+enum read_table_plan_mode {RT_PLAN_STREAM = 0, RT_PLAN_PARALLEL};
+
+typedef struct read_table_plan_s {
+	enum read_table_plan_mode mode;
+	unsigned int nthreads; /* number of threads to use */
+	unsigned int max_threads; /* upper limit on the previous (number of processors by default) */
+	size_t chunk_size; /* size of chunks if reading in parallel */
+	size_t buffer_size; /* buffer size if reading sequentially */
+	uint64_t file_size; /* size of the input (0 if not a regular file) */
+	double cached; /* fraction of the file in the page cache (-1 if not known) */
+	double rate; /* parsing speed for one thread (bytes / second, 0 if not known) */
+	/* results of the last run */
+	uint64_t bytes; /* number of bytes processed */
+	double elapsed; /* time taken (seconds) */
+} read_table_plan;
+
+
+/* current time for measuring elapsed time (seconds) */
+static double read_table_plan_time(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+/* measure the time to parse the beginning of the mapped file (at most
+ * sample_size bytes, ending at a line boundary) with the given schema
+ * (parameters are copied from params); errors are ignored here
+ * returns the number of bytes processed per second (0 on error) */
+static double read_table_plan_sample(const read_table_mapped* m, const read_table* params,
+		const read_table_col* cols, size_t ncols, size_t sample_size) {
+	read_table r = *params;
+	read_table_value val;
+	size_t len = m->size;
+	size_t i;
+	double t1, t2;
+	if(!(m->data && m->size)) return 0.0;
+	if(len > sample_size) {
+		const char* nl = (const char*)memchr(m->data + sample_size - 1, '\n', m->size - sample_size + 1);
+		len = nl ? (size_t)(nl - m->data) + 1 : m->size;
+	}
+	read_table_reset_buf(&r);
+	r.flags &= ~READ_TABLE_CLOSE_FILE;
+	r.line = 0;
+	r.last_error = T_OK;
+	r.f = fmemopen((void*)(m->data), len, "r");
+	if(!r.f) return 0.0;
+	t1 = read_table_plan_time();
+	while(read_table_line(&r) == 0) {
+		for(i = 0; i < ncols; i++) if(read_table_read_col(&r, cols + i, &val)) break;
+		if(!ncols) while(read_table_skip(&r) == 0);
+	}
+	t2 = read_table_plan_time();
+	fclose(r.f);
+	read_table_free_buf(&r);
+	if(t2 <= t1) t2 = t1 + 1e-6;
+	return len / (t2 - t1);
+}
+
+/* choose the number of threads and chunk size from the file size and
+ * the parsing speed stored in plan */
+static void read_table_plan_tune(read_table_plan* plan) {
+	double total, chunk;
+	unsigned int n;
+	if(!(plan->file_size >= READ_TABLE_PLAN_MIN_PARALLEL && plan->rate > 0.0 && plan->max_threads > 1)) {
+		plan->mode = RT_PLAN_STREAM;
+		plan->nthreads = 1;
+		return;
+	}
+	/* expected time on one thread */
+	total = plan->file_size / plan->rate;
+	n = plan->max_threads;
+	if(total / n < READ_TABLE_PLAN_THREAD_TIME) n = (unsigned int)(total / READ_TABLE_PLAN_THREAD_TIME) + 1;
+	if(plan->cached >= 0.0 && plan->cached < 0.5 && n > READ_TABLE_PLAN_COLD_THREADS) n = READ_TABLE_PLAN_COLD_THREADS;
+	if(n > plan->max_threads) n = plan->max_threads;
+	if(n < 2) {
+		plan->mode = RT_PLAN_STREAM;
+		plan->nthreads = 1;
+		return;
+	}
+	plan->mode = RT_PLAN_PARALLEL;
+	plan->nthreads = n;
+	/* chunk size based on the target time, but at least 4 chunks per thread */
+	chunk = plan->rate * READ_TABLE_PLAN_CHUNK_TIME;
+	if(chunk > 64.0 * 1024.0 * 1024.0) chunk = 64.0 * 1024.0 * 1024.0;
+	if(chunk < 256.0 * 1024.0) chunk = 256.0 * 1024.0;
+	if(chunk > plan->file_size / (4.0 * n)) chunk = plan->file_size / (4.0 * n);
+	if(chunk < 64.0 * 1024.0) chunk = 64.0 * 1024.0;
+	plan->chunk_size = (size_t)chunk;
+}
+
+/* create a plan for reading the given file (or stdin if fn is NULL)
+ * with the parameters in r and the given schema (which is used to
+ * measure parsing speed; if cols is NULL, only splitting the lines into
+ * fields is measured); max_threads is the maximum number of threads to
+ * use (0: number of processors)
+ * returns 0 on success, 1 if the file cannot be opened (r->last_error
+ * is set to T_ERROR_FOPEN) */
+static int read_table_plan_init(read_table_plan* plan, const char* fn, read_table* r,
+		const read_table_col* cols, size_t ncols, unsigned int max_threads) {
+	struct stat st;
+	read_table_mapped m;
+	plan->mode = RT_PLAN_STREAM;
+	plan->nthreads = 1;
+	plan->max_threads = max_threads ? max_threads : read_table_default_nthreads();
+	plan->chunk_size = READ_TABLE_CHUNK_SIZE;
+	plan->buffer_size = READ_TABLE_PLAN_STREAM_BUFFER;
+	plan->file_size = 0;
+	plan->cached = -1.0;
+	plan->rate = 0.0;
+	plan->bytes = 0;
+	plan->elapsed = 0.0;
+	if(!cols) ncols = 0;
+	if(!fn) return 0; /* stdin: always read sequentially */
+	if(stat(fn, &st)) {
+		r->last_error = T_ERROR_FOPEN;
+		return 1;
+	}
+	if(!S_ISREG(st.st_mode)) return 0; /* pipe, device, etc. */
+	plan->file_size = st.st_size;
+	if(plan->file_size < READ_TABLE_PLAN_MIN_PARALLEL) {
+		/* small file: no need for a large buffer either */
+		if(plan->file_size < plan->buffer_size) plan->buffer_size = plan->file_size ? plan->file_size : BUFSIZ;
+		return 0;
+	}
+	if(read_table_map_file(&m, fn)) return 0; /* fall back to reading sequentially */
+	/* note: check the page cache before reading the sample */
+	plan->cached = read_table_cached_fraction(m.data, m.size);
+	plan->rate = read_table_plan_sample(&m, r, cols, ncols, READ_TABLE_PLAN_SAMPLE_SIZE);
+	read_table_unmap_file(&m);
+	read_table_plan_tune(plan);
+	return 0;
+}
+
+/* read sequentially, calling cb for each line (with thread_id == 0) */
+static int read_table_plan_stream(read_table_plan* plan, const char* fn, read_table* r,
+		read_table_parallel_cb cb, void* user_data) {
+	read_table r2;
+	int ret = 0;
+	if(read_table_seq_open(fn, r, &r2)) return 1;
+	if(plan->buffer_size) setvbuf(r2.f, 0, _IOFBF, plan->buffer_size);
+	while(read_table_line(&r2) == 0) {
+		plan->bytes += r2.line_len;
+		if(cb(&r2, user_data, 0)) { ret = 1; break; }
+	}
+	if(r2.last_error != T_EOF) ret = 1;
+	read_table_seq_close(r, &r2);
+	return ret;
+}
+
+/* process the input according to the plan, calling cb for each line
+ * (see read_table_parallel() for the callback and return value); the
+ * bytes processed and time taken are stored in plan, and its parameters
+ * are updated based on the measured speed */
+static int read_table_plan_run(read_table_plan* plan, const char* fn, read_table* r,
+		read_table_parallel_cb cb, void* user_data) {
+	double t1, t2;
+	int ret;
+	if(!(plan && r && cb)) return 1;
+	plan->bytes = 0;
+	t1 = read_table_plan_time();
+	if(plan->mode == RT_PLAN_PARALLEL) {
+		ret = read_table_parallel_ex(fn, r, plan->nthreads, cb, user_data,
+			plan->chunk_size, READ_TABLE_PARALLEL_SCHEDULE);
+		if(!ret) plan->bytes = plan->file_size;
+	}
+	else ret = read_table_plan_stream(plan, fn, r, cb, user_data);
+	t2 = read_table_plan_time();
+	plan->elapsed = t2 - t1;
+	if(!ret && plan->bytes && plan->elapsed > 0.0) {
+		double speed = plan->bytes / plan->elapsed;
+		if(plan->mode == RT_PLAN_PARALLEL && plan->rate > 0.0 &&
+				speed < 0.75 * plan->rate * plan->nthreads) {
+			/* threads did not scale as expected (e.g. limited by the disk
+			 * or by other processes), use less threads next time */
+			unsigned int n = (unsigned int)(1.25 * speed / plan->rate) + 1;
+			if(n < plan->max_threads) plan->max_threads = n;
+		}
+		else plan->rate = speed / plan->nthreads;
+		read_table_plan_tune(plan);
+	}
+	return ret;
+}
+
+/* write a description of the plan (and the result of the last run) */
+static void read_table_plan_write(const read_table_plan* plan, FILE* f) {
+	if(!(plan && f)) return;
+	if(plan->mode == RT_PLAN_PARALLEL)
+		fprintf(f, "plan: parallel, %u threads, chunk size: %lu", plan->nthreads, plan->chunk_size);
+	else fprintf(f, "plan: sequential, buffer size: %lu", plan->buffer_size);
+	if(plan->file_size) fprintf(f, ", file size: %lu", plan->file_size);
+	if(plan->cached >= 0.0) fprintf(f, ", cached: %.1f%%", 100.0 * plan->cached);
+	if(plan->rate > 0.0) fprintf(f, ", speed per thread: %.1f MB/s", plan->rate / 1e6);
+	fprintf(f, "\n");
+	if(plan->elapsed > 0.0) fprintf(f, "last run: %lu bytes in %.3f s (%.1f MB/s)\n",
+		plan->bytes, plan->elapsed, plan->bytes / plan->elapsed / 1e6);
+}
+
+#endif /* READ_TABLE_PLAN_H */
+
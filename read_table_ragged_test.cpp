@@ -0,0 +1,129 @@
+/*
+ * read_table_ragged_test.cpp -- simple test cases for reading rows with
+ * 	a variable number of values into a ragged_array, with rest_of_line()
+ * 	in read_table_cpp.h and table_loader::rest_column() in read_table_bulk.h
+ *
+ * usage: read_table_ragged_test [-n rows]
+ *
+ * inputs with empty remainders, trailing blanks and delimiters, comments,
+ * bounds and invalid values are read both ways, and the results (rows
+ * or error positions) are compared to the expected ones; a generated
+ * ragged input of the given number of rows (default: 1000) is also read
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include "read_table_bulk.h"
+
+
+/* compare the contents of a ragged_array to the expected rows */
+static bool same_rows(const ragged_array<uint32_t>& arr, const std::vector<std::vector<uint32_t> >& rows) {
+	if(arr.nrows() != rows.size() || arr.offsets.size() != rows.size() + 1 ||
+		arr.values.size() != arr.offsets.back()) return false;
+	for(size_t i = 0; i < rows.size(); i++) {
+		if(arr.row_size(i) != rows[i].size()) return false;
+		for(size_t j = 0; j < rows[i].size(); j++) if(arr.row(i)[j] != rows[i][j]) return false;
+	}
+	return true;
+}
+
+/* read lines of "id values ..." both with rest_of_line() and with
+ * table_loader::rest_column(); rows are the expected result (rows
+ * before the error in case of an error), err the expected error, and
+ * line, pos, col the expected position of the error */
+static bool test_input(const char* input, char delim, const std::vector<std::vector<uint32_t> >& rows,
+		enum read_table_errors err, uint64_t line, size_t pos, size_t col, const char* desc) {
+	line_parser_params par;
+	par.set_comment('#');
+	if(delim) par.set_delim(delim);
+	bool ret = true;
+	{
+		std::istringstream is(input);
+		read_table2 r(is, par);
+		ragged_array<uint32_t> arr;
+		uint32_t id;
+		while(r.read_line()) if(!r.read(id, rest_of_line(arr, 0U, 1000U))) break;
+		bool ok = same_rows(arr, rows);
+		if(err == T_OK) ok = ok && (r.get_last_error() == T_EOF);
+		else ok = ok && (r.get_last_error() == err && r.get_line() == line && r.get_pos() == pos && r.get_col() == col);
+		if(!ok) {
+			fprintf(stderr,"%s (rest_of_line): ", desc);
+			r.write_error(stderr);
+			ret = false;
+		}
+	}
+	{
+		std::istringstream is(input);
+		read_table2 r(is, par);
+		table_loader t;
+		ragged_array<uint32_t> arr;
+		bool ok = t.load(r, 1) && t.rest_column(arr, 0U, 1000U) == (err == T_OK) && same_rows(arr, rows);
+		if(ok && err != T_OK) {
+			const column_error& e = t.get_error();
+			ok = (e.err == err && e.line == line && e.pos == pos && e.col == col);
+		}
+		if(!ok) {
+			fprintf(stderr,"%s (rest_column): ", desc);
+			t.write_error(std::cerr);
+			ret = false;
+		}
+	}
+	return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t nrows = 1000;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nrows = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	bool ret = true;
+
+	/* 1. valid inputs: empty remainders give empty rows */
+	ret = test_input("1 2 3\n4\n5 6  \n7\t8 # comment\n\n9   \n", 0,
+		{{2, 3}, {}, {6}, {8}, {}}, T_OK, 0, 0, 0, "blanks") && ret;
+	ret = test_input("1,2,3\n4\n5, 6 \n7,8#comment\n", ',',
+		{{2, 3}, {}, {6}, {8}}, T_OK, 0, 0, 0, "delimiter") && ret;
+	ret = test_input("1\t2\t3\n4\n", '\t', {{2, 3}, {}}, T_OK, 0, 0, 0, "tab delimiter") && ret;
+
+	/* 2. empty fields are errors, also at the end of the line */
+	ret = test_input("1,2,3\n4,\n", ',', {{2, 3}}, T_MISSING, 2, 2, 1, "trailing delimiter, empty remainder") && ret;
+	ret = test_input("1,2,3\n4,5, \n", ',', {{2, 3}}, T_MISSING, 2, 5, 2, "trailing delimiter") && ret;
+	ret = test_input("1,2,,3\n", ',', {}, T_MISSING, 1, 4, 2, "empty field") && ret;
+	ret = test_input("1\t2\t\n", '\t', {}, T_MISSING, 1, 4, 2, "trailing tab delimiter") && ret;
+
+	/* 3. invalid values and bounds */
+	ret = test_input("1 2 3\n2 3 x 4\n", 0, {{2, 3}}, T_FORMAT, 2, 4, 2, "invalid value") && ret;
+	ret = test_input("1 2 3\n2 3 1001\n", 0, {{2, 3}}, T_OVERFLOW, 2, 8, 2, "value out of bounds") && ret;
+
+	/* 4. many rows of different length */
+	{
+		std::string input;
+		std::vector<std::vector<uint32_t> > rows(nrows);
+		for(size_t j = 0; j < nrows; j++) {
+			input += std::to_string(j);
+			for(size_t k = 0; k < j % 7; k++) {
+				rows[j].push_back((j + k) % 1000);
+				input += ' ' + std::to_string(rows[j].back());
+			}
+			input += (j % 3) ? "\n" : " \n";
+		}
+		ret = test_input(input.c_str(), 0, rows, T_OK, 0, 0, 0, "generated input") && ret;
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
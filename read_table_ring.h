@@ -0,0 +1,591 @@
+/*  -*- C -*-
+ * read_table_ring.h -- single producer / single consumer ring buffer in
+ * 	shared memory for passing text data between processes on the same host
+ *
+ * A producer process writes lines (e.g. formatted rows) into a ring
+ * buffer in shared memory (a file in /dev/shm or an anonymous memory
+ * file inherited by a child process), from where the consumer can parse
+ * them directly, without the system calls and copies of a pipe. The data
+ * area is mapped twice after each other, so any range in the ring is
+ * contiguous in memory, even if it wraps around the end. Each side only
+ * sleeps (on a futex) if the ring is empty or full, and the other side
+ * only makes a system call to wake it up in this case, after a larger
+ * amount of data was written or read (so the processes do not switch
+ * after each line). If the other process exits without detaching, this
+ * is detected after a timeout.
+ *
+ * This file contains the producer side (which is a small C library that
+ * does not depend on the rest of read_table) and the low-level functions
+ * for the consumer; ring_reader in read_table_ring_reader.h reads lines
+ * from a ring with the same interface as read_table2.
+ *
+ * Linux only (uses futexes and memfd_create()).
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+// consumer (e.g. with ring_reader in read_table_ring_reader.h, or directly)
+read_table_ring q;
+if(read_table_ring_create(&q, "rows", 0, READ_TABLE_RING_CONSUMER)) ... // handle error (errno is set)
+... // start the producer (or pass q.fd to a child process if created with name == NULL)
+const char* data;
+size_t len, have = 0;
+while(read_table_ring_wait(&q, have) == 0) {
+	len = read_table_ring_available(&q, &data);
+	... // process complete lines in data (the last line might be partial)
+	read_table_ring_consume(&q, len_processed);
+	have = len - len_processed; // wait for more than the partial line next time
+}
+if(errno) ... // producer exited without calling read_table_ring_finish()
+read_table_ring_close(&q);
+read_table_ring_remove("rows");
+
+// producer (in a different process)
+read_table_ring q;
+if(read_table_ring_open(&q, "rows", READ_TABLE_RING_PRODUCER)) ... // handle error
+for(...) if(read_table_ring_printf(&q, "%u\t%s\t%f\n", id, name, value)) ... // consumer exited
+read_table_ring_flush(&q); // optionally, if there will be no new rows for some time
+read_table_ring_finish(&q);
+read_table_ring_close(&q);
+
+ */
+
+#ifndef READ_TABLE_RING_H
+#define READ_TABLE_RING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/* directory used for rings given by name */
+#ifndef READ_TABLE_RING_DIR
+#define READ_TABLE_RING_DIR "/dev/shm"
+#endif
+
+/* default size of the data area (rounded up to a power of two) */
+#ifndef READ_TABLE_RING_SIZE
+#define READ_TABLE_RING_SIZE (1024UL*1024UL)
+#endif
+
+/* amount of new data written after which a sleeping consumer is woken up
+ * (or at most half of the ring); a smaller amount is only made available
+ * immediately by read_table_ring_flush() */
+#ifndef READ_TABLE_RING_WAKE
+#define READ_TABLE_RING_WAKE (64UL*1024UL)
+#endif
+
+/* number of times to check for new data (or free space) before sleeping */
+#ifndef READ_TABLE_RING_SPIN
+#define READ_TABLE_RING_SPIN 256
+#endif
+
+/* time to sleep at once (in ms) before checking if the other process still exists */
+#ifndef READ_TABLE_RING_TIMEOUT
+#define READ_TABLE_RING_TIMEOUT 1000
+#endif
+
+#define READ_TABLE_RING_MAGIC 0x31474e4952545452ULL
+
+enum read_table_ring_role { READ_TABLE_RING_PRODUCER = 0, READ_TABLE_RING_CONSUMER = 1 };
+
+/* flags in read_table_ring_header::closed */
+#define READ_TABLE_RING_FINISHED 1U /* the producer has written everything */
+#define READ_TABLE_RING_DETACHED 2U /* the consumer stopped reading */
+
+/* header at the beginning of the shared memory, followed by the data at
+ * offset data_offset; fields written by the producer and the consumer
+ * are in separate cache lines */
+typedef struct read_table_ring_header_s {
+	uint64_t magic;
+	uint64_t capacity; /* size of the data area (power of two) */
+	uint64_t data_offset; /* start of the data (one page after the beginning) */
+	int32_t pid[2]; /* process ID of the producer and the consumer (0 if not attached) */
+	uint32_t closed; /* combination of the above flags */
+	char pad0[64 - 36];
+	/* written by the producer */
+	uint64_t head; /* total number of bytes written */
+	uint32_t head_seq; /* futex for waking up the consumer */
+	uint32_t consumer_waiting; /* set by the consumer before sleeping */
+	char pad1[64 - 16];
+	/* written by the consumer */
+	uint64_t tail; /* total number of bytes read */
+	uint32_t tail_seq; /* futex for waking up the producer */
+	uint32_t producer_waiting; /* set by the producer before sleeping */
+	char pad2[64 - 16];
+} read_table_ring_header;
+
+/* one side (producer or consumer) of a ring mapped in this process */
+typedef struct read_table_ring_s {
+	read_table_ring_header* h;
+	char* data; /* data area, mapped twice after each other, so that any
+		range of up to capacity bytes is contiguous */
+	uint64_t capacity;
+	size_t map_size;
+	int fd; /* file descriptor of the shared memory (kept open) */
+	int role;
+	uint64_t pos; /* producer: bytes written; consumer: bytes released */
+	uint64_t other; /* last known position of the other side */
+	uint64_t flushed; /* producer: position when the consumer was last woken up */
+	uint64_t wake; /* producer: amount of new data to wake up the consumer */
+	unsigned int spin; /* number of times to check before sleeping (0 with one processor) */
+} read_table_ring;
+
+
+static long read_table_ring_futex(uint32_t* addr, int op, uint32_t val, const struct timespec* ts) {
+	return syscall(SYS_futex, addr, op, val, ts, 0, 0);
+}
+
+static void read_table_ring_spin(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/* check if the process with the given ID does not exist anymore (or it
+ * exited, but was not waited for yet, e.g. a child of the other side) */
+static int read_table_ring_exited(int32_t pid) {
+	char path[64];
+	char buf[256];
+	char* p;
+	ssize_t n;
+	int fd;
+	if(pid <= 0) return 0;
+	if(kill(pid, 0) && errno == ESRCH) return 1;
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0) return 0;
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if(n <= 0) return 0;
+	buf[n] = 0;
+	/* note: the state is after the process name (in parentheses) */
+	p = strrchr(buf, ')');
+	return p && p[1] == ' ' && (p[2] == 'Z' || p[2] == 'X');
+}
+
+/* wake up the other side sleeping on seq if it indicated that it waits;
+ * note: the fence orders this after updating the position, while the
+ * other side sets waiting before checking the position again, so either
+ * it sees the new position, or waiting is seen here */
+static void read_table_ring_wake(uint32_t* waiting, uint32_t* seq, int force) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(force || __atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+		__atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+		__atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+		read_table_ring_futex(seq, FUTEX_WAKE, INT_MAX, 0);
+	}
+}
+
+/* get the full path for the given name (relative to READ_TABLE_RING_DIR
+ * unless it starts with '/'); returns 0 on success, 1 if it is too long */
+static int read_table_ring_path(char* path, size_t size, const char* name) {
+	int n = (name[0] == '/') ? snprintf(path, size, "%s", name) :
+		snprintf(path, size, "%s/%s", READ_TABLE_RING_DIR, name);
+	if(n < 0 || (size_t)n >= size) {
+		errno = ENAMETOOLONG;
+		return 1;
+	}
+	return 0;
+}
+
+/* map the ring stored in fd and attach to it with the given role (only
+ * one process can be attached with each role at a time); fd is kept open
+ * returns 0 on success, 1 on error (errno is set) */
+static int read_table_ring_open_fd(read_table_ring* q, int fd, int role) {
+	read_table_ring_header tmp;
+	struct stat st;
+	char* base;
+	int32_t pid;
+	if(!q || (role != READ_TABLE_RING_PRODUCER && role != READ_TABLE_RING_CONSUMER)) {
+		errno = EINVAL;
+		return 1;
+	}
+	q->h = 0;
+	q->data = 0;
+	if(fstat(fd, &st)) return 1;
+	if(pread(fd, &tmp, sizeof(tmp), 0) != (ssize_t)sizeof(tmp) || tmp.magic != READ_TABLE_RING_MAGIC ||
+			!tmp.capacity || (tmp.capacity & (tmp.capacity - 1)) || tmp.data_offset < sizeof(tmp) ||
+			tmp.data_offset % sysconf(_SC_PAGESIZE) || (uint64_t)st.st_size != tmp.data_offset + tmp.capacity) {
+		errno = EINVAL;
+		return 1;
+	}
+	/* reserve the address space, then map the data twice after the header */
+	q->map_size = tmp.data_offset + 2 * tmp.capacity;
+	base = (char*)mmap(0, q->map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED) return 1;
+	if(mmap(base, tmp.data_offset + tmp.capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+			mmap(base + tmp.data_offset + tmp.capacity, tmp.capacity, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_FIXED, fd, tmp.data_offset) == MAP_FAILED) {
+		int err = errno;
+		munmap(base, q->map_size);
+		errno = err;
+		return 1;
+	}
+	q->h = (read_table_ring_header*)base;
+	q->data = base + tmp.data_offset;
+	q->capacity = tmp.capacity;
+	q->fd = fd;
+	q->role = role;
+	q->spin = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? READ_TABLE_RING_SPIN : 0;
+	q->wake = (READ_TABLE_RING_WAKE < tmp.capacity / 2) ? READ_TABLE_RING_WAKE : tmp.capacity / 2;
+	/* register this process, unless another one (still running) has the same role */
+	pid = __atomic_load_n(&(q->h->pid[role]), __ATOMIC_ACQUIRE);
+	do {
+		if(pid && !read_table_ring_exited(pid)) {
+			munmap(base, q->map_size);
+			q->h = 0;
+			q->data = 0;
+			errno = EBUSY;
+			return 1;
+		}
+	} while(!__atomic_compare_exchange_n(&(q->h->pid[role]), &pid, (int32_t)getpid(), 0,
+		__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	if(role == READ_TABLE_RING_PRODUCER) {
+		q->pos = __atomic_load_n(&(q->h->head), __ATOMIC_ACQUIRE);
+		q->other = __atomic_load_n(&(q->h->tail), __ATOMIC_ACQUIRE);
+		q->flushed = q->pos;
+	}
+	else {
+		q->pos = __atomic_load_n(&(q->h->tail), __ATOMIC_ACQUIRE);
+		q->other = __atomic_load_n(&(q->h->head), __ATOMIC_ACQUIRE);
+	}
+	return 0;
+}
+
+/* open an existing ring by name (in READ_TABLE_RING_DIR, or a full path) */
+static int read_table_ring_open(read_table_ring* q, const char* name, int role) {
+	char path[PATH_MAX];
+	int fd;
+	if(read_table_ring_path(path, sizeof(path), name)) return 1;
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if(fd < 0) return 1;
+	if(read_table_ring_open_fd(q, fd, role)) {
+		int err = errno;
+		close(fd);
+		errno = err;
+		return 1;
+	}
+	return 0;
+}
+
+/* create a new ring with (at least) capacity bytes of data (0: use
+ * READ_TABLE_RING_SIZE) and attach to it with the given role; if name is
+ * NULL, an anonymous memory file is used, which is inherited by child
+ * processes (these can use q->fd with read_table_ring_open_fd());
+ * otherwise, it is created in READ_TABLE_RING_DIR (fails if it exists)
+ * returns 0 on success, 1 on error (errno is set) */
+static int read_table_ring_create(read_table_ring* q, const char* name, size_t capacity, int role) {
+	char path[PATH_MAX];
+	char tmp_path[PATH_MAX + 32];
+	read_table_ring_header h;
+	size_t page = sysconf(_SC_PAGESIZE);
+	uint64_t cap = page;
+	int fd, err;
+	if(!capacity) capacity = READ_TABLE_RING_SIZE;
+	while(cap < capacity) cap *= 2;
+	if(name) {
+		/* note: the file is initialized under a temporary name, so that
+		 * others cannot open it before */
+		if(read_table_ring_path(path, sizeof(path), name)) return 1;
+		snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d", path, (int)getpid());
+		fd = open(tmp_path, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+	}
+	else fd = (int)syscall(SYS_memfd_create, "read_table_ring", 0); /* note: memfd_create() is only declared with _GNU_SOURCE */
+	if(fd < 0) return 1;
+	memset(&h, 0, sizeof(h));
+	h.magic = READ_TABLE_RING_MAGIC;
+	h.capacity = cap;
+	h.data_offset = page;
+	if(ftruncate(fd, page + cap) || pwrite(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) goto error;
+	if(name) {
+		/* note: link() fails if the target already exists (unlike rename()) */
+		if(link(tmp_path, path)) goto error;
+		unlink(tmp_path);
+	}
+	if(read_table_ring_open_fd(q, fd, role)) {
+		err = errno;
+		if(name) unlink(path);
+		close(fd);
+		errno = err;
+		return 1;
+	}
+	return 0;
+
+error:
+	err = errno;
+	if(name) unlink(tmp_path);
+	close(fd);
+	errno = err;
+	return 1;
+}
+
+/* remove a ring created with the given name (processes that have it
+ * mapped can continue using it) */
+static int read_table_ring_remove(const char* name) {
+	char path[PATH_MAX];
+	if(read_table_ring_path(path, sizeof(path), name)) return 1;
+	return unlink(path) ? 1 : 0;
+}
+
+
+/* producer side */
+
+/* wait until there is space for len bytes; returns 0 on success, 1 if
+ * the consumer stopped reading (errno is set to EPIPE) */
+static int read_table_ring_wait_space(read_table_ring* q, size_t len) {
+	read_table_ring_header* h = q->h;
+	unsigned int i;
+	for(i = 0; ; i++) {
+		uint32_t seq;
+		if(__atomic_load_n(&(h->closed), __ATOMIC_ACQUIRE) & READ_TABLE_RING_DETACHED) {
+			errno = EPIPE;
+			return 1;
+		}
+		q->other = __atomic_load_n(&(h->tail), __ATOMIC_ACQUIRE);
+		if(q->pos + len - q->other <= q->capacity) return 0;
+		if(i < q->spin) {
+			read_table_ring_spin();
+			continue;
+		}
+		/* note: the consumer increments tail_seq after seeing producer_waiting,
+		 * so either tail is updated already, or the futex call returns */
+		seq = __atomic_load_n(&(h->tail_seq), __ATOMIC_ACQUIRE);
+		__atomic_store_n(&(h->producer_waiting), 1, __ATOMIC_SEQ_CST);
+		q->other = __atomic_load_n(&(h->tail), __ATOMIC_SEQ_CST);
+		if(q->pos + len - q->other <= q->capacity) return 0;
+		/* the consumer might wait for data that was not enough to wake it
+		 * up in read_table_ring_commit() */
+		read_table_ring_wake(&(h->consumer_waiting), &(h->head_seq), 0);
+		q->flushed = q->pos;
+		struct timespec ts = {READ_TABLE_RING_TIMEOUT / 1000, (READ_TABLE_RING_TIMEOUT % 1000) * 1000000L};
+		if(read_table_ring_futex(&(h->tail_seq), FUTEX_WAIT, seq, &ts) && errno == ETIMEDOUT &&
+				read_table_ring_exited(__atomic_load_n(&(h->pid[READ_TABLE_RING_CONSUMER]), __ATOMIC_ACQUIRE))) {
+			errno = EPIPE;
+			return 1;
+		}
+	}
+}
+
+/* get space to directly write up to len bytes in *ptr (waiting until it
+ * is available), which are made available to the consumer by calling
+ * read_table_ring_commit(); len cannot be more than the capacity
+ * returns 0 on success, 1 on error (errno is EPIPE if the consumer
+ * stopped reading, EMSGSIZE if len is too large) */
+static int read_table_ring_reserve(read_table_ring* q, size_t len, char** ptr) {
+	if(len > q->capacity) {
+		errno = EMSGSIZE;
+		return 1;
+	}
+	if(q->pos + len - q->other > q->capacity && read_table_ring_wait_space(q, len)) return 1;
+	*ptr = q->data + (q->pos & (q->capacity - 1));
+	return 0;
+}
+
+/* number of bytes that can be written without waiting (after reserving) */
+static size_t read_table_ring_space(const read_table_ring* q) {
+	return q->capacity - (q->pos - q->other);
+}
+
+/* make len bytes written after read_table_ring_reserve() available; if
+ * the consumer is sleeping, it is only woken up after READ_TABLE_RING_WAKE
+ * bytes (or when the producer has to wait for space), so that the
+ * processes do not switch after each line */
+static void read_table_ring_commit(read_table_ring* q, size_t len) {
+	q->pos += len;
+	__atomic_store_n(&(q->h->head), q->pos, __ATOMIC_RELEASE);
+	if(q->pos - q->flushed >= q->wake) {
+		read_table_ring_wake(&(q->h->consumer_waiting), &(q->h->head_seq), 0);
+		q->flushed = q->pos;
+	}
+}
+
+/* wake up the consumer if it is waiting for data (e.g. if the producer
+ * will not write more for some time) */
+static void read_table_ring_flush(read_table_ring* q) {
+	read_table_ring_wake(&(q->h->consumer_waiting), &(q->h->head_seq), 0);
+	q->flushed = q->pos;
+}
+
+/* copy len bytes to the ring; data does not need to contain whole lines,
+ * but each line has to fit in the ring to be read
+ * returns 0 on success, 1 on error (the consumer stopped reading) */
+static int read_table_ring_write(read_table_ring* q, const char* data, size_t len) {
+	while(len) {
+		char* ptr;
+		size_t n;
+		if(read_table_ring_reserve(q, 1, &ptr)) return 1;
+		n = read_table_ring_space(q);
+		if(n > len) n = len;
+		memcpy(ptr, data, n);
+		read_table_ring_commit(q, n);
+		data += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* format directly into the ring (similarly to printf());
+ * returns 0 on success, 1 on error */
+static int read_table_ring_printf(read_table_ring* q, const char* fmt, ...) {
+	va_list ap;
+	char* ptr;
+	size_t space;
+	int n;
+	if(read_table_ring_reserve(q, 1, &ptr)) return 1;
+	space = read_table_ring_space(q);
+	va_start(ap, fmt);
+	n = vsnprintf(ptr, space, fmt, ap);
+	va_end(ap);
+	if(n < 0) return 1;
+	if((size_t)n >= space) {
+		/* note: vsnprintf() needs space for a terminating 0 as well (this
+		 * is not committed) */
+		if(read_table_ring_reserve(q, (size_t)n + 1, &ptr)) return 1;
+		va_start(ap, fmt);
+		vsnprintf(ptr, (size_t)n + 1, fmt, ap);
+		va_end(ap);
+	}
+	read_table_ring_commit(q, n);
+	return 0;
+}
+
+/* indicate that all data was written (adding a newline after the last
+ * line if needed), the consumer gets an end of input after reading
+ * everything; returns 0 on success, 1 on error */
+static int read_table_ring_finish(read_table_ring* q) {
+	if(q->pos && q->data[(q->pos - 1) & (q->capacity - 1)] != '\n' &&
+		read_table_ring_write(q, "\n", 1)) return 1;
+	__atomic_or_fetch(&(q->h->closed), READ_TABLE_RING_FINISHED, __ATOMIC_SEQ_CST);
+	read_table_ring_wake(&(q->h->consumer_waiting), &(q->h->head_seq), 1);
+	return 0;
+}
+
+
+/* consumer side */
+
+/* wait until more than have bytes are available for reading (i.e. in
+ * addition to a partial line already seen); returns 0 on success, 1 if
+ * no more data will be written (errno is 0 if the producer called
+ * read_table_ring_finish(), EPIPE if it exited without it) */
+static int read_table_ring_wait(read_table_ring* q, size_t have) {
+	read_table_ring_header* h = q->h;
+	unsigned int i;
+	for(i = 0; ; i++) {
+		uint32_t seq;
+		q->other = __atomic_load_n(&(h->head), __ATOMIC_ACQUIRE);
+		if(q->other - q->pos > have) return 0;
+		if(__atomic_load_n(&(h->closed), __ATOMIC_ACQUIRE) & READ_TABLE_RING_FINISHED) {
+			/* note: data written before finishing is visible now */
+			q->other = __atomic_load_n(&(h->head), __ATOMIC_ACQUIRE);
+			if(q->other - q->pos > have) return 0;
+			errno = 0;
+			return 1;
+		}
+		if(i < q->spin) {
+			read_table_ring_spin();
+			continue;
+		}
+		seq = __atomic_load_n(&(h->head_seq), __ATOMIC_ACQUIRE);
+		__atomic_store_n(&(h->consumer_waiting), 1, __ATOMIC_SEQ_CST);
+		q->other = __atomic_load_n(&(h->head), __ATOMIC_SEQ_CST);
+		if(q->other - q->pos > have) return 0;
+		if(__atomic_load_n(&(h->closed), __ATOMIC_ACQUIRE) & READ_TABLE_RING_FINISHED) continue;
+		/* the producer might wait for space that was not enough to wake it
+		 * up in read_table_ring_consume() */
+		read_table_ring_wake(&(h->producer_waiting), &(h->tail_seq), 0);
+		struct timespec ts = {READ_TABLE_RING_TIMEOUT / 1000, (READ_TABLE_RING_TIMEOUT % 1000) * 1000000L};
+		if(read_table_ring_futex(&(h->head_seq), FUTEX_WAIT, seq, &ts) && errno == ETIMEDOUT &&
+				read_table_ring_exited(__atomic_load_n(&(h->pid[READ_TABLE_RING_PRODUCER]), __ATOMIC_ACQUIRE)) &&
+				!(__atomic_load_n(&(h->closed), __ATOMIC_ACQUIRE) & READ_TABLE_RING_FINISHED)) {
+			errno = EPIPE;
+			return 1;
+		}
+	}
+}
+
+/* get the data available for reading without waiting (as one contiguous
+ * range, even if it wraps around the end of the ring); returns its size */
+static size_t read_table_ring_available(const read_table_ring* q, const char** ptr) {
+	*ptr = q->data + (q->pos & (q->capacity - 1));
+	return q->other - q->pos;
+}
+
+/* release len bytes at the beginning of the available data (these can be
+ * overwritten by the producer after this); if the producer is waiting for
+ * space, it is only woken up when at least half of the ring is free (or
+ * when the consumer has to wait for more data), so that the processes do
+ * not switch after each small amount of data */
+static void read_table_ring_consume(read_table_ring* q, size_t len) {
+	q->pos += len;
+	__atomic_store_n(&(q->h->tail), q->pos, __ATOMIC_RELEASE);
+	q->other = __atomic_load_n(&(q->h->head), __ATOMIC_ACQUIRE);
+	if(q->other - q->pos <= q->capacity / 2)
+		read_table_ring_wake(&(q->h->producer_waiting), &(q->h->tail_seq), 0);
+}
+
+
+/* detach from the ring and unmap it, closing the file descriptor; if
+ * the producer did not call read_table_ring_finish() before, it is
+ * called here; the consumer detaching makes the producer fail when
+ * waiting for space */
+static void read_table_ring_close(read_table_ring* q) {
+	read_table_ring_header* h;
+	if(!q || !(q->h)) return;
+	h = q->h;
+	if(q->role == READ_TABLE_RING_PRODUCER) {
+		if(!(__atomic_load_n(&(h->closed), __ATOMIC_ACQUIRE) & READ_TABLE_RING_FINISHED))
+			read_table_ring_finish(q);
+	}
+	else {
+		__atomic_or_fetch(&(h->closed), READ_TABLE_RING_DETACHED, __ATOMIC_SEQ_CST);
+		read_table_ring_wake(&(h->producer_waiting), &(h->tail_seq), 1);
+	}
+	__atomic_store_n(&(h->pid[q->role]), 0, __ATOMIC_RELEASE);
+	munmap((void*)h, q->map_size);
+	close(q->fd);
+	q->h = 0;
+	q->data = 0;
+	q->fd = -1;
+}
+
+#endif
@@ -0,0 +1,302 @@
+/*  -*- C++ -*-
+ * read_table_ring_reader.h -- reading lines from a shared memory ring
+ * 	buffer (read_table_ring.h) with the interface of read_table2
+ *
+ * ring_reader is the consumer side of a ring written by another process
+ * on the same host (e.g. instead of reading its output from a pipe).
+ * Lines can be read one by one and parsed the same way as with
+ * read_table2, or in batches with read_lines(), which returns views
+ * pointing directly to the shared memory, so the data is not copied.
+ *
+ * Linux only (see read_table_ring.h); uses read_table_cpp.h.
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+// consumer: create the ring, then start the producer (see read_table_ring.h)
+ring_reader r(line_parser_params().set_delim('\t'));
+if(!r.create("rows")) r.write_error(stderr);
+std::vector<line_view> batch;
+line_parser lp;
+while(r.read_lines(batch)) for(const line_view& v : batch) {
+	// v.str points to the shared memory, valid until the next call to read_lines()
+	uint32_t id;
+	double value;
+	lp.assign_line(v.str, v.len);
+	if(!lp.read(id, read_table_skip(), value)) ... // handle error
+}
+if(r.get_last_error() != T_EOF) r.write_error(stderr); // e.g. the producer exited
+r.close();
+read_table_ring_remove("rows");
+
+// reading one line at a time works the same as with read_table2
+while(r.read_line()) {
+	uint32_t id;
+	if(!r.read(id)) ... // handle error
+}
+
+ */
+
+#ifndef READ_TABLE_RING_READER_H
+#define READ_TABLE_RING_READER_H
+
+#include "read_table_cpp.h"
+#include "read_table_ring.h"
+#include <vector>
+
+
+/* reading lines from a ring buffer written by another process */
+class ring_reader : public line_parser {
+	protected:
+		read_table_ring q;
+		bool attached = false;
+		const char* fn = nullptr; /* name of the ring, used for error messages */
+		uint64_t line = 0; /* current line (count starts from 1) */
+		uint64_t line_offset = 0; /* offset of the start of the current line in the input */
+		size_t pending = 0; /* size of lines returned previously, released at the next read */
+		int sys_errno = 0; /* errno of the last failed system call */
+
+		bool sys_error(enum read_table_errors err) {
+			sys_errno = errno;
+			last_error = err;
+			return false;
+		}
+		/* check if reading is possible, release the lines returned before */
+		bool start_read();
+		/* find the next complete line after the pending data; if wait is
+		 * true, wait until there is one (setting last_error at the end of
+		 * the input or on error); next is the length including the newline */
+		bool find_line(bool wait, const char*& str, size_t& len, size_t& next);
+		void release() {
+			if(pending) read_table_ring_consume(&q, pending);
+			pending = 0;
+		}
+
+	public:
+		explicit ring_reader(const line_parser_params& par = line_parser_params()) : line_parser(par) { }
+		ring_reader(const ring_reader&) = delete;
+		ring_reader& operator = (const ring_reader&) = delete;
+		~ring_reader() { close(); }
+
+		/* create a new ring as the consumer (in READ_TABLE_RING_DIR if name
+		 * is given, otherwise an anonymous memory file, see fd()) */
+		bool create(const char* name, size_t capacity = READ_TABLE_RING_SIZE) {
+			close();
+			if(read_table_ring_create(&q, name, capacity, READ_TABLE_RING_CONSUMER)) return sys_error(T_ERROR_FOPEN);
+			return opened(name);
+		}
+		/* open a ring created by the producer */
+		bool open(const char* name) {
+			close();
+			if(read_table_ring_open(&q, name, READ_TABLE_RING_CONSUMER)) return sys_error(T_ERROR_FOPEN);
+			return opened(name);
+		}
+		/* use a ring in an already open file descriptor (which is closed
+		 * along with the ring) */
+		bool open_fd(int fd) {
+			close();
+			if(read_table_ring_open_fd(&q, fd, READ_TABLE_RING_CONSUMER)) return sys_error(T_ERROR_FOPEN);
+			return opened(nullptr);
+		}
+		/* file descriptor of the ring (e.g. to pass to a child process) */
+		int fd() const { return attached ? q.fd : -1; }
+		/* detach from the ring (the producer gets an error if it tries to
+		 * write more than what fits in it) */
+		void close() {
+			if(attached) read_table_ring_close(&q);
+			attached = false;
+			pending = 0;
+		}
+
+		/* read one line into the internal buffer (the same as
+		 * read_table2::read_line()), waiting for the producer if needed */
+		bool read_line(bool skip = true);
+		/* read up to max_lines lines at once into batch (clearing its
+		 * previous contents), waiting until at least one is available;
+		 * empty and comment-only lines are skipped; the lines point
+		 * directly to the shared memory, and are valid until the next
+		 * call to read_lines() or read_line() (the space is only released
+		 * to the producer then); returns false at the end of the input
+		 * (last_error == T_EOF) or on error */
+		bool read_lines(std::vector<line_view>& batch, size_t max_lines = 1024);
+
+		uint64_t get_line() const { return line; }
+		uint64_t get_line_offset() const { return line_offset; }
+		void set_fn_for_diag(const char* fn_) { fn = fn_; }
+		const char* get_fn() const { return fn; }
+		int get_errno() const { return sys_errno; }
+
+		void write_error(std::ostream& f) const {
+			f<<"read_table, ";
+			if(fn) f<<"ring "<<fn<<", ";
+			else f<<"input ";
+			f<<"line "<<line<<", position "<<pos<<" / column "<<col<<": "<<get_error_desc(last_error);
+			if(sys_errno) f<<" ("<<strerror(sys_errno)<<")";
+			f<<"\n";
+		}
+		void write_error(FILE* f) const {
+			if(!f) return;
+			fprintf(f,"read_table, ");
+			if(fn) fprintf(f,"ring %s, ",fn);
+			else fprintf(f,"input ");
+			fprintf(f,"line %lu, position %lu / column %lu: %s",line,pos,col,get_error_desc(last_error));
+			if(sys_errno) fprintf(f," (%s)",strerror(sys_errno));
+			fprintf(f,"\n");
+		}
+
+	protected:
+		bool opened(const char* name) {
+			attached = true;
+			fn = name;
+			line = 0;
+			line_offset = q.pos;
+			pending = 0;
+			sys_errno = 0;
+			last_error = T_OK;
+			return true;
+		}
+};
+
+
+bool ring_reader::start_read() {
+	if(!attached) {
+		if(last_error == T_OK) last_error = T_ERROR_FOPEN;
+		return false;
+	}
+	if(last_error == T_EOF || last_error == T_COPIED ||
+		last_error == T_ERROR_FOPEN || last_error == T_READ_ERROR) return false;
+	release();
+	return true;
+}
+
+bool ring_reader::find_line(bool wait, const char*& str, size_t& len, size_t& next) {
+	while(true) {
+		const char* data;
+		size_t avail = read_table_ring_available(&q, &data);
+		if(pending < avail) {
+			const char* nl = (const char*)memchr(data + pending, '\n', avail - pending);
+			if(nl) {
+				str = data + pending;
+				len = nl - str;
+				next = len + 1;
+				return true;
+			}
+		}
+		if(!wait) return false;
+		/* note: lines are only returned as a whole, so they have to fit in the ring */
+		if(avail - pending == q.capacity) {
+			errno = EMSGSIZE;
+			return sys_error(T_READ_ERROR);
+		}
+		if(read_table_ring_wait(&q, avail)) {
+			if(errno) return sys_error(T_READ_ERROR);
+			avail = read_table_ring_available(&q, &data);
+			if(pending < avail) {
+				/* last line without a newline (only if the producer did not
+				 * use read_table_ring_finish()) */
+				str = data + pending;
+				len = avail - pending;
+				next = len;
+				return true;
+			}
+			last_error = T_EOF;
+			return false;
+		}
+	}
+}
+
+bool ring_reader::read_line(bool skip) {
+	if(!start_read()) return false;
+	while(true) {
+		const char* str;
+		size_t len, next;
+		if(!find_line(true, str, len, next)) return false;
+		line++;
+		line_offset = q.pos;
+		/* remove line end characters (same as read_lines()) */
+		if(len && str[len-1] == '\r') len--;
+		buf.assign(str, len);
+		pending = next;
+		release(); /* note: the line was copied */
+		pos = 0;
+		/* check that there is actual data in the line, empty lines are skipped */
+		if(skip) {
+			for(; pos < len; pos++)
+				if( ! (buf[pos] == ' ' || buf[pos] == '\t') ) break;
+			if(pos < len) {
+				if(comment && buf[pos] == comment) continue; /* if there is only a comment, then this line is skipped */
+				if(delim) pos = 0; /* if there is a delimiter character then whitespace at the beginning of a line is not skipped */
+				break; /* there is some data in the line */
+			}
+		}
+		else break;
+	}
+	col = 0;
+	last_error = T_OK;
+	return true;
+}
+
+bool ring_reader::read_lines(std::vector<line_view>& batch, size_t max_lines) {
+	batch.clear();
+	if(!start_read()) return false;
+	last_error = T_OK;
+	while(batch.size() < max_lines) {
+		const char* str;
+		size_t len, next;
+		/* note: only wait for the producer if there is nothing to return */
+		if(!find_line(batch.empty(), str, len, next)) break;
+		line++;
+		line_offset = q.pos + pending;
+		pending += next;
+		if(len && str[len-1] == '\r') len--;
+		/* skip empty and comment-only lines */
+		size_t i = 0;
+		for(; i < len; i++) if( ! (str[i] == ' ' || str[i] == '\t') ) break;
+		if(i == len || (comment && str[i] == comment)) {
+			if(batch.empty()) release();
+			continue;
+		}
+		line_view v;
+		v.str = str;
+		v.len = len;
+		v.line = line;
+		v.offset = line_offset;
+		batch.push_back(v);
+	}
+	buf.clear();
+	pos = 0;
+	col = 0;
+	if(batch.empty()) return false;
+	last_error = T_OK;
+	return true;
+}
+
+#endif
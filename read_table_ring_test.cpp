@@ -0,0 +1,226 @@
+/*
+ * read_table_ring_test.cpp -- simple test cases for read_table_ring.h
+ * 	and read_table_ring_reader.h
+ *
+ * usage: read_table_ring_test [-n lines] [-s ring_size] [-r name]
+ *
+ * a producer is started in a child process for each test, which writes
+ * generated lines (default: 20000) to a small ring (default: 4096 bytes),
+ * so that the data wraps around the end of the ring many times; some of
+ * the lines fill the whole ring (with the newline); these are read in
+ * batches and one by one, comparing each line, its number and offset to
+ * the expected ones:
+ * 1. all lines are written, the last one without a newline (added when
+ * the producer finishes); empty and comment lines are skipped, also if
+ * they end with CRLF (the '\r' is removed from all lines)
+ * 2. the producer exits without finishing, after writing part of a line:
+ * the complete lines are read, then an error (EPIPE) is reported
+ * 3. the producer writes a line longer than the ring: an error (EMSGSIZE)
+ * is reported, and the producer gets an error after the reader closes
+ * the ring
+ * the ring is an anonymous memory file by default, or created with the
+ * given name in /dev/shm (-r), which is opened by the producer
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include "read_table_ring_reader.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* what the producer does after writing the lines */
+enum producer_end { END_FINISH, END_EXIT, END_LONG_LINE };
+
+/* producer: write the lines (without the newline after the last one),
+ * then end as given; returns 0 if everything happened as expected */
+static int producer(int fd, const char* name, const std::vector<std::string>& lines, producer_end end) {
+	read_table_ring q;
+	if(name ? read_table_ring_open(&q, name, READ_TABLE_RING_PRODUCER) :
+			read_table_ring_open_fd(&q, fd, READ_TABLE_RING_PRODUCER)) {
+		fprintf(stderr,"Error opening the ring in the producer: %s!\n",strerror(errno));
+		return 1;
+	}
+	for(size_t j = 0; j < lines.size(); j++) {
+		const std::string& l = lines[j];
+		bool last = (j + 1 == lines.size());
+		/* note: short lines are formatted directly into the ring, while
+		 * vsnprintf() would need space for one more character for lines
+		 * filling the ring */
+		int err = (l.size() < 256 && !last) ? read_table_ring_printf(&q, "%s\n", l.c_str()) :
+			(read_table_ring_write(&q, l.data(), l.size()) || (!last && read_table_ring_write(&q, "\n", 1)));
+		if(err) {
+			fprintf(stderr,"Error writing to the ring: %s!\n",strerror(errno));
+			return 1;
+		}
+	}
+	if(end == END_EXIT) {
+		/* note: _exit() does not detach from the ring */
+		if(read_table_ring_write(&q, "\npartial", 8)) return 1;
+		_exit(0);
+	}
+	if(end == END_LONG_LINE) {
+		/* the reader detaches after finding that the line does not fit */
+		std::string tmp(2 * q.capacity, 'x');
+		if(!read_table_ring_write(&q, "\n", 1) && read_table_ring_write(&q, tmp.data(), tmp.size()) && errno == EPIPE) {
+			read_table_ring_close(&q);
+			return 0;
+		}
+		fprintf(stderr,"Error: producer not stopped after the reader detached!\n");
+		return 1;
+	}
+	read_table_ring_finish(&q);
+	read_table_ring_close(&q);
+	return 0;
+}
+
+/* read from r (in batches or one by one) until the end of the input or
+ * an error, and compare the lines with the expected ones; n is the number
+ * of lines read (including empty and comment lines); returns false if a
+ * line is different */
+static bool read_rows(ring_reader& r, bool single, const std::vector<std::string>& lines,
+		const std::vector<uint64_t>& offsets, size_t& n) {
+	/* length of line j without the '\r' at the end */
+	auto length = [&](size_t j) {
+		size_t len = lines[j].size();
+		return (len && lines[j][len - 1] == '\r') ? len - 1 : len;
+	};
+	auto skip = [&]() {
+		while(n < lines.size() && (!length(n) || lines[n][0] == '#')) n++;
+	};
+	auto compare = [&](const char* str, size_t len, uint64_t line, uint64_t offset) {
+		skip();
+		if(n >= lines.size() || line != n + 1 || offset != offsets[n] || len != length(n) ||
+				memcmp(str, lines[n].data(), len)) {
+			fprintf(stderr,"Error: line %lu (offset %lu) is different from the expected one!\n",
+				(unsigned long)line,(unsigned long)offset);
+			return false;
+		}
+		n++;
+		return true;
+	};
+	if(single) {
+		while(r.read_line()) {
+			const std::string& l = r.get_line_str();
+			if(!compare(l.data(), l.size(), r.get_line(), r.get_line_offset())) return false;
+		}
+	}
+	else {
+		std::vector<line_view> batch;
+		while(r.read_lines(batch, 100)) for(const line_view& v : batch)
+			if(!compare(v.str, v.len, v.line, v.offset)) return false;
+	}
+	skip();
+	return true;
+}
+
+/* create a ring, start the producer and read from it; err and sys_errno
+ * are the error of the reader at the end; returns false if a line was
+ * different or the producer failed */
+static bool run_test(const char* name, size_t size, bool single, const std::vector<std::string>& lines,
+		const std::vector<uint64_t>& offsets, producer_end end, size_t& n, int& err, int& sys_errno) {
+	ring_reader r(line_parser_params().set_comment('#'));
+	n = 0;
+	if(!r.create(name, size)) {
+		r.write_error(stderr);
+		return false;
+	}
+	pid_t pid = fork();
+	if(pid < 0) {
+		fprintf(stderr,"Error creating the producer process!\n");
+		return false;
+	}
+	if(pid == 0) _exit(producer(dup(r.fd()), name, lines, end));
+
+	bool ret = read_rows(r, single, lines, offsets, n);
+	err = r.get_last_error();
+	sys_errno = r.get_errno();
+	r.close();
+	int status;
+	waitpid(pid, &status, 0);
+	if(name) read_table_ring_remove(name);
+	return ret && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+
+int main(int argc, char **argv)
+{
+	char* name = 0;
+	size_t nlines = 20000;
+	size_t size = 4096;
+	int i;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nlines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 's':
+			size = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'r':
+			name = argv[i+1];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	bool ret = true;
+
+	/* size of the ring (the same as in read_table_ring_create()) */
+	size_t cap = sysconf(_SC_PAGESIZE);
+	while(cap < size) cap *= 2;
+
+	/* note: every 1000th line fills the ring (or is one or two characters
+	 * shorter), every 100th ends with CRLF, and every 100th is followed by
+	 * empty lines (one with CRLF) and a comment line */
+	std::vector<std::string> lines;
+	std::vector<uint64_t> offsets;
+	uint64_t total = 0;
+	for(size_t j = 0; j < nlines; j++) {
+		size_t len = (j % 1000 == 999) ? cap - 1 - (j / 1000) % 3 : 10 + (j * 37) % 200;
+		std::string l = std::to_string(j) + "\t";
+		l.append(len - l.size(), (char)('a' + j % 26));
+		if(j % 100 == 20) l += "\r";
+		lines.push_back(l);
+		if(j % 100 == 50) {
+			lines.push_back("");
+			lines.push_back("\r");
+			lines.push_back("# comment\r");
+		}
+	}
+	for(const std::string& l : lines) {
+		offsets.push_back(total);
+		total += l.size() + 1;
+	}
+	ret = check(total > 10 * cap, "ring too large for the number of lines") && ret;
+
+	for(int single = 0; single < 2; single++) {
+		size_t n;
+		int err, sys_errno;
+		/* 1. all lines */
+		ret = check(run_test(name, size, single, lines, offsets, END_FINISH, n, err, sys_errno) &&
+			err == T_EOF && n == lines.size(), "reading all lines") && ret;
+
+		/* 2. producer exiting */
+		std::vector<std::string> half(lines.begin(), lines.begin() + lines.size() / 2);
+		ret = check(run_test(name, size, single, half, offsets, END_EXIT, n, err, sys_errno) &&
+			err == T_READ_ERROR && sys_errno == EPIPE && n == half.size(), "producer exiting") && ret;
+
+		/* 3. line longer than the ring */
+		ret = check(run_test(name, size, single, half, offsets, END_LONG_LINE, n, err, sys_errno) &&
+			err == T_READ_ERROR && sys_errno == EMSGSIZE && n == half.size(), "line longer than the ring") && ret;
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
@@ -0,0 +1,685 @@
+/*  -*- C++ -*-
+ * read_table_serve.h -- sharing tables loaded with read_table_bulk.h
+ * 	between processes on the same host
+ *
+ * A server process loads tables once and stores each of them in columnar
+ * form in a memory file (memfd), which is then sealed so that it cannot
+ * be modified anymore. Clients connect to the server on a Unix socket,
+ * request a table by its name and receive the file descriptor of the
+ * memory file, which they map read-only; this way, a client can start
+ * using a table without parsing (or copying) anything.
+ *
+ * Tables are described by a schema (list of column types, same as
+ * read_table_validate, without bounds): x (skip), s (string), i16, u16,
+ * i32, u32, i64, u64, d (double). Columns are numbered as in the input
+ * file (skipped columns are kept as empty). Strings are stored as an
+ * array of offsets (nrows + 1) and the concatenated characters.
+ *
+ * Linux only (uses memfd_create() and file sealing); requires linking
+ * with -pthread (as read_table_bulk.h).
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+// server (see also read_table_served.cpp)
+read_table2 r("reference.tsv");
+table_loader t;
+std::vector<shared_col_type> types;
+if(!parse_shared_types("u32,s,x,d", types) || !t.load(r, types.size())) ... // handle error
+table_server srv;
+if(!srv.add_table("ref", t, types, 4)) t.write_error(std::cerr);
+if(!srv.listen("/tmp/read_table.sock")) ... // handle error
+srv.run();
+
+// client
+shared_table tbl;
+if(!tbl.open("/tmp/read_table.sock", "ref")) ... // handle error
+const uint32_t* ids;
+const double* values;
+string_view_custom name;
+if(!tbl.column(0, ids) || !tbl.column(3, values)) ... // wrong column type
+for(size_t i = 0; i < tbl.nrows(); i++) {
+	tbl.get_string(1, i, name);
+	... // use ids[i], name and values[i]
+}
+
+ */
+
+#ifndef READ_TABLE_SERVE_H
+#define READ_TABLE_SERVE_H
+
+#include "read_table_bulk.h"
+#include <vector>
+#include <string>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* column types that can be stored (same order as in read_table_validate) */
+enum shared_col_type {SC_SKIP = 0, SC_STRING, SC_INT16, SC_UINT16, SC_INT32,
+	SC_UINT32, SC_INT64, SC_UINT64, SC_DOUBLE};
+static const char* const shared_col_type_names[] = {"x", "s", "i16", "u16", "i32", "u32", "i64", "u64", "d"};
+
+/* type code corresponding to C++ types */
+template<class T> struct shared_col_type_of { static constexpr shared_col_type type = SC_SKIP; };
+template<> struct shared_col_type_of<int16_t> { static constexpr shared_col_type type = SC_INT16; };
+template<> struct shared_col_type_of<uint16_t> { static constexpr shared_col_type type = SC_UINT16; };
+template<> struct shared_col_type_of<int32_t> { static constexpr shared_col_type type = SC_INT32; };
+template<> struct shared_col_type_of<uint32_t> { static constexpr shared_col_type type = SC_UINT32; };
+template<> struct shared_col_type_of<int64_t> { static constexpr shared_col_type type = SC_INT64; };
+template<> struct shared_col_type_of<uint64_t> { static constexpr shared_col_type type = SC_UINT64; };
+template<> struct shared_col_type_of<double> { static constexpr shared_col_type type = SC_DOUBLE; };
+
+/* parse a comma-separated list of column types; returns false on error */
+static bool parse_shared_types(const char* schema, std::vector<shared_col_type>& types) {
+	types.clear();
+	if(!schema) return false;
+	const char* p = schema;
+	while(true) {
+		const char* e = strchr(p, ',');
+		size_t len = e ? (size_t)(e - p) : strlen(p);
+		size_t i;
+		for(i = 0; i < sizeof(shared_col_type_names)/sizeof(shared_col_type_names[0]); i++)
+			if(strlen(shared_col_type_names[i]) == len && !strncmp(shared_col_type_names[i], p, len)) break;
+		if(i == sizeof(shared_col_type_names)/sizeof(shared_col_type_names[0])) return false;
+		types.push_back((shared_col_type)i);
+		if(!e) break;
+		p = e + 1;
+	}
+	return true;
+}
+
+
+/* layout of the shared memory files: header, column descriptions, data
+ * (the start of each column is aligned to 64 bytes) */
+#define READ_TABLE_SHARED_MAGIC "RTSHTAB"
+#define READ_TABLE_SHARED_VERSION 1
+#define READ_TABLE_SHARED_ALIGN 64
+
+struct shared_table_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t ncols;
+	uint64_t nrows;
+	uint64_t size; /* total size, including this header */
+};
+
+struct shared_table_col {
+	uint32_t type; /* one of shared_col_type */
+	uint32_t reserved;
+	uint64_t offset; /* start of the values (or string offsets) */
+	uint64_t size; /* size of the values (or string offsets) in bytes */
+	uint64_t str_offset; /* start of the characters of strings */
+	uint64_t str_size; /* total length of strings */
+};
+
+static size_t shared_table_align(size_t x) {
+	return (x + READ_TABLE_SHARED_ALIGN - 1) & ~(size_t)(READ_TABLE_SHARED_ALIGN - 1);
+}
+
+/* size of one value of the given type (0 for strings and skipped columns) */
+static size_t shared_col_type_size(shared_col_type type) {
+	switch(type) {
+		case SC_INT16:
+		case SC_UINT16:
+			return 2;
+		case SC_INT32:
+		case SC_UINT32:
+			return 4;
+		case SC_INT64:
+		case SC_UINT64:
+		case SC_DOUBLE:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+
+/* client side: one table mapped read-only from the server */
+class shared_table {
+	protected:
+		const char* base = nullptr; /* start of the mapping */
+		size_t size = 0; /* size of the mapping */
+		const shared_table_header* header = nullptr;
+		const shared_table_col* cols = nullptr;
+		enum read_table_errors last_error = T_OK;
+		int sys_errno = 0; /* errno of the last failed system call */
+
+		bool sys_error(enum read_table_errors err) {
+			sys_errno = errno;
+			last_error = err;
+			return false;
+		}
+		bool format_error() {
+			close();
+			last_error = T_FORMAT;
+			return false;
+		}
+
+	public:
+		shared_table() { }
+		shared_table(const shared_table&) = delete;
+		shared_table& operator = (const shared_table&) = delete;
+		shared_table(shared_table&& t) { *this = std::move(t); }
+		shared_table& operator = (shared_table&& t) {
+			close();
+			base = t.base;
+			size = t.size;
+			header = t.header;
+			cols = t.cols;
+			last_error = t.last_error;
+			sys_errno = t.sys_errno;
+			t.base = nullptr;
+			t.size = 0;
+			t.header = nullptr;
+			t.cols = nullptr;
+			return *this;
+		}
+		~shared_table() { close(); }
+
+		/* request the table with the given name from the server listening
+		 * on socket_path and map it; returns false on error (T_MISSING if
+		 * the server does not have the requested table) */
+		bool open(const char* socket_path, const char* name);
+		/* map the table stored in the given file descriptor (fd can be
+		 * closed after this) */
+		bool map(int fd);
+		/* unmap the table */
+		void close() {
+			if(base) munmap((void*)base, size);
+			base = nullptr;
+			size = 0;
+			header = nullptr;
+			cols = nullptr;
+		}
+		bool is_open() const { return base != nullptr; }
+
+		size_t nrows() const { return header ? header->nrows : 0; }
+		size_t ncols() const { return header ? header->ncols : 0; }
+		shared_col_type col_type(size_t i) const {
+			return (header && i < header->ncols) ? (shared_col_type)cols[i].type : SC_SKIP;
+		}
+		/* get the values in column i; returns false if the column does
+		 * not exist or has a different type */
+		template<class T> bool column(size_t i, const T*& data) {
+			if(!header || i >= header->ncols || shared_col_type_of<T>::type == SC_SKIP ||
+					cols[i].type != (uint32_t)shared_col_type_of<T>::type) {
+				last_error = T_TYPE;
+				return false;
+			}
+			data = (const T*)(base + cols[i].offset);
+			return true;
+		}
+		/* get the string in the given row of column i */
+		bool get_string(size_t i, size_t row, string_view_custom& str) {
+			if(!header || i >= header->ncols || cols[i].type != SC_STRING || row >= header->nrows) {
+				last_error = T_TYPE;
+				return false;
+			}
+			const uint64_t* offsets = (const uint64_t*)(base + cols[i].offset);
+			str.str = base + cols[i].str_offset + offsets[row];
+			str.len = offsets[row + 1] - offsets[row];
+			return true;
+		}
+
+		enum read_table_errors get_last_error() const { return last_error; }
+		int get_errno() const { return sys_errno; }
+		void write_error(FILE* f) const {
+			if(!f) return;
+			fprintf(f,"shared_table: %s",get_error_desc(last_error));
+			if(sys_errno) fprintf(f," (%s)",strerror(sys_errno));
+			fprintf(f,"\n");
+		}
+};
+
+
+/* server side: keeps the tables and answers requests from clients */
+class table_server {
+	protected:
+		struct table {
+			std::string name;
+			int fd;
+			size_t size;
+		};
+		std::vector<table> tables;
+		int sock = -1; /* listening socket */
+		std::string sock_path;
+		enum read_table_errors last_error = T_OK;
+		int sys_errno = 0; /* errno of the last failed system call */
+
+		bool sys_error(enum read_table_errors err) {
+			sys_errno = errno;
+			last_error = err;
+			return false;
+		}
+
+	public:
+		table_server() { }
+		table_server(const table_server&) = delete;
+		table_server& operator = (const table_server&) = delete;
+		~table_server() {
+			for(const table& x : tables) ::close(x.fd);
+			if(sock >= 0) {
+				::close(sock);
+				unlink(sock_path.c_str());
+			}
+		}
+
+		/* convert the columns of t (which should be loaded with at least
+		 * types.size() columns) with the given types using nthreads
+		 * threads, and store them as a table with the given name;
+		 * returns false on error: conversion errors can be written with
+		 * t.write_error(), others with write_error() */
+		bool add_table(const std::string& name, table_loader& t,
+			const std::vector<shared_col_type>& types, unsigned int nthreads = 1);
+		/* start listening on the given path (any existing socket file is removed) */
+		bool listen(const char* path);
+		/* answer one request; while waiting for it, the signal mask is
+		 * replaced by sigmask if given (as with ppoll()); returns false on
+		 * error, e.g. if interrupted by a signal (note: errors in
+		 * communicating with a client are not reported here) */
+		bool serve_one(const sigset_t* sigmask = nullptr);
+		/* answer requests until *stop is set from a handler of one of
+		 * stop_signals (default: SIGINT and SIGTERM); these signals are
+		 * blocked except while waiting for a request, so that they cannot
+		 * arrive between checking *stop and starting to wait */
+		bool run(const volatile sig_atomic_t* stop = nullptr, const sigset_t* stop_signals = nullptr);
+		size_t ntables() const { return tables.size(); }
+
+		enum read_table_errors get_last_error() const { return last_error; }
+		int get_errno() const { return sys_errno; }
+		void write_error(FILE* f) const {
+			if(!f) return;
+			fprintf(f,"table_server: %s",get_error_desc(last_error));
+			if(sys_errno) fprintf(f," (%s)",strerror(sys_errno));
+			fprintf(f,"\n");
+		}
+};
+
+
+/* helpers for write_shared_table() */
+template<class T> static bool shared_table_request_col(table_loader& t, size_t i) { return t.request<T>(i); }
+template<class T> static void shared_table_copy_col(table_loader& t, size_t i, char* dst) {
+	const std::vector<T>* values = nullptr;
+	if(t.column(i, values)) memcpy(dst, values->data(), values->size() * sizeof(T));
+}
+
+/* convert the columns of t (which should be loaded with at least
+ * types.size() columns) with the given types using nthreads threads, and
+ * write them in the above format to fd (an empty file, e.g. a memfd);
+ * the total size is stored in size; returns T_OK on success, the error
+ * of converting the columns (details are available in t), or
+ * T_WRITE_ERROR (with errno set) */
+static enum read_table_errors write_shared_table(int fd, table_loader& t,
+		const std::vector<shared_col_type>& types, unsigned int nthreads, size_t& size) {
+	if(types.size() > t.get_ncols()) return T_TYPE;
+	/* request all columns and convert them */
+	bool ret = true;
+	for(size_t i = 0; ret && i < types.size(); i++) switch(types[i]) {
+		case SC_STRING: ret = shared_table_request_col<string_view_custom>(t, i); break;
+		case SC_INT16: ret = shared_table_request_col<int16_t>(t, i); break;
+		case SC_UINT16: ret = shared_table_request_col<uint16_t>(t, i); break;
+		case SC_INT32: ret = shared_table_request_col<int32_t>(t, i); break;
+		case SC_UINT32: ret = shared_table_request_col<uint32_t>(t, i); break;
+		case SC_INT64: ret = shared_table_request_col<int64_t>(t, i); break;
+		case SC_UINT64: ret = shared_table_request_col<uint64_t>(t, i); break;
+		case SC_DOUBLE: ret = shared_table_request_col<double>(t, i); break;
+		default: break;
+	}
+	if(!ret || !t.materialize(nthreads)) return t.get_last_error();
+
+	/* compute the layout */
+	size_t nrows = t.nrows();
+	std::vector<shared_table_col> cols(types.size());
+	size = shared_table_align(sizeof(shared_table_header) + types.size() * sizeof(shared_table_col));
+	for(size_t i = 0; i < types.size(); i++) {
+		shared_table_col& c = cols[i];
+		memset(&c, 0, sizeof(c));
+		c.type = types[i];
+		c.offset = size;
+		if(types[i] == SC_STRING) {
+			const std::vector<string_view_custom>* str = nullptr;
+			c.size = (nrows + 1) * sizeof(uint64_t);
+			if(t.column(i, str)) for(const auto& s : *str) c.str_size += s.len;
+			c.str_offset = shared_table_align(c.offset + c.size);
+			size = shared_table_align(c.str_offset + c.str_size);
+		}
+		else {
+			c.size = nrows * shared_col_type_size(types[i]);
+			size = shared_table_align(c.offset + c.size);
+		}
+	}
+
+	/* copy the data */
+	if(ftruncate(fd, size)) return T_WRITE_ERROR;
+	char* data = (char*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(data == MAP_FAILED) return T_WRITE_ERROR;
+	shared_table_header* h = (shared_table_header*)data;
+	memcpy(h->magic, READ_TABLE_SHARED_MAGIC, sizeof(h->magic));
+	h->version = READ_TABLE_SHARED_VERSION;
+	h->ncols = types.size();
+	h->nrows = nrows;
+	h->size = size;
+	memcpy(data + sizeof(shared_table_header), cols.data(), cols.size() * sizeof(shared_table_col));
+	for(size_t i = 0; i < types.size(); i++) switch(types[i]) {
+		case SC_STRING:
+			{
+				const std::vector<string_view_custom>* str = nullptr;
+				if(!t.column(i, str)) break;
+				uint64_t* offsets = (uint64_t*)(data + cols[i].offset);
+				char* chars = data + cols[i].str_offset;
+				uint64_t pos = 0;
+				for(size_t j = 0; j < nrows; j++) {
+					offsets[j] = pos;
+					memcpy(chars + pos, (*str)[j].str, (*str)[j].len);
+					pos += (*str)[j].len;
+				}
+				offsets[nrows] = pos;
+			}
+			break;
+		case SC_INT16: shared_table_copy_col<int16_t>(t, i, data + cols[i].offset); break;
+		case SC_UINT16: shared_table_copy_col<uint16_t>(t, i, data + cols[i].offset); break;
+		case SC_INT32: shared_table_copy_col<int32_t>(t, i, data + cols[i].offset); break;
+		case SC_UINT32: shared_table_copy_col<uint32_t>(t, i, data + cols[i].offset); break;
+		case SC_INT64: shared_table_copy_col<int64_t>(t, i, data + cols[i].offset); break;
+		case SC_UINT64: shared_table_copy_col<uint64_t>(t, i, data + cols[i].offset); break;
+		case SC_DOUBLE: shared_table_copy_col<double>(t, i, data + cols[i].offset); break;
+		default: break;
+	}
+	munmap(data, size);
+	return T_OK;
+}
+
+
+bool table_server::add_table(const std::string& name, table_loader& t,
+		const std::vector<shared_col_type>& types, unsigned int nthreads) {
+	last_error = T_OK;
+	sys_errno = 0;
+	if(name.empty() || name.find('\n') != std::string::npos) {
+		last_error = T_TYPE;
+		return false;
+	}
+	int fd = memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if(fd < 0) return sys_error(T_WRITE_ERROR);
+	size_t size = 0;
+	enum read_table_errors err = write_shared_table(fd, t, types, nthreads, size);
+	if(err != T_OK) {
+		if(err == T_WRITE_ERROR) sys_error(err);
+		else last_error = err;
+		::close(fd);
+		return false;
+	}
+	/* seal the file, so that clients cannot modify it
+	 * (note: this requires that there are no writable mappings) */
+	if(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) {
+		sys_error(T_WRITE_ERROR);
+		::close(fd);
+		return false;
+	}
+
+	/* replace any previous table with the same name */
+	for(table& x : tables) if(x.name == name) {
+		::close(x.fd);
+		x.fd = fd;
+		x.size = size;
+		return true;
+	}
+	tables.push_back(table{name, fd, size});
+	return true;
+}
+
+bool table_server::listen(const char* path) {
+	last_error = T_OK;
+	sys_errno = 0;
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(!path || strlen(path) >= sizeof(addr.sun_path)) {
+		last_error = T_ERROR_FOPEN;
+		return false;
+	}
+	strcpy(addr.sun_path, path);
+	int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if(s < 0) return sys_error(T_ERROR_FOPEN);
+	unlink(path);
+	if(bind(s, (struct sockaddr*)&addr, sizeof(addr)) || ::listen(s, 64)) {
+		sys_error(T_ERROR_FOPEN);
+		::close(s);
+		return false;
+	}
+	if(sock >= 0) {
+		::close(sock);
+		unlink(sock_path.c_str());
+	}
+	sock = s;
+	sock_path = path;
+	return true;
+}
+
+bool table_server::run(const volatile sig_atomic_t* stop, const sigset_t* stop_signals) {
+	sigset_t block, orig;
+	if(stop) {
+		if(stop_signals) block = *stop_signals;
+		else {
+			sigemptyset(&block);
+			sigaddset(&block, SIGINT);
+			sigaddset(&block, SIGTERM);
+		}
+		int err = pthread_sigmask(SIG_BLOCK, &block, &orig);
+		if(err) {
+			errno = err;
+			return sys_error(T_ERROR_FOPEN);
+		}
+	}
+	bool ret = true;
+	while(!(stop && *stop))
+		if(!serve_one(stop ? &orig : nullptr) && !(last_error == T_READ_ERROR && sys_errno == EINTR)) {
+			ret = false;
+			break;
+		}
+	if(stop) pthread_sigmask(SIG_SETMASK, &orig, nullptr);
+	return ret;
+}
+
+/* protocol: the client sends the name of the table terminated by a
+ * newline; the server answers with one byte: 0 if the table was found
+ * (in this case, the file descriptor is sent along with it), 1 if not */
+bool table_server::serve_one(const sigset_t* sigmask) {
+	if(sock < 0) {
+		last_error = T_ERROR_FOPEN;
+		return false;
+	}
+	int c;
+	while(true) {
+		struct pollfd pfd = {sock, POLLIN, 0};
+		if(ppoll(&pfd, 1, nullptr, sigmask) < 0) return sys_error(T_READ_ERROR);
+		/* note: the listening socket is non-blocking, in case the
+		 * connection was closed since polling */
+		c = accept4(sock, nullptr, nullptr, SOCK_CLOEXEC);
+		if(c >= 0) break;
+		if(!(errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)) return sys_error(T_READ_ERROR);
+	}
+	/* do not wait too long for clients that do not send anything */
+	struct timeval tv = {1, 0};
+	setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	char buf[256];
+	size_t len = 0;
+	while(len < sizeof(buf)) {
+		ssize_t r = recv(c, buf + len, sizeof(buf) - len, 0);
+		if(r <= 0) break;
+		len += r;
+		if(memchr(buf, '\n', len)) break;
+	}
+	const char* e = (const char*)memchr(buf, '\n', len);
+	if(e) {
+		std::string name(buf, e - buf);
+		int fd = -1;
+		for(const table& x : tables) if(x.name == name) { fd = x.fd; break; }
+		char status = (fd >= 0) ? 0 : 1;
+		struct iovec iov = {&status, 1};
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		union {
+			char buf[CMSG_SPACE(sizeof(int))];
+			struct cmsghdr align;
+		} cbuf;
+		if(fd >= 0) {
+			memset(&cbuf, 0, sizeof(cbuf));
+			msg.msg_control = cbuf.buf;
+			msg.msg_controllen = sizeof(cbuf.buf);
+			struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+			cm->cmsg_level = SOL_SOCKET;
+			cm->cmsg_type = SCM_RIGHTS;
+			cm->cmsg_len = CMSG_LEN(sizeof(int));
+			memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+		}
+		sendmsg(c, &msg, MSG_NOSIGNAL);
+	}
+	::close(c);
+	return true;
+}
+
+
+bool shared_table::open(const char* socket_path, const char* name) {
+	close();
+	last_error = T_OK;
+	sys_errno = 0;
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(!socket_path || !name || strlen(socket_path) >= sizeof(addr.sun_path) || strchr(name, '\n')) {
+		last_error = T_ERROR_FOPEN;
+		return false;
+	}
+	strcpy(addr.sun_path, socket_path);
+	int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(s < 0) return sys_error(T_ERROR_FOPEN);
+	if(connect(s, (struct sockaddr*)&addr, sizeof(addr))) {
+		sys_error(T_ERROR_FOPEN);
+		::close(s);
+		return false;
+	}
+	std::string req(name);
+	req += '\n';
+	if(send(s, req.data(), req.size(), MSG_NOSIGNAL) != (ssize_t)req.size()) {
+		sys_error(T_WRITE_ERROR);
+		::close(s);
+		return false;
+	}
+
+	char status = 1;
+	struct iovec iov = {&status, 1};
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} cbuf;
+	memset(&cbuf, 0, sizeof(cbuf));
+	msg.msg_control = cbuf.buf;
+	msg.msg_controllen = sizeof(cbuf.buf);
+	ssize_t r = recvmsg(s, &msg, MSG_CMSG_CLOEXEC);
+	int err = errno;
+	::close(s);
+	int fd = -1;
+	struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+	if(r == 1 && cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+		memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+	if(r < 0) {
+		errno = err;
+		return sys_error(T_READ_ERROR);
+	}
+	if(r != 1 || status != 0 || fd < 0) {
+		if(fd >= 0) ::close(fd);
+		last_error = (r == 1 && status == 1) ? T_MISSING : T_READ_ERROR;
+		return false;
+	}
+	bool ret = map(fd);
+	::close(fd);
+	return ret;
+}
+
+bool shared_table::map(int fd) {
+	close();
+	last_error = T_OK;
+	sys_errno = 0;
+	struct stat st;
+	if(fstat(fd, &st)) return sys_error(T_READ_ERROR);
+	if((size_t)st.st_size < sizeof(shared_table_header)) return format_error();
+	void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(data == MAP_FAILED) return sys_error(T_READ_ERROR);
+	base = (const char*)data;
+	size = st.st_size;
+	header = (const shared_table_header*)base;
+
+	/* check that the header and columns are valid, so that accessing the
+	 * values stays within the mapping (note: the contents of the strings
+	 * are not checked) */
+	if(memcmp(header->magic, READ_TABLE_SHARED_MAGIC, sizeof(header->magic)) ||
+		header->version != READ_TABLE_SHARED_VERSION || header->size > size ||
+		header->ncols > (size - sizeof(shared_table_header)) / sizeof(shared_table_col)) return format_error();
+	cols = (const shared_table_col*)(base + sizeof(shared_table_header));
+	uint64_t nrows = header->nrows;
+	for(size_t i = 0; i < header->ncols; i++) {
+		const shared_table_col& c = cols[i];
+		if(c.type > SC_DOUBLE || c.offset > header->size || c.size > header->size - c.offset) return format_error();
+		if(c.type == SC_STRING) {
+			if(c.size % sizeof(uint64_t) || c.size / sizeof(uint64_t) != nrows + 1 ||
+				c.str_offset > header->size || c.str_size > header->size - c.str_offset) return format_error();
+			const uint64_t* offsets = (const uint64_t*)(base + c.offset);
+			if(offsets[nrows] != c.str_size) return format_error();
+			for(uint64_t j = 0; j < nrows; j++)
+				if(offsets[j] > offsets[j + 1]) return format_error();
+		}
+		else {
+			size_t tsize = shared_col_type_size((shared_col_type)c.type);
+			if(tsize ? (c.size % tsize || c.size / tsize != nrows) : c.size != 0) return format_error();
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * read_table_serve_test.cpp -- simple test cases for read_table_serve.h
+ *
+ * usage: read_table_serve_test [-n rows] [-k clients] [-r restarts]
+ * 	[-u socket]
+ *
+ * 1. two generated tables (one of the given number of rows, default:
+ * 10000, with integer, string, skipped and double columns, one with
+ * 16-bit and 64-bit integers) are served from a child process on a
+ * temporary socket; the given number of client threads (default: 4)
+ * request both at the same time and compare them to the values loaded
+ * directly; requesting wrong types and a nonexistent table are errors
+ * 2. a server is started and stopped with SIGTERM right away the given
+ * number of times (default: 100); it should always exit, even if the
+ * signal arrives just before it starts waiting for clients
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <sys/wait.h>
+#include "read_table_serve.h"
+
+static volatile sig_atomic_t stop = 0;
+static void stop_handler(int) { stop = 1; }
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* load a table from a string and add it to the server */
+static bool add_table(table_server& srv, table_loader& t, const std::string& input,
+		const char* name, const char* schema) {
+	std::istringstream is(input);
+	read_table2 r(is, line_parser_params().set_delim('\t'));
+	std::vector<shared_col_type> types;
+	if(!parse_shared_types(schema, types) || !t.load(r, types.size())) {
+		r.write_error(stderr);
+		return false;
+	}
+	if(!srv.add_table(name, t, types, 2)) {
+		if(t.get_last_error() != T_OK) t.write_error(std::cerr);
+		else srv.write_error(stderr);
+		return false;
+	}
+	return true;
+}
+
+/* wait for the server process to exit, at most for the given time (in
+ * ms); returns true if it exited normally with status 0 */
+static bool wait_server(pid_t pid, unsigned int ms) {
+	int status;
+	for(unsigned int j = 0; j < ms; j++) {
+		pid_t res = waitpid(pid, &status, WNOHANG);
+		if(res == pid) return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		if(res < 0) return false;
+		usleep(1000);
+	}
+	kill(pid, SIGKILL);
+	waitpid(pid, &status, 0);
+	return false;
+}
+
+
+int main(int argc, char **argv)
+{
+	char* socket_path = 0;
+	int i;
+	size_t nrows = 10000;
+	unsigned int nclients = 4;
+	unsigned int nrestarts = 100;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nrows = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'k':
+			nclients = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'r':
+			nrestarts = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'u':
+			socket_path = argv[i+1];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	bool ret = true;
+
+	std::string input1, input2;
+	for(size_t j = 0; j < nrows; j++) {
+		char tmp[128];
+		snprintf(tmp, sizeof(tmp), "%lu\tname%lu\tskipped\t%.3f\n", (unsigned long)j * 3,
+			(unsigned long)(j % 97), (double)j / 8.0);
+		input1 += tmp;
+	}
+	input2 = "-5\t18446744073709551615\n7\t0\n";
+	table_server srv;
+	table_loader t1, t2;
+	if(!(add_table(srv, t1, input1, "points", "u32,s,x,d") && add_table(srv, t2, input2, "small", "i16,u64")))
+		return 1;
+	const std::vector<uint32_t>* ids;
+	const std::vector<string_view_custom>* names;
+	const std::vector<double>* values;
+	if(!(t1.column(0, ids) && t1.column(1, names) && t1.column(3, values))) {
+		t1.write_error(std::cerr);
+		return 1;
+	}
+
+	char tmp[64];
+	if(!socket_path) {
+		snprintf(tmp, sizeof(tmp), "/tmp/read_table_serve_test.%d", (int)getpid());
+		socket_path = tmp;
+	}
+	if(!srv.listen(socket_path)) {
+		srv.write_error(stderr);
+		return 1;
+	}
+	/* note: installed before starting the server processes, so that
+	 * they can be stopped right away */
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_handler;
+	sigaction(SIGTERM, &sa, 0);
+
+	/* 1. several clients at the same time */
+	pid_t pid = fork();
+	if(pid < 0) {
+		fprintf(stderr,"Error creating the server process!\n");
+		return 1;
+	}
+	if(pid == 0) _exit(srv.run(&stop) ? 0 : 1);
+	{
+		std::atomic<unsigned int> nok(0);
+		auto client = [&]() {
+			shared_table tbl, tbl2, tbl3;
+			const uint32_t* ids2;
+			const double* values2;
+			const int16_t* a;
+			const uint64_t* b;
+			const int64_t* wrong;
+			string_view_custom name;
+			if(!(tbl.open(socket_path, "points") && tbl.column(0, ids2) && tbl.column(3, values2))) {
+				tbl.write_error(stderr);
+				return;
+			}
+			bool ok = tbl.nrows() == nrows && tbl.ncols() == 4 && tbl.col_type(2) == SC_SKIP;
+			for(size_t j = 0; ok && j < nrows; j++)
+				ok = ids2[j] == (*ids)[j] && values2[j] == (*values)[j] && tbl.get_string(1, j, name) &&
+					name.len == (*names)[j].len && !memcmp(name.str, (*names)[j].str, name.len);
+			ok = ok && !tbl.column(0, wrong) && tbl.get_last_error() == T_TYPE &&
+				!tbl.column(2, values2) && !tbl.get_string(3, 0, name);
+			ok = ok && tbl2.open(socket_path, "small") && tbl2.nrows() == 2 && tbl2.column(0, a) &&
+				tbl2.column(1, b) && a[0] == -5 && a[1] == 7 && b[0] == UINT64_MAX && b[1] == 0;
+			ok = ok && !tbl3.open(socket_path, "nonexistent") && tbl3.get_last_error() == T_MISSING;
+			if(ok) nok++;
+		};
+		std::vector<std::thread> clients;
+		for(unsigned int j = 0; j < nclients; j++) clients.emplace_back(client);
+		for(std::thread& th : clients) th.join();
+		ret = check(nok == nclients, "shared tables differ from the directly loaded ones") && ret;
+	}
+	kill(pid, SIGTERM);
+	ret = check(wait_server(pid, 5000), "server process did not exit normally") && ret;
+
+	/* 2. stopping the server right after starting it */
+	for(unsigned int j = 0; j < nrestarts && ret; j++) {
+		pid = fork();
+		if(pid < 0) {
+			fprintf(stderr,"Error creating the server process!\n");
+			return 1;
+		}
+		if(pid == 0) _exit(srv.run(&stop) ? 0 : 1);
+		if(j % 2) usleep(j % 7 * 100);
+		kill(pid, SIGTERM);
+		ret = check(wait_server(pid, 5000), "server process not stopped by the signal") && ret;
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
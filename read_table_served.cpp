@@ -0,0 +1,112 @@
+/*
+ * read_table_served.cpp -- daemon loading tables and sharing them with
+ * 	other processes on the same host (see read_table_serve.h)
+ *
+ * usage: read_table_served -u socket [-t nthreads] [-d delim] [-c comment]
+ * 	-n name -s schema -i input [-n name2 -s schema2 -i input2 ...]
+ *
+ * each table is loaded when its input file (-i) is given, using the
+ * previously given name, schema, delimiter and comment character
+ * schema is a comma-separated list of column types, e.g. -s u32,s,x,d
+ * types: x (skip), s (string), i16, u16, i32, u32, i64, u64, d (double)
+ * the daemon runs until it receives SIGINT or SIGTERM
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <iostream>
+#include "read_table_serve.h"
+
+static volatile sig_atomic_t stop = 0;
+static void stop_handler(int) { stop = 1; }
+
+
+int main(int argc, char **argv)
+{
+	char* socket_path = 0;
+	char* name = 0;
+	char* schema = 0;
+	int i;
+	char delim = 0;
+	char comment = 0;
+	unsigned int nthreads = 1;
+	table_server srv;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'u':
+			socket_path = argv[i+1];
+			i++;
+			break;
+		case 'n':
+			name = argv[i+1];
+			i++;
+			break;
+		case 's':
+			schema = argv[i+1];
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'd':
+			delim = argv[i+1][0];
+			i++;
+			break;
+		case 'c':
+			comment = argv[i+1][0];
+			i++;
+			break;
+		case 'i':
+			{
+				const char* fn = argv[i+1];
+				i++;
+				std::vector<shared_col_type> types;
+				if(!name || !parse_shared_types(schema, types)) {
+					fprintf(stderr,"Missing name or invalid schema for input file %s!\n",fn);
+					return 1;
+				}
+				line_parser_params par;
+				if(delim) par.set_delim(delim);
+				if(comment) par.set_comment(comment);
+				read_table2 r(fn, par);
+				table_loader t;
+				t.set_fn_for_diag(fn);
+				if(!t.load(r, types.size())) {
+					r.write_error(std::cerr);
+					return 1;
+				}
+				if(!srv.add_table(name, t, types, nthreads)) {
+					if(t.get_last_error() != T_OK) t.write_error(std::cerr);
+					else srv.write_error(stderr);
+					return 1;
+				}
+				fprintf(stderr,"Loaded table %s from %s (%lu rows)\n",name,fn,t.nrows());
+			}
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	if(!socket_path || !srv.ntables()) {
+		fprintf(stderr,"Socket path (-u) and at least one table (-n, -s, -i) are required!\n");
+		return 1;
+	}
+
+	/* note: run() only lets these signals arrive while waiting for clients */
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_handler;
+	sigaction(SIGINT, &sa, 0);
+	sigaction(SIGTERM, &sa, 0);
+
+	if(!srv.listen(socket_path) || !srv.run(&stop)) {
+		srv.write_error(stderr);
+		return 1;
+	}
+	return 0;
+}
+
@@ -0,0 +1,360 @@
+/*  -*- C++ -*-
+ * read_table_shm_cache.h -- cache of parsed tables in shared memory
+ * 	(/dev/shm), shared by all processes of a user on the same host
+ *
+ * Tables are stored in the format of read_table_serve.h, each in a
+ * separate file named after a hash of the input file's path, size,
+ * modification time, the schema and the parsing parameters (so a
+ * modified input file is parsed again). The first process requesting a
+ * table parses it while holding a lock (flock() on a separate lock file
+ * for each entry); processes requesting the same table at the same time
+ * wait for the lock, and then map the finished table. Later requests
+ * map the existing file directly, without any locking. New entries are
+ * written to a temporary file and renamed when complete.
+ *
+ * The modification time of entries is updated on each use; when the
+ * total size of entries exceeds the limit, the least recently used ones
+ * are removed (processes that already mapped them can keep using them).
+ *
+ * Entries contain a copy of the input file, so they are only readable by
+ * their owner (and are separate for each user); files in the cache
+ * directory that are not owned by the current user or can be modified by
+ * others are not used.
+ *
+ * Linux only; requires linking with -pthread (as read_table_bulk.h).
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+shm_table_cache cache; // use /dev/shm, with the default size limit
+shared_table tbl;
+if(!cache.get("reference.tsv", "u32,s,x,d", tbl)) cache.write_error(stderr);
+const uint32_t* ids;
+if(!tbl.column(0, ids)) ... // wrong column type
+... // use tbl as if it was received from table_server
+
+ */
+
+#ifndef READ_TABLE_SHM_CACHE_H
+#define READ_TABLE_SHM_CACHE_H
+
+#include "read_table_serve.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <stdlib.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/file.h>
+
+/* default directory and size limit */
+#ifndef READ_TABLE_SHM_CACHE_DIR
+#define READ_TABLE_SHM_CACHE_DIR "/dev/shm"
+#endif
+#ifndef READ_TABLE_SHM_CACHE_LIMIT
+#define READ_TABLE_SHM_CACHE_LIMIT (1024UL*1024UL*1024UL)
+#endif
+
+/* prefix of the names of the cache entries (followed by 16 hex digits) */
+#define READ_TABLE_SHM_CACHE_PREFIX "read_table_cache."
+
+
+class shm_table_cache {
+	protected:
+		std::string dir; /* directory to store entries in */
+		uint64_t limit; /* maximum total size of entries */
+		bool hit = false; /* whether the last request was found in the cache */
+		enum read_table_errors last_error = T_OK;
+		int sys_errno = 0; /* errno of the last failed system call */
+		std::string err_msg; /* message for errors while parsing */
+
+		bool sys_error(enum read_table_errors err) {
+			sys_errno = errno;
+			last_error = err;
+			return false;
+		}
+
+		static void hash_bytes(uint64_t& h, const void* data, size_t len) {
+			const unsigned char* p = (const unsigned char*)data;
+			for(size_t i = 0; i < len; i++) {
+				h ^= p[i];
+				h *= 0x100000001b3ULL;
+			}
+		}
+		template<class T> static void hash_value(uint64_t& h, const T& x) { hash_bytes(h, &x, sizeof(T)); }
+
+		/* file name of the entry for the given input */
+		std::string entry_name(const char* path, const struct stat& st, const char* schema,
+				const line_parser_params& par) const {
+			uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a */
+			hash_bytes(h, path, strlen(path) + 1);
+			hash_value(h, geteuid());
+			hash_value(h, st.st_dev);
+			hash_value(h, st.st_ino);
+			hash_value(h, st.st_size);
+			hash_value(h, st.st_mtim.tv_sec);
+			hash_value(h, st.st_mtim.tv_nsec);
+			hash_bytes(h, schema, strlen(schema) + 1);
+			hash_value(h, par.base);
+			hash_value(h, par.delim);
+			hash_value(h, par.comment);
+			hash_value(h, par.decimal);
+			hash_value(h, par.allow_nan_inf);
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+			return dir + "/" + READ_TABLE_SHM_CACHE_PREFIX + buf;
+		}
+
+		/* try to map an existing entry, and mark it as used; files created
+		 * by other users are not trusted (the name can be found out by
+		 * anyone who can see the input file) */
+		bool attach(const std::string& name, shared_table& tbl) {
+			int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+			if(fd < 0) return false;
+			struct stat st;
+			if(fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 022)) {
+				close(fd);
+				return false;
+			}
+			struct timespec times[2] = {{0, UTIME_OMIT}, {0, UTIME_NOW}};
+			futimens(fd, times); /* note: errors are ignored, this only affects eviction */
+			bool ret = tbl.map(fd);
+			close(fd);
+			return ret;
+		}
+
+		/* parse the input file into a new entry */
+		bool create(const std::string& name, const char* fn, const std::vector<shared_col_type>& types,
+				const line_parser_params& par, unsigned int nthreads, shared_table& tbl);
+
+	public:
+		explicit shm_table_cache(const char* dir_ = READ_TABLE_SHM_CACHE_DIR,
+			uint64_t limit_ = READ_TABLE_SHM_CACHE_LIMIT) : dir(dir_), limit(limit_) { }
+
+		void set_limit(uint64_t limit_) { limit = limit_; }
+		uint64_t get_limit() const { return limit; }
+
+		/* get the table parsed from the given file with the given schema
+		 * (see read_table_serve.h) and parameters, either from the cache,
+		 * or by parsing it with nthreads threads and adding it to the cache;
+		 * returns false on error */
+		bool get(const char* fn, const char* schema, shared_table& tbl,
+			const line_parser_params& par = line_parser_params(), unsigned int nthreads = 1);
+		/* whether the table returned by the last call to get() was found
+		 * in the cache (either existing before or created by another
+		 * process while waiting) */
+		bool last_hit() const { return hit; }
+
+		/* remove the least recently used entries until their total size
+		 * is at most max_size (except for keep, if given); returns the
+		 * number of entries removed */
+		size_t evict(uint64_t max_size, const std::string& keep = std::string());
+		/* remove all entries */
+		size_t clear() { return evict(0); }
+		/* total size of the entries currently in the cache */
+		uint64_t total_size() const;
+
+		enum read_table_errors get_last_error() const { return last_error; }
+		int get_errno() const { return sys_errno; }
+		void write_error(FILE* f) const {
+			if(!f) return;
+			if(err_msg.size()) fprintf(f,"%s",err_msg.c_str());
+			else {
+				fprintf(f,"shm_table_cache: %s",get_error_desc(last_error));
+				if(sys_errno) fprintf(f," (%s)",strerror(sys_errno));
+				fprintf(f,"\n");
+			}
+		}
+
+		/* list the entries of the current user in the cache directory:
+		 * name, size, time of last use */
+		struct entry {
+			std::string name;
+			uint64_t size;
+			struct timespec used;
+		};
+		void list_entries(std::vector<entry>& entries) const;
+};
+
+
+bool shm_table_cache::get(const char* fn, const char* schema, shared_table& tbl,
+		const line_parser_params& par, unsigned int nthreads) {
+	last_error = T_OK;
+	sys_errno = 0;
+	err_msg.clear();
+	hit = false;
+	tbl.close();
+	std::vector<shared_col_type> types;
+	if(!parse_shared_types(schema, types)) {
+		last_error = T_TYPE;
+		return false;
+	}
+	struct stat st;
+	char path[PATH_MAX];
+	if(!fn || !realpath(fn, path) || stat(path, &st)) return sys_error(T_ERROR_FOPEN);
+	std::string name = entry_name(path, st, schema, par);
+
+	/* 1. entry already exists */
+	if(attach(name, tbl)) {
+		hit = true;
+		return true;
+	}
+
+	/* 2. wait until no other process is creating it */
+	std::string lock_name = name + ".lock";
+	int lfd;
+	while(true) {
+		lfd = open(lock_name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC | O_NOFOLLOW, 0600);
+		if(lfd < 0) return sys_error(T_ERROR_FOPEN);
+		int ret;
+		do ret = flock(lfd, LOCK_EX); while(ret && errno == EINTR);
+		if(ret) {
+			sys_error(T_ERROR_FOPEN);
+			close(lfd);
+			return false;
+		}
+		/* the lock file might have been removed (after a failed attempt
+		 * to create the entry, or by evict()) while waiting; in this
+		 * case, others might already use a new one, so try again */
+		struct stat st1, st2;
+		if(!fstat(lfd, &st1) && !stat(lock_name.c_str(), &st2) &&
+			st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino) break;
+		close(lfd);
+	}
+	bool res;
+	if(attach(name, tbl)) {
+		hit = true;
+		res = true;
+	}
+	else res = create(name, path, types, par, nthreads, tbl);
+	/* do not leave the lock file behind if the input cannot be parsed
+	 * (others waiting for it will notice that it was removed) */
+	if(res) evict(limit, name);
+	else unlink(lock_name.c_str());
+	flock(lfd, LOCK_UN);
+	close(lfd);
+	return res;
+}
+
+bool shm_table_cache::create(const std::string& name, const char* fn, const std::vector<shared_col_type>& types,
+		const line_parser_params& par, unsigned int nthreads, shared_table& tbl) {
+	read_table2 r(fn, par);
+	table_loader t;
+	t.set_fn_for_diag(fn);
+	if(!t.load(r, types.size())) {
+		std::ostringstream os;
+		r.write_error(os);
+		err_msg = os.str();
+		last_error = r.get_last_error();
+		return false;
+	}
+
+	/* note: the temporary file is only visible under the final name when complete */
+	std::string tmp_name = name + ".tmp." + std::to_string((long)getpid());
+	int fd = open(tmp_name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+	if(fd < 0) return sys_error(T_WRITE_ERROR);
+	size_t size = 0;
+	enum read_table_errors err = write_shared_table(fd, t, types, nthreads, size);
+	/* entries are read-only once complete: they can only be opened with
+	 * O_RDONLY and mapped with PROT_READ (as done by attach()), and only
+	 * by the owner, as they contain the data of the input file */
+	if(err == T_OK && (fchmod(fd, 0400) || rename(tmp_name.c_str(), name.c_str()))) err = T_WRITE_ERROR;
+	if(err != T_OK) {
+		if(err == T_WRITE_ERROR) sys_error(err);
+		else {
+			std::ostringstream os;
+			t.write_error(os);
+			err_msg = os.str();
+			last_error = err;
+		}
+		close(fd);
+		unlink(tmp_name.c_str());
+		return false;
+	}
+	/* note: the entry is mapped with PROT_READ here as well */
+	bool ret = tbl.map(fd);
+	close(fd);
+	if(!ret) last_error = tbl.get_last_error();
+	return ret;
+}
+
+void shm_table_cache::list_entries(std::vector<entry>& entries) const {
+	entries.clear();
+	DIR* d = opendir(dir.c_str());
+	if(!d) return;
+	const size_t plen = strlen(READ_TABLE_SHM_CACHE_PREFIX);
+	struct dirent* de;
+	while((de = readdir(d))) {
+		if(strlen(de->d_name) != plen + 16 || strncmp(de->d_name, READ_TABLE_SHM_CACHE_PREFIX, plen)) continue;
+		std::string name = dir + "/" + de->d_name;
+		struct stat st;
+		if(lstat(name.c_str(), &st) || !S_ISREG(st.st_mode) || st.st_uid != geteuid()) continue;
+		entries.push_back(entry{name, (uint64_t)st.st_size, st.st_mtim});
+	}
+	closedir(d);
+}
+
+uint64_t shm_table_cache::total_size() const {
+	std::vector<entry> entries;
+	list_entries(entries);
+	uint64_t total = 0;
+	for(const entry& e : entries) total += e.size;
+	return total;
+}
+
+size_t shm_table_cache::evict(uint64_t max_size, const std::string& keep) {
+	std::vector<entry> entries;
+	list_entries(entries);
+	uint64_t total = 0;
+	for(const entry& e : entries) total += e.size;
+	if(total <= max_size) return 0;
+	std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) {
+		return a.used.tv_sec < b.used.tv_sec || (a.used.tv_sec == b.used.tv_sec && a.used.tv_nsec < b.used.tv_nsec);
+	});
+	size_t n = 0;
+	for(const entry& e : entries) {
+		if(total <= max_size) break;
+		if(e.name == keep) continue;
+		/* note: a process holding the lock file of this entry (after
+		 * finding that it does not exist) might create it again, while
+		 * another creates a new lock file; this only results in parsing
+		 * the input twice */
+		if(!unlink(e.name.c_str())) {
+			unlink((e.name + ".lock").c_str());
+			total -= e.size;
+			n++;
+		}
+	}
+	return n;
+}
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * read_table_shm_cache_test.cpp -- simple test cases for read_table_shm_cache.h
+ *
+ * usage: read_table_shm_cache_test [-n processes] [-r rounds] [-l lines]
+ * 	[-D base_dir]
+ *
+ * a generated input file (of the given number of lines, default: 10000)
+ * and a cache are created in a new temporary directory (in base_dir,
+ * default: /dev/shm)
+ * 1. several processes (default: 4) request the same table at the same
+ * time; exactly one of them should parse it, and all should get the same
+ * result as loading the file directly; this is repeated for the given
+ * number of rounds (default: 10), starting from an empty cache each time
+ * 2. the same with an input that cannot be parsed: all processes should
+ * fail without waiting forever, and no files should be left behind
+ * 3. entries are read-only and only readable by the owner, a later
+ * request is found in the cache, and a request with a different schema
+ * evicts it with a small size limit
+ * 4. an entry replaced by a file that others can modify is not used;
+ * a table with invalid string offsets is not mapped
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <iostream>
+#include <sys/wait.h>
+#include "read_table_shm_cache.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* compare the shared table to the directly loaded one */
+static bool compare(shared_table& tbl, table_loader& t) {
+	const uint32_t* ids;
+	const double* values;
+	const std::vector<uint32_t>* ids2;
+	const std::vector<double>* values2;
+	const std::vector<string_view_custom>* names2;
+	if(!(tbl.column(0, ids) && tbl.column(2, values) && t.column(0, ids2) &&
+		t.column(1, names2) && t.column(2, values2))) return false;
+	if(tbl.nrows() != t.nrows()) return false;
+	for(size_t j = 0; j < tbl.nrows(); j++) {
+		string_view_custom name;
+		tbl.get_string(1, j, name);
+		if(ids[j] != (*ids2)[j] || memcmp(values + j, &(*values2)[j], sizeof(double)) ||
+			name.len != (*names2)[j].len || memcmp(name.str, (*names2)[j].str, name.len)) return false;
+	}
+	return true;
+}
+
+/* start nproc processes requesting fn from the cache in dir at the same
+ * time; these exit with 0 if they found the table in the cache, 2 if
+ * they parsed it, 3 if they could not get it, 1 if the result differs
+ * from t; the number of processes exiting with each code is counted in
+ * res (a process not exiting in 10 seconds is counted as 1) */
+static void run_processes(const std::string& dir, const std::string& fn, unsigned int nproc,
+		table_loader& t, unsigned int res[4]) {
+	std::vector<pid_t> pids;
+	for(unsigned int j = 0; j < 4; j++) res[j] = 0;
+	for(unsigned int j = 0; j < nproc; j++) {
+		pid_t pid = fork();
+		if(pid < 0) {
+			res[1]++;
+			continue;
+		}
+		if(pid == 0) {
+			shm_table_cache cache(dir.c_str());
+			shared_table tbl;
+			if(!cache.get(fn.c_str(), "u32,s,d", tbl)) _exit(3);
+			_exit(compare(tbl, t) ? (cache.last_hit() ? 0 : 2) : 1);
+		}
+		pids.push_back(pid);
+	}
+	for(pid_t pid : pids) {
+		int status = 0;
+		pid_t r = 0;
+		for(unsigned int j = 0; j < 10000 && (r = waitpid(pid, &status, WNOHANG)) == 0; j++) usleep(1000);
+		if(r != pid) {
+			kill(pid, SIGKILL);
+			waitpid(pid, &status, 0);
+			res[1]++;
+		}
+		else if(!WIFEXITED(status) || WEXITSTATUS(status) > 3) res[1]++;
+		else res[WEXITSTATUS(status)]++;
+	}
+}
+
+/* write the string to the given file */
+static bool write_file(const std::string& fn, const std::string& data) {
+	FILE* f = fopen(fn.c_str(), "w");
+	if(!f) return false;
+	bool ret = fwrite(data.data(), 1, data.size(), f) == data.size();
+	return (fclose(f) == 0) && ret;
+}
+
+static bool read_file(const std::string& fn, std::string& data) {
+	FILE* f = fopen(fn.c_str(), "r");
+	if(!f) return false;
+	char buf[65536];
+	size_t n;
+	data.clear();
+	while((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+	bool ret = !ferror(f);
+	fclose(f);
+	return ret;
+}
+
+/* count all files in dir (including lock and temporary files) */
+static size_t count_files(const std::string& dir) {
+	DIR* d = opendir(dir.c_str());
+	if(!d) return 0;
+	size_t n = 0;
+	struct dirent* de;
+	while((de = readdir(d))) if(strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) n++;
+	closedir(d);
+	return n;
+}
+
+
+int main(int argc, char **argv)
+{
+	char* base_dir = 0;
+	int i;
+	unsigned int nproc = 4;
+	unsigned int nrounds = 10;
+	size_t nlines = 10000;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nproc = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'r':
+			nrounds = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'l':
+			nlines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'D':
+			base_dir = argv[i+1];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	std::string dir = std::string(base_dir ? base_dir : READ_TABLE_SHM_CACHE_DIR) + "/read_table_shm_cache_test.XXXXXX";
+	if(!mkdtemp(&dir[0])) {
+		fprintf(stderr,"Error creating temporary directory %s!\n",dir.c_str());
+		return 1;
+	}
+	std::string input;
+	for(size_t j = 0; j < nlines; j++)
+		input += std::to_string(j * 7) + "\tname" + std::to_string(j % 101) + "\t" + std::to_string(j / 4.0) + "\n";
+	std::string fn = dir + "/input.tsv";
+	std::string fn_bad = dir + "/bad.tsv";
+	if(!(write_file(fn, input) && write_file(fn_bad, input + "1\tx\tnot_a_number\n"))) {
+		fprintf(stderr,"Error writing the input files!\n");
+		return 1;
+	}
+	read_table2 r(fn.c_str());
+	table_loader t;
+	if(!t.load(r, 3)) {
+		r.write_error(std::cerr);
+		return 1;
+	}
+	bool ret = true;
+	shm_table_cache cache(dir.c_str());
+	unsigned int res[4];
+
+	/* 1. concurrent requests */
+	for(unsigned int j = 0; j < nrounds && ret; j++) {
+		cache.clear();
+		run_processes(dir, fn, nproc, t, res);
+		ret = check(res[0] == nproc - 1 && res[2] == 1, "concurrent requests should be parsed once") && ret;
+		ret = check(count_files(dir) == 4, "extra files left behind") && ret; /* inputs, entry, lock */
+	}
+
+	/* 2. concurrent requests, input with an error */
+	run_processes(dir, fn_bad, nproc, t, res);
+	ret = check(res[3] == nproc, "error in the input not reported by all processes") && ret;
+	ret = check(count_files(dir) == 4, "files left behind after an error") && ret;
+	shared_table tbl;
+	ret = check(!cache.get(fn_bad.c_str(), "u32,s,d", tbl) && cache.get_last_error() == T_FORMAT,
+		"error in the input not reported") && ret;
+
+	/* 3. entries are read-only; a later request is found in the cache */
+	std::vector<shm_table_cache::entry> entries;
+	cache.list_entries(entries);
+	struct stat st, st2;
+	ret = check(entries.size() == 1 && !stat(entries[0].name.c_str(), &st) && !(st.st_mode & 0222),
+		"cache entry is writable") && ret;
+	ret = check(entries.size() == 1 && (st.st_mode & 0777) == 0400 &&
+		!stat((entries[0].name + ".lock").c_str(), &st2) && (st2.st_mode & 0777) == 0600,
+		"cache entry or lock file accessible by others") && ret;
+	ret = check(cache.get(fn.c_str(), "u32,s,d", tbl) && cache.last_hit() && compare(tbl, t),
+		"table not found in the cache") && ret;
+
+	/* 4. files that others could have written are not used */
+	std::string data;
+	if(entries.size() == 1 && read_file(entries[0].name, data)) {
+		/* string offsets of the second column pointing outside of the strings */
+		std::string bad_fn = dir + "/bad_table";
+		std::string bad = data;
+		shared_table_col c;
+		memcpy(&c, &bad[sizeof(shared_table_header) + sizeof(shared_table_col)], sizeof(c));
+		uint64_t x = c.str_size + 1000;
+		memcpy(&bad[c.offset + sizeof(uint64_t)], &x, sizeof(x));
+		shared_table tbl3;
+		int fd = -1;
+		ret = check(write_file(bad_fn, bad) && (fd = open(bad_fn.c_str(), O_RDONLY)) >= 0 &&
+			!tbl3.map(fd) && tbl3.get_last_error() == T_FORMAT, "invalid string offsets not detected") && ret;
+		if(fd >= 0) close(fd);
+		unlink(bad_fn.c_str());
+
+		/* valid table, but writable by others: parsed again */
+		unlink(entries[0].name.c_str());
+		ret = check(write_file(entries[0].name, data) && !chmod(entries[0].name.c_str(), 0666) &&
+			cache.get(fn.c_str(), "u32,s,d", tbl) && !cache.last_hit() && compare(tbl, t) &&
+			!stat(entries[0].name.c_str(), &st) && (st.st_mode & 0777) == 0400,
+			"entry writable by others used") && ret;
+	}
+	else ret = check(false, "cannot read the cache entry") && ret;
+
+	/* another schema is a new entry; with a small limit, the older one is removed */
+	cache.set_limit(1);
+	shared_table tbl2;
+	ret = check(cache.get(fn.c_str(), "u32,x,d", tbl2) && !cache.last_hit(), "creating a new entry") && ret;
+	cache.list_entries(entries);
+	ret = check(entries.size() == 1 && tbl2.col_type(1) == SC_SKIP, "older entry not evicted") && ret;
+	/* the evicted table can still be used */
+	ret = check(compare(tbl, t), "evicted table changed") && ret;
+
+	cache.clear();
+	unlink(fn.c_str());
+	unlink(fn_bad.c_str());
+	ret = check(count_files(dir) == 0, "files left behind") && ret;
+	rmdir(dir.c_str());
+	if(ret) fprintf(stdout,"All tests passed\n");
+	else cache.write_error(stderr);
+	return ret ? 0 : 1;
+}
+
@@ -0,0 +1,137 @@
+/*
+ * read_table_sort.cpp -- sort a text file by a numeric column
+ * 	(similar to sort -s -n -k, but the key is only parsed once per line)
+ *
+ * usage: read_table_sort -k 2 [-T i64|u64|d] [-i input] [-o output] [-d delim]
+ * 	[-c comment] [-t nthreads] [-m run_size_MiB] [-r max_runs] [-D tmp_dir]
+ *
+ * columns are numbered from 1; the key is parsed as a 64-bit signed
+ * integer by default (-T i64), or as an unsigned integer or a double;
+ * lines with invalid keys are reported as an error; the sort is stable;
+ * at most max_runs temporary files are merged at once (default: 64);
+ * input is read from stdin and output is written to stdout by default
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <iostream>
+#include "read_table_sort.h"
+
+
+template<class K>
+static int sort_file(size_t key_col, const line_parser_params& par, size_t run_size, size_t max_runs,
+		unsigned int nthreads, const char* tmp_dir, const char* fn, FILE* out) {
+	external_sort<K> s(key_col, par, run_size, nthreads, tmp_dir);
+	s.set_max_runs(max_runs);
+	read_table2 r(fn, std::cin, par);
+	if(!s.add(r)) {
+		s.write_error(stderr);
+		return 1;
+	}
+	size_t nruns = s.nruns();
+	uint64_t nlines = s.nlines();
+	if(!s.write(out)) {
+		s.write_error(stderr);
+		return 1;
+	}
+	fprintf(stderr,"Sorted %lu lines (%lu runs written to temporary files)\n",nlines,nruns);
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	char* fn = 0;
+	char* out_fn = 0;
+	const char* type = "i64";
+	const char* tmp_dir = 0;
+	size_t key = 0;
+	int i;
+	char delim = 0;
+	char comment = 0;
+	unsigned int nthreads = 1;
+	size_t run_size = READ_TABLE_SORT_RUN_SIZE;
+	size_t max_runs = READ_TABLE_SORT_MAX_RUNS;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'i':
+			fn = argv[i+1];
+			i++;
+			break;
+		case 'o':
+			out_fn = argv[i+1];
+			i++;
+			break;
+		case 'k':
+			key = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'T':
+			type = argv[i+1];
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'd':
+			delim = argv[i+1][0];
+			i++;
+			break;
+		case 'c':
+			comment = argv[i+1][0];
+			i++;
+			break;
+		case 'm':
+			run_size = strtoul(argv[i+1],0,10) * 1024UL * 1024UL;
+			i++;
+			break;
+		case 'r':
+			max_runs = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'D':
+			tmp_dir = argv[i+1];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	if(!key) {
+		fprintf(stderr,"No key column given (use -k)!\n");
+		return 1;
+	}
+	if(!nthreads) nthreads = std::thread::hardware_concurrency();
+
+	line_parser_params par;
+	if(delim) par.set_delim(delim);
+	if(comment) par.set_comment(comment);
+
+	FILE* out = stdout;
+	if(out_fn) {
+		out = fopen(out_fn,"w");
+		if(!out) {
+			fprintf(stderr,"Error opening output file %s!\n",out_fn);
+			return 1;
+		}
+	}
+
+	int ret;
+	if(!strcmp(type,"i64")) ret = sort_file<int64_t>(key - 1, par, run_size, max_runs, nthreads, tmp_dir, fn, out);
+	else if(!strcmp(type,"u64")) ret = sort_file<uint64_t>(key - 1, par, run_size, max_runs, nthreads, tmp_dir, fn, out);
+	else if(!strcmp(type,"d")) ret = sort_file<double>(key - 1, par, run_size, max_runs, nthreads, tmp_dir, fn, out);
+	else {
+		fprintf(stderr,"Unknown key type: %s!\n",type);
+		ret = 1;
+	}
+
+	if(out != stdout && fclose(out) && !ret) {
+		fprintf(stderr,"Error writing output file %s!\n",out_fn);
+		ret = 1;
+	}
+	return ret;
+}
@@ -0,0 +1,491 @@
+/*  -*- C++ -*-
+ * read_table_sort.h -- external sort of large text files by a key column
+ *
+ * Lines are read in batches with read_table2::read_lines(), and the key
+ * (an integer or floating point column) is parsed once for each line.
+ * Lines are collected in runs of a given size (the text and the parsed
+ * keys together); each run is sorted by the key in parallel (sorting
+ * separate parts in each thread, then merging them) and written to a
+ * temporary file as (key, length, line) records. In the end, the runs are
+ * merged, and the lines are given in sorted order to a callback function
+ * (with the parsed key), or are written to an output file. If the input
+ * fits in one run, nothing is written to temporary files. At most a given
+ * number of runs are merged at once (default: READ_TABLE_SORT_MAX_RUNS):
+ * when this many runs of the same length are written, they are merged
+ * into a new, longer run right away (so the number of open files grows
+ * only with the logarithm of the input size), and in the end, groups of
+ * the remaining runs are merged until few enough are left.
+ *
+ * The sort is stable: lines with the same key keep their order in the
+ * input. Temporary files are created in the given directory (default:
+ * TMPDIR or /tmp) and are removed right after they are created, so
+ * that nothing is left behind even if the program is stopped.
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ * example usage:
+
+// sort by the second column (timestamps as 64-bit integers)
+external_sort<int64_t> s(1, line_parser_params().set_delim('\t'));
+read_table2 r("input.tsv");
+if(!s.add(r)) ... // handle error
+if(!s.write(stdout)) ... // handle error
+// or, instead of write(), process the sorted lines directly
+s.merge([](const int64_t& key, const char* line, size_t len) {
+	... // use key and line
+	return true; // return false to stop
+});
+if(s.get_last_error() != T_OK) s.write_error(stderr);
+
+ */
+
+#ifndef READ_TABLE_SORT_H
+#define READ_TABLE_SORT_H
+
+#include "read_table_cpp.h"
+#include <vector>
+#include <string>
+#include <queue>
+#include <thread>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/* default size of runs (memory used for sorting) */
+#ifndef READ_TABLE_SORT_RUN_SIZE
+#define READ_TABLE_SORT_RUN_SIZE (256UL*1024UL*1024UL)
+#endif
+/* maximum number of runs merged at once (fan-in) */
+#ifndef READ_TABLE_SORT_MAX_RUNS
+#define READ_TABLE_SORT_MAX_RUNS 64
+#endif
+/* size of the buffer used for each temporary file */
+#ifndef READ_TABLE_SORT_FILE_BUFFER
+#define READ_TABLE_SORT_FILE_BUFFER (1024UL*1024UL)
+#endif
+
+
+template<class K>
+class external_sort {
+	protected:
+		/* one line in the current run */
+		struct record {
+			K key;
+			uint32_t len;
+			uint64_t start; /* start of the line in text */
+		};
+		/* one run stored in a temporary file while merging */
+		struct run_reader {
+			FILE* f = nullptr;
+			K key;
+			std::string line;
+			/* read the next record; returns false at the end of the run
+			 * (sets err if this was due to an error) */
+			bool next(bool& err) {
+				uint32_t len;
+				if(fread(&key, sizeof(K), 1, f) != 1) { err = !feof(f); return false; }
+				if(fread(&len, sizeof(uint32_t), 1, f) != 1) { err = true; return false; }
+				line.resize(len);
+				if(len && fread(&line[0], 1, len, f) != len) { err = true; return false; }
+				return true;
+			}
+		};
+
+		size_t key_col; /* column of the key (starting from 0) */
+		const line_parser_params par;
+		size_t run_size; /* maximum memory used for one run (approximately) */
+		size_t max_runs = READ_TABLE_SORT_MAX_RUNS; /* maximum number of runs merged at once */
+		unsigned int nthreads;
+		std::string tmp_dir;
+		std::vector<char> text; /* lines in the current run */
+		std::vector<record> recs; /* keys of the lines in the current run */
+		std::vector<FILE*> runs; /* runs written to temporary files */
+		std::vector<unsigned int> run_level; /* number of times each run was merged from shorter ones */
+		size_t nspilled = 0; /* number of runs written from memory */
+		uint64_t total_lines = 0;
+		read_table_mem_tracker mem; /* memory used by text and recs */
+		enum read_table_errors last_error = T_OK;
+		int sys_errno = 0;
+		std::string err_msg;
+
+		static bool key_less(const record& x, const record& y) { return x.key < y.key; }
+
+		bool set_error(enum read_table_errors err, const char* msg, int errno_ = 0) {
+			last_error = err;
+			sys_errno = errno_;
+			err_msg = std::string("external_sort: ") + msg;
+			if(sys_errno) { err_msg += " ("; err_msg += strerror(sys_errno); err_msg += ")"; }
+			err_msg += "\n";
+			return false;
+		}
+
+		/* sort the current run, using nthreads threads */
+		void sort_run();
+		/* create a new temporary file; returns nullptr on error */
+		FILE* new_run();
+		/* write the current run to a new temporary file and clear it */
+		bool spill();
+		/* merge n runs starting at first, calling f(key, line, len) for
+		 * each line in sorted order; returns false on error or if f
+		 * returned false (note: runs are not closed) */
+		template<class F> bool merge_runs(size_t first, size_t n, F&& f);
+		/* merge n runs starting at first into one new run, replacing them */
+		bool merge_group(size_t first, size_t n);
+		/* merge groups of max_runs runs into new runs */
+		bool merge_pass();
+		/* add one line to the current run, parsing its key with lp */
+		bool add_line(line_parser& lp, const line_view& v, const char* fn);
+
+	public:
+		/* sort by column key_col_ (starting from 0), parsed as type K (an
+		 * integer type or double) using the given parameters; runs are at
+		 * most run_size_ bytes (including the keys), sorted using nthreads_
+		 * threads, and stored in tmp_dir_ (if NULL, TMPDIR or /tmp) */
+		explicit external_sort(size_t key_col_, const line_parser_params& par_ = line_parser_params(),
+				size_t run_size_ = READ_TABLE_SORT_RUN_SIZE, unsigned int nthreads_ = 1,
+				const char* tmp_dir_ = nullptr) : key_col(key_col_), par(par_), run_size(run_size_),
+				nthreads(nthreads_ ? nthreads_ : 1) {
+			if(!tmp_dir_) tmp_dir_ = getenv("TMPDIR");
+			tmp_dir = (tmp_dir_ && tmp_dir_[0]) ? tmp_dir_ : "/tmp";
+		}
+		external_sort(const external_sort&) = delete;
+		external_sort& operator = (const external_sort&) = delete;
+		~external_sort() { clear(); }
+
+		/* read all lines from r (empty and comment lines are skipped); can
+		 * be called multiple times to sort several inputs together; all
+		 * fields before the key are skipped, any fields after are ignored;
+		 * returns false on error */
+		bool add(read_table2& r);
+
+		/* merge the runs, calling f(key, line, len) for each line in sorted
+		 * order; f should return false to stop; afterwards, everything
+		 * added before is removed; returns false on error or if f
+		 * returned false (in this case, get_last_error() returns T_OK) */
+		template<class F> bool merge(F&& f);
+		/* write the sorted lines to out, each followed by a newline */
+		bool write(FILE* out);
+
+		/* remove all lines added before and the temporary files */
+		void clear();
+
+		/* set the maximum number of runs merged at once (at least 2) */
+		void set_max_runs(size_t max_runs_) { max_runs = max_runs_ < 2 ? 2 : max_runs_; }
+
+		/* count the memory used by the current run in m (in addition to the
+		 * global account, see read_table_memory.h); adding lines fails with
+		 * T_MEMORY if this would exceed the limit of either */
+		void set_memory(read_table_mem* m) { mem.set_account(m); mem.update(text.capacity() + recs.capacity() * sizeof(record)); }
+
+		uint64_t nlines() const { return total_lines; }
+		/* number of runs written to temporary files so far */
+		size_t nruns() const { return nspilled; }
+		/* number of temporary files currently used (these are longer
+		 * runs if some were already merged) */
+		size_t nfiles() const { return runs.size(); }
+
+		enum read_table_errors get_last_error() const { return last_error; }
+		int get_errno() const { return sys_errno; }
+		void write_error(FILE* f) const {
+			if(!f) return;
+			if(err_msg.size()) fprintf(f,"%s",err_msg.c_str());
+			else fprintf(f,"external_sort: %s\n",get_error_desc(last_error));
+		}
+};
+
+
+template<class K>
+bool external_sort<K>::add_line(line_parser& lp, const line_view& v, const char* fn) {
+	K key;
+	lp.assign_line(v.str, v.len);
+	for(size_t i = 0; i < key_col; i++) if(!lp.read_skip()) break;
+	if(lp.get_last_error() == T_OK) lp.read_next(key);
+	/* note: NaN values cannot be ordered */
+	if(lp.get_last_error() == T_OK && std::is_floating_point<K>::value && std::isnan((double)key)) {
+		lp.reset_pos();
+		for(size_t i = 0; i < key_col; i++) lp.read_skip();
+		last_error = T_NAN;
+	}
+	else last_error = lp.get_last_error();
+	if(last_error != T_OK) {
+		char buf[64];
+		snprintf(buf, sizeof(buf), "line %lu, position %lu / column %lu: ", (unsigned long)v.line,
+			(unsigned long)lp.get_pos(), (unsigned long)lp.get_col());
+		err_msg = "read_table, ";
+		if(fn) { err_msg += "file "; err_msg += fn; err_msg += ", "; }
+		else err_msg += "input ";
+		err_msg += buf;
+		err_msg += get_error_desc(last_error);
+		err_msg += "\n";
+		return false;
+	}
+	if(v.len > UINT32_MAX) return set_error(T_OVERFLOW, "line too long");
+	/* start a new run if this line does not fit in the current one */
+	if(recs.size() && text.size() + v.len + (recs.size() + 1) * sizeof(record) > run_size)
+		if(!spill()) return false;
+	/* note: the buffers are counted before growing them */
+	size_t text_cap = read_table_grown_capacity(text, v.len);
+	size_t recs_cap = read_table_grown_capacity(recs, 1);
+	if(text_cap != text.capacity() || recs_cap != recs.capacity()) {
+		if(!mem.update(text_cap + recs_cap * sizeof(record)))
+			return set_error(T_MEMORY, get_error_desc(T_MEMORY));
+		text.reserve(text_cap);
+		recs.reserve(recs_cap);
+	}
+	record x;
+	x.key = key;
+	x.len = v.len;
+	x.start = text.size();
+	text.insert(text.end(), v.str, v.str + v.len);
+	recs.push_back(x);
+	total_lines++;
+	return true;
+}
+
+template<class K>
+bool external_sort<K>::add(read_table2& r) {
+	last_error = T_OK;
+	sys_errno = 0;
+	err_msg.clear();
+	line_parser lp(par);
+	std::vector<line_view> batch;
+	while(r.read_lines(batch))
+		for(const line_view& v : batch) if(!add_line(lp, v, r.get_fn())) return false;
+	if(r.get_last_error() != T_EOF) {
+		last_error = r.get_last_error();
+		err_msg = r.exception_string();
+		return false;
+	}
+	return true;
+}
+
+template<class K>
+void external_sort<K>::sort_run() {
+	size_t n = recs.size();
+	size_t nparts = nthreads;
+	if(nparts > n / 1024) nparts = n / 1024; /* note: not worth using threads for small runs */
+	if(nparts < 2) {
+		std::stable_sort(recs.begin(), recs.end(), key_less);
+		return;
+	}
+	/* sort nparts parts in parallel, then merge pairs of them in parallel */
+	std::vector<size_t> bounds(nparts + 1);
+	for(size_t i = 0; i <= nparts; i++) bounds[i] = (n * i) / nparts;
+	std::vector<std::thread> threads;
+	for(size_t i = 0; i < nparts; i++) threads.emplace_back([this, &bounds, i]() {
+		std::stable_sort(recs.begin() + bounds[i], recs.begin() + bounds[i+1], key_less);
+	});
+	for(auto& th : threads) th.join();
+	while(bounds.size() > 2) {
+		threads.clear();
+		std::vector<size_t> next;
+		for(size_t i = 0; i + 1 < bounds.size(); i += 2) {
+			next.push_back(bounds[i]);
+			if(i + 2 < bounds.size()) threads.emplace_back([this, &bounds, i]() {
+				std::inplace_merge(recs.begin() + bounds[i], recs.begin() + bounds[i+1],
+					recs.begin() + bounds[i+2], key_less);
+			});
+		}
+		next.push_back(n);
+		for(auto& th : threads) th.join();
+		bounds.swap(next);
+	}
+}
+
+template<class K>
+FILE* external_sort<K>::new_run() {
+	std::string fn = tmp_dir + "/read_table_sort.XXXXXX";
+	int fd = mkstemp(&fn[0]);
+	if(fd < 0) {
+		set_error(T_WRITE_ERROR, "cannot create temporary file", errno);
+		return nullptr;
+	}
+	unlink(fn.c_str()); /* note: removed when closed */
+	FILE* f = fdopen(fd, "w+b");
+	if(!f) {
+		int e = errno;
+		close(fd);
+		set_error(T_WRITE_ERROR, "cannot create temporary file", e);
+		return nullptr;
+	}
+	setvbuf(f, nullptr, _IOFBF, READ_TABLE_SORT_FILE_BUFFER);
+	return f;
+}
+
+template<class K>
+bool external_sort<K>::spill() {
+	sort_run();
+	FILE* f = new_run();
+	if(!f) return false;
+	runs.push_back(f);
+	run_level.push_back(0);
+	for(const record& x : recs) {
+		if(fwrite(&x.key, sizeof(K), 1, f) != 1 || fwrite(&x.len, sizeof(uint32_t), 1, f) != 1 ||
+			(x.len && fwrite(text.data() + x.start, 1, x.len, f) != x.len))
+			return set_error(T_WRITE_ERROR, "error writing temporary file", errno);
+	}
+	if(fflush(f)) return set_error(T_WRITE_ERROR, "error writing temporary file", errno);
+	text.clear();
+	recs.clear();
+	nspilled++;
+	/* merge the last max_runs runs if these have the same length */
+	while(runs.size() >= max_runs) {
+		size_t first = runs.size() - max_runs;
+		size_t i = first + 1;
+		for(; i < runs.size(); i++) if(run_level[i] != run_level[first]) break;
+		if(i < runs.size()) break;
+		if(!merge_group(first, max_runs)) return false;
+	}
+	return true;
+}
+
+template<class K> template<class F>
+bool external_sort<K>::merge(F&& f) {
+	last_error = T_OK;
+	sys_errno = 0;
+	err_msg.clear();
+	bool ret = true;
+	if(runs.empty()) {
+		/* everything fits in memory */
+		sort_run();
+		for(const record& x : recs) if(!f(x.key, text.data() + x.start, (size_t)x.len)) { ret = false; break; }
+		clear();
+		return ret;
+	}
+	if(recs.size() && !spill()) { clear(); return false; }
+	/* free the memory used for the runs, it is not needed anymore */
+	std::vector<char>().swap(text);
+	std::vector<record>().swap(recs);
+	mem.update(0);
+
+	while(runs.size() > max_runs) if(!merge_pass()) { clear(); return false; }
+	ret = merge_runs(0, runs.size(), f);
+	clear();
+	return ret;
+}
+
+template<class K> template<class F>
+bool external_sort<K>::merge_runs(size_t first, size_t n, F&& f) {
+	std::vector<run_reader> readers(n);
+	/* heap of the current record of each run; ties are broken by the
+	 * order of runs, so that the sort is stable */
+	auto cmp = [&readers](size_t i, size_t j) {
+		return readers[j].key < readers[i].key || (!(readers[i].key < readers[j].key) && j < i);
+	};
+	std::priority_queue<size_t, std::vector<size_t>, decltype(cmp)> heap(cmp);
+	bool err = false;
+	bool ret = true;
+	for(size_t i = 0; i < n; i++) {
+		readers[i].f = runs[first + i];
+		if(fseek(readers[i].f, 0, SEEK_SET)) { err = true; break; }
+		if(readers[i].next(err)) heap.push(i);
+		if(err) break;
+	}
+	while(!err && !heap.empty()) {
+		size_t i = heap.top();
+		heap.pop();
+		run_reader& rd = readers[i];
+		if(!f(rd.key, rd.line.data(), rd.line.size())) { ret = false; break; }
+		if(rd.next(err)) heap.push(i);
+	}
+	if(err) ret = set_error(T_READ_ERROR, "error reading temporary file", errno);
+	return ret;
+}
+
+/* note: only consecutive runs are merged, which keeps their order, so
+ * the sort stays stable */
+template<class K>
+bool external_sort<K>::merge_group(size_t first, size_t n) {
+	FILE* out = new_run();
+	if(!out) return false;
+	int write_err = -1;
+	bool ret = merge_runs(first, n, [out, &write_err](const K& key, const char* line, size_t len) {
+		uint32_t len1 = (uint32_t)len;
+		if(fwrite(&key, sizeof(K), 1, out) != 1 || fwrite(&len1, sizeof(uint32_t), 1, out) != 1 ||
+			(len && fwrite(line, 1, len, out) != len)) { write_err = errno; return false; }
+		return true;
+	});
+	if(write_err >= 0) ret = set_error(T_WRITE_ERROR, "error writing temporary file", write_err);
+	else if(ret && fflush(out)) ret = set_error(T_WRITE_ERROR, "error writing temporary file", errno);
+	if(!ret) {
+		fclose(out);
+		return false;
+	}
+	unsigned int level = 0;
+	for(size_t i = first; i < first + n; i++) {
+		fclose(runs[i]);
+		if(run_level[i] > level) level = run_level[i];
+	}
+	runs.erase(runs.begin() + first + 1, runs.begin() + first + n);
+	run_level.erase(run_level.begin() + first + 1, run_level.begin() + first + n);
+	runs[first] = out;
+	run_level[first] = level + 1;
+	return true;
+}
+
+template<class K>
+bool external_sort<K>::merge_pass() {
+	for(size_t i = 0; i + 1 < runs.size(); i++) {
+		size_t n = (runs.size() - i < max_runs) ? runs.size() - i : max_runs;
+		if(!merge_group(i, n)) return false;
+	}
+	return true;
+}
+
+template<class K>
+bool external_sort<K>::write(FILE* out) {
+	int write_err = -1;
+	bool ret = merge([out, &write_err](const K&, const char* line, size_t len) {
+		if(fwrite(line, 1, len, out) != len || fputc('\n', out) == EOF) { write_err = errno; return false; }
+		return true;
+	});
+	if(write_err >= 0) return set_error(T_WRITE_ERROR, "error writing output", write_err);
+	/* note: errors can also be reported only when the buffer is flushed */
+	if(ret && (fflush(out) || ferror(out))) return set_error(T_WRITE_ERROR, "error writing output", errno);
+	return ret;
+}
+
+template<class K>
+void external_sort<K>::clear() {
+	for(FILE* f : runs) fclose(f);
+	runs.clear();
+	run_level.clear();
+	nspilled = 0;
+	std::vector<char>().swap(text);
+	std::vector<record>().swap(recs);
+	mem.update(0);
+	total_lines = 0;
+}
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * read_table_sort_test.cpp -- simple test cases for read_table_sort.h
+ *
+ * usage: read_table_sort_test [-n lines] [-m run_size] [-r max_runs]
+ * 	[-t threads] [-D tmp_dir]
+ *
+ * a generated input of the given number of lines (default: 20000, with
+ * few distinct keys, so that there are many lines with the same key) is
+ * sorted by its first column, and the result is compared to the one
+ * given by std::stable_sort()
+ * 1. the whole input fits in memory
+ * 2. small runs (run_size bytes, default: 4096) are written to temporary
+ * files (in tmp_dir, default: TMPDIR or /tmp) and merged at most max_runs
+ * (default: 4) at once, i.e. in several passes, keeping only a few files
+ * open; both with one and with the given number of threads (default: 4)
+ * 3. the output is written to a file; writing to /dev/full fails
+ * 4. errors: invalid key, NaN key, stopping in the callback
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include <sstream>
+#include "read_table_sort.h"
+
+
+static bool check(bool cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* one generated line and its key */
+struct test_line {
+	int64_t key;
+	std::string line;
+};
+
+/* sort the input with s, comparing the keys and lines given to the
+ * callback to the expected ones */
+static bool test_merge(external_sort<int64_t>& s, const std::string& input,
+		const std::vector<test_line>& expected) {
+	std::istringstream is(input);
+	read_table2 r(is, line_parser_params().set_delim('\t'));
+	if(!s.add(r)) {
+		s.write_error(stderr);
+		return false;
+	}
+	if(s.nlines() != expected.size()) return false;
+	size_t i = 0;
+	bool ok = true;
+	bool ret = s.merge([&](const int64_t& key, const char* line, size_t len) {
+		if(i >= expected.size() || key != expected[i].key || len != expected[i].line.size() ||
+			memcmp(line, expected[i].line.data(), len)) ok = false;
+		i++;
+		return ok;
+	});
+	if(!ret && s.get_last_error() != T_OK) s.write_error(stderr);
+	return ret && ok && i == expected.size() && s.nruns() == 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	size_t nlines = 20000;
+	size_t run_size = 4096;
+	size_t max_runs = 4;
+	unsigned int nthreads = 4;
+	const char* tmp_dir = 0;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nlines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'm':
+			run_size = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'r':
+			max_runs = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'D':
+			tmp_dir = argv[i+1];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	if(max_runs < 2) max_runs = 2;
+	bool ret = true;
+
+	/* note: the second column is the line number, to check that lines
+	 * with the same key keep their order */
+	std::string input;
+	std::vector<test_line> expected(nlines);
+	uint64_t x = 1;
+	for(size_t j = 0; j < nlines; j++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		test_line& l = expected[j];
+		l.key = (int64_t)((x >> 33) % 200) - 100;
+		l.line = std::to_string(l.key) + "\t" + std::to_string(j) + "\t" + std::string((x >> 20) % 50, 'a');
+		input += l.line + "\n";
+	}
+	std::stable_sort(expected.begin(), expected.end(),
+		[](const test_line& a, const test_line& b) { return a.key < b.key; });
+
+	/* 1. everything in memory */
+	{
+		external_sort<int64_t> s(0, line_parser_params().set_delim('\t'), SIZE_MAX, nthreads, tmp_dir);
+		ret = check(test_merge(s, input, expected), "wrong result when sorting in memory") && ret;
+	}
+
+	/* 2. small runs, merged in several passes */
+	for(unsigned int t = 1; t <= nthreads; t += (nthreads > 1 ? nthreads - 1 : 1)) {
+		external_sort<int64_t> s(0, line_parser_params().set_delim('\t'), run_size, t, tmp_dir);
+		s.set_max_runs(max_runs);
+		std::istringstream is(input);
+		read_table2 r(is, line_parser_params().set_delim('\t'));
+		ret = check(s.add(r) && s.nruns() > max_runs * max_runs, "too few runs, use a smaller run size") && ret;
+		/* runs are merged while adding them, at most max_runs - 1 files
+		 * remain from each pass */
+		size_t npasses = 0;
+		for(size_t k = 1; k < s.nruns(); k *= max_runs) npasses++;
+		ret = check(s.nfiles() <= (max_runs - 1) * npasses + 1, "too many temporary files") && ret;
+		s.clear();
+		ret = check(test_merge(s, input, expected), "wrong result when merging runs") && ret;
+	}
+
+	/* 3. writing the output */
+	{
+		external_sort<int64_t> s(0, line_parser_params().set_delim('\t'), run_size, nthreads, tmp_dir);
+		s.set_max_runs(max_runs);
+		std::istringstream is(input);
+		read_table2 r(is, line_parser_params().set_delim('\t'));
+		FILE* f = tmpfile();
+		std::string output(input.size() + 1, 0);
+		ret = check(f && s.add(r) && s.write(f) && !fseek(f, 0, SEEK_SET) &&
+			fread(&output[0], 1, output.size(), f) == input.size(), "writing the output") && ret;
+		output.resize(input.size());
+		std::string output2;
+		for(const test_line& l : expected) output2 += l.line + "\n";
+		ret = check(output == output2, "wrong output") && ret;
+		if(f) fclose(f);
+
+		/* note: the error is only detected when the buffer is flushed */
+		FILE* full = fopen("/dev/full", "w");
+		if(full) {
+			std::istringstream is2(input);
+			read_table2 r2(is2, line_parser_params().set_delim('\t'));
+			ret = check(s.add(r2) && !s.write(full) && s.get_last_error() == T_WRITE_ERROR,
+				"write error not detected") && ret;
+			fclose(full);
+		}
+	}
+
+	/* 4. errors */
+	{
+		external_sort<int64_t> s(1, line_parser_params().set_delim('\t'), run_size, nthreads, tmp_dir);
+		std::istringstream is("a\t1\nb\t2\nc\tx\n");
+		read_table2 r(is, line_parser_params().set_delim('\t'));
+		ret = check(!s.add(r) && s.get_last_error() == T_FORMAT, "invalid key not detected") && ret;
+		s.clear();
+		external_sort<double> s2(0);
+		std::istringstream is2("1.5\n2.5\nnan\n");
+		read_table2 r2(is2);
+		ret = check(!s2.add(r2) && s2.get_last_error() == T_NAN, "NaN key not detected") && ret;
+		s2.clear();
+		external_sort<int64_t> s3(0, line_parser_params().set_delim('\t'), run_size, nthreads, tmp_dir);
+		std::istringstream is3(input);
+		read_table2 r3(is3, line_parser_params().set_delim('\t'));
+		size_t n = 0;
+		ret = check(s3.add(r3) && !s3.merge([&n](const int64_t&, const char*, size_t) { return ++n < 10; }) &&
+			s3.get_last_error() == T_OK && n == 10 && s3.nruns() == 0, "stopping the merge") && ret;
+	}
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+
@@ -0,0 +1,379 @@
+/*  -*- C -*-
+ * read_table_sparse.h -- reading sparse data in the libsvm / svmlight
+ * 	format, i.e. lines like "label idx:val idx:val ..."
+ *
+ * Each line is parsed with the number conversion functions of read_table.h
+ * (so the same checks for format errors and overflow apply), and the rows
+ * are stored in compressed sparse row (CSR) format: a label for each row,
+ * and the indices and values of all rows in two arrays, with the start of
+ * each row in a separate array of offsets. Regular files can be read in
+ * parallel (see read_table_parallel.h), the result is the same as reading
+ * sequentially. The arrays are counted in the memory accounts (see
+ * read_table_memory.h; sp.mem can be set to a separate account), and
+ * reading fails with T_MEMORY if they would exceed a limit.
+ *
+ * Note: this requires linking with -pthread (see read_table_parallel.h)
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * example usage:
+
+read_table r;
+read_table_init(&r, 0); // r is only used for parameters and to return errors
+read_table_sparse sp;
+read_table_sparse_init(&sp);
+// read all rows, indices should be between 1 and 1000000, use 4 threads
+if(read_table_sparse_read("input.svm", &r, &sp, 1, 1000000, 4))
+	read_table_write_error(&r, stderr);
+for(size_t i = 0; i < sp.nrows; i++) {
+	double label = sp.labels[i];
+	for(uint64_t j = sp.offsets[i]; j < sp.offsets[i+1]; j++) {
+		uint32_t idx = sp.indices[j];
+		double val = sp.values[j];
+		...
+	}
+}
+read_table_sparse_free(&sp);
+
+ */
+
+#ifndef READ_TABLE_SPARSE_H
+#define READ_TABLE_SPARSE_H
+
+#include "read_table_parallel.h"
+
+/* sparse rows in CSR format */
+typedef struct read_table_sparse_s {
+	size_t nrows; /* number of rows */
+	size_t nnz; /* total number of index:value pairs */
+	double* labels; /* label of each row (nrows) */
+	uint64_t* offsets; /* start of each row in indices and values (nrows + 1) */
+	uint32_t* indices; /* indices of all rows (nnz) */
+	double* values; /* values of all rows (nnz) */
+	size_t rows_size; /* allocated size of labels (and offsets - 1) */
+	size_t nnz_size; /* allocated size of indices and values */
+	read_table_mem* mem; /* optional memory account for the arrays (see read_table_memory.h) */
+	size_t mem_tracked; /* size of the arrays counted in mem and the global account */
+} read_table_sparse;
+
+static void read_table_sparse_init(read_table_sparse* sp) {
+	sp->nrows = 0;
+	sp->nnz = 0;
+	sp->labels = 0;
+	sp->offsets = 0;
+	sp->indices = 0;
+	sp->values = 0;
+	sp->rows_size = 0;
+	sp->nnz_size = 0;
+	sp->mem = 0;
+	sp->mem_tracked = 0;
+}
+
+/* free the arrays (the memory account is kept) */
+static void read_table_sparse_free(read_table_sparse* sp) {
+	read_table_mem* mem = sp->mem;
+	if(sp->labels) free(sp->labels);
+	if(sp->offsets) free(sp->offsets);
+	if(sp->indices) free(sp->indices);
+	if(sp->values) free(sp->values);
+	read_table_mem_update(sp->mem, &(sp->mem_tracked), 0);
+	read_table_sparse_init(sp);
+	sp->mem = mem;
+}
+
+/* memory used by the arrays with the given allocated sizes */
+static size_t read_table_sparse_mem_size(size_t rows_size, size_t nnz_size) {
+	return rows_size ? rows_size * sizeof(double) + (rows_size + 1) * sizeof(uint64_t) +
+		nnz_size * (sizeof(uint32_t) + sizeof(double)) : nnz_size * (sizeof(uint32_t) + sizeof(double));
+}
+
+/* ensure that there is space for at least the given number of rows and
+ * pairs; returns 0 on success, 1 on memory allocation error or if this
+ * would exceed the limit of the memory accounts (the new size is counted
+ * before allocating) */
+static int read_table_sparse_reserve(read_table_sparse* sp, size_t rows, size_t nnz) {
+	size_t rows_size = sp->rows_size;
+	size_t nnz_size = sp->nnz_size;
+	if(rows > sp->rows_size || !sp->offsets) {
+		rows_size = sp->rows_size ? sp->rows_size : 1024;
+		while(rows_size < rows) rows_size *= 2;
+	}
+	if(nnz > sp->nnz_size) {
+		nnz_size = sp->nnz_size ? sp->nnz_size : 4096;
+		while(nnz_size < nnz) nnz_size *= 2;
+	}
+	if(read_table_mem_update(sp->mem, &(sp->mem_tracked), read_table_sparse_mem_size(rows_size, nnz_size)))
+		return 1;
+	if(rows_size != sp->rows_size || !sp->offsets) {
+		size_t size = rows_size;
+		double* labels = (double*)realloc(sp->labels, size * sizeof(double));
+		if(!labels) return 1;
+		sp->labels = labels;
+		uint64_t* offsets = (uint64_t*)realloc(sp->offsets, (size + 1) * sizeof(uint64_t));
+		if(!offsets) return 1;
+		if(!sp->offsets) offsets[0] = 0;
+		sp->offsets = offsets;
+		sp->rows_size = size;
+	}
+	if(nnz_size != sp->nnz_size) {
+		size_t size = nnz_size;
+		uint32_t* indices = (uint32_t*)realloc(sp->indices, size * sizeof(uint32_t));
+		if(!indices) return 1;
+		sp->indices = indices;
+		double* values = (double*)realloc(sp->values, size * sizeof(double));
+		if(!values) return 1;
+		sp->values = values;
+		sp->nnz_size = size;
+	}
+	return 0;
+}
+
+/* parse one index:value pair; the index is read with ':' as a delimiter,
+ * the value is read with the original delimiter
+ * returns 0 on success, 1 on error (T_EOL if there are no more pairs) */
+static int read_table_sparse_pair(read_table* r, uint32_t* idx, double* val,
+		uint32_t min_index, uint32_t max_index) {
+	char delim = r->delim;
+	int ret;
+	r->delim = ':';
+	ret = read_table_uint32_limits(r, idx, min_index, max_index);
+	r->delim = delim;
+	if(ret) return 1;
+	/* note: the delimiter (':') is skipped at this point, but blanks
+	 * before it are not allowed */
+	if(r->pos > 1 && r->buf[r->pos - 1] == ':' &&
+			(r->buf[r->pos - 2] == ' ' || r->buf[r->pos - 2] == '\t')) {
+		r->pos--;
+		while(r->buf[r->pos - 1] == ' ' || r->buf[r->pos - 1] == '\t') r->pos--;
+		r->last_error = T_FORMAT;
+		return 1;
+	}
+	/* a value is required after the delimiter */
+	if(r->pos == r->line_len || r->buf[r->pos] == ' ' || r->buf[r->pos] == '\t' ||
+			r->buf[r->pos] == '\n' || r->buf[r->pos] == '\r') {
+		r->last_error = T_MISSING;
+		return 1;
+	}
+	return read_table_double(r, val);
+}
+
+/* parse the current line of r and add it as a new row to sp; indices
+ * should be between min_index and max_index (inclusive)
+ * returns 0 on success, 1 on error (r->last_error is set, and nothing
+ * is added to sp) */
+static int read_table_sparse_line(read_table* r, read_table_sparse* sp,
+		uint32_t min_index, uint32_t max_index) {
+	size_t nnz = sp->nnz;
+	if(read_table_sparse_reserve(sp, sp->nrows + 1, nnz + 1)) {
+		r->last_error = T_MEMORY;
+		return 1;
+	}
+	if(read_table_double(r, sp->labels + sp->nrows)) return 1;
+	while(1) {
+		uint32_t idx;
+		double val;
+		if(read_table_sparse_pair(r, &idx, &val, min_index, max_index)) {
+			if(r->last_error == T_EOL) break;
+			return 1;
+		}
+		if(nnz == sp->nnz_size && read_table_sparse_reserve(sp, sp->nrows + 1, nnz + 1)) {
+			r->last_error = T_MEMORY;
+			return 1;
+		}
+		sp->indices[nnz] = idx;
+		sp->values[nnz] = val;
+		nnz++;
+	}
+	r->last_error = T_OK;
+	sp->nnz = nnz;
+	sp->nrows++;
+	sp->offsets[sp->nrows] = nnz;
+	return 0;
+}
+
+
+/* reading in parallel: each thread stores the rows it reads in a separate
+ * read_table_sparse struct, along with a list of segments (consecutive
+ * lines of the input); these are sorted by the line numbers and copied in
+ * order at the end */
+typedef struct read_table_sparse_segment_s {
+	uint64_t first_line; /* line number of the first row */
+	size_t row; /* first row in the thread's results */
+	size_t nrows;
+	unsigned int thread; /* thread that read these rows */
+} read_table_sparse_segment;
+
+typedef struct read_table_sparse_thread_s {
+	read_table_sparse sp;
+	read_table_sparse_segment* segments;
+	size_t nsegments;
+	size_t segments_size;
+	uint64_t last_line; /* line of the last row read */
+} read_table_sparse_thread;
+
+typedef struct read_table_sparse_data_s {
+	read_table_sparse_thread* threads;
+	uint32_t min_index;
+	uint32_t max_index;
+} read_table_sparse_data;
+
+static int read_table_sparse_cb(read_table* r, void* user_data, unsigned int thread_id) {
+	read_table_sparse_data* d = (read_table_sparse_data*)user_data;
+	read_table_sparse_thread* t = d->threads + thread_id;
+	if(!t->nsegments || r->line != t->last_line + 1) {
+		/* start of a new chunk (or empty lines were skipped) */
+		if(t->nsegments == t->segments_size) {
+			size_t size = t->segments_size ? 2 * t->segments_size : 16;
+			read_table_sparse_segment* tmp = (read_table_sparse_segment*)realloc(t->segments,
+				size * sizeof(read_table_sparse_segment));
+			if(!tmp) {
+				r->last_error = T_MEMORY;
+				return 1;
+			}
+			t->segments = tmp;
+			t->segments_size = size;
+		}
+		t->segments[t->nsegments].first_line = r->line;
+		t->segments[t->nsegments].row = t->sp.nrows;
+		t->segments[t->nsegments].nrows = 0;
+		t->segments[t->nsegments].thread = thread_id;
+		t->nsegments++;
+	}
+	if(read_table_sparse_line(r, &(t->sp), d->min_index, d->max_index)) return 1;
+	t->segments[t->nsegments - 1].nrows++;
+	t->last_line = r->line;
+	return 0;
+}
+
+static int read_table_sparse_segment_cmp(const void* x, const void* y) {
+	const read_table_sparse_segment* s1 = (const read_table_sparse_segment*)x;
+	const read_table_sparse_segment* s2 = (const read_table_sparse_segment*)y;
+	return (s1->first_line > s2->first_line) - (s1->first_line < s2->first_line);
+}
+
+/* copy the rows of the segments to sp, in the order of the lines;
+ * if max_line is not zero, only lines before it are copied
+ * returns 0 on success, 1 on memory allocation error */
+static int read_table_sparse_merge(read_table_sparse* sp, read_table_sparse_thread* threads,
+		unsigned int nthreads, uint64_t max_line) {
+	size_t nseg = 0;
+	size_t nrows = sp->nrows, nnz = sp->nnz;
+	size_t i, j;
+	unsigned int k;
+	read_table_sparse_segment* segs;
+	for(k = 0; k < nthreads; k++) nseg += threads[k].nsegments;
+	segs = (read_table_sparse_segment*)malloc((nseg ? nseg : 1) * sizeof(read_table_sparse_segment));
+	if(!segs) return 1;
+	nseg = 0;
+	for(k = 0; k < nthreads; k++) for(i = 0; i < threads[k].nsegments; i++) {
+		const read_table_sparse_segment* s = threads[k].segments + i;
+		if(max_line && s->first_line >= max_line) continue;
+		segs[nseg++] = *s;
+		nrows += s->nrows;
+		nnz += threads[k].sp.offsets[s->row + s->nrows] - threads[k].sp.offsets[s->row];
+	}
+	qsort(segs, nseg, sizeof(read_table_sparse_segment), read_table_sparse_segment_cmp);
+	if(read_table_sparse_reserve(sp, nrows, nnz)) {
+		free(segs);
+		return 1;
+	}
+	for(j = 0; j < nseg; j++) {
+		const read_table_sparse_segment* s = segs + j;
+		const read_table_sparse_thread* t = threads + s->thread;
+		uint64_t o1 = t->sp.offsets[s->row];
+		uint64_t o2 = t->sp.offsets[s->row + s->nrows];
+		memcpy(sp->labels + sp->nrows, t->sp.labels + s->row, s->nrows * sizeof(double));
+		memcpy(sp->indices + sp->nnz, t->sp.indices + o1, (o2 - o1) * sizeof(uint32_t));
+		memcpy(sp->values + sp->nnz, t->sp.values + o1, (o2 - o1) * sizeof(double));
+		for(i = 0; i < s->nrows; i++)
+			sp->offsets[sp->nrows + i + 1] = sp->nnz + t->sp.offsets[s->row + i + 1] - o1;
+		sp->nrows += s->nrows;
+		sp->nnz += o2 - o1;
+	}
+	free(segs);
+	return 0;
+}
+
+/* read all lines of the given file (or stdin if fn is NULL), adding them
+ * to sp; indices should be between min_index and max_index (inclusive);
+ * regular files are processed in parallel with nthreads threads (0 means
+ * the number of processors), otherwise the input is read sequentially
+ * parameters (delimiter, comment character) are taken from r, which is
+ * also used to return errors
+ * returns 0 on success, 1 on error; in the latter case, sp contains the
+ * rows before the error */
+static int read_table_sparse_read(const char* fn, read_table* r, read_table_sparse* sp,
+		uint32_t min_index, uint32_t max_index, unsigned int nthreads) {
+	struct stat st;
+	int ret;
+	unsigned int k;
+	if(!(r && sp)) return 1;
+	if(read_table_sparse_reserve(sp, 1, 0)) {
+		r->last_error = T_MEMORY;
+		return 1;
+	}
+	if(fn && !stat(fn, &st) && S_ISREG(st.st_mode)) {
+		read_table_sparse_data d;
+		if(!nthreads) nthreads = read_table_default_nthreads();
+		d.min_index = min_index;
+		d.max_index = max_index;
+		d.threads = (read_table_sparse_thread*)calloc(nthreads, sizeof(read_table_sparse_thread));
+		if(!d.threads) {
+			r->last_error = T_MEMORY;
+			return 1;
+		}
+		for(k = 0; k < nthreads; k++) {
+			read_table_sparse_init(&(d.threads[k].sp));
+			d.threads[k].sp.mem = sp->mem; /* note: the same account is used while reading */
+		}
+		ret = read_table_parallel(fn, r, nthreads, read_table_sparse_cb, &d);
+		if(read_table_sparse_merge(sp, d.threads, nthreads, ret ? r->line : 0) && !ret) {
+			r->last_error = T_MEMORY;
+			ret = 1;
+		}
+		for(k = 0; k < nthreads; k++) {
+			read_table_sparse_free(&(d.threads[k].sp));
+			if(d.threads[k].segments) free(d.threads[k].segments);
+		}
+		free(d.threads);
+		return ret;
+	}
+	/* read sequentially (e.g. from a pipe) */
+	read_table r2;
+	if(read_table_seq_open(fn, r, &r2)) return 1;
+	while(read_table_line(&r2) == 0)
+		if(read_table_sparse_line(&r2, sp, min_index, max_index)) break;
+	ret = (r2.last_error != T_EOF);
+	read_table_seq_close(r, &r2);
+	return ret;
+}
+
+#endif /* READ_TABLE_SPARSE_H */
+
@@ -0,0 +1,86 @@
+/*
+ * read_table_sparse_test.c -- simple test for read_table_sparse.h
+ *
+ * reads the given file (-i, or stdin) in the libsvm format and writes the
+ * number of rows, pairs and the sum of labels, indices and values (-s: read
+ * the file sequentially instead of in parallel, -t: number of threads,
+ * -m: maximum index, -c: comment character)
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include "read_table_sparse.h"
+
+
+int main(int argc, char **argv)
+{
+	char* fn = 0;
+	int i;
+	char comment = 0;
+	unsigned int nthreads = 0;
+	uint32_t max_index = UINT32_MAX;
+	int seq = 0;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'i':
+			fn = argv[i+1];
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'm':
+			max_index = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'c':
+			comment = argv[i+1][0];
+			i++;
+			break;
+		case 's':
+			seq = 1;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	/* note: only regular files are read in parallel, so reading the
+	 * file through stdin is sequential */
+	if(seq && fn) {
+		if(!freopen(fn,"r",stdin)) {
+			fprintf(stderr,"Error opening input file %s!\n",fn);
+			return 1;
+		}
+		fn = 0;
+	}
+
+	read_table r;
+	read_table_init(&r,0);
+	if(comment) read_table_set_comment(&r,comment);
+	read_table_sparse sp;
+	read_table_sparse_init(&sp);
+	int ret = read_table_sparse_read(fn,&r,&sp,0,max_index,nthreads);
+	if(ret) read_table_write_error(&r,stderr);
+
+	double labels = 0.0;
+	double values = 0.0;
+	uint64_t indices = 0;
+	size_t j;
+	for(j=0;j<sp.nrows;j++) {
+		uint64_t k;
+		labels += sp.labels[j];
+		for(k=sp.offsets[j];k<sp.offsets[j+1];k++) {
+			indices += sp.indices[k];
+			values += sp.values[k];
+		}
+	}
+	fprintf(stdout,"Read %lu rows, %lu pairs, sum of labels: %f, indices: %lu, values: %f\n",
+		sp.nrows,sp.nnz,labels,indices,values);
+	read_table_sparse_free(&sp);
+	return ret;
+}
+
@@ -0,0 +1,158 @@
+/*
+ * read_table_validate.c -- check that a text file conforms to a schema
+ * 	without storing any of the values
+ *
+ * usage: read_table_validate -s schema -i input [-d delim] [-c comment]
+ * 	[-p decimal] [-t nthreads] [-k nerrors] [-n] [-x]
+ *
+ * schema is a comma-separated list of column types, optionally with
+ * bounds, e.g. -s u32:1:100,d:-180:180,x,s,i16
+ * types: x (skip), s (string), i16, u16, i32, u32, i64, u64, d (double)
+ * -p: decimal separator in the input (e.g. -p , -d ";" for files using
+ * 	decimal commas; bounds in the schema always use '.')
+ * -k: number of error locations to output (default: 10)
+ * -n: NaN and infinite values are considered errors
+ * -x: allow extra columns after the ones in the schema
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+#include "read_table_parallel.h"
+
+
+/* parse one column specification, return 0 on success */
+int parse_col(const char* str, size_t len, read_table_col* c) {
+	static const char* const names[] = {"x", "s", "i16", "u16", "i32", "u32", "i64", "u64", "d"};
+	size_t i;
+	size_t tlen;
+	for(tlen = 0; tlen < len && str[tlen] != ':'; tlen++);
+	for(i = 0; i < sizeof(names)/sizeof(names[0]); i++)
+		if(strlen(names[i]) == tlen && !strncmp(names[i], str, tlen)) break;
+	if(i == sizeof(names)/sizeof(names[0])) return 1;
+	c->type = (enum read_table_types)i;
+	c->has_bounds = 0;
+	if(tlen == len) return 0;
+	if(c->type == RT_SKIP || c->type == RT_STRING) return 1; /* no bounds possible */
+
+	/* parse bounds, reusing the library functions */
+	read_table r;
+	read_table_init(&r, 0);
+	char* tmp = strndup(str + tlen + 1, len - tlen - 1);
+	if(!tmp) return 1;
+	r.buf = tmp;
+	r.line_len = strlen(tmp);
+	read_table_set_delim(&r, ':');
+	read_table_col c2 = *c; /* same type without bounds */
+	int ret = read_table_read_col(&r, &c2, &(c->min)) || read_table_read_col(&r, &c2, &(c->max)) ||
+		read_table_check_end(&r);
+	free(tmp);
+	c->has_bounds = 1;
+	return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+	char* fn = 0;
+	char* schema = 0;
+	int i;
+	char delim = 0;
+	char comment = 0;
+	char decimal = 0;
+	unsigned int nthreads = 0;
+	size_t max_first = 10;
+	int allow_nan_inf = 1;
+	int allow_extra = 0;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'i':
+			fn = argv[i+1];
+			i++;
+			break;
+		case 's':
+			schema = argv[i+1];
+			i++;
+			break;
+		case 't':
+			nthreads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'k':
+			max_first = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 'n':
+			allow_nan_inf = 0;
+			break;
+		case 'x':
+			allow_extra = 1;
+			break;
+		case 'd':
+			delim = argv[i+1][0];
+			i++;
+			break;
+		case 'c':
+			comment = argv[i+1][0];
+			i++;
+			break;
+		case 'p':
+			decimal = argv[i+1][0];
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+
+	if(!(fn && schema)) {
+		fprintf(stderr,"Input file (-i) and schema (-s) are required!\n");
+		return 1;
+	}
+
+	/* parse the schema */
+	size_t ncols = 1;
+	for(i=0;schema[i];i++) if(schema[i] == ',') ncols++;
+	read_table_col* cols = (read_table_col*)malloc(ncols * sizeof(read_table_col));
+	read_table_error_loc* first = (read_table_error_loc*)malloc((max_first + 1) * sizeof(read_table_error_loc));
+	if(!(cols && first)) {
+		fprintf(stderr,"Error allocating memory!\n");
+		free(cols);
+		free(first);
+		return 1;
+	}
+	{
+		const char* p = schema;
+		size_t j;
+		for(j=0;j<ncols;j++) {
+			const char* e = strchr(p, ',');
+			size_t len = e ? (size_t)(e - p) : strlen(p);
+			if(parse_col(p, len, cols + j)) {
+				fprintf(stderr,"Invalid column specification: %.*s!\n", (int)len, p);
+				free(cols);
+				free(first);
+				return 1;
+			}
+			p += len + 1;
+		}
+	}
+
+	read_table r;
+	read_table_init(&r,0);
+	if(delim) read_table_set_delim(&r,delim);
+	if(comment) read_table_set_comment(&r,comment);
+	if(decimal) read_table_set_decimal(&r,decimal);
+	if(!allow_nan_inf) r.flags &= ~READ_TABLE_ALLOW_NAN_INF;
+
+	read_table_validate_report rep;
+	read_table_validate_report_init(&rep, first, max_first);
+	int ret = read_table_validate(fn, &r, cols, ncols, allow_extra, nthreads, &rep);
+	if(ret && r.last_error != T_EOF) read_table_write_error(&r,stderr);
+	else read_table_validate_report_write(&rep, fn, stdout);
+
+	free(cols);
+	free(first);
+	return ret;
+}
+
@@ -0,0 +1,301 @@
+/*
+ * read_table_validate_test.c -- simple test cases for read_table_validate()
+ * 	in read_table_parallel.h (used by read_table_validate.c)
+ *
+ * usage: read_table_validate_test [-n lines] [-t max_threads] [-k nerrors]
+ *
+ * a file with the given number of lines (default: 20000, with some empty
+ * and comment lines as well) is generated for the schema
+ * u32:1:1000000,d:-180:180,i16,s,d (with ',' as the delimiter), and
+ * errors are planted in every 97th line: invalid numbers, values out of
+ * bounds or overflowing, empty fields, NaN and infinity (allowed or not,
+ * and never allowed with bounds), missing and extra fields
+ * 1. the file is read sequentially, checking each line with the schema:
+ * errors should be found in the lines where they were planted, with the
+ * expected error codes
+ * 2. the file is validated with 1 to max_threads threads (default: 8)
+ * and several small chunk sizes (so that errors are found in many
+ * chunks): the reports should be the same as reading sequentially (the
+ * number of lines checked, the number of errors of each type and the
+ * line, position and column of the first errors, default: 5, and also
+ * of all of them)
+ * both are done allowing or not NaN and infinity and extra fields
+ *
+ * Copyright 2021 Daniel Kondor <kondor.dani@gmail.com>
+ *
+ */
+
+
+#include <stdio.h>
+
+/* note: the chunk size is changed by the test, the parallel reader
+ * uses this variable instead of a constant */
+static size_t test_chunk_size = 4096;
+#define READ_TABLE_CHUNK_SIZE test_chunk_size
+
+#include "read_table_parallel.h"
+
+
+static int check(int cond, const char* desc) {
+	if(!cond) fprintf(stderr,"Error: %s!\n",desc);
+	return cond;
+}
+
+/* schema: u32:1:1000000,d:-180:180,i16,s,d */
+#define NCOLS 5
+static void init_cols(read_table_col* cols) {
+	memset(cols, 0, NCOLS * sizeof(read_table_col));
+	cols[0].type = RT_UINT32;
+	cols[0].has_bounds = 1;
+	cols[0].min.u32 = 1;
+	cols[0].max.u32 = 1000000;
+	cols[1].type = RT_DOUBLE;
+	cols[1].has_bounds = 1;
+	cols[1].min.d = -180.0;
+	cols[1].max.d = 180.0;
+	cols[2].type = RT_INT16;
+	cols[3].type = RT_STRING;
+	cols[4].type = RT_DOUBLE;
+}
+
+/* types of errors planted */
+enum planted { P_FORMAT = 0, P_BOUNDS, P_INT16, P_MISSING, P_NAN, P_INF, P_EOL, P_EXTRA, P_ZERO,
+	P_NAN_BOUNDS, P_NTYPES };
+
+/* error code expected for each type of planted error; nan_inf: whether
+ * NaN and infinity are allowed, extra: whether extra fields are allowed;
+ * returns T_OK if the line is not an error */
+static enum read_table_errors planted_error(int p, int nan_inf, int extra) {
+	switch(p) {
+		case P_FORMAT: return T_FORMAT;
+		case P_BOUNDS: return T_OVERFLOW;
+		case P_INT16: return T_OVERFLOW;
+		case P_MISSING: return T_MISSING;
+		case P_NAN:
+		case P_INF: return nan_inf ? T_OK : T_NAN;
+		case P_EOL: return T_EOL;
+		case P_EXTRA: return extra ? T_OK : T_FORMAT;
+		case P_ZERO: return T_OVERFLOW;
+		case P_NAN_BOUNDS: return T_NAN;
+		default: return T_OK;
+	}
+}
+
+/* one line with a planted error */
+typedef struct {
+	uint64_t line; /* line number in the file */
+	int p; /* type of planted error */
+} planted_line;
+
+/* generate the input file into input; lines with errors are stored in
+ * errors (with space for nlines / 97 + 1 elements) and their number in
+ * nerrors; returns 0 on success, 1 on memory allocation error */
+static int gen_input(uint64_t nlines, read_table_outbuf* input, planted_line* errors, size_t* nerrors) {
+	uint64_t j, line = 0;
+	int err = 0;
+	*nerrors = 0;
+	for(j = 0; j < nlines && !err; j++) {
+		char id[32], x[32], k16[32], name[32], v[32];
+		char tmp[256];
+		size_t len;
+		int nf = 5;
+		if(j % 31 == 4) {
+			/* lines not checked */
+			err = read_table_out_string(input, "# comment, 1, 2\n\n", 17);
+			line += 2;
+		}
+		line++;
+		/* fields of a correct line */
+		sprintf(id, "%lu", (unsigned long)(j + 1));
+		sprintf(x, "%.3f", (double)(j % 3600) / 10.0 - 180.0);
+		sprintf(k16, "%d", (int)(j % 65536) - 32768);
+		sprintf(name, "name%lu", (unsigned long)(j % 1000));
+		sprintf(v, "%g", (double)j * 1.5e-3 - 1e3);
+		if(j % 97 == 13) {
+			int p = (int)((j / 97) % P_NTYPES);
+			switch(p) {
+				case P_FORMAT: strcat(id, "x"); break;
+				case P_BOUNDS: strcpy(x, "180.001"); break;
+				case P_INT16: strcpy(k16, "32768"); break;
+				case P_MISSING: k16[0] = 0; break;
+				case P_NAN: strcpy(v, "nan"); break;
+				case P_INF: strcpy(v, "-inf"); break;
+				case P_EOL: nf = 4; break;
+				case P_EXTRA: nf = 6; break;
+				case P_ZERO: strcpy(id, "0"); break;
+				case P_NAN_BOUNDS: strcpy(x, "NaN"); break;
+			}
+			errors[*nerrors].line = line;
+			errors[*nerrors].p = p;
+			(*nerrors)++;
+		}
+		len = sprintf(tmp, "%s,%s,%s,%s", id, x, k16, name);
+		if(nf > 4) len += sprintf(tmp + len, ",%s", v);
+		if(nf > 5) len += sprintf(tmp + len, ",%s", name);
+		if(j % 7 == 2) len += sprintf(tmp + len, " # comment");
+		if(j + 1 < nlines) tmp[len++] = '\n'; /* note: no newline after the last line */
+		err = err || read_table_out_string(input, tmp, len);
+	}
+	return err;
+}
+
+/* 1. read the file sequentially with the schema and r (which gives the
+ * parameters), storing the location of all errors in locs (with space
+ * for one for each line) and the number of lines checked in ndata;
+ * returns the number of errors, or (size_t)-1 if the file could not be
+ * read */
+static size_t read_seq(const char* fn, read_table* r, const read_table_col* cols, int extra,
+		read_table_error_loc* locs, uint64_t* ndata) {
+	read_table r2;
+	size_t n = 0;
+	*ndata = 0;
+	if(read_table_seq_open(fn, r, &r2)) return (size_t)-1;
+	while(read_table_line(&r2) == 0) {
+		read_table_value val;
+		size_t i;
+		(*ndata)++;
+		for(i = 0; i < NCOLS; i++) if(read_table_read_col(&r2, cols + i, &val)) break;
+		if(i == NCOLS && (extra || !read_table_check_end(&r2))) continue;
+		locs[n].line = r2.line;
+		locs[n].pos = r2.pos;
+		locs[n].col = r2.col;
+		locs[n].err = r2.last_error;
+		n++;
+		r2.last_error = T_OK;
+	}
+	read_table_seq_close(r, &r2);
+	return (r->last_error == T_EOF) ? n : (size_t)-1;
+}
+
+/* compare the errors found when reading sequentially to the planted ones */
+static int check_planted(const read_table_error_loc* locs, size_t n, const planted_line* errors,
+		size_t nerrors, int nan_inf, int extra) {
+	size_t i, j = 0;
+	for(i = 0; i < nerrors; i++) {
+		enum read_table_errors e = planted_error(errors[i].p, nan_inf, extra);
+		if(e == T_OK) continue;
+		if(j >= n || locs[j].line != errors[i].line || locs[j].err != e) return 0;
+		j++;
+	}
+	return j == n;
+}
+
+/* 2. compare the report to the errors found when reading sequentially */
+static int check_report(const read_table_validate_report* rep, const read_table_error_loc* locs, size_t n,
+		uint64_t ndata) {
+	uint64_t nerr[READ_TABLE_NERRORS];
+	size_t i;
+	if(rep->lines != ndata || rep->nfirst != (n < rep->max_first ? n : rep->max_first)) return 0;
+	for(i = 0; i < READ_TABLE_NERRORS; i++) nerr[i] = 0;
+	for(i = 0; i < n; i++) nerr[locs[i].err]++;
+	for(i = 0; i < READ_TABLE_NERRORS; i++) if(rep->nerrors[i] != nerr[i]) return 0;
+	for(i = 0; i < rep->nfirst; i++) if(rep->first[i].line != locs[i].line ||
+		rep->first[i].pos != locs[i].pos || rep->first[i].col != locs[i].col ||
+		rep->first[i].err != locs[i].err) return 0;
+	return 1;
+}
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	uint64_t nlines = 20000;
+	unsigned int max_threads = 8;
+	size_t max_first = 5;
+	for(i=1;i<argc;i++) if(argv[i][0] == '-') switch(argv[i][1]) {
+		case 'n':
+			nlines = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		case 't':
+			max_threads = atoi(argv[i+1]);
+			i++;
+			break;
+		case 'k':
+			max_first = strtoul(argv[i+1],0,10);
+			i++;
+			break;
+		default:
+			fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			break;
+	}
+	if(nlines < 1000) nlines = 1000;
+	if(!max_threads) max_threads = 1;
+	if(!max_first) max_first = 1;
+	int ret = 1;
+
+	read_table_col cols[NCOLS];
+	init_cols(cols);
+
+	read_table_outbuf input;
+	size_t nerrors;
+	planted_line* errors = (planted_line*)malloc((nlines / 97 + 1) * sizeof(planted_line));
+	read_table_error_loc* locs = (read_table_error_loc*)malloc(nlines * sizeof(read_table_error_loc));
+	read_table_error_loc* first = (read_table_error_loc*)malloc(nlines * sizeof(read_table_error_loc));
+	char fn[] = "/tmp/read_table_validate_test.XXXXXX";
+	int fd = -1;
+	read_table_outbuf_init(&input);
+	if(!(errors && locs && first) || gen_input(nlines, &input, errors, &nerrors) || (fd = mkstemp(fn)) < 0 ||
+			read_table_write_all(fd, input.buf, input.len)) {
+		fprintf(stderr,"Error creating the input file!\n");
+		if(fd >= 0) unlink(fn);
+		return 1;
+	}
+	close(fd);
+	read_table_outbuf_free(&input);
+
+	int nan_inf, extra;
+	for(nan_inf = 0; nan_inf < 2; nan_inf++) for(extra = 0; extra < 2; extra++) {
+		read_table r;
+		uint64_t ndata;
+		read_table_init(&r, 0);
+		read_table_set_delim(&r, ',');
+		read_table_set_comment(&r, '#');
+		if(!nan_inf) r.flags &= ~READ_TABLE_ALLOW_NAN_INF;
+
+		/* 1. reading sequentially */
+		size_t n = read_seq(fn, &r, cols, extra, locs, &ndata);
+		if(!check(n != (size_t)-1 && ndata == nlines && check_planted(locs, n, errors, nerrors, nan_inf, extra),
+				"errors found when reading sequentially are different from the planted ones")) {
+			fprintf(stderr,"(NaN %sallowed, extra fields %sallowed)\n", nan_inf ? "" : "not ", extra ? "" : "not ");
+			ret = 0;
+			continue;
+		}
+
+		/* 2. validating in parallel */
+		const size_t chunk_sizes[] = {1000, 4096, 65536};
+		size_t k;
+		for(k = 0; k < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); k++) {
+			unsigned int nthreads;
+			test_chunk_size = chunk_sizes[k];
+			for(nthreads = 1; nthreads <= max_threads; nthreads++) {
+				size_t kk;
+				/* first K errors and all of them */
+				for(kk = max_first; kk; kk = (kk < n ? n : 0)) {
+					read_table_validate_report rep;
+					read_table_validate_report_init(&rep, first, kk);
+					r.last_error = T_OK;
+					int res = read_table_validate(fn, &r, cols, NCOLS, extra, nthreads, &rep);
+					if(!(res == (n ? 1 : 0) && r.last_error == T_EOF && check_report(&rep, locs, n, ndata))) {
+						fprintf(stderr,"Error: wrong report with %u threads, chunk size %lu "
+							"(NaN %sallowed, extra fields %sallowed, %lu locations)!\n",
+							nthreads, (unsigned long)test_chunk_size, nan_inf ? "" : "not ",
+							extra ? "" : "not ", (unsigned long)kk);
+						if(r.last_error != T_EOF) read_table_write_error(&r, stderr);
+						else read_table_validate_report_write(&rep, fn, stderr);
+						ret = 0;
+					}
+				}
+			}
+		}
+		read_table_free_buf(&r);
+	}
+	unlink(fn);
+	free(errors);
+	free(locs);
+	free(first);
+
+	if(ret) fprintf(stdout,"All tests passed\n");
+	return ret ? 0 : 1;
+}
+